@@ -9,9 +9,16 @@
 
 #include <Gamma/Noise.h>
 
+#include "playground/DeltaState.hpp"
+#include "playground/IcoMesh.hpp"
+#include "playground/SpringMesh.hpp"
+#include "playground/WorkerPool.hpp"
+
 using namespace al;
 
+#include <cstdlib> // getenv
 #include <iostream> // cout
+#include <memory> // unique_ptr
 #include <vector> // vector
 
 // This example demonstrates how to write a distributed application that
@@ -27,6 +34,12 @@ using namespace al;
 //#define N 163842
 //#define N 655362
 
+// With BLOB_DELTA_STATE the vertices leave the cuttlebone state and go to the
+// renderers as compressed deltas (see playground/DeltaState.hpp): 16 bit
+// positions, only the regions that changed, LZ compressed. Renderers find
+// the simulator through the BLOB_SIMULATOR environment variable.
+#define BLOB_DELTA_STATE 1
+
 struct State {
   Pose pose; // for navigation
 
@@ -47,67 +60,16 @@ struct State {
   // on the server/simulator, so it does not need to be calculated on the
   // renderer, only interpreted.
   //
+  // large meshes are better sent as deltas, outside of the state.
+  //
 
+#if !BLOB_DELTA_STATE
   Vec3f p[N];
+#endif
 };
 
-// Load file into mesh
-bool load(std::string fileName, Mesh &mesh, std::vector<std::vector<int>> &nn) {
-  std::ifstream file(fileName);
-  if (!file.is_open())
-    return false;
-
-  std::string line;
-  int state = 0;
-  while (getline(file, line)) {
-    if (line == "|") {
-      state++;
-      continue;
-    }
-    switch (state) {
-    case 0: {
-      std::vector<float> v;
-      std::stringstream ss(line);
-      float f;
-      while (ss >> f) {
-        v.push_back(f);
-        if (ss.peek() == ',')
-          ss.ignore();
-      }
-      mesh.vertex(v[0], v[1], v[2]);
-      // cout << v[0] << "|" << v[1] << "|" << v[2] << endl;
-    } break;
-
-    case 1: {
-      std::stringstream ss(line);
-      int i;
-      if (ss >> i)
-        mesh.index(i);
-      else
-        return false;
-      // cout << i << endl;
-    } break;
-
-    case 2: {
-      std::vector<int> v;
-      std::stringstream ss(line);
-      int i;
-      while (ss >> i) {
-        v.push_back(i);
-        if (ss.peek() == ',')
-          ss.ignore();
-      }
-      if ((v.size() != 5) && (v.size() != 6))
-        return false;
-      nn.push_back(v);
-      // cout << nn[nn.size() - 1].size() << endl;
-    } break;
-    }
-  }
-  file.close();
-
-  return true;
-}
+// Vertex positions are within this distance of the origin
+const float kPositionRange = 4.0f;
 
 #ifdef AL_WINDOWS
 // Damn you Windows!
@@ -134,14 +96,13 @@ struct Blob : DistributedAppWithState<State> {
   // Internal computation data
   // This data will not be shared to remote nodes, so you should only use it on
   // the simulator machine
-  vector<vector<int>> nn;
-  vector<Vec3f> velocity;
-  vector<Vec3f> original;
+  playground::SpringMesh springs;
+  std::unique_ptr<playground::WorkerPool> pool;
 
   // a boolean value that is read and reset (false) by the simulation step and
   // written (true) by audio, keyboard and mouse callbacks.
   bool shouldPoke;
-  unsigned pokedVertex;
+  unsigned pokedVertex = 0;
   Vec3f pokedVertexRest;
 
   // a mesh we use to do graphics rendering in this app
@@ -149,6 +110,12 @@ struct Blob : DistributedAppWithState<State> {
 
   gam::NoisePink<> pinkNoise;
 
+#if BLOB_DELTA_STATE
+  std::unique_ptr<playground::DeltaStateSender> sender;
+  std::unique_ptr<playground::DeltaStateReceiver> receiver;
+  vector<int16_t> quantized;
+#endif
+
   void onInit() override {
 
     mesh.primitive(Mesh::TRIANGLES);
@@ -158,23 +125,16 @@ struct Blob : DistributedAppWithState<State> {
     searchPaths.addSearchPath("/alloshare/blob", false);
     searchPaths.addAppPaths();
 
-    std::string icoSphereFile = std::to_string(N) + ".ico";
-
-    if (!load(searchPaths.find(icoSphereFile).filepath(), mesh, nn)) {
-      std::cout << "cannot find " << icoSphereFile << std::endl;
+    if (!load(searchPaths)) {
+      std::cout << "cannot find " << N << ".ico" << std::endl;
       quit();
+      return;
     }
+
     if (isPrimary()) {
       shouldPoke = true; // start with a poke
+      pool.reset(new playground::WorkerPool);
 
-      // Initialize simulation data
-      velocity.resize(mesh.vertices().size(), Vec3f(0, 0, 0));
-      original.resize(mesh.vertices().size());
-      for (int i = 0; i < mesh.vertices().size(); i++)
-        original[i] = mesh.vertices()[i];
-
-      for (int i = 0; i < N; i++)
-        state().p[i] = original[i];
       state().eyeSeparation = 0.03;
       state().backgroundColor = Color(0.1f, 0.1f);
       state().wireFrame = true;
@@ -193,6 +153,63 @@ struct Blob : DistributedAppWithState<State> {
       auto &gui = guiDomain->newGUI();
       gui << SK << NK << D << wireFrame << bgColor;
     }
+
+#if BLOB_DELTA_STATE
+    const size_t snapshotBytes = sizeof(int16_t) * 3 * N;
+    if (isPrimary()) {
+      quantized.resize(3 * N);
+      sender.reset(new playground::DeltaStateSender(snapshotBytes));
+      if (!sender->open()) {
+        std::cerr << "ERROR: Could not open delta state port." << std::endl;
+      }
+    } else {
+      const char *simulator = getenv("BLOB_SIMULATOR");
+      receiver.reset(new playground::DeltaStateReceiver(
+          snapshotBytes, simulator ? simulator : "127.0.0.1"));
+      if (!receiver->open()) {
+        std::cerr << "ERROR: Could not reach simulator for delta state."
+                  << std::endl;
+      }
+    }
+#endif
+  }
+
+  // Map N.icomesh into the mesh (and the springs on the simulator). The
+  // first run converts N.ico, next to it or else in the working directory.
+  bool load(SearchPaths &searchPaths) {
+    const std::string name = std::to_string(N);
+    std::string path = searchPaths.find(name + ".icomesh").filepath();
+    playground::IcoMeshFile file;
+    if (!file.open(path)) {
+      const std::string text = searchPaths.find(name + ".ico").filepath();
+      if (text.empty()) {
+        return false;
+      }
+      path = text.substr(0, text.size() - 4) + ".icomesh";
+      if (!playground::convertIcoText(text, path)) {
+        path = name + ".icomesh";
+        if (!playground::convertIcoText(text, path)) {
+          return false;
+        }
+      }
+      if (!file.open(path)) {
+        return false;
+      }
+    }
+    if (file.numVertices() != N) {
+      std::cout << path << " does not have " << N << " vertices" << std::endl;
+      return false;
+    }
+
+    mesh.vertices().resize(N);
+    memcpy(&mesh.vertices()[0], file.positions(), file.positionBytes());
+    mesh.indices().assign(file.indices(), file.indices() + file.numIndices());
+    if (isPrimary()) {
+      // Stored in solver order already
+      springs.build(N, file.positions(), file.neighborOffsets(),
+                    file.neighbors(), false);
+    }
+    return true;
   }
 
   //  void onCreate() override {}
@@ -204,31 +221,25 @@ struct Blob : DistributedAppWithState<State> {
       if (shouldPoke) {
         shouldPoke = false;
         int n = al::rnd::uniform(N);
-        pokedVertex = n;
-        pokedVertexRest = original[n];
+        springs.restPosition(n, pokedVertexRest.elems());
         Vec3f v = Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
-        for (unsigned k = 0; k < nn[n].size(); k++)
-          state().p[nn[n][k]] += v * 0.5;
-        state().p[n] += v;
+        springs.forEachNeighbor(n, [&](int k) {
+          springs.displace(k, v.x * 0.5f, v.y * 0.5f, v.z * 0.5f);
+        });
+        springs.displace(n, v.x, v.y, v.z);
+        pokedVertex = n;
       }
 
       // Compute new postions
-      for (int i = 0; i < N; i++) {
-        Vec3f &v = state().p[i];
-        Vec3f force = (v - original[i]) * -SK;
-
-        for (int k = 0; k < nn[i].size(); k++) {
-          Vec3f &n = state().p[nn[i][k]];
-          force += (v - n) * -NK;
-        }
-
-        force -= velocity[i] * D;
-        velocity[i] += force;
-      }
-
-      for (int i = 0; i < N; i++) {
-        state().p[i] += velocity[i];
-      }
+      springs.step(SK, NK, D, pool.get());
+      springs.copyPositions(&mesh.vertices()[0][0], pool.get());
+#if BLOB_DELTA_STATE
+      playground::quantize(&mesh.vertices()[0][0], 3 * N, kPositionRange,
+                           quantized.data());
+      sender->send(quantized.data());
+#else
+      memcpy(&state().p[0], &mesh.vertices()[0], sizeof(Vec3f) * N);
+#endif
 
       // Update variables in state to send to nodes
       state().pose = nav();
@@ -240,9 +251,17 @@ struct Blob : DistributedAppWithState<State> {
       pose() = state().pose;
       bgColor = state().backgroundColor;
       wireFrame = state().wireFrame;
+
+      // Copy vertex positions from state to mesh
+#if BLOB_DELTA_STATE
+      if (const uint8_t *snapshot = receiver->poll()) {
+        playground::dequantize(reinterpret_cast<const int16_t *>(snapshot),
+                               3 * N, kPositionRange, &mesh.vertices()[0][0]);
+      }
+#else
+      memcpy(&mesh.vertices()[0], &state().p[0], sizeof(Vec3f) * N);
+#endif
     }
-    // Copy vertex positions from state to mesh
-    memcpy(&mesh.vertices()[0], &state().p[0], sizeof(Vec3f) * N);
   }
 
   void onDraw(Graphics &g) override {
@@ -275,7 +294,9 @@ struct Blob : DistributedAppWithState<State> {
           }
         }
 
-        float f = (state().p[pokedVertex] - pokedVertexRest).mag() - 0.45;
+        Vec3f p;
+        springs.position(pokedVertex, p.elems());
+        float f = (p - pokedVertexRest).mag() - 0.45;
 
         if (f > 0.99) {
           f = 0.99;
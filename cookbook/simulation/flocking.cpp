@@ -15,6 +15,18 @@ calculating the "nearness" of flockmates. This is done primarily to avoid
 infinities, but also to give smoother motions. Lastly, we give each boid a
 random walk motion which helps both dissolve and redirect the flocks.
 
+Only flockmates within a few radii of each other interact (the Gaussians are
+negligible beyond that), so the boids are sorted into a grid of cells that
+size and each boid only looks at its own and the surrounding cells. Boids
+are stored as one array per coordinate, sorted by cell, and updated on all
+cores. All boids move from where the flock was at the start of the step, so
+the result does not depend on the order they are visited in.
+
+Keys 1 to 5 set the flock size from 32 up to 300000 boids; larger flocks get
+smaller radii so each boid sees about as many flockmates as in a flock of
+32. Run with --benchmark to print the time per step for a range of sizes, or
+with a number to start with that many boids.
+
 [1] Reynolds, C. W. (1987). Flocks, herds, and schools: A distributed behavioral
     model. Computer Graphics, 21(4):25–34.
 
@@ -22,28 +34,181 @@ Author:
 Lance Putnam, Oct. 2014
 */
 
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
 
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
 #include "al/math/al_Functions.hpp"
 #include "al/math/al_Random.hpp"
 
+#include "playground/SpatialGrid.hpp"
+#include "playground/WorkerPool.hpp"
+
 using namespace al;
 
-// A "boid" (play on bird) is one member of a flock.
-class Boid {
+// A flock of "boids" (play on bird). Each boid has a position and velocity,
+// kept as one array per coordinate.
+class Flock {
  public:
-  // Each boid has a position and velocity.
-  Vec2d pos, vel;
+  // Interactions as tuned for 32 boids
+  static constexpr int referenceSize = 32;
+  float pushRadius = 0.05f;
+  float pushStrength = 1.0f;
+  float matchRadius = 0.125f;
+  float huntUrge = 0.2f;
+
+  std::vector<float> x, y, vx, vy;
+  std::vector<int> id;  // which boid is at each index, for coloring
 
-  // Update position based on velocity and delta time
-  void update(double dt) { pos += vel * dt; }
+  int size() const { return int(x.size()); }
+
+  // Randomize boid positions/velocities uniformly inside unit disc
+  void reset(int n) {
+    x.resize(n);
+    y.resize(n);
+    vx.resize(n);
+    vy.resize(n);
+    id.resize(n);
+    for (int i = 0; i < n; ++i) {
+      Vec2f pos = rnd::ball<Vec2f>();
+      Vec2f vel = rnd::ball<Vec2f>();
+      x[i] = pos.x;
+      y[i] = pos.y;
+      vx[i] = vel.x;
+      vy[i] = vel.y;
+      id[i] = i;
+    }
+  }
+
+  void step(float dt, playground::WorkerPool* pool) {
+    const int n = size();
+    // Keep the number of flockmates in reach about the same for any flock
+    const float scale =
+        n > referenceSize ? std::sqrt(float(referenceSize) / n) : 1.0f;
+    const float push2 = al::pow2(pushRadius * scale);
+    const float match2 = al::pow2(matchRadius * scale);
+    // exp(-9) is about 1e-4, small enough to leave out
+    const float cutoff = 3.0f * matchRadius * scale;
+    const float cutoff2 = cutoff * cutoff;
+
+    // Sort by cell. The flock is still sorted from the last step, so this
+    // mostly reads front to back.
+    grid.build(x.data(), y.data(), n, cutoff);
+    const std::vector<int>& order = grid.order();
+    resizeScratch(n);
+    pool->parallelFor(0, n, 8192, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        const int k = order[i];
+        sx[i] = x[k];
+        sy[i] = y[k];
+        svx[i] = vx[k];
+        svy[i] = vy[k];
+        sid[i] = id[k];
+      }
+    });
+
+    // Boid-boid interactions, from the positions at the start of the step
+    const std::vector<int>& cells = grid.sortedCells();
+    const uint32_t seed = ++steps * 2654435761u;
+    pool->parallelFor(0, n, 2048, [&](int begin, int end) {
+      uint32_t random = (seed ^ (uint32_t(begin) * 2246822519u)) | 1u;
+      for (int i = begin; i < end; ++i) {
+        const float xi = sx[i], yi = sy[i];
+        const float vxi = svx[i], vyi = svy[i];
+        float pushX = 0, pushY = 0;
+        float matchX = 0, matchY = 0, weight = 0;
+        grid.forEachNeighborRange(cells[i], [&](int jBegin, int jEnd) {
+          for (int j = jBegin; j < jEnd; ++j) {
+            const float dx = xi - sx[j];
+            const float dy = yi - sy[j];
+            const float dist2 = dx * dx + dy * dy;
+            if (dist2 >= cutoff2 || j == i) continue;
+
+            // Collision avoidance
+            if (dist2 > 0) {
+              const float push =
+                  std::exp(-dist2 / push2) * pushStrength / std::sqrt(dist2);
+              pushX += dx * push;
+              pushY += dy * push;
+            }
+
+            // Velocity matching
+            const float nearness = std::exp(-dist2 / match2);
+            matchX += (svx[j] - vxi) * nearness;
+            matchY += (svy[j] - vyi) * nearness;
+            weight += nearness;
+          }
+        });
+
+        // Move halfway towards the weighted average of nearby velocities
+        const float match = 0.5f / std::max(weight, 1.0f);
+        float px = xi + pushX, py = yi + pushY;
+        float pvx = vxi + matchX * match, pvy = vyi + matchY * match;
+
+        // Random "hunting" motion, uniform in the unit disc
+        float hx, hy;
+        do {
+          hx = uniformS(random);
+          hy = uniformS(random);
+        } while (hx * hx + hy * hy > 1);
+        // Use cubed distribution to make small jumps more frequent
+        const float hunt = (hx * hx + hy * hy) * huntUrge;
+        pvx += hx * hunt;
+        pvy += hy * hunt;
+
+        // Bound boid into a box
+        if (px > 1 || px < -1) {
+          px = px > 0 ? 1 : -1;
+          pvx = -pvx;
+        }
+        if (py > 1 || py < -1) {
+          py = py > 0 ? 1 : -1;
+          pvy = -pvy;
+        }
+
+        // Update position based on velocity and delta time
+        x[i] = px + pvx * dt;
+        y[i] = py + pvy * dt;
+        vx[i] = pvx;
+        vy[i] = pvy;
+        id[i] = sid[i];
+      }
+    });
+  }
+
+ private:
+  // xorshift, one stream per task so threads don't share a generator
+  static float uniformS(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return float(state) * (2.0f / 4294967296.0f) - 1.0f;
+  }
+
+  void resizeScratch(int n) {
+    sx.resize(n);
+    sy.resize(n);
+    svx.resize(n);
+    svy.resize(n);
+    sid.resize(n);
+  }
+
+  playground::SpatialGrid grid;
+  std::vector<float> sx, sy, svx, svy;  // start of the step, sorted by cell
+  std::vector<int> sid;
+  uint32_t steps = 0;
 };
 
 struct MyApp : public App {
-  static const int Nb = 32;  // Number of boids
-  Boid boids[Nb];
+  int numBoids = 32;
+  Flock flock;
+  playground::WorkerPool pool;
   Mesh heads, tails;
   Mesh box;
 
@@ -58,67 +223,11 @@ struct MyApp : public App {
     resetBoids();
   }
 
-  // Randomize boid positions/velocities uniformly inside unit disc
-  void resetBoids() {
-    for (auto& b : boids) {
-      b.pos = rnd::ball<Vec2f>();
-      b.vel = rnd::ball<Vec2f>();
-    }
-  }
+  void resetBoids() { flock.reset(numBoids); }
 
   void onAnimate(double dt_ms) {
     double dt = dt_ms;
-
-    // Compute boid-boid interactions
-    for (int i = 0; i < Nb - 1; ++i) {
-      for (int j = i + 1; j < Nb; ++j) {
-        // printf("checking boids %d and %d\n", i,j);
-
-        auto ds = boids[i].pos - boids[j].pos;
-        auto dist = ds.mag();
-
-        // Collision avoidance
-        double pushRadius = 0.05;
-        double pushStrength = 1;
-        double push = exp(-al::pow2(dist / pushRadius)) * pushStrength;
-
-        auto pushVector = ds.normalized() * push;
-        boids[i].pos += pushVector;
-        boids[j].pos -= pushVector;
-
-        // Velocity matching
-        double matchRadius = 0.125;
-        double nearness = exp(-al::pow2(dist / matchRadius));
-        Vec2d veli = boids[i].vel;
-        Vec2d velj = boids[j].vel;
-
-        // Take a weighted average of velocities according to nearness
-        boids[i].vel = veli * (1 - 0.5 * nearness) + velj * (0.5 * nearness);
-        boids[j].vel = velj * (1 - 0.5 * nearness) + veli * (0.5 * nearness);
-
-        // TODO: Flock centering
-      }
-    }
-
-    // Update boid independent behaviors
-    for (auto& b : boids) {
-      // Random "hunting" motion
-      float huntUrge = 0.2f;
-      auto hunt = rnd::ball<Vec2f>();
-      // Use cubed distribution to make small jumps more frequent
-      hunt *= hunt.magSqr();
-      b.vel += hunt * huntUrge;
-
-      // Bound boid into a box
-      if (b.pos.x > 1 || b.pos.x < -1) {
-        b.pos.x = b.pos.x > 0 ? 1 : -1;
-        b.vel.x = -b.vel.x;
-      }
-      if (b.pos.y > 1 || b.pos.y < -1) {
-        b.pos.y = b.pos.y > 0 ? 1 : -1;
-        b.vel.y = -b.vel.y;
-      }
-    }
+    flock.step(float(dt), &pool);
 
     // Generate meshes
     heads.reset();
@@ -127,16 +236,19 @@ struct MyApp : public App {
     tails.reset();
     tails.primitive(Mesh::LINES);
 
-    for (size_t i = 0; i < Nb; ++i) {
-      boids[i].update(dt);
+    const int n = flock.size();
+    for (int i = 0; i < n; ++i) {
+      Vec2f pos(flock.x[i], flock.y[i]);
+      Vec2f vel(flock.vx[i], flock.vy[i]);
 
-      heads.vertex(boids[i].pos);
-      heads.color(HSV(float(i) / Nb * 0.3f + 0.3f, 0.7f));
+      heads.vertex(pos);
+      Color color = HSV(float(flock.id[i]) / n * 0.3f + 0.3f, 0.7f);
+      heads.color(color);
 
-      tails.vertex(boids[i].pos);
-      tails.vertex(boids[i].pos - boids[i].vel.normalized(0.07));
+      tails.vertex(pos);
+      tails.vertex(pos - vel.normalized(0.07));
 
-      tails.color(heads.colors()[i]);
+      tails.color(color);
       tails.color(RGB(0.5));
     }
   }
@@ -144,7 +256,7 @@ struct MyApp : public App {
   void onDraw(Graphics& g) {
     g.clear(0);
     gl::depthTesting(true);
-    gl::pointSize(8);
+    gl::pointSize(numBoids > 1000 ? 2 : 8);
     // g.nicest();
     // g.stroke(8);
     g.meshColor();
@@ -157,16 +269,54 @@ struct MyApp : public App {
   }
 
   bool onKeyDown(const Keyboard& k) {
+    static const int sizes[] = {32, 1000, 10000, 100000, 300000};
     switch (k.key()) {
       case 'r':
         resetBoids();
         break;
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+        numBoids = sizes[k.key() - '1'];
+        resetBoids();
+        break;
     }
     return true;
   }
 };
 
-int main() {
-  MyApp().start();
+// Time steps of flocks of increasing size, without graphics
+void benchmark() {
+  playground::WorkerPool pool;
+  printf("%d threads\n", pool.concurrency());
+  for (int n : {32, 1000, 10000, 100000, 300000, 1000000}) {
+    Flock flock;
+    flock.reset(n);
+    for (int i = 0; i < 10; ++i) {
+      flock.step(1 / 60.0f, &pool);
+    }
+    const int steps = n > 100000 ? 20 : 100;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; ++i) {
+      flock.step(1 / 60.0f, &pool);
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("%8d boids  %8.3f ms/step\n", n, elapsed.count() / steps);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    benchmark();
+    return 0;
+  }
+  MyApp app;
+  if (argc > 1) {
+    app.numBoids = std::max(2, atoi(argv[1]));
+  }
+  app.start();
   return 0;
 }
@@ -3,9 +3,19 @@ Allocore Example: Gravity Well
 
 Description:
 The demonstrates how to make many lightweight bodies interact with the
-gravitational pull of a single heavy body.
+gravitational pull of heavy bodies ("wells") and of each other.
 
-Press the number keys to reset the particles with different initial conditions.
+The pull of the bodies on each other is approximated with a Barnes-Hut octree
+(playground::NBody): distant groups of bodies act as one body at their center
+of mass. theta sets how distant: 0 sums every pair exactly, larger values are
+faster and rougher. All bodies are drawn with one instanced draw call, with
+their positions uploaded as per instance data.
+
+Press the number keys to reset the bodies with different initial conditions.
+'w' adds a well and 'q' removes one, '[' and ']' lower and raise theta, 'g'
+turns the pull of the bodies on each other on and off, and space toggles the
+light of the wells. Run with a number to use that many bodies (100000 by
+default), or with --benchmark to time steps for a range of theta.
 
 Author:
 Lance Putnam, Nov. 2015
@@ -18,84 +28,170 @@ Lance Putnam, Nov. 2015
 #include "al/math/al_Random.hpp"
 #include "al/system/al_Time.hpp"
 #include <algorithm> // max
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "playground/NBody.hpp"
+#include "playground/WorkerPool.hpp"
 
 using namespace al;
 using namespace std;
 
-// A particle with acceleration
-class Particle {
-public:
-  Vec3f pos;
-  Vec3f vel;
-  Vec3f acc;
-
-  void update(double dt) {
-    // Semi-implicit Euler method:
-    vel += acc * dt;
-    pos += vel * dt;
+// Bodies are icosahedra of unit size scaled by radius and moved to their
+// position, which comes from the instance attribute
+const std::string instancing_vert = R"(
+#version 330
+uniform mat4 al_ModelViewMatrix;
+uniform mat4 al_ProjectionMatrix;
+uniform float radius;
+
+layout (location = 0) in vec3 position;
+layout (location = 3) in vec3 normal;
+layout (location = 5) in vec4 body; // x, y, z, mass; one per instance
+
+out vec3 P;
+out vec3 N;
+
+void main() {
+  P = body.xyz + radius * position;
+  N = normal;
+  gl_Position = al_ProjectionMatrix * al_ModelViewMatrix * vec4(P, 1.0);
+}
+)";
+
+// Diffuse lighting from a white directional light, a red point light and a
+// point light at each well, all in world space
+const std::string instancing_frag = R"(
+#version 330
+uniform vec3 color;
+uniform vec3 lightDir;
+uniform vec3 redLightPos;
+uniform vec3 wellLightColor;
+uniform vec3 wellPos[8];
+uniform int numWells;
+
+in vec3 P;
+in vec3 N;
+layout (location = 0) out vec4 fragColor;
+
+void main() {
+  vec3 n = normalize(N);
+  vec3 light = vec3(0.2) + max(dot(n, normalize(lightDir)), 0.0) * vec3(1.0);
+  light += max(dot(n, normalize(redLightPos - P)), 0.0) * vec3(1.0, 0.0, 0.0);
+  for (int i = 0; i < numWells; i++) {
+    light += max(dot(n, normalize(wellPos[i] - P)), 0.0) * wellLightColor;
   }
-};
+  fragColor = vec4(color * light, 1.0);
+}
+)";
 
 class MyApp : public App {
 public:
-  static const int M = 20;
-  static const int N = M * M;
-  Particle particles[N];
-  Particle well;
-  Mesh body1, body2;
+  static const int maxWells = 8; // lights in the instancing shader
+  int N = 100000;
+  int M = 0;                 // bodies per side in grid formations
+  float bodyMass = 0.05f;    // of all bodies together
+  float wellMass = 0.1f;
+  playground::NBody bodies;
+  std::vector<playground::NBody::Well> wells;
+  playground::WorkerPool pool;
+  bool wellLight = true;
+
+  VAOMesh body1;
+  Mesh body2;
+  BufferObject instances;
+  ShaderProgram instancing;
   Light light1, light2;
 
   void onCreate() override {
+    M = int(std::sqrt(float(N)));
+    N = M * M;
+    bodies.theta = 0.7f;
+    addWell(0, 0, 0);
     reset();
-    addIcosahedron(body1, 0.03);
+
+    addIcosahedron(body1, 1);
     body1.generateNormals();
+    body1.decompress(); // drawn with glDrawArraysInstanced
+    body1.update();
     addTorus(body2, 0.03, 0.1);
     body2.generateNormals();
 
+    // Per instance attribute 5: the x, y, z, mass of each body
+    instances.bufferType(GL_ARRAY_BUFFER);
+    instances.usage(GL_STREAM_DRAW);
+    instances.create();
+    instances.bind();
+    instances.data(4 * sizeof(float) * N, nullptr);
+    instances.unbind();
+    body1.vao().bind();
+    body1.vao().enableAttrib(5);
+    body1.vao().attribPointer(5, instances, 4);
+    glVertexAttribDivisor(5, 1);
+    body1.vao().unbind();
+    instancing.compile(instancing_vert, instancing_frag);
+
     nav().pullBack(3.5);
     nav().faceToward(Vec3f(0, 0.7, -1));
   }
 
+  void addWell(float x, float y, float z) {
+    if (int(wells.size()) < maxWells) {
+      wells.push_back({{x, y, z}, wellMass});
+    }
+  }
+
+  void setBody(int i, const Vec3f &pos, const Vec3f &vel) {
+    bodies.set(i, &pos[0], &vel[0], bodyMass / N);
+  }
+
   void reset(int preset = '1') {
+    if (preset < '1' || preset > '6') {
+      return;
+    }
+    bodies.resize(N);
     switch (preset) {
     case '1': // dust cloud
-      for (auto &p : particles) {
-        p.pos = rnd::ball<Vec3f>() * 0.2 + Vec3f(-0.7, 0, 0);
-        p.vel = Vec3f(0, -0.3, 0);
+      for (int i = 0; i < N; ++i) {
+        setBody(i, rnd::ball<Vec3f>() * 0.2 + Vec3f(-0.7, 0, 0),
+                Vec3f(0, -0.3, 0));
       }
       break;
     case '2': // hourglass
-      for (auto &p : particles) {
-        p.pos = rnd::ball<Vec3f>().mag(1);
-        p.vel = clone(p.pos).rotate(M_PI / 2) * Vec3f(1, 1, -1) * 0.2;
+      for (int i = 0; i < N; ++i) {
+        Vec3f pos = rnd::ball<Vec3f>().mag(1);
+        setBody(i, pos, clone(pos).rotate(M_PI / 2) * Vec3f(1, 1, -1) * 0.2);
       }
       break;
     case '3': // line orbit 1
       for (int i = 0; i < N; ++i) {
-        particles[i].pos = Vec3f(float(i) / N * 0.5 - 1, 0, 0);
-        particles[i].vel = Vec3f(0, -0.3, 0);
+        setBody(i, Vec3f(float(i) / N * 0.5 - 1, 0, 0), Vec3f(0, -0.3, 0));
       }
       break;
     case '4': // line orbit 2
       for (int i = 0; i < N; ++i) {
         float frac = float(i) / N;
-        particles[i].pos = Vec3f(-0.8, frac, 0);
-        particles[i].vel = Vec3f(-0.1, -0.2, 0.2);
+        setBody(i, Vec3f(-0.8, frac, 0), Vec3f(-0.1, -0.2, 0.2));
       }
       break;
     case '5': // grid formation (side)
       for (int i = 0; i < N; ++i) {
-        particles[i].pos = Vec3f(-1, float(i % M) / (M - 1) * 2 - 1,
-                                 float(i / M) / (M - 1) * 2 - 1);
-        particles[i].vel = Vec3f(0, 0, 0);
+        setBody(i,
+                Vec3f(-1, float(i % M) / (M - 1) * 2 - 1,
+                      float(i / M) / (M - 1) * 2 - 1),
+                Vec3f(0, 0, 0));
       }
       break;
     case '6': // grid formation (front)
       for (int i = 0; i < N; ++i) {
-        particles[i].pos = Vec3f(float(i % M) / (M - 1) - 0.5,
-                                 float(i / M) / (M - 1) - 0.5, 1);
-        particles[i].vel = Vec3f(0.1, 0, 0);
+        setBody(i,
+                Vec3f(float(i % M) / (M - 1) - 0.5,
+                      float(i / M) / (M - 1) - 0.5, 1),
+                Vec3f(0.1, 0, 0));
       }
       break;
     }
@@ -105,21 +201,8 @@ public:
     // convert millisecond to second
     float dt = dt_ms;
 
-    // Compute forces
-    for (auto &p : particles) {
-      // Newton's law of gravity
-      auto r21 = well.pos - p.pos; // distance vector between well and particle
-      auto dist = r21.mag();       // distance between well and particle
-      dist = std::max(dist, 0.1f); // prevent high velocities
-      auto F = r21 / (dist * dist * dist); // force vector acting on particle
-
-      // Newton's second law of motion, F = ma -> a = F/m
-      p.acc = F * (1. / 10); // mass of particle is 10
-    }
-
-    // Update particles
-    for (auto &p : particles)
-      p.update(dt);
+    // Forces from the wells and the other bodies, and update
+    bodies.step(dt, wells.data(), int(wells.size()), &pool);
   }
 
   void onDraw(Graphics &g) override {
@@ -139,23 +222,47 @@ public:
     g.light(light2, 1);
 
     Light l3;
-    l3.pos(5 * sin(2 * al_steady_time()), -1, 5 * cos(2 * al_steady_time()));
+    Vec3f redLightPos(5 * sin(2 * al_steady_time()), -1,
+                      5 * cos(2 * al_steady_time()));
+    l3.pos(redLightPos.x, redLightPos.y, redLightPos.z);
     l3.diffuse({1, 0, 0});
     g.light(l3, 2);
 
-    // Draw the well
+    // Draw the wells
     g.color(HSV(0.2));
-    g.draw(body2);
-
-    // Draw the particles
-    g.color(HSV(0.67, 0.2, 0.5));
-    for (auto &p : particles) {
+    for (auto &w : wells) {
       g.pushMatrix();
-      g.translate(p.pos);
-      g.draw(body1);
+      g.translate(w.position[0], w.position[1], w.position[2]);
+      g.draw(body2);
       g.popMatrix();
     }
 
+    // Draw all bodies at once
+    instances.bind();
+    instances.subdata(0, 4 * sizeof(float) * N, bodies.bodies());
+    instances.unbind();
+
+    Color color = HSV(0.67, 0.2, 0.5);
+    Color wellColor = HSV(0.2);
+    g.shader(instancing);
+    g.shader().uniform("radius", 0.03f * std::min(1.0f, std::sqrt(400.0f / N)));
+    g.shader().uniform("color", Vec3f(color.r, color.g, color.b));
+    g.shader().uniform("lightDir", Vec3f(1, 1, 1));
+    g.shader().uniform("redLightPos", redLightPos);
+    g.shader().uniform("wellLightColor",
+                       wellLight ? Vec3f(wellColor.r, wellColor.g, wellColor.b)
+                                 : Vec3f(0, 0, 0));
+    for (size_t i = 0; i < wells.size(); ++i) {
+      g.shader().uniform(("wellPos[" + std::to_string(i) + "]").c_str(),
+                         Vec3f(wells[i].position[0], wells[i].position[1],
+                               wells[i].position[2]));
+    }
+    g.shader().uniform("numWells", int(wells.size()));
+    g.update();
+    body1.vao().bind();
+    glDrawArraysInstanced(GL_TRIANGLES, 0, GLsizei(body1.vertices().size()), N);
+    body1.vao().unbind();
+
     // cout << "\rfps: " << fps() << rnd::uniform() << flush;
     //		cout << "\rfps: " << fps() << "   " << rnd::uniform() << flush;
   }
@@ -163,14 +270,73 @@ public:
   bool onKeyDown(const Keyboard &k) override {
     reset(k.key());
 
-    if (k.key() == ' ') {
+    switch (k.key()) {
+    case ' ':
       graphics().toggleLight(1);
+      wellLight = !wellLight;
+      break;
+    case 'w': {
+      Vec3f pos = rnd::ball<Vec3f>() * 0.8;
+      addWell(pos.x, pos.y, pos.z);
+      break;
+    }
+    case 'q':
+      if (!wells.empty()) {
+        wells.pop_back();
+      }
+      break;
+    case '[':
+    case ']':
+      bodies.theta += k.key() == '[' ? -0.1f : 0.1f;
+      bodies.theta = std::max(0.0f, std::min(bodies.theta, 1.5f));
+      printf("theta %.1f\n", bodies.theta);
+      break;
+    case 'g':
+      bodies.selfGravity = !bodies.selfGravity;
+      printf("bodies attract each other: %s\n",
+             bodies.selfGravity ? "yes" : "no");
+      break;
     }
     return true;
   }
 };
 
-int main() {
-  MyApp().start();
+// Time steps of a dust cloud around one well for a range of theta, without
+// graphics
+void benchmark(int n) {
+  playground::WorkerPool pool;
+  printf("%d threads, %d bodies\n", pool.concurrency(), n);
+  std::vector<playground::NBody::Well> wells = {{{0, 0, 0}, 0.1f}};
+  for (float theta : {0.3f, 0.5f, 0.7f, 1.0f}) {
+    playground::NBody bodies;
+    bodies.theta = theta;
+    bodies.resize(n);
+    for (int i = 0; i < n; ++i) {
+      Vec3f pos = rnd::ball<Vec3f>() * 0.2 + Vec3f(-0.7, 0, 0);
+      Vec3f vel(0, -0.3, 0);
+      bodies.set(i, &pos[0], &vel[0], 0.05f / n);
+    }
+    bodies.step(1 / 60.0f, wells.data(), 1, &pool);
+    const int steps = 10;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; ++i) {
+      bodies.step(1 / 60.0f, wells.data(), 1, &pool);
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("theta %.1f  %8.3f ms/step\n", theta, elapsed.count() / steps);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    benchmark(argc > 2 ? std::max(2, atoi(argv[2])) : 100000);
+    return 0;
+  }
+  MyApp app;
+  if (argc > 1) {
+    app.N = std::max(4, atoi(argv[1]));
+  }
+  app.start();
   return 0;
 }
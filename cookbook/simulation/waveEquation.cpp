@@ -19,31 +19,47 @@ in the x and y directions.
 
 See also: http://locklessinc.com/articles/wave_eqn/
 
+The update runs on playground::WaveGrid, which steps bands of rows on all
+cores with SIMD and writes the heights and normals of the surface in the
+same pass. Run with a grid size (up to 4096) to change the resolution, or
+with --benchmark to print steps per second for a range of sizes.
+
 Author:
 Lance Putnam, Oct. 2014
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
 #include "al/math/al_Random.hpp"
+
+#include "playground/WaveGrid.hpp"
+#include "playground/WorkerPool.hpp"
 using namespace al;
 
 struct MyApp : public App {
-  static const int Nx = 256, Ny = Nx;
-  float wave[Nx * Ny * 2];  // Values of wave for current and previous time step
-  int zcurr = 0;            // The current "plane" coordinate representing time
-  float decay = 0.96f;      // Decay factor of waves, in (0, 1]
-  float velocity = 0.5f;    // Velocity of wave propagation, in (0, 0.5]
+  int Nx = 256, Ny = 256;
+  playground::WaveGrid wave;  // Values of wave for current and previous time step
+  float decay = 0.96f;        // Decay factor of waves, in (0, 1]
+  float velocity = 0.5f;      // Velocity of wave propagation, in (0, 0.5]
 
+  playground::WorkerPool pool;
   Mesh mesh;
   Light light;
   Material mtrl;
 
   void onCreate() {
-    for (auto& v : wave) v = 0;
+    wave.resize(Nx, Ny);
 
     // Add a tessellated plane
     addSurface(mesh, Nx, Ny);
+    mesh.generateNormals();  // allocate them; the wave updates them
 
     nav().pullBack(4);
 
@@ -52,14 +68,7 @@ struct MyApp : public App {
     mtrl.shininess(30);
   }
 
-  int indexAt(int x, int y, int z) {
-    // return (z*Nx + y)*Ny + x;
-    return (y * Nx + x) * 2 + z;  // may give slightly faster accessing
-  }
-
   void onAnimate(double /*dt*/) {
-    int zprev = 1 - zcurr;
-
     // Add some random droplets
     for (int k = 0; k < 3; ++k) {
       if (rnd::prob(0.01)) {
@@ -71,45 +80,19 @@ struct MyApp : public App {
             float x = float(i) / 4;
             float y = float(j) / 4;
             float v = 0.5 * exp(-(x * x + y * y) / (0.5 * 0.5));
-            wave[indexAt(ix + i, iy + j, zcurr)] += v;
-            wave[indexAt(ix + i, iy + j, zprev)] += v;
+            wave.add(ix + i, iy + j, v);
           }
         }
       }
     }
 
-    // Update wave equation
-    for (int j = 0; j < Ny; ++j) {
-      for (int i = 0; i < Nx; ++i) {
-        // Neighbor indices; wrap toroidally
-        int im1 = i != 0 ? i - 1 : Nx - 1;
-        int ip1 = i != Nx - 1 ? i + 1 : 0;
-        int jm1 = j != 0 ? j - 1 : Ny - 1;
-        int jp1 = j != Nx - 1 ? j + 1 : 0;
-
-        // Get neighborhood of samples
-        auto vp = wave[indexAt(i, j, zprev)];    // previous value
-        auto vc = wave[indexAt(i, j, zcurr)];    // current value
-        auto vl = wave[indexAt(im1, j, zcurr)];  // neighbor left
-        auto vr = wave[indexAt(ip1, j, zcurr)];  // neighbor right
-        auto vd = wave[indexAt(i, jm1, zcurr)];  // neighbor up
-        auto vu = wave[indexAt(i, jp1, zcurr)];  // neighbor down
-
-        // Compute next value of wave equation at (i,j)
-        auto val =
-            2 * vc - vp + velocity * ((vl - 2 * vc + vr) + (vd - 2 * vc + vu));
-
-        // Store in previous value since we don't need it again
-        wave[indexAt(i, j, zprev)] = val * decay;
-
-        int idx = j * Nx + i;
-        mesh.vertices()[idx].z = val;
-      }
-    }
-
-    mesh.generateNormals();
-
-    zcurr = zprev;
+    // Update wave equation, with the mesh heights and normals
+    playground::WaveGrid::Surface surface;
+    surface.positions = &mesh.vertices()[0][0];
+    surface.normals = &mesh.normals()[0][0];
+    surface.dx = 2.0f / (Nx - 1);  // addSurface() spans [-1, 1]
+    surface.dy = 2.0f / (Ny - 1);
+    wave.step(velocity, decay, &surface, &pool);
   }
 
   void onDraw(Graphics& g) {
@@ -122,4 +105,41 @@ struct MyApp : public App {
   }
 };
 
-int main() { MyApp().start(); }
+// Steps per second for square grids, with and without writing a surface
+void benchmark() {
+  playground::WorkerPool pool;
+  printf("%d threads\n", pool.concurrency());
+  for (int n = 256; n <= playground::WaveGrid::kMaxSize; n *= 2) {
+    playground::WaveGrid grid(n, n);
+    std::vector<float> positions(size_t(3) * n * n), normals(positions.size());
+    playground::WaveGrid::Surface surface;
+    surface.positions = positions.data();
+    surface.normals = normals.data();
+    const int steps = std::max(5, int(100000000LL / (n * n)));
+    double rates[2];
+    for (int withSurface = 0; withSurface < 2; ++withSurface) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < steps; ++i) {
+        grid.step(0.5f, 0.96f, withSurface ? &surface : nullptr, &pool);
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      rates[withSurface] = steps / elapsed.count();
+    }
+    printf("%5d x %-5d %9.1f steps/s  %9.1f with surface\n", n, n, rates[0],
+           rates[1]);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    benchmark();
+    return 0;
+  }
+  MyApp app;
+  if (argc > 1) {
+    app.Nx = app.Ny =
+        std::max(16, std::min(atoi(argv[1]), int(playground::WaveGrid::kMaxSize)));
+  }
+  app.start();
+}
@@ -6,6 +6,10 @@
 #include "Gamma/Filter.h"
 #include "Gamma/Noise.h"
 
+#include "playground/EventQueue.hpp"
+#include "playground/RtSanitizer.hpp"
+#include "playground/VoiceStager.hpp"
+
 using namespace al;
 
 // Frequency coefficients from:
@@ -39,7 +43,7 @@ std::vector<float> smallHandBell = {1,
                                     7.3188262195122,
                                     7.5551829268293};
 
-struct ModalVoice : public SynthVoice {
+struct ModalVoice : public SynthVoice, public playground::PreparedVoice {
 
   std::vector<gam::Reson<>> modes;
   std::vector<float> amps;
@@ -51,10 +55,14 @@ struct ModalVoice : public SynthVoice {
   gam::EnvFollow<> envFollow; // track envelope to know when to turn off note.
 
   float fundamentalFreq = 440;
+  const std::vector<float> &freqs = smallHandBell;
 
   void init() override {
     residualEnv.levels(0.0f, 1.0f, 0.0f);
     residualEnv.lengths(0.002f, 0.07f);
+    // Sized once where the voice is created, so notes never allocate
+    modes.resize(freqs.size());
+    amps.resize(freqs.size());
   }
 
   void onProcess(AudioIOData &io) override {
@@ -72,11 +80,8 @@ struct ModalVoice : public SynthVoice {
     }
   }
 
-  void onTriggerOn() override {
-    residualEnv.reset();
-    auto &freqs = smallHandBell;
-    modes.resize(freqs.size());
-    amps.resize(freqs.size());
+  // Tunes and clears the modes, off the audio thread when staged
+  void onPrepare() override {
     auto modesIt = modes.begin();
     auto ampsIt = amps.begin();
     int counter = 1;
@@ -97,19 +102,36 @@ struct ModalVoice : public SynthVoice {
       mode.zero();
     }
   }
+
+  void onTriggerOn() override {
+    ensurePrepared();
+    residualEnv.reset();
+  }
 };
 
 struct MyApp : public App {
 
   PolySynth synth;
 
-  void onInit() override { gam::sampleRate(audioIO().framesPerSecond()); }
+  // Key presses are staged: their voices are prepared on the stager's
+  // thread and started by the audio thread at their frame
+  playground::EventQueue mEvents;
+  playground::VoiceStager mStager{mEvents};
 
-  void onSound(AudioIOData &io) override { synth.render(io); }
+  void onInit() override {
+    gam::sampleRate(audioIO().framesPerSecond());
+    mStager.startThread();
+  }
+
+  void onSound(AudioIOData &io) override {
+    PLAYGROUND_RT_SCOPE("onSound"); // checked with -DPLAYGROUND_RT_SANITIZER
+    mEvents.dispatch(synth, io);
+    synth.render(io);
+  }
 
   bool onKeyDown(const Keyboard &k) override {
     auto voice = synth.getVoice<ModalVoice>();
-    synth.triggerOn(voice);
+    mStager.addVoiceFromNow(voice, 0, 0); // frees itself when it dies out
     return true;
   }
 };
@@ -0,0 +1,272 @@
+#ifndef PLAYGROUND_ANALYSISBUS_HPP
+#define PLAYGROUND_ANALYSISBUS_HPP
+
+// Spectra of voices and mixes, computed off the audio thread.
+//
+// Giving every voice its own gam::STFT runs a large transform inside the
+// audio callback for every sounding voice. An AnalysisBus takes the samples
+// instead and analyzes them on a worker thread, with one short time Fourier
+// transform (one window, one set of twiddles) shared by all channels:
+//
+//   playground::AnalysisBus spectra;      // 4096 point frames, hop of 1024
+//
+//   // Voice init(), or the app's onInit() for a mix: not the audio thread
+//   mChannel = spectra.addChannel();
+//
+//   // Audio thread: never blocks or allocates
+//   while (io()) {
+//     float s = ...;
+//     spectra.push(mChannel, s);
+//   }
+//   spectra.publish(mChannel);
+//
+//   // Graphics thread: the newest magnitudes, numBins() of them
+//   const float *magnitudes = spectra.spectrum(mChannel);
+//
+// Each channel has one writer, which pushes into a ring and makes the
+// samples visible with publish() once per block, and one reader. The worker
+// wakes every few milliseconds and analyzes only the newest complete hop of
+// each channel that has one; silent channels (those not pushed to) cost
+// nothing. Spectra are handed over through a triple buffer, so the reader
+// always gets a whole frame without waiting for the worker.
+//
+// Magnitudes are scaled so a sine of amplitude A reads about A at its bin.
+// If the worker falls more than a ring behind, old samples are skipped. The
+// writer counts a sample before it stores it, so a frame the writer started
+// to overwrite while the worker copied it is dropped rather than analyzed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace playground {
+
+class AnalysisBus {
+public:
+  static constexpr int kMaxChannels = 64;
+  /// Samples kept per channel; the worker must come by within this many
+  static constexpr int kRingSize = 16384;
+
+  /// fftSize is rounded up to a power of two no larger than kRingSize / 2
+  explicit AnalysisBus(int fftSize = 4096, int hopSize = 1024) {
+    mSize = 2;
+    while (mSize < fftSize && mSize < kRingSize / 2) {
+      mSize *= 2;
+    }
+    mHop = std::min(std::max(hopSize, 1), mSize);
+
+    const double pi = 3.14159265358979323846;
+    mWindow.resize(mSize);
+    double sum = 0;
+    for (int i = 0; i < mSize; i++) {
+      mWindow[i] = float(0.5 - 0.5 * std::cos(2 * pi * i / mSize)); // Hann
+      sum += mWindow[i];
+    }
+    for (auto &w : mWindow) {
+      w = float(w * 2 / sum);
+    }
+    mTwiddles.resize(mSize / 2);
+    for (int i = 0; i < mSize / 2; i++) {
+      mTwiddles[i] = std::polar(1.0f, float(-2 * pi * i / mSize));
+    }
+    mFrame.resize(mSize);
+  }
+
+  AnalysisBus(const AnalysisBus &) = delete;
+  AnalysisBus &operator=(const AnalysisBus &) = delete;
+
+  ~AnalysisBus() {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mRunning = false;
+    }
+    mWake.notify_all();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+  int fftSize() const { return mSize; }
+  int hopSize() const { return mHop; }
+  int numBins() const { return mSize / 2 + 1; }
+
+  /// Add a channel and return its number, or -1 if all kMaxChannels are
+  /// taken (push() and publish() ignore -1, spectrum() reads zeros). Starts
+  /// the worker on first use. Allocates, so not for the audio thread.
+  int addChannel() {
+    std::lock_guard<std::mutex> lock(mLock);
+    const int channel = mNumChannels.load(std::memory_order_relaxed);
+    if (channel >= kMaxChannels) {
+      return -1;
+    }
+    mChannels[channel].reset(new Channel(numBins()));
+    mNumChannels.store(channel + 1, std::memory_order_release);
+    if (!mWorker.joinable()) {
+      mRunning = true;
+      mWorker = std::thread([this]() { workerLoop(); });
+    }
+    return channel;
+  }
+
+  /// Writer side: append one sample to channel
+  void push(int channel, float sample) {
+    if (channel < 0) {
+      return;
+    }
+    Channel &c = *mChannels[channel];
+    const uint64_t slot = c.written.load(std::memory_order_relaxed);
+    c.written.store(slot + 1, std::memory_order_relaxed);
+    // Release: a worker that reads the sample also sees the count above
+    c.ring[slot & (kRingSize - 1)].store(sample, std::memory_order_release);
+  }
+
+  /// Writer side: make the samples pushed so far visible to the worker
+  void publish(int channel) {
+    if (channel < 0) {
+      return;
+    }
+    Channel &c = *mChannels[channel];
+    c.tail.store(c.written.load(std::memory_order_relaxed),
+                 std::memory_order_release);
+  }
+
+  /// Reader side: the newest numBins() magnitudes of channel, valid until
+  /// the next call for the same channel
+  const float *spectrum(int channel) {
+    if (channel < 0) {
+      mSilence.resize(numBins(), 0.0f);
+      return mSilence.data();
+    }
+    Channel &c = *mChannels[channel];
+    if (c.middle.load(std::memory_order_relaxed) & kFresh) {
+      c.front = c.middle.exchange(c.front, std::memory_order_acq_rel) & ~kFresh;
+    }
+    return c.spectra[c.front].data();
+  }
+
+  /// Number of spectra computed for channel so far
+  uint64_t analyses(int channel) const {
+    return channel < 0 ? 0
+                       : mChannels[channel]->analyses.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr int kFresh = 4; // set in middle when it holds a new frame
+
+  struct Channel {
+    explicit Channel(int numBins) : ring(new std::atomic<float>[kRingSize]()) {
+      for (auto &s : spectra) {
+        s.assign(numBins, 0.0f);
+      }
+    }
+    std::unique_ptr<std::atomic<float>[]> ring; // read while overwritten
+    std::atomic<uint64_t> written{0}; // pushed; counted before stored
+    std::atomic<uint64_t> tail{0};    // published by the writer
+    uint64_t nextHop{0};              // worker only: end of the next frame
+    std::vector<float> spectra[3];    // triple buffer
+    int back{1};                      // worker only
+    std::atomic<int> middle{2};       // index, | kFresh when unread
+    int front{0};                     // reader only
+    std::atomic<uint64_t> analyses{0};
+  };
+
+  void workerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (mRunning) {
+      const int numChannels = mNumChannels.load(std::memory_order_acquire);
+      lock.unlock();
+      for (int channel = 0; channel < numChannels; channel++) {
+        analyze(*mChannels[channel]);
+      }
+      lock.lock();
+      mWake.wait_for(lock, std::chrono::milliseconds(5));
+    }
+  }
+
+  // Transform the newest complete hop of c, if there is one
+  void analyze(Channel &c) {
+    const uint64_t tail = c.tail.load(std::memory_order_acquire);
+    if (c.nextHop == 0) {
+      c.nextHop = uint64_t(mSize);
+    }
+    if (tail < c.nextHop) {
+      return;
+    }
+    // Skip to the last hop boundary that has arrived
+    const uint64_t end = c.nextHop + (tail - c.nextHop) / mHop * mHop;
+    c.nextHop = end + mHop;
+    const uint64_t begin = end - mSize;
+    for (int i = 0; i < mSize; i++) {
+      const float sample =
+          c.ring[(begin + i) & (kRingSize - 1)].load(std::memory_order_acquire);
+      mFrame[i] = std::complex<float>(sample * mWindow[i], 0.0f);
+    }
+    // The writer may have lapped the frame while it was copied. written runs
+    // ahead of tail by the block being pushed, and it covers every sample
+    // the copy could have seen.
+    if (c.written.load(std::memory_order_relaxed) - begin >
+        uint64_t(kRingSize)) {
+      return;
+    }
+    transform();
+    float *magnitudes = c.spectra[c.back].data();
+    for (int k = 0; k < numBins(); k++) {
+      magnitudes[k] = std::abs(mFrame[k]);
+    }
+    c.back = c.middle.exchange(c.back | kFresh, std::memory_order_acq_rel) & ~kFresh;
+    c.analyses.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // In place radix 2 FFT of mFrame
+  void transform() {
+    const int n = mSize;
+    for (int i = 1, j = 0; i < n; i++) {
+      int bit = n >> 1;
+      for (; j & bit; bit >>= 1) {
+        j ^= bit;
+      }
+      j ^= bit;
+      if (i < j) {
+        std::swap(mFrame[i], mFrame[j]);
+      }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+      const int half = length / 2;
+      const int stride = n / length;
+      for (int start = 0; start < n; start += length) {
+        for (int k = 0; k < half; k++) {
+          const std::complex<float> odd =
+              mFrame[start + k + half] * mTwiddles[k * stride];
+          mFrame[start + k + half] = mFrame[start + k] - odd;
+          mFrame[start + k] += odd;
+        }
+      }
+    }
+  }
+
+  int mSize;
+  int mHop;
+  std::vector<float> mWindow;
+  std::vector<std::complex<float>> mTwiddles;
+  std::vector<std::complex<float>> mFrame; // worker only
+  std::vector<float> mSilence;             // reader of channel -1
+
+  std::unique_ptr<Channel> mChannels[kMaxChannels];
+  std::atomic<int> mNumChannels{0};
+  std::mutex mLock;
+  std::condition_variable mWake;
+  bool mRunning{false};
+  std::thread mWorker;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_ANALYSISBUS_HPP
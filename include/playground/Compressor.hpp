@@ -0,0 +1,226 @@
+#ifndef PLAYGROUND_COMPRESSOR_HPP
+#define PLAYGROUND_COMPRESSOR_HPP
+
+// A linked, any-channel-count compressor for the output bus.
+//
+// All channels share one gain curve, computed from the loudest channel at
+// each frame, so the stereo (or 60 channel) image does not shift when the
+// compressor ducks. The channels are processed in place on
+// AudioIOData::outBuffer(), any block size works, and the audio thread never
+// prints or allocates once prepare() has been called.
+//
+//   playground::Compressor compressor;
+//   ...
+//   void onCreate() override {
+//     compressor.prepare(audioIO().framesPerSecond(), audioIO().channelsOut());
+//   }
+//   void onSound(AudioIOData &io) override {
+//     synth.render(io);
+//     compressor(io);
+//   }
+//
+// The levels of every block are published on telemetry() for a GUI or
+// logging thread to drain. The time spent in process() shows up as
+// "Compressor" in the DspProfiler.
+//
+// With lookAhead(true) the gain reduction is faded in ahead of each peak by
+// LookAheadGainReduction and the audio is delayed by latency() frames to line
+// up with it, so transients are caught instead of overshooting for the length
+// of the attack.
+//
+// The gain computer and look-ahead come from SimpleCompressor
+// (https://github.com/DanielRudrich/SimpleCompressor), which is expected in
+// the app's directory as it is for tutorials/synthesis. Apps still compile its
+// .cpp files in, as before.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+#include "SimpleCompressor/src/GainReductionComputer.h"
+#include "SimpleCompressor/src/LookAheadGainReduction.h"
+
+#include "playground/BufferOps.hpp"
+#include "playground/DspProfiler.hpp"
+#include "playground/Telemetry.hpp"
+
+namespace playground {
+
+/// Levels of one processed block, linear
+struct CompressorStats {
+  float prePeak = 0.0f;
+  float gain = 1.0f; // smallest gain applied
+  float postPeak = 0.0f;
+};
+
+class Compressor {
+public:
+  /// Frames per gain computation. Larger blocks are processed in pieces.
+  static constexpr int kChunk = 256;
+
+  Compressor() {
+    threshold(-5.0f);
+    ratio(100.0f);
+    knee(20.0f);
+    attack(0.0025f);
+    release(0.1f);
+  }
+
+  /// Size the delay lines for numChannels and set up the gain computer.
+  /// Allocates; call it before audio starts. process() calls it itself if
+  /// the bus grows or the sample rate changes.
+  void prepare(double sampleRate, int numChannels) {
+    mSampleRate = sampleRate;
+    mNumChannels = numChannels;
+    mGain.prepare(sampleRate);
+    mLookAhead.setDelayTime(mLookAheadTime);
+    mLookAhead.prepare(sampleRate, kChunk);
+    mDelayFrames = mLookAhead.getDelayInSamples();
+    mDelay.assign(size_t(numChannels) * (mDelayFrames + kChunk), 0.0f);
+    mChannels.assign(numChannels, nullptr);
+    mParamsChanged = true;
+  }
+
+  // Settings can be changed from any thread. They are applied at the start
+  // of the next block.
+  void threshold(float dB) { set(mThreshold, dB); }
+  void ratio(float r) { set(mRatio, r); }
+  void knee(float dB) { set(mKnee, dB); }
+  void attack(float seconds) { set(mAttack, seconds); }
+  void release(float seconds) { set(mRelease, seconds); }
+
+  void lookAhead(bool on) { mLookAheadRequested = on; }
+  bool lookAhead() const { return mLookAheadRequested; }
+
+  /// How far ahead gain reduction starts. Takes effect at the next prepare().
+  void lookAheadTime(float seconds) { mLookAheadTime = seconds; }
+
+  /// Frames the output is delayed by while look-ahead is on
+  int latency() const { return lookAhead() ? mDelayFrames : 0; }
+
+  /// One record per processed block. Drain it from a single non audio
+  /// thread.
+  TelemetryChannel<CompressorStats> &telemetry() { return mTelemetry; }
+
+  al::AudioIOData &operator()(al::AudioIOData &io) {
+    process(io);
+    return io;
+  }
+
+  void process(al::AudioIOData &io) {
+    const int numChannels = io.channelsOut();
+    if (numChannels > mNumChannels || io.framesPerSecond() != mSampleRate) {
+      prepare(io.framesPerSecond(), numChannels);
+    }
+    for (int c = 0; c < numChannels; c++) {
+      mChannels[c] = io.outBuffer(c);
+    }
+    process(mChannels.data(), numChannels, int(io.framesPerBuffer()));
+  }
+
+  /// Compress numChannels non interleaved buffers in place.
+  /// numChannels must not exceed the count given to prepare().
+  void process(float *const *channels, int numChannels, int numFrames) {
+    PLAYGROUND_DSP_ZONE("Compressor");
+    applySettings();
+
+    CompressorStats block;
+    for (int offset = 0; offset < numFrames; offset += kChunk) {
+      const int n = numFrames - offset < kChunk ? numFrames - offset : kChunk;
+
+      // Sidechain: loudest channel at each frame
+      std::fill(mSidechain, mSidechain + n, 0.0f);
+      for (int c = 0; c < numChannels; c++) {
+        buffer::maxAbs(mSidechain, channels[c] + offset, n);
+      }
+      block.prePeak = std::max(block.prePeak, buffer::peak(mSidechain, n));
+
+      if (mLookAheadActive) {
+        mGain.computeGainInDecibelsFromSidechainSignal(mSidechain, mGainBuf, n);
+        mLookAhead.pushSamples(mGainBuf, n);
+        mLookAhead.process();
+        mLookAhead.readSamples(mGainBuf, n);
+        for (int i = 0; i < n; i++) {
+          mGainBuf[i] = std::exp(mGainBuf[i] * kDecibelsToLog);
+        }
+      } else {
+        mGain.computeLinearGainFromSidechainSignal(mSidechain, mGainBuf, n);
+      }
+      block.gain = std::min(block.gain, buffer::minimum(mGainBuf, n));
+
+      const size_t stride = size_t(mDelayFrames) + kChunk;
+      for (int c = 0; c < numChannels; c++) {
+        float *out = channels[c] + offset;
+        float peak;
+        if (mLookAheadActive) {
+          // Delay the audio by the look-ahead so the gain leads it
+          float *line = mDelay.data() + c * stride;
+          std::memcpy(line + mDelayFrames, out, n * sizeof(float));
+          peak = buffer::multiplyPeak(out, line, mGainBuf, n);
+          std::memmove(line, line + n, mDelayFrames * sizeof(float));
+        } else {
+          peak = buffer::multiplyPeak(out, out, mGainBuf, n);
+        }
+        block.postPeak = std::max(block.postPeak, peak);
+      }
+    }
+
+    mTelemetry.publish(block);
+  }
+
+private:
+  static constexpr float kDecibelsToLog = 0.11512925f; // ln(10) / 20
+
+  void set(std::atomic<float> &param, float value) {
+    param.store(value, std::memory_order_relaxed);
+    mParamsChanged.store(true, std::memory_order_release);
+  }
+
+  void applySettings() {
+    if (mParamsChanged.exchange(false, std::memory_order_acquire)) {
+      mGain.setThreshold(mThreshold.load(std::memory_order_relaxed));
+      mGain.setRatio(mRatio.load(std::memory_order_relaxed));
+      mGain.setKnee(mKnee.load(std::memory_order_relaxed));
+      mGain.setAttackTime(mAttack.load(std::memory_order_relaxed));
+      mGain.setReleaseTime(mRelease.load(std::memory_order_relaxed));
+    }
+    const bool lookAhead = mLookAheadRequested.load(std::memory_order_relaxed);
+    if (lookAhead != mLookAheadActive) {
+      // Start from silence rather than audio left over from last time
+      std::fill(mDelay.begin(), mDelay.end(), 0.0f);
+      mLookAheadActive = lookAhead;
+    }
+  }
+
+  GainReductionComputer mGain;
+  LookAheadGainReduction mLookAhead;
+
+  double mSampleRate{0.0};
+  int mNumChannels{0};
+  float mLookAheadTime{0.005f};
+  int mDelayFrames{0};
+  std::vector<float> mDelay; // per channel: mDelayFrames history + a chunk
+  std::vector<float *> mChannels;
+
+  float mSidechain[kChunk];
+  float mGainBuf[kChunk];
+
+  std::atomic<float> mThreshold{0.0f};
+  std::atomic<float> mRatio{1.0f};
+  std::atomic<float> mKnee{0.0f};
+  std::atomic<float> mAttack{0.0f};
+  std::atomic<float> mRelease{0.0f};
+  std::atomic<bool> mParamsChanged{true};
+  std::atomic<bool> mLookAheadRequested{false};
+  bool mLookAheadActive{false};
+
+  TelemetryChannel<CompressorStats> mTelemetry;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_COMPRESSOR_HPP
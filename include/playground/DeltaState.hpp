@@ -0,0 +1,777 @@
+#ifndef PLAYGROUND_DELTASTATE_HPP
+#define PLAYGROUND_DELTASTATE_HPP
+
+// Sending large, slowly changing state to renderers as compressed deltas.
+//
+// Cuttlebone broadcasts the whole state struct every frame. That is fine for
+// a pose and a few flags but not for a mesh: 655362 vertices are 8 MB a
+// frame. DeltaStateSender and DeltaStateReceiver carry one fixed size
+// snapshot (typically quantized vertex positions) alongside the regular
+// state, and send only what changed:
+//
+//   // Simulator
+//   playground::DeltaStateSender mSender{snapshotBytes};
+//   mSender.open();                      // listens on port 16000
+//   ...
+//   mSender.send(snapshot);              // once per frame
+//
+//   // Renderer
+//   playground::DeltaStateReceiver mReceiver{snapshotBytes, "sim-host"};
+//   mReceiver.open();
+//   ...
+//   if (const uint8_t *snapshot = mReceiver.poll()) { ...use it... }
+//
+// Renderers announce themselves to the simulator and acknowledge every frame
+// they decode. Each frame is encoded against the oldest frame all renderers
+// have acknowledged:
+//
+//   - the snapshot is taken as 16 bit words and subtracted from the
+//     reference, so small motions become small numbers
+//   - only 256 byte regions that changed are kept, listed in a bitmap
+//   - the low and high bytes of the differences are stored apart, so the
+//     high bytes form long runs of 0x00 and 0xff
+//   - the result is LZ compressed (an LZ4 style block)
+//
+// Every keyframeInterval frames, and whenever a renderer joins, falls too far
+// behind or cannot decode a frame, a keyframe is sent against an all zero
+// reference instead. Frames are split into UDP datagrams of at most
+// maxDatagram bytes; incomplete frames are dropped.
+//
+// Nothing blocks: send() and poll() use non blocking sockets and are meant to
+// be called from onAnimate(). Several renderers can run on one machine, each
+// on its own ephemeral port, which makes the whole path testable over
+// loopback.
+//
+// quantize() and dequantize() map floats in [-range, range] to 16 bit
+// integers for snapshots of positions.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace playground {
+
+namespace delta_state {
+
+static const uint32_t kFragmentMagic = 0x46544c44; // "DLTF"
+static const uint32_t kAckMagic = 0x41544c44;      // "DLTA"
+static const uint32_t kNoFrame = 0xffffffff;
+static const size_t kRegionBytes = 256;
+
+/// Starts every datagram of a frame
+struct FragmentHeader {
+  uint32_t magic;
+  uint32_t frame;
+  uint32_t reference; ///< frame the delta is against, kNoFrame for keyframes
+  uint32_t encodedSize; ///< LZ block size of the whole frame
+  uint32_t rawSize;     ///< size of the block once decompressed
+  uint32_t fragmentBytes; ///< payload of every datagram but the last
+  uint16_t index;
+  uint16_t count;
+};
+
+/// Renderer to simulator: latest frame decoded
+struct Ack {
+  uint32_t magic;
+  uint32_t frame; ///< kNoFrame if none yet
+  uint32_t needKeyframe;
+};
+
+inline uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline void writeLength(std::vector<uint8_t> &out, size_t length) {
+  while (length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back(uint8_t(length));
+}
+
+/// LZ4 style block compression: sequences of literals followed by a match
+/// of at least 4 bytes up to 64 KB back. Appends to out.
+inline void compress(const uint8_t *src, size_t n, std::vector<uint8_t> &out) {
+  static const int kHashBits = 14;
+  std::vector<uint32_t> table(size_t(1) << kHashBits, 0); // position + 1
+  size_t anchor = 0;
+  size_t i = 0;
+  while (i + 4 <= n) {
+    const uint32_t sequence = read32(src + i);
+    const uint32_t hash = (sequence * 2654435761u) >> (32 - kHashBits);
+    const size_t candidate = table[hash];
+    table[hash] = uint32_t(i + 1);
+    if (candidate == 0 || i + 1 - candidate > 65535 ||
+        read32(src + candidate - 1) != sequence) {
+      i++;
+      continue;
+    }
+    const size_t match = candidate - 1;
+    size_t length = 4;
+    while (i + length < n && src[match + length] == src[i + length]) {
+      length++;
+    }
+    const size_t literals = i - anchor;
+    out.push_back(uint8_t((std::min<size_t>(literals, 15) << 4) |
+                          std::min<size_t>(length - 4, 15)));
+    if (literals >= 15) {
+      writeLength(out, literals - 15);
+    }
+    out.insert(out.end(), src + anchor, src + i);
+    const uint16_t offset = uint16_t(i - match);
+    out.push_back(uint8_t(offset & 0xff));
+    out.push_back(uint8_t(offset >> 8));
+    if (length - 4 >= 15) {
+      writeLength(out, length - 4 - 15);
+    }
+    i += length;
+    anchor = i;
+  }
+  // The last sequence is literals only
+  const size_t literals = n - anchor;
+  out.push_back(uint8_t(std::min<size_t>(literals, 15) << 4));
+  if (literals >= 15) {
+    writeLength(out, literals - 15);
+  }
+  out.insert(out.end(), src + anchor, src + n);
+}
+
+/// Largest output of compress() for n bytes
+inline size_t maxCompressedSize(size_t n) { return n + n / 255 + 16; }
+
+/// Undo compress(). Returns false unless src decodes to exactly n bytes.
+inline bool decompress(const uint8_t *src, size_t size, uint8_t *dst,
+                       size_t n) {
+  size_t ip = 0;
+  size_t op = 0;
+  auto readLength = [&](size_t &length) {
+    uint8_t b;
+    do {
+      if (ip >= size) {
+        return false;
+      }
+      b = src[ip++];
+      length += b;
+    } while (b == 255);
+    return true;
+  };
+  while (ip < size) {
+    const uint8_t token = src[ip++];
+    size_t literals = token >> 4;
+    if (literals == 15 && !readLength(literals)) {
+      return false;
+    }
+    if (literals > size - ip || literals > n - op) {
+      return false;
+    }
+    std::memcpy(dst + op, src + ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == size) {
+      break; // last sequence
+    }
+    if (size - ip < 2) {
+      return false;
+    }
+    const size_t offset = src[ip] | (size_t(src[ip + 1]) << 8);
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && !readLength(length)) {
+      return false;
+    }
+    length += 4;
+    if (offset == 0 || offset > op || length > n - op) {
+      return false;
+    }
+    // Byte by byte: the match may overlap what it is copying
+    for (size_t k = 0; k < length; k++, op++) {
+      dst[op] = dst[op - offset];
+    }
+  }
+  return op == n;
+}
+
+/// Frame as differences from reference (nullptr for a keyframe): a bitmap
+/// of changed regions followed by the low then the high bytes of the
+/// changed 16 bit words
+inline void encodeDelta(const uint8_t *current, const uint8_t *reference,
+                        size_t n, std::vector<uint8_t> &raw) {
+  const size_t numRegions = (n + kRegionBytes - 1) / kRegionBytes;
+  const size_t bitmapBytes = (numRegions + 7) / 8;
+  raw.assign(bitmapBytes, 0);
+  size_t changed = 0;
+  for (size_t r = 0; r < numRegions; r++) {
+    const size_t begin = r * kRegionBytes;
+    const size_t bytes = std::min(kRegionBytes, n - begin);
+    const bool dirty =
+        reference ? std::memcmp(current + begin, reference + begin, bytes) != 0
+                  : std::any_of(current + begin, current + begin + bytes,
+                                [](uint8_t b) { return b != 0; });
+    if (dirty) {
+      raw[r / 8] |= uint8_t(1 << (r % 8));
+      changed += (bytes + 1) / 2;
+    }
+  }
+  raw.resize(bitmapBytes + 2 * changed);
+  uint8_t *low = raw.data() + bitmapBytes;
+  uint8_t *high = low + changed;
+  for (size_t r = 0; r < numRegions; r++) {
+    if (!(raw[r / 8] & (1 << (r % 8)))) {
+      continue;
+    }
+    const size_t begin = r * kRegionBytes;
+    const size_t end = std::min(begin + kRegionBytes, n);
+    for (size_t b = begin; b < end; b += 2) {
+      uint16_t word = current[b];
+      uint16_t base = reference ? reference[b] : 0;
+      if (b + 1 < end) {
+        word |= uint16_t(current[b + 1]) << 8;
+        base |= uint16_t(reference ? reference[b + 1] : 0) << 8;
+      }
+      const uint16_t delta = uint16_t(word - base);
+      *low++ = uint8_t(delta & 0xff);
+      *high++ = uint8_t(delta >> 8);
+    }
+  }
+}
+
+/// Largest output of encodeDelta() for an n byte snapshot: every region
+/// changed, the last one padded to whole words
+inline size_t maxDeltaSize(size_t n) {
+  const size_t numRegions = (n + kRegionBytes - 1) / kRegionBytes;
+  return (numRegions + 7) / 8 + n + (n & 1);
+}
+
+/// Undo encodeDelta() into current, which must hold reference (or zeros for
+/// a keyframe) on entry
+inline bool decodeDelta(const uint8_t *raw, size_t rawSize, uint8_t *current,
+                        size_t n) {
+  const size_t numRegions = (n + kRegionBytes - 1) / kRegionBytes;
+  const size_t bitmapBytes = (numRegions + 7) / 8;
+  if (rawSize < bitmapBytes || (rawSize - bitmapBytes) % 2 != 0) {
+    return false;
+  }
+  const size_t changed = (rawSize - bitmapBytes) / 2;
+  const uint8_t *low = raw + bitmapBytes;
+  const uint8_t *high = low + changed;
+  size_t used = 0;
+  for (size_t r = 0; r < numRegions; r++) {
+    if (!(raw[r / 8] & (1 << (r % 8)))) {
+      continue;
+    }
+    const size_t begin = r * kRegionBytes;
+    const size_t end = std::min(begin + kRegionBytes, n);
+    for (size_t b = begin; b < end; b += 2) {
+      if (used == changed) {
+        return false;
+      }
+      uint16_t word = current[b];
+      if (b + 1 < end) {
+        word |= uint16_t(current[b + 1]) << 8;
+      }
+      word = uint16_t(word + (low[used] | (uint16_t(high[used]) << 8)));
+      used++;
+      current[b] = uint8_t(word & 0xff);
+      if (b + 1 < end) {
+        current[b + 1] = uint8_t(word >> 8);
+      }
+    }
+  }
+  return used == changed;
+}
+
+// Minimal non blocking UDP socket
+class UdpSocket {
+public:
+  UdpSocket() = default;
+  UdpSocket(const UdpSocket &) = delete;
+  UdpSocket &operator=(const UdpSocket &) = delete;
+  ~UdpSocket() { close(); }
+
+  /// Bind to port on every interface, 0 for any free port
+  bool open(uint16_t port) {
+    close();
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+      return false;
+    }
+    mStarted = true;
+#endif
+    mSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (!valid()) {
+      return false;
+    }
+    // Keyframes of large meshes arrive as thousands of datagrams at once
+    int bufferSize = 8 << 20;
+    setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, (const char *)&bufferSize,
+               sizeof(bufferSize));
+    setsockopt(mSocket, SOL_SOCKET, SO_SNDBUF, (const char *)&bufferSize,
+               sizeof(bufferSize));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(mSocket, (const sockaddr *)&address, sizeof(address)) != 0) {
+      close();
+      return false;
+    }
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(mSocket, FIONBIO, &nonBlocking);
+#else
+    fcntl(mSocket, F_SETFL, fcntl(mSocket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    return true;
+  }
+
+  void close() {
+    if (valid()) {
+#ifdef _WIN32
+      closesocket(mSocket);
+#else
+      ::close(mSocket);
+#endif
+    }
+    mSocket = kInvalid;
+#ifdef _WIN32
+    if (mStarted) {
+      WSACleanup();
+      mStarted = false;
+    }
+#endif
+  }
+
+  bool valid() const { return mSocket != kInvalid; }
+
+  bool sendTo(const void *data, size_t size, const sockaddr_in &to) {
+    return ::sendto(mSocket, (const char *)data, int(size), 0,
+                    (const sockaddr *)&to, sizeof(to)) == int(size);
+  }
+
+  /// Bytes received, or -1 if nothing is waiting
+  int receive(void *data, size_t size, sockaddr_in &from) {
+    socklen_t length = sizeof(from);
+    return int(::recvfrom(mSocket, (char *)data, int(size), 0,
+                          (sockaddr *)&from, &length));
+  }
+
+  static bool resolve(const std::string &host, uint16_t port,
+                      sockaddr_in &address) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) {
+      return false;
+    }
+    address = *(const sockaddr_in *)result->ai_addr;
+    address.sin_port = htons(port);
+    freeaddrinfo(result);
+    return true;
+  }
+
+private:
+#ifdef _WIN32
+  typedef SOCKET Handle;
+  static constexpr Handle kInvalid = INVALID_SOCKET;
+  bool mStarted{false};
+#else
+  typedef int Handle;
+  static constexpr Handle kInvalid = -1;
+#endif
+  Handle mSocket{kInvalid};
+};
+
+} // namespace delta_state
+
+/// floats in [-range, range] to 16 bit integers, clamping outside
+inline void quantize(const float *src, size_t n, float range, int16_t *dst) {
+  const float scale = 32767.0f / range;
+  for (size_t i = 0; i < n; i++) {
+    const float q = std::max(-32767.0f, std::min(32767.0f, src[i] * scale));
+    dst[i] = int16_t(std::lrint(q));
+  }
+}
+
+inline void dequantize(const int16_t *src, size_t n, float range, float *dst) {
+  const float scale = range / 32767.0f;
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+class DeltaStateSender {
+public:
+  struct Stats {
+    uint32_t frame{0};
+    bool keyframe{false};
+    size_t snapshotBytes{0};
+    size_t sentBytes{0}; ///< per renderer, headers included
+    size_t renderers{0};
+  };
+
+  /// history is how many past frames can serve as a reference. Throws
+  /// std::invalid_argument if keyframeInterval or history is below 1.
+  explicit DeltaStateSender(size_t snapshotBytes, uint16_t port = 16000,
+                            int keyframeInterval = 120, int history = 8)
+      : mSize(snapshotBytes), mPort(port),
+        mKeyframeInterval(uint32_t(checkAtLeastOne(keyframeInterval,
+                                                   "keyframeInterval"))),
+        mHistory(size_t(checkAtLeastOne(history, "history")),
+                 std::vector<uint8_t>(snapshotBytes)),
+        mHistoryFrames(size_t(history), delta_state::kNoFrame) {}
+
+  bool open() { return mSocket.open(mPort); }
+
+  /// Largest datagram sent, headers included
+  void maxDatagram(size_t bytes) { mMaxDatagram = bytes; }
+
+  /// Send snapshot (snapshotBytes long) to every renderer as the next frame
+  void send(const void *snapshot) {
+    receiveAcks();
+    const uint32_t frame = mFrame++;
+    uint8_t *stored = slot(frame);
+    std::memcpy(stored, snapshot, mSize);
+
+    const uint32_t reference = pickReference(frame);
+    const uint8_t *base = reference == delta_state::kNoFrame
+                              ? nullptr
+                              : mHistory[reference % mHistory.size()].data();
+    delta_state::encodeDelta(stored, base, mSize, mRaw);
+    mEncoded.clear();
+    delta_state::compress(mRaw.data(), mRaw.size(), mEncoded);
+
+    mStats.frame = frame;
+    mStats.keyframe = base == nullptr;
+    mStats.snapshotBytes = mSize;
+    mStats.renderers = mPeers.size();
+    mStats.sentBytes = sendFrame(frame, reference);
+  }
+
+  const Stats &stats() const { return mStats; }
+
+private:
+  static int checkAtLeastOne(int value, const char *name) {
+    if (value < 1) {
+      throw std::invalid_argument(std::string("DeltaStateSender: ") + name +
+                                  " must be at least 1");
+    }
+    return value;
+  }
+
+  struct Peer {
+    sockaddr_in address;
+    uint32_t acked{delta_state::kNoFrame};
+    bool needKeyframe{true};
+    std::chrono::steady_clock::time_point lastHeard;
+  };
+
+  uint8_t *slot(uint32_t frame) {
+    const size_t index = frame % mHistory.size();
+    mHistoryFrames[index] = frame;
+    return mHistory[index].data();
+  }
+
+  bool inHistory(uint32_t frame) const {
+    return frame != delta_state::kNoFrame &&
+           mHistoryFrames[frame % mHistory.size()] == frame;
+  }
+
+  void receiveAcks() {
+    delta_state::Ack ack;
+    sockaddr_in from;
+    int received;
+    while ((received = mSocket.receive(&ack, sizeof(ack), from)) >= 0) {
+      if (received != int(sizeof(ack)) || ack.magic != delta_state::kAckMagic) {
+        continue;
+      }
+      auto peer = std::find_if(mPeers.begin(), mPeers.end(), [&](Peer &p) {
+        return p.address.sin_addr.s_addr == from.sin_addr.s_addr &&
+               p.address.sin_port == from.sin_port;
+      });
+      if (peer == mPeers.end()) {
+        mPeers.push_back(Peer());
+        peer = mPeers.end() - 1;
+        peer->address = from;
+      }
+      // Acks can arrive out of order; keep the newest
+      if (peer->acked == delta_state::kNoFrame ||
+          (ack.frame != delta_state::kNoFrame &&
+           int32_t(ack.frame - peer->acked) > 0)) {
+        peer->acked = ack.frame;
+      }
+      peer->needKeyframe = ack.needKeyframe != 0;
+      peer->lastHeard = std::chrono::steady_clock::now();
+    }
+    // Forget renderers that went away
+    const auto now = std::chrono::steady_clock::now();
+    mPeers.erase(std::remove_if(mPeers.begin(), mPeers.end(),
+                                [&](const Peer &p) {
+                                  return now - p.lastHeard >
+                                         std::chrono::seconds(5);
+                                }),
+                 mPeers.end());
+  }
+
+  // Oldest frame every renderer has acknowledged, or kNoFrame for a keyframe
+  uint32_t pickReference(uint32_t frame) {
+    if (mPeers.empty() || frame % mKeyframeInterval == 0) {
+      return delta_state::kNoFrame;
+    }
+    uint32_t oldest = frame - 1;
+    for (auto &peer : mPeers) {
+      if (peer.needKeyframe || !inHistory(peer.acked)) {
+        peer.needKeyframe = false; // the keyframe is on its way
+        return delta_state::kNoFrame;
+      }
+      if (int32_t(peer.acked - oldest) < 0) {
+        oldest = peer.acked;
+      }
+    }
+    return oldest;
+  }
+
+  size_t sendFrame(uint32_t frame, uint32_t reference) {
+    const size_t headerBytes = sizeof(delta_state::FragmentHeader);
+    const size_t payload = mMaxDatagram - headerBytes;
+    const size_t count =
+        std::max<size_t>(1, (mEncoded.size() + payload - 1) / payload);
+    if (count > 65535) {
+      fprintf(stderr, "DeltaStateSender: frame too large to send\n");
+      return 0;
+    }
+    delta_state::FragmentHeader header;
+    header.magic = delta_state::kFragmentMagic;
+    header.frame = frame;
+    header.reference = reference;
+    header.encodedSize = uint32_t(mEncoded.size());
+    header.rawSize = uint32_t(mRaw.size());
+    header.fragmentBytes = uint32_t(payload);
+    header.count = uint16_t(count);
+    mDatagram.resize(mMaxDatagram);
+    size_t sent = 0;
+    for (size_t i = 0; i < count; i++) {
+      header.index = uint16_t(i);
+      const size_t begin = i * payload;
+      const size_t bytes = std::min(payload, mEncoded.size() - begin);
+      std::memcpy(mDatagram.data(), &header, headerBytes);
+      std::memcpy(mDatagram.data() + headerBytes, mEncoded.data() + begin,
+                  bytes);
+      for (auto &peer : mPeers) {
+        mSocket.sendTo(mDatagram.data(), headerBytes + bytes, peer.address);
+      }
+      sent += headerBytes + bytes;
+    }
+    return sent;
+  }
+
+  size_t mSize;
+  uint16_t mPort;
+  uint32_t mKeyframeInterval;
+  size_t mMaxDatagram{1400};
+  delta_state::UdpSocket mSocket;
+  std::vector<Peer> mPeers;
+
+  uint32_t mFrame{0};
+  std::vector<std::vector<uint8_t>> mHistory;
+  std::vector<uint32_t> mHistoryFrames;
+  std::vector<uint8_t> mRaw;
+  std::vector<uint8_t> mEncoded;
+  std::vector<uint8_t> mDatagram;
+  Stats mStats;
+};
+
+class DeltaStateReceiver {
+public:
+  DeltaStateReceiver(size_t snapshotBytes, const std::string &senderHost,
+                     uint16_t senderPort = 16000, int history = 8)
+      : mSize(snapshotBytes), mHost(senderHost), mPort(senderPort),
+        mMaxRaw(delta_state::maxDeltaSize(snapshotBytes)),
+        mMaxEncoded(delta_state::maxCompressedSize(mMaxRaw)),
+        mHistory(size_t(std::max(history, 1)),
+                 std::vector<uint8_t>(snapshotBytes)),
+        mHistoryFrames(size_t(std::max(history, 1)), delta_state::kNoFrame) {}
+
+  /// Open an ephemeral port and announce ourselves to the sender
+  bool open() {
+    if (!delta_state::UdpSocket::resolve(mHost, mPort, mSender) ||
+        !mSocket.open(0)) {
+      return false;
+    }
+    sendAck();
+    return true;
+  }
+
+  /// Read everything that arrived. Returns the newest snapshot if a new
+  /// frame was completed since the last call, nullptr otherwise.
+  const uint8_t *poll() {
+    const uint8_t *result = nullptr;
+    mDatagram.resize(65536);
+    sockaddr_in from;
+    int received;
+    while ((received = mSocket.receive(mDatagram.data(), mDatagram.size(),
+                                       from)) >= 0) {
+      if (const uint8_t *snapshot = receiveFragment(size_t(received))) {
+        result = snapshot;
+      }
+    }
+    // Keep announcing ourselves while nothing arrives, in case the sender
+    // started after us
+    const auto now = std::chrono::steady_clock::now();
+    if (now - mLastAck > std::chrono::milliseconds(500)) {
+      sendAck();
+    }
+    return result;
+  }
+
+  /// Frame number of the newest snapshot, kNoFrame before the first
+  uint32_t frame() const { return mLatest; }
+
+private:
+  const uint8_t *receiveFragment(size_t size) {
+    const size_t headerBytes = sizeof(delta_state::FragmentHeader);
+    delta_state::FragmentHeader header;
+    if (size < headerBytes) {
+      return nullptr;
+    }
+    std::memcpy(&header, mDatagram.data(), headerBytes);
+    if (header.magic != delta_state::kFragmentMagic || header.count == 0 ||
+        header.index >= header.count) {
+      return nullptr;
+    }
+    if (mLatest != delta_state::kNoFrame &&
+        int32_t(header.frame - mLatest) <= 0) {
+      return nullptr; // older than what we have
+    }
+    if (header.frame != mAssembling) {
+      // Sizes no sender of our snapshot size produces: drop the packet
+      // rather than allocate what it claims
+      const uint64_t capacity = uint64_t(header.count) * header.fragmentBytes;
+      if (header.encodedSize > mMaxEncoded || header.rawSize > mMaxRaw ||
+          header.fragmentBytes == 0 || capacity < header.encodedSize ||
+          capacity - header.fragmentBytes >= header.encodedSize) {
+        return nullptr;
+      }
+      // A newer frame starts; whatever was incomplete is lost
+      mAssembling = header.frame;
+      mHeader = header;
+      mEncoded.assign(header.encodedSize, 0);
+      mHave.assign(header.count, false);
+      mMissing = header.count;
+    }
+    if (header.encodedSize != mHeader.encodedSize ||
+        header.rawSize != mHeader.rawSize ||
+        header.fragmentBytes != mHeader.fragmentBytes ||
+        header.count != mHeader.count ||
+        header.reference != mHeader.reference) {
+      return nullptr; // does not belong to the frame being assembled
+    }
+    const size_t payload = size - headerBytes;
+    const size_t begin = size_t(header.index) * header.fragmentBytes;
+    if (mHave[header.index] || begin + payload > mEncoded.size()) {
+      return nullptr;
+    }
+    std::memcpy(mEncoded.data() + begin, mDatagram.data() + headerBytes,
+                payload);
+    mHave[header.index] = true;
+    if (--mMissing > 0) {
+      return nullptr;
+    }
+    return decodeFrame();
+  }
+
+  const uint8_t *decodeFrame() {
+    const uint32_t frame = mHeader.frame;
+    mAssembling = delta_state::kNoFrame;
+    uint8_t *target = mHistory[frame % mHistory.size()].data();
+    // Decode into scratch first: the target slot may hold the reference
+    mScratch.resize(mSize);
+    if (mHeader.reference == delta_state::kNoFrame) {
+      std::fill(mScratch.begin(), mScratch.end(), 0);
+    } else if (mHistoryFrames[mHeader.reference % mHistory.size()] ==
+               mHeader.reference) {
+      std::memcpy(mScratch.data(),
+                  mHistory[mHeader.reference % mHistory.size()].data(), mSize);
+    } else {
+      mNeedKeyframe = true;
+      sendAck();
+      return nullptr;
+    }
+    mRaw.resize(mHeader.rawSize);
+    if (!delta_state::decompress(mEncoded.data(), mEncoded.size(), mRaw.data(),
+                                 mRaw.size()) ||
+        !delta_state::decodeDelta(mRaw.data(), mRaw.size(), mScratch.data(),
+                                  mSize)) {
+      mNeedKeyframe = true;
+      sendAck();
+      return nullptr;
+    }
+    std::memcpy(target, mScratch.data(), mSize);
+    mHistoryFrames[frame % mHistory.size()] = frame;
+    mLatest = frame;
+    mNeedKeyframe = false;
+    sendAck();
+    return target;
+  }
+
+  void sendAck() {
+    delta_state::Ack ack;
+    ack.magic = delta_state::kAckMagic;
+    ack.frame = mLatest;
+    ack.needKeyframe = mNeedKeyframe ? 1 : 0;
+    mSocket.sendTo(&ack, sizeof(ack), mSender);
+    mLastAck = std::chrono::steady_clock::now();
+  }
+
+  size_t mSize;
+  std::string mHost;
+  uint16_t mPort;
+  size_t mMaxRaw;     // largest raw delta of an mSize snapshot
+  size_t mMaxEncoded; // largest encoded frame a sender can produce
+  sockaddr_in mSender{};
+  delta_state::UdpSocket mSocket;
+  std::chrono::steady_clock::time_point mLastAck;
+
+  std::vector<std::vector<uint8_t>> mHistory;
+  std::vector<uint32_t> mHistoryFrames;
+  uint32_t mLatest{delta_state::kNoFrame};
+  bool mNeedKeyframe{false};
+
+  uint32_t mAssembling{delta_state::kNoFrame};
+  delta_state::FragmentHeader mHeader{};
+  std::vector<bool> mHave;
+  size_t mMissing{0};
+  std::vector<uint8_t> mDatagram;
+  std::vector<uint8_t> mEncoded;
+  std::vector<uint8_t> mRaw;
+  std::vector<uint8_t> mScratch;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_DELTASTATE_HPP
@@ -0,0 +1,399 @@
+#ifndef PLAYGROUND_DSPPROFILER_HPP
+#define PLAYGROUND_DSPPROFILER_HPP
+
+// Where the audio budget goes, per voice class and per processing stage.
+//
+// The audio callback only shows up as one number in a CPU meter. The
+// profiler times each voice's onProcess() under its class and each marked
+// stage of the callback under its name:
+//
+//   playground::DspProfiler::get().enable(); // onInit(), not the audio thread
+//   ...
+//   void onProcess(AudioIOData &io) override {
+//     PLAYGROUND_DSP_VOICE(this); // timed as this voice's class
+//     ...
+//   }
+//   ...
+//   void onSound(AudioIOData &io) override {
+//     PLAYGROUND_DSP_ZONE("onSound");
+//     scene.render(io);
+//     {
+//       PLAYGROUND_DSP_ZONE("DownMixer");
+//       downMixer.downMixToBus(io);
+//     }
+//   }
+//
+// VoiceRenderPool times every voice it renders and playground::Compressor
+// times itself, so apps built on them only mark their own stages. A voice
+// timed twice in one call (marked, and rendered by the pool) counts once.
+//
+// Scopes read the CPU's cycle counter (the time stamp counter on x86, the
+// virtual counter on ARM64, the steady clock elsewhere) and append one
+// (zone, cycles) record to a ring of the calling thread: no locks, no
+// allocation. A thread of the profiler drains the rings every 20 ms into a
+// histogram per class and zone, and converts cycles to seconds against the
+// steady clock. rows() gives the calls, mean, 99th percentile and worst time
+// per call and the share of one core spent there. drawDspLoad() in
+// DspProfilerPanel.hpp shows them in ImGui and writeCsv() saves them.
+//
+// Percentiles are read from histogram bins an eighth of an octave wide.
+// Before enable() (or after enable(false)) a scope costs one atomic load.
+// Define PLAYGROUND_NO_DSP_PROFILER to compile the macros out.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PLAYGROUND_DSP_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PLAYGROUND_DSP_RDTSC 1
+#endif
+
+#include "playground/Telemetry.hpp"
+
+namespace playground {
+
+class DspProfiler {
+public:
+  /// Threads that can record; further threads are not timed
+  static constexpr int kMaxThreads = 64;
+  /// Records per thread between drains
+  static constexpr int kRingSize = 4096;
+
+  struct Row {
+    std::string name;
+    bool isClass; ///< a voice or other class rather than a named zone
+    uint64_t calls;
+    double mean;  ///< seconds per call
+    double p99;   ///< seconds per call
+    double worst; ///< seconds per call
+    double load;  ///< share of one core's time since reset()
+  };
+
+  /// The profiler shared by every scope
+  static DspProfiler &get() {
+    static DspProfiler profiler;
+    return profiler;
+  }
+
+  DspProfiler(const DspProfiler &) = delete;
+  DspProfiler &operator=(const DspProfiler &) = delete;
+
+  ~DspProfiler() {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mRunning = false;
+    }
+    mWake.notify_all();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+  /// Start or stop timing. The first call allocates the rings and starts
+  /// the aggregating thread, so make it before the audio starts.
+  void enable(bool on = true) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (on && !mWorker.joinable()) {
+      for (auto &ring : mRings) {
+        ring.reset(new TelemetryChannel<Record>(kRingSize));
+      }
+      mStartTicks = mLastTicks = mResetTicks = ticks();
+      mStartTime = std::chrono::steady_clock::now();
+      mRunning = true;
+      mWorker = std::thread([this]() { workerLoop(); });
+    }
+    mEnabled.store(on, std::memory_order_release);
+  }
+
+  bool enabled() const { return mEnabled.load(std::memory_order_acquire); }
+
+  /// Forget what was measured so far
+  void reset() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntries.clear();
+    mResetTicks = mLastTicks;
+  }
+
+  /// Everything measured since reset(), the heaviest load first
+  std::vector<Row> rows() {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::vector<Row> rows;
+    const double span = double(mLastTicks - mResetTicks);
+    for (const auto &e : mEntries) {
+      const Entry &entry = e.second;
+      Row row;
+      row.isClass = entry.isClass;
+      row.name = entry.isClass
+                     ? demangle(static_cast<const std::type_info *>(e.first)->name())
+                     : static_cast<const char *>(e.first);
+      row.calls = entry.calls;
+      row.mean = double(entry.sum) / double(entry.calls) / mTicksPerSecond;
+      row.p99 = percentile(entry, 0.99) / mTicksPerSecond;
+      row.worst = double(entry.worst) / mTicksPerSecond;
+      row.load = span > 0 ? double(entry.sum) / span : 0.0;
+      rows.push_back(std::move(row));
+    }
+    std::sort(rows.begin(), rows.end(),
+              [](const Row &a, const Row &b) { return a.load > b.load; });
+    return rows;
+  }
+
+  /// Write rows() to path as CSV, times in microseconds. Returns false if
+  /// the file could not be written.
+  bool writeCsv(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+      return false;
+    }
+    fprintf(file, "name,kind,calls,mean_us,p99_us,worst_us,load_percent\n");
+    for (const Row &row : rows()) {
+      std::string name; // class names can hold commas and quotes
+      for (char c : row.name) {
+        name += c == '"' ? std::string("\"\"") : std::string(1, c);
+      }
+      fprintf(file, "\"%s\",%s,%llu,%.3f,%.3f,%.3f,%.3f\n", name.c_str(),
+              row.isClass ? "class" : "zone", (unsigned long long)row.calls,
+              row.mean * 1e6, row.p99 * 1e6, row.worst * 1e6, row.load * 100);
+    }
+    return fclose(file) == 0;
+  }
+
+  /// Records lost because a ring filled up between drains
+  uint64_t dropped() {
+    std::lock_guard<std::mutex> lock(mLock);
+    uint64_t dropped = 0;
+    const int threads = std::min(mThreads.load(), int(kMaxThreads));
+    for (int t = 0; t < threads; t++) {
+      if (mRings[t]) {
+        dropped += mRings[t]->dropped();
+      }
+    }
+    return dropped;
+  }
+
+  /// Cycle counter read by the scopes
+  static uint64_t ticks() {
+#if PLAYGROUND_DSP_RDTSC
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t t;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+#endif
+  }
+
+  /// Add a call of key that took elapsed ticks. key is a zone name or a
+  /// std::type_info. Wait-free; only call while enabled().
+  void record(const void *key, bool isClass, uint64_t elapsed) {
+    static thread_local int thread = -1;
+    if (thread < 0) {
+      thread = std::min(mThreads.fetch_add(1, std::memory_order_relaxed),
+                        int(kMaxThreads));
+    }
+    if (thread < kMaxThreads) {
+      mRings[thread]->publish({key, elapsed, isClass});
+    }
+  }
+
+  /// Times the enclosing scope under name, which must outlive the profiler
+  /// (a string literal)
+  class Zone {
+  public:
+    explicit Zone(const char *name)
+        : mName(name), mStart(get().enabled() ? ticks() : 0) {}
+    ~Zone() {
+      if (mStart) {
+        get().record(mName, false, ticks() - mStart);
+      }
+    }
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+  private:
+    const char *mName;
+    uint64_t mStart;
+  };
+
+  /// Times the enclosing scope under type, the class of object
+  class ClassZone {
+  public:
+    ClassZone(const std::type_info &type, const void *object)
+        : mType(&type), mOuter(current()) {
+      if (mOuter == object || !get().enabled()) {
+        return; // already timed further out
+      }
+      current() = object;
+      mStart = ticks();
+    }
+    ~ClassZone() {
+      if (mStart) {
+        get().record(mType, true, ticks() - mStart);
+        current() = mOuter;
+      }
+    }
+    ClassZone(const ClassZone &) = delete;
+    ClassZone &operator=(const ClassZone &) = delete;
+
+  private:
+    static const void *&current() {
+      static thread_local const void *object = nullptr;
+      return object;
+    }
+
+    const std::type_info *mType;
+    const void *mOuter;
+    uint64_t mStart{0};
+  };
+
+private:
+  static constexpr int kSubBins = 8; // per octave
+  static constexpr int kBins = 64 * kSubBins;
+
+  struct Record {
+    const void *key;
+    uint64_t ticks;
+    bool isClass;
+  };
+
+  struct Entry {
+    bool isClass{false};
+    uint64_t calls{0};
+    uint64_t sum{0};
+    uint64_t worst{0};
+    uint32_t bins[kBins] = {};
+  };
+
+  DspProfiler() = default;
+
+  static int bin(uint64_t t) {
+    if (t == 0) {
+      return 0;
+    }
+    int octave = 63;
+    while (!(t >> octave)) {
+      octave--;
+    }
+    const int sub = octave >= 3 ? int(t >> (octave - 3)) & (kSubBins - 1)
+                                : int(t << (3 - octave)) & (kSubBins - 1);
+    return octave * kSubBins + sub;
+  }
+
+  // Upper edge of the bin holding the given share of calls, in ticks
+  static double percentile(const Entry &entry, double share) {
+    const uint64_t target = uint64_t(std::ceil(share * double(entry.calls)));
+    uint64_t count = 0;
+    for (int b = 0; b < kBins; b++) {
+      count += entry.bins[b];
+      if (count >= target) {
+        const double edge = std::ldexp(
+            1.0 + double(b % kSubBins + 1) / kSubBins, b / kSubBins);
+        return std::min(edge, double(entry.worst));
+      }
+    }
+    return double(entry.worst);
+  }
+
+  static std::string demangle(const char *name) {
+#if defined(__GNUC__)
+    int status = 0;
+    char *plain = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result = status == 0 && plain ? plain : name;
+    std::free(plain);
+    return result;
+#else
+    return name;
+#endif
+  }
+
+  void workerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (mRunning) {
+      drain();
+      mWake.wait_for(lock, std::chrono::milliseconds(20),
+                     [this]() { return !mRunning; });
+    }
+  }
+
+  // With mLock held
+  void drain() {
+    const int threads = std::min(mThreads.load(), int(kMaxThreads));
+    for (int t = 0; t < threads; t++) {
+      mRings[t]->drain([this](const Record &r) {
+        Entry &entry = mEntries[r.key];
+        entry.isClass = r.isClass;
+        entry.calls++;
+        entry.sum += r.ticks;
+        entry.worst = std::max(entry.worst, r.ticks);
+        entry.bins[bin(r.ticks)]++;
+      });
+    }
+    mLastTicks = ticks();
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - mStartTime)
+                               .count();
+    if (seconds > 0.01) {
+      mTicksPerSecond = double(mLastTicks - mStartTicks) / seconds;
+    }
+  }
+
+  std::atomic<bool> mEnabled{false};
+  std::atomic<int> mThreads{0}; // threads that have recorded
+  std::unique_ptr<TelemetryChannel<Record>> mRings[kMaxThreads];
+
+  std::mutex mLock;
+  std::condition_variable mWake;
+  std::unordered_map<const void *, Entry> mEntries;
+  uint64_t mStartTicks{0};
+  uint64_t mLastTicks{0};  // at the last drain
+  uint64_t mResetTicks{0}; // at the last reset()
+  std::chrono::steady_clock::time_point mStartTime;
+  double mTicksPerSecond{1e9}; // until measured
+  bool mRunning{false};
+  std::thread mWorker;
+};
+
+} // namespace playground
+
+#if defined(PLAYGROUND_NO_DSP_PROFILER)
+
+#define PLAYGROUND_DSP_ZONE(name) (void)0
+#define PLAYGROUND_DSP_VOICE(voice) (void)0
+
+#else
+
+#define PLAYGROUND_DSP_CONCAT_(a, b) a##b
+#define PLAYGROUND_DSP_CONCAT(a, b) PLAYGROUND_DSP_CONCAT_(a, b)
+#define PLAYGROUND_DSP_ZONE(name)                                              \
+  ::playground::DspProfiler::Zone PLAYGROUND_DSP_CONCAT(playgroundDspZone,      \
+                                                        __LINE__)(name)
+#define PLAYGROUND_DSP_VOICE(voice)                                            \
+  ::playground::DspProfiler::ClassZone PLAYGROUND_DSP_CONCAT(                  \
+      playgroundDspVoice, __LINE__)(typeid(*(voice)), voice)
+
+#endif // PLAYGROUND_NO_DSP_PROFILER
+
+#endif // PLAYGROUND_DSPPROFILER_HPP
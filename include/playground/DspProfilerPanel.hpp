@@ -0,0 +1,82 @@
+#ifndef PLAYGROUND_DSPPROFILERPANEL_HPP
+#define PLAYGROUND_DSPPROFILERPANEL_HPP
+
+// The DspProfiler's measurements as an ImGui section, for a ParameterGUI
+// panel or any other ImGui window:
+//
+//   gui.drawFunction = [&]() {
+//     ParameterGUI::drawAudioIO(audioIO());
+//     playground::drawDspLoad();
+//   };
+//
+// Lists every voice class and zone measured since the last reset, heaviest
+// first, with its calls, mean, 99th percentile and worst time per call in
+// microseconds and its load in percent of one core. "Export CSV" writes the
+// same table to csvPath. Draw from the GUI thread only.
+
+#include <string>
+
+#include "al/io/al_Imgui.hpp"
+
+#include "playground/DspProfiler.hpp"
+
+namespace playground {
+
+inline void drawDspLoad(const char *csvPath = "dsp_load.csv",
+                        DspProfiler &profiler = DspProfiler::get()) {
+  static std::string status;
+  if (!ImGui::CollapsingHeader("DSP load", ImGuiTreeNodeFlags_DefaultOpen)) {
+    return;
+  }
+  bool on = profiler.enabled();
+  if (ImGui::Checkbox("Measure", &on)) {
+    profiler.enable(on);
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    profiler.reset();
+    status.clear();
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Export CSV")) {
+    status = profiler.writeCsv(csvPath) ? std::string("Wrote ") + csvPath
+                                        : std::string("Could not write ") +
+                                              csvPath;
+  }
+  if (!status.empty()) {
+    ImGui::Text("%s", status.c_str());
+  }
+
+  const auto rows = profiler.rows();
+  ImGui::Columns(6, "dsp load");
+  for (const char *heading :
+       {"Class or zone", "Calls", "Mean us", "p99 us", "Worst us", "Load %"}) {
+    ImGui::Text("%s", heading);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (const auto &row : rows) {
+    ImGui::Text("%s", row.name.c_str());
+    ImGui::NextColumn();
+    ImGui::Text("%llu", (unsigned long long)row.calls);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", row.mean * 1e6);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", row.p99 * 1e6);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", row.worst * 1e6);
+    ImGui::NextColumn();
+    ImGui::Text("%.2f", row.load * 100);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+  const uint64_t dropped = profiler.dropped();
+  if (dropped > 0) {
+    ImGui::Text("%llu calls not counted (rings full)",
+                (unsigned long long)dropped);
+  }
+}
+
+} // namespace playground
+
+#endif // PLAYGROUND_DSPPROFILERPANEL_HPP
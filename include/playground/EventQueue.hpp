@@ -0,0 +1,366 @@
+#ifndef PLAYGROUND_EVENTQUEUE_HPP
+#define PLAYGROUND_EVENTQUEUE_HPP
+
+// Scheduling notes from the GUI, MIDI, OSC or score threads without locks.
+//
+// Calling PolySynth::triggerOn() or SynthSequencer::addVoiceFromNow() from
+// the UI thread takes locks the audio thread also needs, and the note starts
+// at whatever block boundary the audio thread happens to be at. EventQueue
+// moves scheduling over to the audio thread:
+//
+//   EventQueue mEvents;
+//   EventQueue::Producer mUiEvents = mEvents.producer(); // one per thread
+//
+//   // UI thread: prepare the voice here, the audio thread only starts it
+//   auto *voice = mUiEvents.getVoice<SineEnv>(synth);
+//   if (voice) { // null while the ring is full
+//     voice->setTriggerParams(params);
+//     mUiEvents.noteOn(voice, mEvents.nowFrames() + mEvents.seconds(time),
+//                      mEvents.seconds(duration));
+//   }
+//
+//   // Audio thread, before rendering the synth
+//   mEvents.dispatch(synth, io);
+//
+// Each producer owns a bounded single-producer ring, so pushing is wait-free
+// and a full queue drops the event instead of blocking. A voice taken from
+// the synth is only returned to its free voices once it has played, so a
+// dropped note on would strand it: take voices through Producer::getVoice(),
+// or check available() first, and the note on that follows cannot fail. The audio thread
+// drains every ring into a preallocated schedule ordered by time and starts
+// the voices that are due at their exact frame within the block.
+//
+// Times are absolute frame counts of the audio stream. nowFrames() is the
+// current stream position interpolated from the wall clock plus one block of
+// latency, so live events land a constant delay after they happen instead of
+// being snapped to the next block boundary. How late events were when they
+// were dispatched is kept in stats(), which makes scheduling jitter visible.
+//
+// Note offs go through PolySynth::triggerOff(id), which takes effect at the
+// start of the block they are due in.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_PolySynth.hpp"
+
+#include "playground/RtSanitizer.hpp"
+
+namespace playground {
+
+struct NoteEvent {
+  enum Type : uint8_t { NOTE_ON, NOTE_OFF };
+
+  uint64_t frame{0};    ///< absolute stream time
+  uint64_t duration{0}; ///< frames until the note off, 0 to wait for NOTE_OFF
+  al::SynthVoice *voice{nullptr}; ///< NOTE_ON: prepared voice
+  int id{0};
+  Type type{NOTE_ON};
+};
+
+class EventQueue {
+  // Bounded ring with one writer and the audio thread as its reader
+  struct Lane {
+    explicit Lane(size_t capacity) : events(capacity) {}
+    std::vector<NoteEvent> events;
+    std::atomic<size_t> head{0}; // next slot to read
+    char pad[64];                // keep reader and writer off one cache line
+    std::atomic<size_t> tail{0}; // next slot to write
+    std::atomic<uint32_t> dropped{0};
+  };
+
+public:
+  /// Handle for pushing events from one thread. Copies share the same ring,
+  /// so they must stay on the thread the handle was made for.
+  class Producer {
+  public:
+    Producer() = default;
+
+    bool valid() const { return mLane != nullptr; }
+
+    /// Number of events that can be pushed right now without being dropped
+    size_t available() const {
+      const size_t used = mLane->tail.load(std::memory_order_relaxed) -
+                          mLane->head.load(std::memory_order_acquire);
+      return mLane->events.size() - used;
+    }
+
+    /// A free voice of TVoice from synth, or null if the ring has no room
+    /// for its note on. Room only grows between pushes from this thread, so
+    /// the noteOn() for the voice cannot fail.
+    template <class TVoice> TVoice *getVoice(al::PolySynth &synth) {
+      return valid() && available() > 0 ? synth.getVoice<TVoice>() : nullptr;
+    }
+
+    /// Start voice at frame and release it duration frames later
+    /// (0 for a note that waits for noteOff()). Returns false if the ring is
+    /// full, in which case the voice is not started and is lost to the
+    /// synth: see getVoice().
+    bool noteOn(al::SynthVoice *voice, uint64_t frame, uint64_t duration = 0,
+                int id = -1) {
+      NoteEvent event;
+      event.type = NoteEvent::NOTE_ON;
+      event.frame = frame;
+      event.duration = duration;
+      event.voice = voice;
+      event.id = id >= 0 ? id : mQueue->newNoteId();
+      return push(event);
+    }
+
+    bool noteOff(int id, uint64_t frame) {
+      NoteEvent event;
+      event.type = NoteEvent::NOTE_OFF;
+      event.frame = frame;
+      event.id = id;
+      return push(event);
+    }
+
+    bool push(const NoteEvent &event) {
+      Lane &lane = *mLane;
+      const size_t tail = lane.tail.load(std::memory_order_relaxed);
+      const size_t head = lane.head.load(std::memory_order_acquire);
+      if (tail - head >= lane.events.size()) {
+        lane.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      lane.events[tail % lane.events.size()] = event;
+      lane.tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    friend class EventQueue;
+    Producer(EventQueue *queue, Lane *lane) : mQueue(queue), mLane(lane) {}
+    EventQueue *mQueue{nullptr};
+    Lane *mLane{nullptr};
+  };
+
+  struct Stats {
+    uint64_t dispatched{0};  ///< note ons started
+    uint64_t late{0};        ///< note ons that started after their frame
+    uint64_t maxLateFrames{0};
+    double meanLateFrames{0.0}; ///< over late events only
+    uint64_t dropped{0};     ///< events lost to full rings or a full schedule
+  };
+
+  /// capacity is per producer ring; the audio side schedule holds
+  /// scheduleCapacity pending events (including pending note offs)
+  explicit EventQueue(size_t capacity = 1024, size_t scheduleCapacity = 4096,
+                      int maxProducers = 8)
+      : mMaxProducers(maxProducers) {
+    mLanes.reserve(maxProducers);
+    for (int i = 0; i < maxProducers; i++) {
+      mLanes.emplace_back(new Lane(capacity));
+    }
+    mSchedule.reserve(scheduleCapacity);
+  }
+
+  /// Register a producer thread. Call outside the audio thread.
+  Producer producer() {
+    int index = mNumProducers.load();
+    while (index < mMaxProducers &&
+           !mNumProducers.compare_exchange_weak(index, index + 1)) {
+    }
+    if (index >= mMaxProducers) {
+      return Producer();
+    }
+    return Producer(this, mLanes[index].get());
+  }
+
+  /// Unique ids for scheduled notes, kept clear of keyboard and MIDI ids
+  int newNoteId() {
+    return kFirstNoteId + int(mNextNoteId.fetch_add(1) & 0xfffffff);
+  }
+
+  /// Sample rate used by seconds() until the first dispatch() reports the
+  /// stream's own
+  void sampleRate(double sr) { mSampleRate.store(sr); }
+
+  /// Frames in the given number of seconds at the stream's sample rate
+  uint64_t seconds(double s) const {
+    return s > 0 ? uint64_t(s * mSampleRate.load(std::memory_order_relaxed) + 0.5)
+                 : 0;
+  }
+
+  /// Earliest frame a live event can still be started at on time: the
+  /// current stream position plus one block. Safe to call from any thread.
+  uint64_t nowFrames() const {
+    uint64_t frame, nanos;
+    uint32_t seq;
+    do { // seqlock: retry if the audio thread published in between
+      seq = mClockSeq.load(std::memory_order_acquire);
+      frame = mClockFrame.load(std::memory_order_relaxed);
+      nanos = mClockNanos.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != mClockSeq.load(std::memory_order_relaxed));
+    const double sr = mSampleRate.load(std::memory_order_relaxed);
+    const double elapsed = double(steadyNanos() - int64_t(nanos)) * 1e-9;
+    const uint64_t block = mFramesPerBuffer.load(std::memory_order_relaxed);
+    // Clamp to a block: past that the callback is late and the clock stale
+    const uint64_t sinceBlock =
+        std::min(block, uint64_t(std::max(0.0, elapsed * sr)));
+    return frame + sinceBlock + block;
+  }
+
+  // ---- Audio thread ----
+
+  /// Start and stop the notes due in the next io.framesPerBuffer() frames.
+  /// Call once per callback, before rendering synth.
+  void dispatch(al::PolySynth &synth, const al::AudioIOData &io) {
+    const uint64_t blockStart = mFrame;
+    const uint64_t blockSize = io.framesPerBuffer();
+    const uint64_t blockEnd = blockStart + blockSize;
+    publishClock(blockStart, io.framesPerSecond(), blockSize);
+
+    drainLanes();
+    while (!mSchedule.empty() && mSchedule.front().event.frame < blockEnd) {
+      std::pop_heap(mSchedule.begin(), mSchedule.end(), Later());
+      NoteEvent event = mSchedule.back().event;
+      mSchedule.pop_back();
+
+      if (event.type == NoteEvent::NOTE_OFF) {
+        synth.triggerOff(event.id);
+        continue;
+      }
+      uint64_t offset = 0;
+      if (event.frame >= blockStart) {
+        offset = event.frame - blockStart;
+      } else {
+        recordLate(blockStart - event.frame);
+      }
+      mDispatched++;
+      {
+        PLAYGROUND_RT_VOICE(event.voice); // onTriggerOn() runs in here
+        synth.triggerOn(event.voice, int(offset), event.id);
+      }
+      if (event.duration > 0) {
+        NoteEvent off;
+        off.type = NoteEvent::NOTE_OFF;
+        off.id = event.id;
+        off.frame = std::max(event.frame, blockStart) + event.duration;
+        schedule(off);
+      }
+    }
+    mFrame = blockEnd;
+    publishStats();
+  }
+
+  /// Frame at the start of the next block (audio thread)
+  uint64_t frame() const { return mFrame; }
+
+  /// Snapshot of the dispatch statistics. Safe to call from any thread.
+  Stats stats() const {
+    Stats s;
+    s.dispatched = mStatDispatched.load(std::memory_order_relaxed);
+    s.late = mStatLate.load(std::memory_order_relaxed);
+    s.maxLateFrames = mStatMaxLate.load(std::memory_order_relaxed);
+    uint64_t sum = mStatSumLate.load(std::memory_order_relaxed);
+    s.meanLateFrames = s.late > 0 ? double(sum) / s.late : 0.0;
+    s.dropped = mStatDropped.load(std::memory_order_relaxed);
+    for (int i = 0; i < mNumProducers.load(); i++) {
+      s.dropped += mLanes[i]->dropped.load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+private:
+  static constexpr int kFirstNoteId = 0x10000000;
+
+  struct Pending {
+    NoteEvent event;
+    uint64_t order; // keeps events with the same frame in arrival order
+  };
+  struct Later {
+    bool operator()(const Pending &a, const Pending &b) const {
+      return a.event.frame != b.event.frame ? a.event.frame > b.event.frame
+                                            : a.order > b.order;
+    }
+  };
+
+  int mMaxProducers;
+  std::vector<std::unique_ptr<Lane>> mLanes;
+  std::atomic<int> mNumProducers{0};
+  std::atomic<uint32_t> mNextNoteId{0};
+
+  // Audio thread state
+  std::vector<Pending> mSchedule; // min-heap on frame, never reallocated
+  uint64_t mFrame{0};
+  uint64_t mOrder{0};
+  uint64_t mDispatched{0}, mLate{0}, mMaxLate{0}, mSumLate{0}, mDropped{0};
+
+  // Published by the audio thread
+  std::atomic<uint32_t> mClockSeq{0};
+  std::atomic<uint64_t> mClockFrame{0};
+  std::atomic<uint64_t> mClockNanos{0};
+  std::atomic<double> mSampleRate{44100.0};
+  std::atomic<uint64_t> mFramesPerBuffer{512};
+  std::atomic<uint64_t> mStatDispatched{0}, mStatLate{0}, mStatMaxLate{0},
+      mStatSumLate{0}, mStatDropped{0};
+
+  static int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void publishClock(uint64_t frame, double sampleRate, uint64_t blockSize) {
+    const uint32_t seq = mClockSeq.load(std::memory_order_relaxed);
+    mClockSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mClockFrame.store(frame, std::memory_order_relaxed);
+    mClockNanos.store(uint64_t(steadyNanos()), std::memory_order_relaxed);
+    mClockSeq.store(seq + 2, std::memory_order_release);
+    mSampleRate.store(sampleRate, std::memory_order_relaxed);
+    mFramesPerBuffer.store(blockSize, std::memory_order_relaxed);
+  }
+
+  void drainLanes() {
+    const int numLanes = mNumProducers.load(std::memory_order_acquire);
+    for (int i = 0; i < numLanes; i++) {
+      Lane &lane = *mLanes[i];
+      size_t head = lane.head.load(std::memory_order_relaxed);
+      const size_t tail = lane.tail.load(std::memory_order_acquire);
+      // Leave events in the ring while the schedule is full, so producers
+      // see the back pressure instead of events vanishing here
+      for (; head != tail && mSchedule.size() < mSchedule.capacity(); head++) {
+        schedule(lane.events[head % lane.events.size()]);
+      }
+      lane.head.store(head, std::memory_order_release);
+    }
+  }
+
+  // Never drops a note on, which would strand its voice: drainLanes() only
+  // moves events out of the rings while there is room, and a note on is
+  // popped before its note off is pushed, so note offs always find room.
+  void schedule(const NoteEvent &event) {
+    if (mSchedule.size() == mSchedule.capacity()) {
+      mDropped++; // never grow on the audio thread
+      return;
+    }
+    mSchedule.push_back({event, mOrder++});
+    std::push_heap(mSchedule.begin(), mSchedule.end(), Later());
+  }
+
+  void recordLate(uint64_t frames) {
+    mLate++;
+    mSumLate += frames;
+    mMaxLate = std::max(mMaxLate, frames);
+  }
+
+  void publishStats() {
+    mStatDispatched.store(mDispatched, std::memory_order_relaxed);
+    mStatLate.store(mLate, std::memory_order_relaxed);
+    mStatMaxLate.store(mMaxLate, std::memory_order_relaxed);
+    mStatSumLate.store(mSumLate, std::memory_order_relaxed);
+    mStatDropped.store(mDropped, std::memory_order_relaxed);
+  }
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_EVENTQUEUE_HPP
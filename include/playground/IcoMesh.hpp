@@ -0,0 +1,339 @@
+#ifndef PLAYGROUND_ICOMESH_HPP
+#define PLAYGROUND_ICOMESH_HPP
+
+// Binary, memory mapped icosphere meshes (.icomesh) for the blob.
+//
+// A text .ico file lists vertex positions, triangle indices and the
+// neighbors of every vertex, one per line, and has to be parsed number by
+// number on every node at startup. A .icomesh holds the same data as arrays
+// that are used in place:
+//
+//   header | positions | indices | neighbor offsets | neighbors
+//
+// Positions are x, y, z floats per vertex, indices are uint32_t triangle
+// corners and the neighbors are in compressed sparse row form, as
+// SpringMesh::build() takes them. Every array starts on a 64 byte boundary.
+// The vertices are stored in SpringMesh::breadthFirstOrder(), so the solver
+// can use them without renumbering.
+//
+//   playground::IcoMeshFile file;
+//   if (file.open("163842.icomesh")) {
+//     mesh.vertices().resize(file.numVertices());
+//     memcpy(&mesh.vertices()[0], file.positions(), file.positionBytes());
+//     mesh.indices().assign(file.indices(), file.indices() + file.numIndices());
+//     springs.build(file.numVertices(), file.positions(),
+//                   file.neighborOffsets(), file.neighbors(), false);
+//   }
+//
+// convertIcoText() turns the text format into this one. Files are written in
+// native byte order, like .synthScore files.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#endif
+
+#include "playground/MappedFile.hpp"
+#include "playground/SpringMesh.hpp"
+
+namespace playground {
+
+namespace ico_format {
+
+static const char kMagic[8] = {'I', 'C', 'O', 'M', 'E', 'S', 'H', '\0'};
+static const uint32_t kVersion = 1;
+static const uint64_t kAlignment = 64;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t numIndices;
+  uint32_t numNeighbors;
+  uint64_t positionsOffset; ///< float[3 * numVertices]
+  uint64_t indicesOffset;   ///< uint32_t[numIndices]
+  uint64_t offsetsOffset;   ///< int32_t[numVertices + 1]
+  uint64_t neighborsOffset; ///< int32_t[numNeighbors]
+  uint64_t fileSize;
+};
+
+inline uint64_t align(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+} // namespace ico_format
+
+class IcoMeshFile {
+public:
+  /// Map a .icomesh file and check it is consistent
+  bool open(const std::string &path) {
+    close();
+    if (!mFile.open(path)) {
+      return false;
+    }
+    // Everything is about to be copied or read by the solver
+    mFile.willNeed();
+    const char *data = mFile.data();
+    if (mFile.size() < sizeof(ico_format::Header)) {
+      close();
+      return false;
+    }
+    memcpy(&mHeader, data, sizeof(mHeader));
+    const auto &h = mHeader;
+    if (memcmp(h.magic, ico_format::kMagic, sizeof(h.magic)) != 0 ||
+        h.version != ico_format::kVersion || h.fileSize > mFile.size() ||
+        h.positionsOffset + 12 * uint64_t(h.numVertices) > h.fileSize ||
+        h.indicesOffset + 4 * uint64_t(h.numIndices) > h.fileSize ||
+        h.offsetsOffset + 4 * (uint64_t(h.numVertices) + 1) > h.fileSize ||
+        h.neighborsOffset + 4 * uint64_t(h.numNeighbors) > h.fileSize ||
+        h.positionsOffset % 4 || h.indicesOffset % 4 || h.offsetsOffset % 4 ||
+        h.neighborsOffset % 4) {
+      fprintf(stderr, "IcoMeshFile: %s is not a valid .icomesh\n",
+              path.c_str());
+      close();
+      return false;
+    }
+    mPositions = reinterpret_cast<const float *>(data + h.positionsOffset);
+    mIndices = reinterpret_cast<const uint32_t *>(data + h.indicesOffset);
+    mOffsets = reinterpret_cast<const int *>(data + h.offsetsOffset);
+    mNeighbors = reinterpret_cast<const int *>(data + h.neighborsOffset);
+
+    // Out of range numbers would make the renderer and solver read out of
+    // bounds, so check them once here
+    bool valid = mOffsets[0] == 0 &&
+                 mOffsets[h.numVertices] == int(h.numNeighbors);
+    for (uint32_t i = 0; valid && i < h.numVertices; i++) {
+      valid = mOffsets[i] <= mOffsets[i + 1];
+    }
+    for (uint32_t i = 0; valid && i < h.numIndices; i++) {
+      valid = mIndices[i] < h.numVertices;
+    }
+    for (uint32_t i = 0; valid && i < h.numNeighbors; i++) {
+      valid = mNeighbors[i] >= 0 && uint32_t(mNeighbors[i]) < h.numVertices;
+    }
+    if (!valid) {
+      fprintf(stderr, "IcoMeshFile: %s has out of range vertices\n",
+              path.c_str());
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    mFile.close();
+    mPositions = nullptr;
+    mIndices = nullptr;
+    mOffsets = nullptr;
+    mNeighbors = nullptr;
+    memset(&mHeader, 0, sizeof(mHeader));
+  }
+
+  bool isOpen() const { return mPositions != nullptr; }
+
+  int numVertices() const { return int(mHeader.numVertices); }
+  size_t numIndices() const { return mHeader.numIndices; }
+  size_t numNeighbors() const { return mHeader.numNeighbors; }
+
+  /// x, y, z per vertex
+  const float *positions() const { return mPositions; }
+  size_t positionBytes() const { return 3 * sizeof(float) * numVertices(); }
+  const uint32_t *indices() const { return mIndices; }
+  /// numVertices() + 1 entries
+  const int *neighborOffsets() const { return mOffsets; }
+  const int *neighbors() const { return mNeighbors; }
+
+private:
+  MappedFile mFile;
+  ico_format::Header mHeader{};
+  const float *mPositions{nullptr};
+  const uint32_t *mIndices{nullptr};
+  const int *mOffsets{nullptr};
+  const int *mNeighbors{nullptr};
+};
+
+/// Write a .icomesh as is (vertices in the order given). The file is written
+/// under a temporary name and renamed into place, so several nodes converting
+/// into a shared directory at once never see a partial file.
+inline bool writeIcoMesh(const std::string &path, int numVertices,
+                         const float *positions, size_t numIndices,
+                         const uint32_t *indices, const int *offsets,
+                         const int *neighbors) {
+  ico_format::Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, ico_format::kMagic, sizeof(h.magic));
+  h.version = ico_format::kVersion;
+  h.numVertices = uint32_t(numVertices);
+  h.numIndices = uint32_t(numIndices);
+  h.numNeighbors = uint32_t(offsets[numVertices]);
+  h.positionsOffset = ico_format::align(sizeof(h));
+  h.indicesOffset =
+      ico_format::align(h.positionsOffset + 12 * uint64_t(numVertices));
+  h.offsetsOffset = ico_format::align(h.indicesOffset + 4 * uint64_t(numIndices));
+  h.neighborsOffset =
+      ico_format::align(h.offsetsOffset + 4 * (uint64_t(numVertices) + 1));
+  h.fileSize = h.neighborsOffset + 4 * uint64_t(h.numNeighbors);
+
+#ifdef _WIN32
+  const std::string temporary = path + "." + std::to_string(_getpid());
+#else
+  const std::string temporary = path + "." + std::to_string(getpid());
+#endif
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  uint64_t written = 0;
+  bool ok = true;
+  auto put = [&](uint64_t offset, const void *data, size_t bytes) {
+    static const char zeros[ico_format::kAlignment] = {0};
+    if (offset > written) {
+      ok = ok && fwrite(zeros, 1, size_t(offset - written), file) ==
+                     size_t(offset - written);
+    }
+    ok = ok && fwrite(data, 1, bytes, file) == bytes;
+    written = offset + bytes;
+  };
+  put(0, &h, sizeof(h));
+  put(h.positionsOffset, positions, 12 * size_t(numVertices));
+  put(h.indicesOffset, indices, 4 * numIndices);
+  put(h.offsetsOffset, offsets, 4 * (size_t(numVertices) + 1));
+  put(h.neighborsOffset, neighbors, 4 * size_t(h.numNeighbors));
+  ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+  // rename() does not replace existing files on Windows
+  remove(path.c_str());
+#endif
+  if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+    remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Convert a text .ico file (vertices, "|", indices, "|", neighbor lists) to
+/// a .icomesh, renumbering the vertices in SpringMesh::breadthFirstOrder()
+inline bool convertIcoText(const std::string &textPath,
+                           const std::string &meshPath, bool verbose = true) {
+  FILE *in = fopen(textPath.c_str(), "rb");
+  if (!in) {
+    if (verbose) {
+      fprintf(stderr, "convertIcoText: can't open %s\n", textPath.c_str());
+    }
+    return false;
+  }
+  std::string text;
+  char chunk[1 << 16];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    text.append(chunk, n);
+  }
+  fclose(in);
+
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  std::vector<int> offsets(1, 0);
+  std::vector<int> neighbors;
+  int section = 0;
+  const char *p = text.c_str();
+  const char *end = p + text.size();
+  while (p < end) {
+    const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (!lineEnd) {
+      lineEnd = end;
+    }
+    if (*p == '|') {
+      section++;
+    } else if (lineEnd > p && *p != '\r') {
+      // Comma separated numbers; strtof and strtol stop at the comma
+      const char *q = p;
+      char *next;
+      switch (section) {
+      case 0:
+        for (int axis = 0; axis < 3; axis++) {
+          positions.push_back(strtof(q, &next));
+          q = next + (*next == ',' ? 1 : 0);
+        }
+        break;
+      case 1:
+        indices.push_back(uint32_t(strtol(q, &next, 10)));
+        break;
+      case 2:
+        while (q < lineEnd) {
+          const long v = strtol(q, &next, 10);
+          if (next == q) {
+            break;
+          }
+          neighbors.push_back(int(v));
+          q = next + (*next == ',' ? 1 : 0);
+        }
+        offsets.push_back(int(neighbors.size()));
+        break;
+      }
+    }
+    p = lineEnd + 1;
+  }
+
+  const int numVertices = int(positions.size() / 3);
+  bool valid = section >= 2 && int(offsets.size()) == numVertices + 1;
+  for (uint32_t index : indices) {
+    valid = valid && index < uint32_t(numVertices);
+  }
+  for (int v : neighbors) {
+    valid = valid && v >= 0 && v < numVertices;
+  }
+  if (!valid) {
+    if (verbose) {
+      fprintf(stderr, "convertIcoText: %s is not a valid .ico file\n",
+              textPath.c_str());
+    }
+    return false;
+  }
+
+  // Renumber for the solver
+  const std::vector<int> order = SpringMesh::breadthFirstOrder(
+      numVertices, offsets.data(), neighbors.data());
+  std::vector<int> rank(numVertices);
+  for (int i = 0; i < numVertices; i++) {
+    rank[order[i]] = i;
+  }
+  std::vector<float> sortedPositions(positions.size());
+  std::vector<int> sortedOffsets(1, 0);
+  std::vector<int> sortedNeighbors;
+  sortedNeighbors.reserve(neighbors.size());
+  for (int i = 0; i < numVertices; i++) {
+    const int old = order[i];
+    memcpy(&sortedPositions[3 * i], &positions[3 * old], 3 * sizeof(float));
+    for (int k = offsets[old]; k < offsets[old + 1]; k++) {
+      sortedNeighbors.push_back(rank[neighbors[k]]);
+    }
+    sortedOffsets.push_back(int(sortedNeighbors.size()));
+  }
+  for (auto &index : indices) {
+    index = uint32_t(rank[index]);
+  }
+
+  if (!writeIcoMesh(meshPath, numVertices, sortedPositions.data(),
+                    indices.size(), indices.data(), sortedOffsets.data(),
+                    sortedNeighbors.data())) {
+    if (verbose) {
+      fprintf(stderr, "convertIcoText: can't write %s\n", meshPath.c_str());
+    }
+    return false;
+  }
+  if (verbose) {
+    printf("%s: %d vertices, %zu indices, %zu neighbors\n", meshPath.c_str(),
+           numVertices, indices.size(), neighbors.size());
+  }
+  return true;
+}
+
+} // namespace playground
+
+#endif // PLAYGROUND_ICOMESH_HPP
@@ -0,0 +1,258 @@
+#ifndef PLAYGROUND_INSTANCEBATCH_HPP
+#define PLAYGROUND_INSTANCEBATCH_HPP
+
+// Drawing many copies of a few meshes, e.g. one per synth voice, with one
+// instanced draw call per mesh instead of one draw call per copy.
+//
+// Meshes are registered once and shared; every frame, each copy is added
+// with its own transform and color, and draw() uploads them all and draws
+// each mesh once:
+//
+//   playground::InstanceBatch voiceMeshes;
+//
+//   // In a voice's init(): build the mesh only for the first voice
+//   static const int sphere = [] {
+//     Mesh m;
+//     addSphere(m, 1, 100, 100);
+//     m.generateNormals();
+//     return voiceMeshes.addMesh(m);
+//   }();
+//
+//   // In the voice's onProcess(Graphics &g), instead of drawing
+//   playground::InstanceBatch::Transform t;
+//   t.translate(x, y, z);
+//   t.rotate(angle, 0, 1, 0);
+//   t.scale(sx, sy, sz);
+//   voiceMeshes.add(sphere, t, HSV(hue, 0.5, 1));
+//
+//   // In the app's onDraw(), after synth.render(g)
+//   voiceMeshes.draw(g);
+//
+// Transforms compose like Graphics::translate(), rotate() (in degrees) and
+// scale() do, relative to the view at the time of draw(). Meshes are drawn
+// with their own primitive, in the given color, lit by one light from the
+// upper right front. Per vertex mesh colors are ignored, as they are under
+// Graphics::color().
+//
+// addMesh() may be called from any thread (voices are initialized wherever
+// they are first allocated); add() and draw() belong to the graphics thread.
+// Copies that are added but never drawn are dropped past kMaxInstances.
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "al/graphics/al_Graphics.hpp"
+#include "al/graphics/al_Shader.hpp"
+#include "al/graphics/al_VAOMesh.hpp"
+
+namespace playground {
+
+class InstanceBatch {
+public:
+  /// Copies of one mesh kept per frame at most
+  static constexpr size_t kMaxInstances = 65536;
+
+  /// A model matrix, column major, built up like the Graphics matrix stack
+  struct Transform {
+    float m[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    void translate(float x, float y, float z) {
+      for (int row = 0; row < 4; row++) {
+        m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+      }
+    }
+    void translate(const al::Vec3f &v) { translate(v.x, v.y, v.z); }
+
+    /// Rotate by degrees about the axis (x, y, z), which need not be unit
+    /// length. A zero axis leaves the transform as it is.
+    void rotate(float degrees, float x, float y, float z) {
+      const float length = std::sqrt(x * x + y * y + z * z);
+      if (!(length > 0)) {
+        return;
+      }
+      x /= length;
+      y /= length;
+      z /= length;
+      const double pi = 3.14159265358979323846;
+      const float radians = degrees * float(pi / 180.0);
+      const float c = std::cos(radians), s = std::sin(radians), t = 1 - c;
+      const float r[9] = {t * x * x + c,     t * x * y + s * z, t * x * z - s * y,
+                          t * x * y - s * z, t * y * y + c,     t * y * z + s * x,
+                          t * x * z + s * y, t * y * z - s * x, t * z * z + c};
+      float columns[12];
+      for (int col = 0; col < 3; col++) {
+        for (int row = 0; row < 4; row++) {
+          columns[4 * col + row] = m[row] * r[3 * col] +
+                                   m[4 + row] * r[3 * col + 1] +
+                                   m[8 + row] * r[3 * col + 2];
+        }
+      }
+      std::memcpy(m, columns, sizeof(columns));
+    }
+    void rotate(float degrees, const al::Vec3f &axis) {
+      rotate(degrees, axis.x, axis.y, axis.z);
+    }
+
+    void scale(float x, float y, float z) {
+      for (int row = 0; row < 4; row++) {
+        m[row] *= x;
+        m[4 + row] *= y;
+        m[8 + row] *= z;
+      }
+    }
+    void scale(float s) { scale(s, s, s); }
+  };
+
+  InstanceBatch() = default;
+  InstanceBatch(const InstanceBatch &) = delete;
+  InstanceBatch &operator=(const InstanceBatch &) = delete;
+
+  /// Share a copy of mesh, with normals already generated if it is to be
+  /// lit. Indexed meshes are expanded, as copies are drawn without indices.
+  /// Returns the id to add() copies of it under.
+  int addMesh(const al::Mesh &mesh) {
+    std::unique_ptr<Entry> entry(new Entry);
+    static_cast<al::Mesh &>(entry->mesh) = mesh;
+    if (!entry->mesh.indices().empty()) {
+      entry->mesh.decompress();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntries.push_back(std::move(entry));
+    return int(mEntries.size()) - 1;
+  }
+
+  /// Draw a copy of mesh with transform and color this frame
+  void add(int mesh, const Transform &transform, const al::Color &color) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto &instances = mEntries[mesh]->instances;
+    if (instances.size() >= kMaxInstances) {
+      return;
+    }
+    instances.emplace_back();
+    Instance &instance = instances.back();
+    std::memcpy(instance.model, transform.m, sizeof(instance.model));
+    instance.color[0] = color.r;
+    instance.color[1] = color.g;
+    instance.color[2] = color.b;
+    instance.color[3] = color.a;
+  }
+
+  /// Draw and forget the copies added since the last call: one draw call
+  /// per mesh that has any
+  void draw(al::Graphics &g) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mCompiled) {
+      mShader.compile(vertexShader(), fragmentShader());
+      mCompiled = true;
+    }
+    g.depthTesting(true);
+    g.shader(mShader);
+    g.update();
+    for (auto &entry : mEntries) {
+      if (entry->instances.empty()) {
+        continue;
+      }
+      if (!entry->created) {
+        createBuffers(*entry);
+      }
+      entry->buffer.bind();
+      entry->buffer.data(entry->instances.size() * sizeof(Instance),
+                         entry->instances.data());
+      entry->buffer.unbind();
+      entry->mesh.vao().bind();
+      glDrawArraysInstanced(GLenum(entry->mesh.primitive()), 0,
+                            GLsizei(entry->mesh.vertices().size()),
+                            GLsizei(entry->instances.size()));
+      entry->mesh.vao().unbind();
+      entry->instances.clear();
+    }
+  }
+
+private:
+  // Per instance attributes: model matrix in locations 5 to 8, color in 9
+  struct Instance {
+    float model[16];
+    float color[4];
+  };
+
+  struct Entry {
+    al::VAOMesh mesh;
+    al::BufferObject buffer;
+    std::vector<Instance> instances;
+    bool created{false};
+  };
+
+  static void createBuffers(Entry &entry) {
+    entry.mesh.update();
+    entry.buffer.bufferType(GL_ARRAY_BUFFER);
+    entry.buffer.usage(GL_STREAM_DRAW);
+    entry.buffer.create();
+    auto &vao = entry.mesh.vao();
+    vao.bind();
+    for (int column = 0; column < 5; column++) {
+      const unsigned location = 5 + column;
+      vao.enableAttrib(location);
+      vao.attribPointer(location, entry.buffer, 4, GL_FLOAT, GL_FALSE,
+                        sizeof(Instance),
+                        reinterpret_cast<void *>(column * 4 * sizeof(float)));
+      glVertexAttribDivisor(location, 1);
+    }
+    vao.unbind();
+    entry.created = true;
+  }
+
+  static std::string vertexShader() {
+    return R"(
+#version 330
+uniform mat4 al_ModelViewMatrix;
+uniform mat4 al_ProjectionMatrix;
+
+layout (location = 0) in vec3 position;
+layout (location = 3) in vec3 normal;
+layout (location = 5) in mat4 model; // one per instance, locations 5 to 8
+layout (location = 9) in vec4 color;
+
+out vec3 N;
+out vec4 C;
+
+void main() {
+  mat4 modelView = al_ModelViewMatrix * model;
+  gl_Position = al_ProjectionMatrix * modelView * vec4(position, 1.0);
+  N = transpose(inverse(mat3(modelView))) * normal;
+  C = color;
+}
+)";
+  }
+
+  static std::string fragmentShader() {
+    return R"(
+#version 330
+in vec3 N;
+in vec4 C;
+layout (location = 0) out vec4 fragColor;
+
+void main() {
+  // Unlit where there are no normals, e.g. on lines
+  float light = 1.0;
+  float len = length(N);
+  if (len > 1e-6) {
+    light = 0.3 + 0.7 * max(dot(N / len, normalize(vec3(1.0, 1.0, 2.0))), 0.0);
+  }
+  fragColor = vec4(C.rgb * light, C.a);
+}
+)";
+  }
+
+  std::mutex mLock;
+  std::vector<std::unique_ptr<Entry>> mEntries;
+  al::ShaderProgram mShader;
+  bool mCompiled{false};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_INSTANCEBATCH_HPP
@@ -0,0 +1,226 @@
+#ifndef PLAYGROUND_LEVELMETER_HPP
+#define PLAYGROUND_LEVELMETER_HPP
+
+// Peak, RMS and true peak levels for every output channel.
+//
+// The audio thread measures each block in a single pass per channel and
+// publishes the raw levels; the graphics thread turns them into meter values
+// with falling ballistics in dB and writes them wherever they are shown,
+// typically straight into the distributed state:
+//
+//   playground::LevelMeter mLevels;
+//   ...
+//   void onSound(AudioIOData &io) override {
+//     ...render...
+//     mLevels.processSound(io);
+//   }
+//   void onAnimate(double dt) override {
+//     if (isPrimary()) {
+//       mLevels.update(state().meterValues, 64);
+//     }
+//   }
+//
+// True peak is estimated from a 4x oversampled signal (32 tap windowed sinc
+// interpolator), so inter-sample overs that a sample peak meter misses are
+// caught.
+//
+// Meter values use the same scale as al::Meter: 0.01 at -60 dB and below,
+// rising by 0.005 per dB.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "al/io/al_AudioIOData.hpp"
+
+#include "playground/BufferOps.hpp"
+#include "playground/Telemetry.hpp"
+
+namespace playground {
+
+class LevelMeter {
+public:
+  static constexpr int kMaxChannels = 128;
+
+  /// Which level drives the meter values written by update()
+  enum Measure { PEAK = 0, RMS, TRUE_PEAK, NUM_MEASURES };
+
+  LevelMeter() {
+    // 4x interpolator: a windowed sinc split into 4 phases of 8 taps. Each
+    // phase is normalized to unity gain at DC.
+    const double pi = 3.14159265358979323846;
+    for (int phase = 0; phase < kPhases; phase++) {
+      double sum = 0.0;
+      for (int k = 0; k < kTaps; k++) {
+        const int j = k * kPhases + phase;
+        const double t = (j - (kPhases * kTaps - 1) / 2.0) / kPhases;
+        const double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+        const double window =
+            0.5 - 0.5 * std::cos(2.0 * pi * (j + 0.5) / (kPhases * kTaps));
+        mTaps[phase][k] = float(sinc * window);
+        sum += mTaps[phase][k];
+      }
+      for (int k = 0; k < kTaps; k++) {
+        mTaps[phase][k] = float(mTaps[phase][k] / sum);
+      }
+    }
+    std::memset(mHistory, 0, sizeof(mHistory));
+    std::fill(&mHeld[0][0], &mHeld[0][0] + NUM_MEASURES * kMaxChannels,
+              float(kFloorDb));
+  }
+
+  void measure(Measure m) { mMeasure = m; }
+
+  /// How fast the meter falls, in dB per second
+  void release(float dBPerSecond) { mRelease = dBPerSecond; }
+
+  /// Audio thread: measure the output channels of this block
+  void processSound(al::AudioIOData &io) {
+    Block &block = mBlock;
+    block.channels = std::min(int(io.channelsOut()), int(kMaxChannels));
+    block.frames = int(io.framesPerBuffer());
+    block.sampleRate = float(io.framesPerSecond());
+    for (int c = 0; c < block.channels; c++) {
+      measureChannel(c, io.outBuffer(c), block.frames);
+    }
+    mBlocks.publish(block);
+  }
+
+  /// Graphics thread: fold in the blocks measured since the last call and
+  /// write up to count meter values to values. Returns the channel count.
+  int update(float *values, int count) {
+    int channels = 0;
+    int frames = 0;
+    float sampleRate = 0.0f;
+    float peak[kMaxChannels] = {0};
+    float sumSquares[kMaxChannels] = {0};
+    float truePeak[kMaxChannels] = {0};
+    mBlocks.drain([&](const Block &block) {
+      channels = block.channels;
+      frames += block.frames;
+      sampleRate = block.sampleRate;
+      buffer::maximum(peak, block.peak, channels);
+      buffer::add(sumSquares, block.sumSquares, channels);
+      buffer::maximum(truePeak, block.truePeak, channels);
+    });
+    if (frames == 0) {
+      return mChannels;
+    }
+    mChannels = channels;
+
+    // Levels in dB, then the held levels fall towards them
+    float levels[NUM_MEASURES][kMaxChannels];
+    for (int c = 0; c < channels; c++) {
+      sumSquares[c] /= frames;
+    }
+    buffer::decibels(levels[PEAK], peak, channels);
+    buffer::decibels(levels[RMS], sumSquares, channels, 10.0f, 1e-12f);
+    buffer::decibels(levels[TRUE_PEAK], truePeak, channels);
+    const float fall = mRelease * frames / sampleRate;
+    for (int m = 0; m < NUM_MEASURES; m++) {
+      for (int c = 0; c < channels; c++) {
+        mHeld[m][c] = std::max(levels[m][c], mHeld[m][c] - fall);
+      }
+    }
+
+    const float *held = mHeld[mMeasure];
+    count = std::min(count, channels);
+    for (int c = 0; c < count; c++) {
+      values[c] = 0.01f + 0.005f * std::max(held[c] - kFloorDb, 0.0f);
+    }
+    return channels;
+  }
+
+  // Held levels in dB as of the last update()
+  float peakDb(int channel) const { return mHeld[PEAK][channel]; }
+  float rmsDb(int channel) const { return mHeld[RMS][channel]; }
+  float truePeakDb(int channel) const { return mHeld[TRUE_PEAK][channel]; }
+  int channels() const { return mChannels; }
+
+private:
+  static constexpr int kPhases = 4;
+  static constexpr int kTaps = 8;
+  static constexpr int kChunk = 256;
+  static constexpr float kFloorDb = -60.0f;
+
+  struct Block {
+    int channels;
+    int frames;
+    float sampleRate;
+    float peak[kMaxChannels];
+    float sumSquares[kMaxChannels];
+    float truePeak[kMaxChannels];
+  };
+
+  // Peak, sum of squares and interpolated peak of one channel in one pass
+  void measureChannel(int c, const float *src, int numFrames) {
+    float *history = mHistory[c];
+    float peak = 0.0f;
+    float sumSquares = 0.0f;
+    float truePeak = 0.0f;
+    for (int offset = 0; offset < numFrames; offset += kChunk) {
+      const int n = numFrames - offset < kChunk ? numFrames - offset : kChunk;
+      // The interpolator looks kTaps - 1 frames back, into the last chunk
+      std::memcpy(mScratch, history, (kTaps - 1) * sizeof(float));
+      std::memcpy(mScratch + kTaps - 1, src + offset, n * sizeof(float));
+      const float *x = mScratch + kTaps - 1;
+      int i = 0;
+#if PLAYGROUND_BUFFEROPS_SSE
+      __m128 peak4 = _mm_setzero_ps();
+      __m128 sum4 = _mm_setzero_ps();
+      __m128 truePeak4 = _mm_setzero_ps();
+      for (; i + 4 <= n; i += 4) {
+        const __m128 s = _mm_loadu_ps(x + i);
+        peak4 = _mm_max_ps(peak4, buffer::absPs(s));
+        sum4 = _mm_add_ps(sum4, _mm_mul_ps(s, s));
+        for (int phase = 0; phase < kPhases; phase++) {
+          __m128 acc = _mm_setzero_ps();
+          for (int k = 0; k < kTaps; k++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(mTaps[phase][k]),
+                                             _mm_loadu_ps(x + i - k)));
+          }
+          truePeak4 = _mm_max_ps(truePeak4, buffer::absPs(acc));
+        }
+      }
+      peak = std::max(peak, buffer::horizontalMax(peak4));
+      truePeak = std::max(truePeak, buffer::horizontalMax(truePeak4));
+      float sums[4];
+      _mm_storeu_ps(sums, sum4);
+      sumSquares += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+      for (; i < n; i++) {
+        peak = std::max(peak, std::abs(x[i]));
+        sumSquares += x[i] * x[i];
+        for (int phase = 0; phase < kPhases; phase++) {
+          float acc = 0.0f;
+          for (int k = 0; k < kTaps; k++) {
+            acc += mTaps[phase][k] * x[i - k];
+          }
+          truePeak = std::max(truePeak, std::abs(acc));
+        }
+      }
+      std::memcpy(history, mScratch + n, (kTaps - 1) * sizeof(float));
+    }
+    mBlock.peak[c] = peak;
+    mBlock.sumSquares[c] = sumSquares;
+    mBlock.truePeak[c] = std::max(truePeak, peak);
+  }
+
+  float mTaps[kPhases][kTaps];
+
+  // Audio thread
+  float mHistory[kMaxChannels][kTaps - 1];
+  float mScratch[kTaps - 1 + kChunk];
+  Block mBlock;
+  TelemetryChannel<Block> mBlocks{128};
+
+  // Graphics thread
+  Measure mMeasure{PEAK};
+  float mRelease{20.0f};
+  float mHeld[NUM_MEASURES][kMaxChannels];
+  int mChannels{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_LEVELMETER_HPP
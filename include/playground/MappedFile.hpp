@@ -0,0 +1,161 @@
+#ifndef PLAYGROUND_MAPPEDFILE_HPP
+#define PLAYGROUND_MAPPEDFILE_HPP
+
+// A read only memory mapped file, for the binary formats (ScoreFile.hpp,
+// IcoMesh.hpp) that are read in place rather than parsed.
+//
+//   playground::MappedFile file;
+//   if (file.open("piece.synthScore")) {
+//     const char *bytes = file.data();  // file.size() bytes
+//   }
+//
+// Pages are read in by the OS as they are touched. sequential() and
+// willNeed() tell it how the mapping is going to be used; both are hints and
+// do nothing on Windows.
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace playground {
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  /// Map the whole file. Fails for missing and empty files.
+  bool open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    mFileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (mFileHandle == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFileHandle, &size) || size.QuadPart == 0) {
+      close();
+      return false;
+    }
+    mMapping =
+        CreateFileMappingA(mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mMapping) {
+      close();
+      return false;
+    }
+    mData = static_cast<const char *>(
+        MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    mSize = size_t(size.QuadPart);
+    if (!mData) {
+      close();
+      return false;
+    }
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    mData = static_cast<const char *>(p);
+    mSize = size_t(st.st_size);
+    return true;
+#endif
+  }
+
+  void close() {
+#ifdef _WIN32
+    if (mData) {
+      UnmapViewOfFile(mData);
+    }
+    if (mMapping) {
+      CloseHandle(mMapping);
+    }
+    if (mFileHandle != INVALID_HANDLE_VALUE) {
+      CloseHandle(mFileHandle);
+    }
+    mMapping = nullptr;
+    mFileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mData) {
+      munmap(const_cast<char *>(mData), mSize);
+    }
+#endif
+    mData = nullptr;
+    mSize = 0;
+  }
+
+  bool isOpen() const { return mData != nullptr; }
+  const char *data() const { return mData; }
+  size_t size() const { return mSize; }
+
+  /// The file will be read front to back
+  void sequential() {
+#ifndef _WIN32
+    if (mData) {
+      madvise(const_cast<char *>(mData), mSize, MADV_SEQUENTIAL);
+    }
+#endif
+  }
+
+  /// The whole file will be read soon; start reading it in now
+  void willNeed() {
+#ifndef _WIN32
+    if (mData) {
+      madvise(const_cast<char *>(mData), mSize, MADV_WILLNEED);
+    }
+#endif
+  }
+
+  /// Let the OS drop the pages of bytes [begin, end). They are read in again
+  /// if touched.
+  void release(size_t begin, size_t end) {
+#ifndef _WIN32
+    const size_t page = size_t(sysconf(_SC_PAGESIZE));
+    begin = begin / page * page;
+    end = (end < mSize ? end : mSize) / page * page;
+    if (mData && end > begin) {
+      madvise(const_cast<char *>(mData) + begin, end - begin, MADV_DONTNEED);
+    }
+#else
+    (void)begin;
+    (void)end;
+#endif
+  }
+
+private:
+  const char *mData{nullptr};
+  size_t mSize{0};
+#ifdef _WIN32
+  HANDLE mFileHandle{INVALID_HANDLE_VALUE};
+  HANDLE mMapping{nullptr};
+#endif
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_MAPPEDFILE_HPP
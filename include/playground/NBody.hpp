@@ -0,0 +1,451 @@
+#ifndef PLAYGROUND_NBODY_HPP
+#define PLAYGROUND_NBODY_HPP
+
+// Bodies that attract each other and any number of heavy wells, with the
+// body-body forces approximated by a Barnes-Hut octree.
+//
+//   playground::NBody mBodies;
+//   playground::WorkerPool mPool;
+//   std::vector<playground::NBody::Well> mWells;
+//   ...
+//   mBodies.resize(100000);
+//   mBodies.set(i, position, velocity, mass);  // for each body
+//   ...
+//   void onAnimate(double dt) override {
+//     mBodies.theta = 0.5f;  // 0 is exact; larger is faster and rougher
+//     mBodies.step(dt, mWells.data(), int(mWells.size()), &mPool);
+//     // mBodies.bodies(): x, y, z, mass per body, e.g. as instance data
+//   }
+//
+// Every step sorts the bodies along a Morton (Z order) curve over their
+// bounding cube, so that each octree cell is a contiguous run of bodies,
+// and builds the tree over the sorted run in depth first order: a cell's
+// first child follows it and next() skips its whole subtree, so the tree is
+// walked with no stack. Bodies keep their sorted order between steps (and
+// so change index); use bodies() rather than remembering indices.
+//
+// The leaves of the tree are also the units of work. Each leaf walks the
+// tree once, accepting a cell's center of mass when the leaf's bounding box
+// is further than size / theta (plus the distance from the cell's center
+// to its center of mass) from it, and the resulting list of masses is
+// summed for every body in the leaf four at a time with SSE. Leaves are
+// spread over a WorkerPool. All bodies move from where they were at the
+// start of the step (semi-implicit Euler).
+//
+// Body-body forces are softened, G m r / (|r|^2 + softening^2)^(3/2), so
+// close encounters stay bounded. Wells pull with G m r / max(|r|, d)^3,
+// where d is wellMinDistance, and are not moved by the bodies.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define PLAYGROUND_NBODY_SSE 1
+#endif
+
+#include "playground/WorkerPool.hpp"
+
+namespace playground {
+
+class NBody {
+public:
+  /// Most bodies in a leaf, unless they share a cell at the deepest level
+  static constexpr int kLeafSize = 16;
+  /// Most bodies sharing one walk of the tree
+  static constexpr int kGroupSize = 64;
+  /// Octree levels below the root; 10 bits per axis of Morton code
+  static constexpr int kLevels = 10;
+  /// Leaves per parallel task
+  static constexpr int kGrain = 32;
+
+  struct Well {
+    float position[3];
+    float mass;
+  };
+
+  /// Accuracy of the approximation; 0 sums every pair exactly
+  float theta{0.5f};
+  /// Gravitational constant
+  float gravity{1.0f};
+  float softening{0.01f};
+  float wellMinDistance{0.1f};
+  /// Whether bodies attract each other; if not, only the wells pull
+  bool selfGravity{true};
+
+  /// Set the number of bodies, all at the origin, at rest and massless
+  void resize(int numBodies) {
+    mNumBodies = std::max(numBodies, 0);
+    mBodies.assign(4 * size_t(mNumBodies), 0.0f);
+    mVelocities.assign(4 * size_t(mNumBodies), 0.0f);
+  }
+
+  int size() const { return mNumBodies; }
+
+  void set(int i, const float *position, const float *velocity, float mass) {
+    for (int axis = 0; axis < 3; axis++) {
+      mBodies[4 * i + axis] = position[axis];
+      mVelocities[4 * i + axis] = velocity[axis];
+    }
+    mBodies[4 * i + 3] = mass;
+  }
+
+  /// x, y, z, mass per body, in the current order
+  const float *bodies() const { return mBodies.data(); }
+
+  /// Velocity of body i as x, y, z
+  void velocity(int i, float *xyz) const {
+    for (int axis = 0; axis < 3; axis++) {
+      xyz[axis] = mVelocities[4 * i + axis];
+    }
+  }
+
+  /// Cells in the tree built by the last step
+  int numNodes() const { return int(mNodes.size()); }
+
+  /// Advance every body by dt under the pull of all other bodies and of
+  /// numWells wells. Runs on pool if given.
+  void step(float dt, const Well *wells, int numWells,
+            WorkerPool *pool = nullptr) {
+    const int numWorkers = pool ? pool->concurrency() : 1;
+    mScratch.resize(numWorkers);
+    mNext.resize(mBodies.size());
+
+    if (selfGravity && mNumBodies > 0) {
+      sortBodies();
+      buildTree();
+    } else {
+      // Every body on its own, with only the wells acting on it
+      mNodes.clear();
+      mGroups.clear();
+    }
+
+    const int numGroups =
+        selfGravity ? int(mGroups.size()) : (mNumBodies + kLeafSize - 1) / kLeafSize;
+    const int numTasks = (numGroups + kGrain - 1) / kGrain;
+    auto task = [&](int t, int worker) {
+      const int end = std::min((t + 1) * kGrain, numGroups);
+      for (int g = t * kGrain; g < end; g++) {
+        if (selfGravity) {
+          const Node &group = mNodes[mGroups[g]];
+          stepGroup(group.begin, group.end, &group, dt, wells, numWells,
+                    mScratch[worker]);
+        } else {
+          stepGroup(g * kLeafSize, std::min((g + 1) * kLeafSize, mNumBodies),
+                    nullptr, dt, wells, numWells, mScratch[worker]);
+        }
+      }
+    };
+    if (pool) {
+      pool->run(numTasks, task);
+    } else {
+      for (int t = 0; t < numTasks; t++) {
+        task(t, 0);
+      }
+    }
+    mBodies.swap(mNext);
+  }
+
+private:
+  struct Node {
+    float com[3]; // center of mass
+    float mass;
+    float lo[3]; // bounding box of the bodies inside
+    float hi[3];
+    float open2; // accepted when further than this squared
+    int next;    // node after this subtree
+    int begin;   // bodies [begin, end)
+    int end;
+    int leaf;
+  };
+
+  // Interaction list of one worker, one array per component. Every cell
+  // and body is listed at most once, so sized for all of them up front.
+  struct Scratch {
+    std::vector<float> x, y, z, m;
+    int size{0};
+    void reset(size_t capacity) {
+      if (m.size() < capacity) {
+        x.resize(capacity);
+        y.resize(capacity);
+        z.resize(capacity);
+        m.resize(capacity);
+      }
+      size = 0;
+    }
+    void push(float px, float py, float pz, float pm) {
+      x[size] = px;
+      y[size] = py;
+      z[size] = pz;
+      m[size] = pm;
+      size++;
+    }
+  };
+
+  // Spread the low 10 bits of v to every third bit
+  static uint32_t spreadBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+  }
+
+  // Reorder bodies and velocities along the Morton curve
+  void sortBodies() {
+    float lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++) {
+      lo[axis] = hi[axis] = mBodies[axis];
+    }
+    for (int i = 1; i < mNumBodies; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        lo[axis] = std::min(lo[axis], mBodies[4 * i + axis]);
+        hi[axis] = std::max(hi[axis], mBodies[4 * i + axis]);
+      }
+    }
+    const float side =
+        std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    const float scale = side > 0 ? 1023.0f / side : 0.0f;
+
+    // Keys in the high half, indices in the low half; radix sort on the key
+    mKeys.resize(mNumBodies);
+    for (int i = 0; i < mNumBodies; i++) {
+      uint32_t code = 0;
+      for (int axis = 0; axis < 3; axis++) {
+        const uint32_t q = uint32_t((mBodies[4 * i + axis] - lo[axis]) * scale);
+        code |= spreadBits(std::min(q, 1023u)) << (2 - axis);
+      }
+      mKeys[i] = (uint64_t(code) << 32) | uint32_t(i);
+    }
+    mSortScratch.resize(mNumBodies);
+    for (int shift = 32; shift < 62; shift += 10) {
+      size_t counts[1025] = {};
+      for (uint64_t k : mKeys) {
+        counts[((k >> shift) & 1023) + 1]++;
+      }
+      for (int b = 1; b < 1025; b++) {
+        counts[b] += counts[b - 1];
+      }
+      for (uint64_t k : mKeys) {
+        mSortScratch[counts[(k >> shift) & 1023]++] = k;
+      }
+      mKeys.swap(mSortScratch);
+    }
+
+    mSortedVelocities.resize(mVelocities.size());
+    for (int i = 0; i < mNumBodies; i++) {
+      const size_t from = 4 * size_t(uint32_t(mKeys[i]));
+      std::copy(&mBodies[from], &mBodies[from] + 4, &mNext[4 * i]);
+      std::copy(&mVelocities[from], &mVelocities[from] + 4,
+                &mSortedVelocities[4 * i]);
+    }
+    mBodies.swap(mNext);
+    mVelocities.swap(mSortedVelocities);
+  }
+
+  void buildTree() {
+    mNodes.clear();
+    mGroups.clear();
+    buildNode(0, mNumBodies, 0, false);
+  }
+
+  int buildNode(int begin, int end, int level, bool inGroup) {
+    const int index = int(mNodes.size());
+    mNodes.emplace_back();
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.leaf = end - begin <= kLeafSize || level == kLevels;
+    if (!inGroup && (end - begin <= kGroupSize || node.leaf)) {
+      mGroups.push_back(index);
+      inGroup = true;
+    }
+    float weighted[3] = {0.0f, 0.0f, 0.0f};
+    node.mass = 0.0f;
+    if (node.leaf) {
+      for (int axis = 0; axis < 3; axis++) {
+        node.lo[axis] = node.hi[axis] = mBodies[4 * begin + axis];
+      }
+      for (int i = begin; i < end; i++) {
+        const float *b = &mBodies[4 * i];
+        for (int axis = 0; axis < 3; axis++) {
+          node.lo[axis] = std::min(node.lo[axis], b[axis]);
+          node.hi[axis] = std::max(node.hi[axis], b[axis]);
+          weighted[axis] += b[3] * b[axis];
+        }
+        node.mass += b[3];
+      }
+    } else {
+      // Children are the runs of bodies sharing the next three key bits
+      const int shift = 32 + 3 * (kLevels - 1 - level);
+      bool first = true;
+      for (int b = begin; b < end;) {
+        const uint64_t octant = (mKeys[b] >> shift) & 7;
+        const int e = int(std::partition_point(mKeys.begin() + b,
+                                               mKeys.begin() + end,
+                                               [&](uint64_t k) {
+                                                 return ((k >> shift) & 7) == octant;
+                                               }) -
+                          mKeys.begin());
+        const Node &child = mNodes[buildNode(b, e, level + 1, inGroup)];
+        for (int axis = 0; axis < 3; axis++) {
+          node.lo[axis] = first ? child.lo[axis] : std::min(node.lo[axis], child.lo[axis]);
+          node.hi[axis] = first ? child.hi[axis] : std::max(node.hi[axis], child.hi[axis]);
+          weighted[axis] += child.mass * child.com[axis];
+        }
+        node.mass += child.mass;
+        first = false;
+        b = e;
+      }
+    }
+
+    float center2 = 0.0f;
+    float size = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+      const float center = 0.5f * (node.lo[axis] + node.hi[axis]);
+      node.com[axis] = node.mass > 0 ? weighted[axis] / node.mass : center;
+      center2 += (node.com[axis] - center) * (node.com[axis] - center);
+      size = std::max(size, node.hi[axis] - node.lo[axis]);
+    }
+    const float open = theta > 0 ? size / theta + std::sqrt(center2) : 3.4e38f;
+    node.open2 = open < 1.8e19f ? open * open : 3.4e38f;
+    node.next = int(mNodes.size());
+    mNodes[index] = node;
+    return index;
+  }
+
+  // Step bodies [begin, end), gathering the sources for them from the tree
+  // if group is given
+  void stepGroup(int begin, int end, const Node *group, float dt,
+                 const Well *wells, int numWells, Scratch &list) {
+    list.reset(mNodes.size() + size_t(mNumBodies) + 3);
+    if (group) {
+      for (int i = 0; i < int(mNodes.size());) {
+        const Node &node = mNodes[i];
+        float d2 = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+          const float d = std::max(std::max(group->lo[axis] - node.com[axis],
+                                            node.com[axis] - group->hi[axis]),
+                                   0.0f);
+          d2 += d * d;
+        }
+        if (d2 > node.open2) {
+          list.push(node.com[0], node.com[1], node.com[2], node.mass);
+          i = node.next;
+        } else if (node.leaf) {
+          for (int j = node.begin; j < node.end; j++) {
+            const float *b = &mBodies[4 * j];
+            list.push(b[0], b[1], b[2], b[3]);
+          }
+          i = node.next;
+        } else {
+          i++;
+        }
+      }
+    }
+    // Pad to a multiple of four with massless sources
+    while (list.size % 4) {
+      list.push(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    const float eps2 = softening * softening;
+    const float minDistance2 = wellMinDistance * wellMinDistance;
+    for (int i = begin; i < end; i++) {
+      const float *b = &mBodies[4 * i];
+      float a[3];
+      accumulate(b, list, eps2, a);
+      for (int w = 0; w < numWells; w++) {
+        const float r[3] = {wells[w].position[0] - b[0],
+                            wells[w].position[1] - b[1],
+                            wells[w].position[2] - b[2]};
+        const float dist2 =
+            std::max(r[0] * r[0] + r[1] * r[1] + r[2] * r[2], minDistance2);
+        const float s = wells[w].mass / (dist2 * std::sqrt(dist2));
+        for (int axis = 0; axis < 3; axis++) {
+          a[axis] += s * r[axis];
+        }
+      }
+      float *v = &mVelocities[4 * i];
+      float *next = &mNext[4 * i];
+      for (int axis = 0; axis < 3; axis++) {
+        v[axis] += gravity * a[axis] * dt;
+        next[axis] = b[axis] + v[axis] * dt;
+      }
+      next[3] = b[3];
+    }
+  }
+
+  // Sum of m r / (|r|^2 + eps2)^(3/2) over the list, from body b
+  static void accumulate(const float *b, const Scratch &list, float eps2,
+                         float *a) {
+    const int n = list.size;
+#if PLAYGROUND_NBODY_SSE
+    const __m128 bx = _mm_set1_ps(b[0]);
+    const __m128 by = _mm_set1_ps(b[1]);
+    const __m128 bz = _mm_set1_ps(b[2]);
+    const __m128 e = _mm_set1_ps(eps2);
+    __m128 ax = _mm_setzero_ps();
+    __m128 ay = _mm_setzero_ps();
+    __m128 az = _mm_setzero_ps();
+    for (int j = 0; j < n; j += 4) {
+      const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&list.x[j]), bx);
+      const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&list.y[j]), by);
+      const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&list.z[j]), bz);
+      const __m128 r2 = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+          _mm_add_ps(_mm_mul_ps(dz, dz), e));
+      // 1 / sqrt(r2) to about 22 bits: the estimate and a Newton step
+      const __m128 y = _mm_rsqrt_ps(r2);
+      const __m128 inv = _mm_mul_ps(
+          _mm_mul_ps(_mm_set1_ps(0.5f), y),
+          _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(r2, y), y)));
+      const __m128 s = _mm_mul_ps(_mm_loadu_ps(&list.m[j]),
+                                  _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+      ax = _mm_add_ps(ax, _mm_mul_ps(s, dx));
+      ay = _mm_add_ps(ay, _mm_mul_ps(s, dy));
+      az = _mm_add_ps(az, _mm_mul_ps(s, dz));
+    }
+    a[0] = horizontalSum(ax);
+    a[1] = horizontalSum(ay);
+    a[2] = horizontalSum(az);
+#else
+    a[0] = a[1] = a[2] = 0.0f;
+    for (int j = 0; j < n; j++) {
+      const float dx = list.x[j] - b[0];
+      const float dy = list.y[j] - b[1];
+      const float dz = list.z[j] - b[2];
+      const float r2 = dx * dx + dy * dy + dz * dz + eps2;
+      const float s = list.m[j] / (r2 * std::sqrt(r2));
+      a[0] += s * dx;
+      a[1] += s * dy;
+      a[2] += s * dz;
+    }
+#endif
+  }
+
+#if PLAYGROUND_NBODY_SSE
+  static float horizontalSum(__m128 v) {
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  }
+#endif
+
+  int mNumBodies{0};
+  std::vector<float> mBodies;     // x, y, z, mass
+  std::vector<float> mVelocities; // x, y, z, 0
+  std::vector<float> mNext;       // bodies after the step
+  std::vector<float> mSortedVelocities;
+  std::vector<uint64_t> mKeys; // Morton code << 32 | original index
+  std::vector<uint64_t> mSortScratch;
+  std::vector<Node> mNodes;
+  std::vector<int> mGroups;
+  std::vector<Scratch> mScratch;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_NBODY_HPP
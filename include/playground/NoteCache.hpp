@@ -0,0 +1,343 @@
+#ifndef PLAYGROUND_NOTECACHE_HPP
+#define PLAYGROUND_NOTECACHE_HPP
+
+// Notes rendered once and replayed from memory.
+//
+// Drum and pluck voices in a score are triggered thousands of times with the
+// same parameters, and each trigger synthesizes the same samples again. A
+// NoteCache renders a note the first time it is asked for, on a worker
+// thread, into a buffer that is never written again; later triggers of the
+// same voice class, trigger parameters and duration play a CachedNote voice
+// that only adds that buffer to the output:
+//
+//   playground::NoteCache mNotes;
+//   ...
+//   void playKick(float time, float freq, float duration) {
+//     if (!claimNote(time, duration)) return;
+//     auto take = mNotes.find<Kick>({0.25f, freq}, duration);
+//     if (take) {  // seen before: mix the cached samples
+//       auto *voice = sequencer().synth().getVoice<playground::CachedNote>();
+//       voice->play(take, &mNotes);
+//       sequencer().addVoiceFromNow(voice, time, duration);
+//       return;
+//     }
+//     ... // first time: schedule a Kick as before
+//   }
+//   ...
+//   playScore();
+//   mNotes.wait();   // all first renders done before the audio starts
+//   mNotes.print("loonboon");
+//
+// The trigger parameters are given to the rendered voice with
+// setTriggerParams() and, with the duration, make up the key. A note is
+// rendered until the voice frees itself, at most maxSeconds after it is
+// released. Only voices that sound the same every time they are triggered
+// with the same parameters should be cached: a voice that draws noise is
+// frozen into the one take that was rendered first. Takes are rendered in
+// blocks of blockSize frames, which should be the block size of the synth
+// the takes play in, for voices that update their state once per block.
+//
+// Takes are kept while they fit in maxBytes; beyond that the least recently
+// found ones are dropped. Voices still holding a dropped take play it to the
+// end. find() and wait() belong to the thread that schedules the score (voices
+// are created and destroyed there, as Gamma's domain is not thread safe);
+// CachedNote::onProcess() never locks or allocates.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "Gamma/Domain.h"
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_PolySynth.hpp"
+
+namespace playground {
+
+class NoteCache {
+public:
+  /// Channels of every take
+  static constexpr int kChannels = 2;
+
+  /// A rendered note: interleaved samples, immutable once ready
+  struct Take {
+    std::vector<float> samples;
+    int frames{0};
+    std::atomic<bool> ready{false};
+  };
+
+  struct Stats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+    uint64_t late{0}; ///< cached notes triggered before their take was ready
+    size_t notes{0};  ///< takes kept
+    size_t bytes{0};  ///< memory of the takes kept
+
+    double hitRate() const {
+      return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0;
+    }
+  };
+
+  size_t maxBytes;   ///< memory kept for takes before the oldest are dropped
+  double maxSeconds; ///< longest tail rendered after a note's release
+  int blockSize{512}; ///< frames per onProcess() call while rendering
+
+  explicit NoteCache(size_t maxBytes = 64 << 20, double maxSeconds = 10.0)
+      : maxBytes(maxBytes), maxSeconds(maxSeconds) {}
+
+  NoteCache(const NoteCache &) = delete;
+  NoteCache &operator=(const NoteCache &) = delete;
+
+  ~NoteCache() {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mRunning = false;
+    }
+    mWake.notify_all();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+  /// The take of a TVoice triggered with params and released after duration
+  /// seconds, if it was asked for before (it may still be rendering). On the
+  /// first call for a note, queues its render and returns null: the caller
+  /// plays the voice itself this time.
+  template <class TVoice>
+  std::shared_ptr<const Take> find(std::vector<float> params, double duration) {
+    std::string key = typeid(TVoice).name();
+    key.append(reinterpret_cast<const char *>(params.data()),
+               params.size() * sizeof(float));
+    key.append(reinterpret_cast<const char *>(&duration), sizeof(duration));
+
+    std::unique_lock<std::mutex> lock(mLock);
+    mRetired.clear();
+    auto found = mEntries.find(key);
+    if (found != mEntries.end()) {
+      mStats.hits++;
+      mOrder.splice(mOrder.begin(), mOrder, found->second.order);
+      return found->second.take;
+    }
+    mStats.misses++;
+    lock.unlock();
+
+    // Set the voice up here rather than on the worker, see above
+    Job job;
+    job.take = std::make_shared<Take>();
+    job.voice.reset(new TVoice);
+    job.voice->init();
+    if (!params.empty()) {
+      job.voice->setTriggerParams(params);
+    }
+    job.sampleRate = gam::sampleRate();
+    job.releaseFrame = long(duration * job.sampleRate);
+    job.blockSize = std::max(blockSize, 1);
+
+    lock.lock();
+    mOrder.push_front(key);
+    mEntries[key] = Entry{job.take, mOrder.begin()};
+    mJobs.push_back(std::move(job));
+    if (!mWorker.joinable()) {
+      mRunning = true;
+      mWorker = std::thread([this]() { workerLoop(); });
+    }
+    lock.unlock();
+    mWake.notify_all();
+    return nullptr;
+  }
+
+  /// Block until every queued note is rendered
+  void wait() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mIdle.wait(lock, [this]() { return mJobs.empty() && !mBusy; });
+    mRetired.clear();
+  }
+
+  Stats stats() {
+    std::lock_guard<std::mutex> lock(mLock);
+    Stats s = mStats;
+    s.late = mLate.load(std::memory_order_relaxed);
+    s.notes = mEntries.size();
+    return s;
+  }
+
+  /// Print the hit rate and memory use on one line
+  void print(const char *name = "NoteCache") {
+    Stats s = stats();
+    printf("%s: %.1f%% of %llu notes from cache, %zu takes in %.1f MB "
+           "(%llu dropped, %llu late)\n",
+           name, 100.0 * s.hitRate(),
+           (unsigned long long)(s.hits + s.misses), s.notes,
+           s.bytes / (1024.0 * 1024.0), (unsigned long long)s.evictions,
+           (unsigned long long)s.late);
+  }
+
+  /// Called by CachedNote from the audio thread
+  void countLate() { mLate.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+  struct Entry {
+    std::shared_ptr<Take> take;
+    std::list<std::string>::iterator order;
+  };
+
+  struct Job {
+    std::shared_ptr<Take> take;
+    std::unique_ptr<al::SynthVoice> voice;
+    double sampleRate{44100};
+    long releaseFrame{0};
+    int blockSize{512};
+  };
+
+  void workerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (mRunning) {
+      if (mJobs.empty()) {
+        mWake.wait(lock);
+        continue;
+      }
+      Job job = std::move(mJobs.front());
+      mJobs.pop_front();
+      mBusy = true;
+      lock.unlock();
+      render(job);
+      lock.lock();
+      mBusy = false;
+      job.take->ready.store(true, std::memory_order_release);
+      mStats.bytes += job.take->samples.size() * sizeof(float);
+      mRetired.push_back(std::move(job.voice));
+      evict();
+      mIdle.notify_all();
+    }
+  }
+
+  // Run the voice until it frees itself, releasing it at releaseFrame
+  void render(Job &job) {
+    al::SynthVoice &voice = *job.voice;
+    al::AudioIOData io;
+    io.framesPerSecond(job.sampleRate);
+    io.channelsOut(kChannels);
+    const long maxFrames = job.releaseFrame + long(maxSeconds * job.sampleRate);
+    std::vector<float> &samples = job.take->samples;
+    long frame = 0;
+    bool released = false;
+    voice.triggerOn(0);
+    while (voice.active() && frame < maxFrames) {
+      if (!released && frame >= job.releaseFrame) {
+        voice.triggerOff(0);
+        released = true;
+      }
+      // Split the block at the release so it lands on its frame
+      long frames = std::min<long>(job.blockSize, maxFrames - frame);
+      if (!released) {
+        frames = std::min(frames, job.releaseFrame - frame);
+      }
+      if (long(io.framesPerBuffer()) != frames) {
+        io.framesPerBuffer(int(frames));
+      }
+      io.zeroOut();
+      io.frame(0);
+      voice.onProcess(io);
+      samples.resize(size_t(frame + frames) * kChannels);
+      for (int c = 0; c < kChannels; c++) {
+        const float *src = io.outBuffer(c);
+        float *dst = samples.data() + size_t(frame) * kChannels + c;
+        for (long i = 0; i < frames; i++) {
+          dst[i * kChannels] = src[i];
+        }
+      }
+      frame += frames;
+    }
+    samples.shrink_to_fit();
+    job.take->frames = int(frame);
+  }
+
+  // Drop the least recently found takes until the rest fit in maxBytes
+  void evict() {
+    auto key = mOrder.end();
+    while (mStats.bytes > maxBytes && key != mOrder.begin()) {
+      --key;
+      auto entry = mEntries.find(*key);
+      const Take &take = *entry->second.take;
+      if (!take.ready.load(std::memory_order_relaxed)) {
+        continue; // still queued
+      }
+      mStats.bytes -= take.samples.size() * sizeof(float);
+      mStats.evictions++;
+      mEntries.erase(entry);
+      key = mOrder.erase(key);
+    }
+  }
+
+  std::unordered_map<std::string, Entry> mEntries;
+  std::list<std::string> mOrder; // most recently found first
+  std::deque<Job> mJobs;
+  std::vector<std::unique_ptr<al::SynthVoice>> mRetired; // rendered voices
+  Stats mStats;
+  std::atomic<uint64_t> mLate{0};
+
+  std::mutex mLock;
+  std::condition_variable mWake;
+  std::condition_variable mIdle;
+  bool mBusy{false};
+  bool mRunning{false};
+  std::thread mWorker;
+};
+
+/// A voice that plays a NoteCache take
+class CachedNote : public al::SynthVoice {
+public:
+  /// Set up before the voice is scheduled, on the thread that schedules it.
+  /// The voice keeps the take until it is next set up, so a take is never
+  /// freed on the audio thread.
+  void play(std::shared_ptr<const NoteCache::Take> take, NoteCache *cache) {
+    mTake = std::move(take);
+    mCache = cache;
+  }
+
+  void onTriggerOn() override { mFrame = 0; }
+
+  void onProcess(al::AudioIOData &io) override {
+    if (!mTake || !mTake->ready.load(std::memory_order_acquire)) {
+      if (mCache) {
+        mCache->countLate();
+      }
+      free();
+      return;
+    }
+    const int channels =
+        std::min(int(io.channelsOut()), int(NoteCache::kChannels));
+    const float *samples = mTake->samples.data();
+    while (mFrame < mTake->frames && io()) {
+      const float *frame = samples + size_t(mFrame) * NoteCache::kChannels;
+      for (int c = 0; c < channels; c++) {
+        io.out(c) += frame[c];
+      }
+      mFrame++;
+    }
+    if (mFrame >= mTake->frames) {
+      free();
+    }
+  }
+
+private:
+  std::shared_ptr<const NoteCache::Take> mTake;
+  NoteCache *mCache{nullptr};
+  int mFrame{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_NOTECACHE_HPP
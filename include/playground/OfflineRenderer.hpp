@@ -0,0 +1,359 @@
+#ifndef PLAYGROUND_OFFLINERENDERER_HPP
+#define PLAYGROUND_OFFLINERENDERER_HPP
+
+// Headless, faster than real time rendering of scored pieces to WAV files.
+//
+// A piece derives its score from playground::Score. The score schedules every
+// note into sequencer() and calls claimNote() for each one:
+//
+//   class Song : public playground::Score {
+//   public:
+//     void playNote(float freq, float time, float duration) {
+//       if (!claimNote(time, duration)) return;
+//       auto *voice = sequencer().synth().getVoice<SineEnv>();
+//       ...
+//       sequencer().addVoiceFromNow(voice, time, duration);
+//     }
+//     void playScore() override { ... }
+//   };
+//
+// The app implements sequencer() with its SynthGUIManager's sequencer, while
+// HeadlessScore<Song> gives the score a sequencer of its own with no audio
+// device behind it. OfflineRenderer then drives that sequencer block by block:
+//
+//   int main(int argc, char *argv[]) {
+//     playground::OfflineRenderer offline;
+//     if (offline.parseArgs(argc, argv)) {
+//       return offline.bounce<playground::HeadlessScore<Song>>() ? 0 : 1;
+//     }
+//     ...
+//   }
+//
+//   ./loonboon --bounce loonboon.wav --all-cores
+//
+// With more than one job, every job builds the score but claimNote() only
+// lets it keep every jobs-th note. The jobs render their share in parallel and
+// are summed in job order, so the result does not depend on thread timing.
+// Voices must not share mutable state across instances for this to be exact.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Gamma/Domain.h"
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_SynthSequencer.hpp"
+
+namespace playground {
+
+/// Base class for pieces that schedule their notes from code
+class Score {
+public:
+  virtual ~Score() {}
+
+  /// Sequencer the notes are scheduled into
+  virtual al::SynthSequencer &sequencer() = 0;
+
+  /// Schedule every note of the piece, relative to now
+  virtual void playScore() = 0;
+
+  /// Only keep every count-th note, starting at note index
+  void part(int index, int count) {
+    mPart = index;
+    mNumParts = count < 1 ? 1 : count;
+  }
+
+  /// End of the last note scheduled so far, in seconds from the start
+  double length() const { return mLength; }
+
+protected:
+  /// Record a note and tell whether this part should schedule it
+  bool claimNote(double time, double duration) {
+    mLength = std::max(mLength, time + duration);
+    return (mNoteIndex++ % mNumParts) == mPart;
+  }
+
+private:
+  int mPart{0};
+  int mNumParts{1};
+  long mNoteIndex{0};
+  double mLength{0.0};
+};
+
+/// A score with its own sequencer and no audio device
+template <class TScore> class HeadlessScore : public TScore {
+public:
+  al::SynthSequencer &sequencer() override { return mSequencer; }
+
+private:
+  al::SynthSequencer mSequencer;
+};
+
+/// Minimal RIFF/WAVE writer for interleaved float samples
+class WavWriter {
+public:
+  ~WavWriter() { close(); }
+
+  /// bitDepth 16 writes PCM, 32 writes IEEE float
+  bool open(const std::string &path, int sampleRate, int channels,
+            int bitDepth = 16) {
+    close();
+    mFile = fopen(path.c_str(), "wb");
+    if (!mFile) {
+      return false;
+    }
+    mChannels = channels;
+    mBitDepth = bitDepth == 32 ? 32 : 16;
+    mSampleRate = sampleRate;
+    mFrames = 0;
+    writeHeader(); // sizes are patched in close()
+    return true;
+  }
+
+  void write(const float *interleaved, size_t frames) {
+    if (!mFile) {
+      return;
+    }
+    const size_t count = frames * mChannels;
+    if (mBitDepth == 32) {
+      for (size_t i = 0; i < count; i++) {
+        put32(floatBits(interleaved[i]));
+      }
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        float s = std::max(-1.0f, std::min(1.0f, interleaved[i]));
+        put16(uint16_t(int16_t(std::lrint(s * 32767.0f))));
+      }
+    }
+    mFrames += frames;
+  }
+
+  void close() {
+    if (mFile) {
+      fseek(mFile, 0, SEEK_SET);
+      writeHeader();
+      fclose(mFile);
+      mFile = nullptr;
+    }
+  }
+
+private:
+  FILE *mFile{nullptr};
+  int mChannels{2};
+  int mBitDepth{16};
+  int mSampleRate{48000};
+  size_t mFrames{0};
+
+  static uint32_t floatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+  }
+  void put16(uint16_t v) {
+    unsigned char b[2] = {(unsigned char)(v & 0xff), (unsigned char)(v >> 8)};
+    fwrite(b, 1, 2, mFile);
+  }
+  void put32(uint32_t v) {
+    unsigned char b[4] = {(unsigned char)(v & 0xff),
+                          (unsigned char)((v >> 8) & 0xff),
+                          (unsigned char)((v >> 16) & 0xff),
+                          (unsigned char)(v >> 24)};
+    fwrite(b, 1, 4, mFile);
+  }
+  // Float files take the extended fmt chunk (cbSize 0) and a fact chunk,
+  // which WAVE requires for anything but PCM
+  void writeHeader() {
+    const bool isFloat = mBitDepth == 32;
+    const uint32_t bytesPerFrame = mChannels * mBitDepth / 8;
+    const uint32_t dataBytes = uint32_t(mFrames * bytesPerFrame);
+    const uint32_t fmtBytes = isFloat ? 18 : 16;
+    const uint32_t factBytes = isFloat ? 12 : 0;
+    fwrite("RIFF", 1, 4, mFile);
+    put32(4 + 8 + fmtBytes + factBytes + 8 + dataBytes);
+    fwrite("WAVEfmt ", 1, 8, mFile);
+    put32(fmtBytes);
+    put16(isFloat ? 3 : 1); // IEEE float or PCM
+    put16(uint16_t(mChannels));
+    put32(uint32_t(mSampleRate));
+    put32(uint32_t(mSampleRate) * bytesPerFrame);
+    put16(uint16_t(bytesPerFrame));
+    put16(uint16_t(mBitDepth));
+    if (isFloat) {
+      put16(0); // cbSize
+      fwrite("fact", 1, 4, mFile);
+      put32(4);
+      put32(uint32_t(mFrames)); // frames per channel
+    }
+    fwrite("data", 1, 4, mFile);
+    put32(dataBytes);
+  }
+};
+
+class OfflineRenderer {
+public:
+  std::string path;          ///< WAV file to write
+  double sampleRate{48000};  ///< frames per second
+  int blockSize{512};        ///< frames per render() call
+  int channels{2};           ///< output channels
+  double tail{3.0};          ///< seconds rendered after the last note ends
+  int jobs{1};               ///< parallel jobs, 0 for one per core
+  int bitDepth{16};          ///< 16 (PCM) or 32 (float)
+  double chunkSeconds{10.0}; ///< audio rendered by the jobs between merges
+
+  /// Parse command line. Returns true if an offline bounce was requested.
+  ///   --bounce <file.wav>  render offline to file.wav
+  ///   --jobs <n>, -j <n>   use n parallel jobs
+  ///   --all-cores          use one job per hardware thread
+  ///   --rate <hz>          sample rate (default 48000)
+  ///   --block <frames>     block size (default 512)
+  ///   --tail <seconds>     time rendered after the last note (default 3)
+  ///   --float              write 32 bit float samples instead of 16 bit PCM
+  bool parseArgs(int argc, char *argv[]) {
+    bool bounceRequested = false;
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--bounce" && hasValue) {
+        path = argv[++i];
+        bounceRequested = true;
+      } else if ((arg == "--jobs" || arg == "-j") && hasValue) {
+        jobs = atoi(argv[++i]);
+      } else if (arg == "--all-cores") {
+        jobs = 0;
+      } else if (arg == "--rate" && hasValue) {
+        sampleRate = atof(argv[++i]);
+      } else if (arg == "--block" && hasValue) {
+        blockSize = atoi(argv[++i]);
+      } else if (arg == "--tail" && hasValue) {
+        tail = atof(argv[++i]);
+      } else if (arg == "--float") {
+        bitDepth = 32;
+      }
+    }
+    return bounceRequested;
+  }
+
+  /// Number of jobs bounce() will use
+  int numJobs() const {
+    if (jobs > 0) {
+      return jobs;
+    }
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? int(cores) : 1;
+  }
+
+  /// Build TScore and render it to path. TScore must be default
+  /// constructible and own its sequencer (see HeadlessScore).
+  template <class TScore> bool bounce() {
+    // Voices must be created after the sample rate is set. Building the
+    // scores also creates the voices, which touches Gamma's global domain, so
+    // it is done here on one thread before any rendering starts.
+    gam::sampleRate(sampleRate);
+    const int numParts = numJobs();
+    std::vector<std::unique_ptr<TScore>> parts;
+    double length = 0.0;
+    for (int p = 0; p < numParts; p++) {
+      parts.emplace_back(new TScore);
+      parts.back()->part(p, numParts);
+      parts.back()->playScore();
+      length = std::max(length, parts.back()->length());
+    }
+
+    std::vector<al::SynthSequencer *> sequencers;
+    for (auto &p : parts) {
+      sequencers.push_back(&p->sequencer());
+    }
+    return render(sequencers, length + tail);
+  }
+
+  /// Render the sum of the sequencers for the given number of seconds.
+  /// Each sequencer is rendered on its own thread.
+  bool render(const std::vector<al::SynthSequencer *> &sequencers,
+              double seconds) {
+    WavWriter wav;
+    if (!wav.open(path, int(sampleRate), channels, bitDepth)) {
+      fprintf(stderr, "OfflineRenderer: can't open %s\n", path.c_str());
+      return false;
+    }
+    const size_t numParts = sequencers.size();
+    const long totalBlocks = long(std::ceil(seconds * sampleRate / blockSize));
+    const long chunkBlocks =
+        std::max(1L, long(chunkSeconds * sampleRate / blockSize));
+
+    std::vector<std::unique_ptr<al::AudioIOData>> ios;
+    std::vector<std::vector<float>> stems(numParts);
+    for (size_t p = 0; p < numParts; p++) {
+      ios.emplace_back(new al::AudioIOData);
+      ios[p]->framesPerSecond(sampleRate);
+      ios[p]->framesPerBuffer(blockSize);
+      ios[p]->channelsOut(channels);
+      stems[p].resize(size_t(chunkBlocks) * blockSize * channels);
+    }
+    std::vector<float> mix(stems[0].size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (long block = 0; block < totalBlocks; block += chunkBlocks) {
+      const long numBlocks = std::min(chunkBlocks, totalBlocks - block);
+      if (numParts == 1) {
+        renderBlocks(*sequencers[0], *ios[0], numBlocks, stems[0].data());
+      } else {
+        std::vector<std::thread> workers;
+        for (size_t p = 0; p < numParts; p++) {
+          workers.emplace_back([&, p]() {
+            renderBlocks(*sequencers[p], *ios[p], numBlocks, stems[p].data());
+          });
+        }
+        for (auto &w : workers) {
+          w.join();
+        }
+      }
+      // Sum in part order so the output is the same for any thread timing
+      const size_t count = size_t(numBlocks) * blockSize * channels;
+      std::copy(stems[0].begin(), stems[0].begin() + count, mix.begin());
+      for (size_t p = 1; p < numParts; p++) {
+        for (size_t i = 0; i < count; i++) {
+          mix[i] += stems[p][i];
+        }
+      }
+      wav.write(mix.data(), size_t(numBlocks) * blockSize);
+    }
+    wav.close();
+
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    double rendered = totalBlocks * blockSize / sampleRate;
+    printf("Bounced %.1f s to %s in %.2f s (%.1fx real time, %d jobs)\n",
+           rendered, path.c_str(), elapsed,
+           elapsed > 0 ? rendered / elapsed : 0.0, int(numParts));
+    return true;
+  }
+
+private:
+  void renderBlocks(al::SynthSequencer &sequencer, al::AudioIOData &io,
+                    long numBlocks, float *interleaved) {
+    for (long b = 0; b < numBlocks; b++) {
+      io.zeroOut();
+      sequencer.render(io);
+      for (int c = 0; c < channels; c++) {
+        const float *src = io.outBuffer(c);
+        float *dst = interleaved + size_t(b) * blockSize * channels + c;
+        for (int i = 0; i < blockSize; i++) {
+          dst[i * channels] = src[i];
+        }
+      }
+    }
+  }
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_OFFLINERENDERER_HPP
@@ -0,0 +1,259 @@
+#ifndef PLAYGROUND_OSCILLATORBANK_HPP
+#define PLAYGROUND_OSCILLATORBANK_HPP
+
+// A bank of sine partials rendered a block at a time.
+//
+// Additive voices used to run one gam::Sine per partial sample by sample and
+// multiply every partial by the envelope and amplitude. OscillatorBank keeps
+// the partials side by side (one SIMD lane per partial) and renders their
+// weighted sum for a whole block, so the voice only applies its envelope once
+// per sample:
+//
+//   OscillatorBank<> mBank;
+//   ...
+//   mBank.size(5);
+//   mBank.freq(k, (2 * k + 1) * f);  mBank.amp(k, amp / (2 * k + 1));
+//   ...
+//   mBank.render(buffer, frames);
+//   while (io()) { float s = buffer[i++] * mAmpEnv(); ... }
+//
+// Each partial is a complex phasor rotated by its per-sample increment.
+// Rounding drift of the phasor length is corrected at the end of every
+// render() call. Phases start at 0, like a freshly reset gam::Sine.
+//
+// Uses AVX when compiled with -mavx, SSE on other x86 builds and plain loops
+// elsewhere.
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PLAYGROUND_OSCBANK_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define PLAYGROUND_OSCBANK_SSE 1
+#endif
+
+namespace playground {
+
+template <int MaxPartials = 16> class OscillatorBank {
+public:
+  /// Partials are padded to a multiple of the widest SIMD register
+  static constexpr int kLanes = 8;
+  static constexpr int kCapacity = (MaxPartials + kLanes - 1) / kLanes * kLanes;
+
+  OscillatorBank() {
+    for (int k = 0; k < kCapacity; k++) {
+      mFreq[k] = 0.0f;
+      mAmp[k] = 0.0f;
+      mIncRe[k] = 1.0f;
+      mIncIm[k] = 0.0f;
+    }
+    reset();
+  }
+
+  /// Set sample rate. Partial frequencies are kept.
+  void sampleRate(double sr) {
+    if (sr != mSampleRate && sr > 0) {
+      mSampleRate = sr;
+      for (int k = 0; k < mSize; k++) {
+        updateIncrement(k);
+      }
+    }
+  }
+  double sampleRate() const { return mSampleRate; }
+
+  /// Set number of active partials
+  void size(int n) {
+    n = n < 0 ? 0 : (n > MaxPartials ? MaxPartials : n);
+    for (int k = n; k < mSize; k++) {
+      mAmp[k] = 0.0f;
+    }
+    mSize = n;
+  }
+  int size() const { return mSize; }
+
+  /// Set frequency of partial k in Hz. The phase is kept.
+  void freq(int k, float hz) {
+    if (mFreq[k] != hz) {
+      mFreq[k] = hz;
+      updateIncrement(k);
+    }
+  }
+  float freq(int k) const { return mFreq[k]; }
+
+  /// Set amplitude of partial k
+  void amp(int k, float a) { mAmp[k] = a; }
+  float amp(int k) const { return mAmp[k]; }
+
+  /// Reset all phases to 0
+  void reset() {
+    for (int k = 0; k < kCapacity; k++) {
+      mRe[k] = 1.0f;
+      mIm[k] = 0.0f;
+    }
+  }
+
+  /// Write the sum of all partials for the next 'frames' samples to out
+  void render(float *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+      out[i] = 0.0f;
+    }
+    renderAdd(out, frames);
+  }
+
+  /// Add the sum of all partials for the next 'frames' samples to out
+  void renderAdd(float *out, int frames) {
+    const int used = (mSize + 3) / 4 * 4; // lanes that need processing
+    int k = 0;
+#if PLAYGROUND_OSCBANK_AVX
+    for (; k + 8 <= used; k += 8) {
+      renderAVX(k, out, frames);
+    }
+#endif
+#if PLAYGROUND_OSCBANK_SSE
+    for (; k + 4 <= used; k += 4) {
+      renderSSE(k, out, frames);
+    }
+#endif
+    for (; k < mSize; k++) {
+      renderScalar(k, out, frames);
+    }
+    normalize(used > mSize ? used : mSize);
+  }
+
+private:
+  alignas(32) float mRe[kCapacity];
+  alignas(32) float mIm[kCapacity];
+  alignas(32) float mIncRe[kCapacity];
+  alignas(32) float mIncIm[kCapacity];
+  alignas(32) float mAmp[kCapacity];
+  float mFreq[kCapacity];
+  double mSampleRate{44100.0};
+  int mSize{0};
+
+  void updateIncrement(int k) {
+    const double w = 6.283185307179586 * mFreq[k] / mSampleRate;
+    mIncRe[k] = float(std::cos(w));
+    mIncIm[k] = float(std::sin(w));
+  }
+
+  // Pull phasors back onto the unit circle (one Newton step is enough for
+  // the drift a block of float rotations accumulates)
+  void normalize(int lanes) {
+    for (int k = 0; k < lanes; k++) {
+      float g = 1.5f - 0.5f * (mRe[k] * mRe[k] + mIm[k] * mIm[k]);
+      mRe[k] *= g;
+      mIm[k] *= g;
+    }
+  }
+
+  void renderScalar(int k, float *out, int frames) {
+    float re = mRe[k], im = mIm[k];
+    const float ir = mIncRe[k], ii = mIncIm[k], a = mAmp[k];
+    for (int i = 0; i < frames; i++) {
+      out[i] += a * im;
+      float r = re * ir - im * ii;
+      im = re * ii + im * ir;
+      re = r;
+    }
+    mRe[k] = re;
+    mIm[k] = im;
+  }
+
+#if PLAYGROUND_OSCBANK_SSE
+  static inline void rotate(__m128 &re, __m128 &im, __m128 ir, __m128 ii) {
+    __m128 r = _mm_sub_ps(_mm_mul_ps(re, ir), _mm_mul_ps(im, ii));
+    im = _mm_add_ps(_mm_mul_ps(re, ii), _mm_mul_ps(im, ir));
+    re = r;
+  }
+
+  static inline float horizontalSum(__m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+  }
+
+  // Four frames of four lanes each are transposed so the per-frame sums come
+  // out as one vector instead of four horizontal adds.
+  static inline void accumulate4(float *out, __m128 v0, __m128 v1, __m128 v2,
+                                 __m128 v3) {
+    _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+    __m128 sum = _mm_add_ps(_mm_add_ps(v0, v1), _mm_add_ps(v2, v3));
+    _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), sum));
+  }
+
+  void renderSSE(int k, float *out, int frames) {
+    __m128 re = _mm_load_ps(mRe + k);
+    __m128 im = _mm_load_ps(mIm + k);
+    const __m128 ir = _mm_load_ps(mIncRe + k);
+    const __m128 ii = _mm_load_ps(mIncIm + k);
+    const __m128 a = _mm_load_ps(mAmp + k);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+      __m128 v0 = _mm_mul_ps(im, a);
+      rotate(re, im, ir, ii);
+      __m128 v1 = _mm_mul_ps(im, a);
+      rotate(re, im, ir, ii);
+      __m128 v2 = _mm_mul_ps(im, a);
+      rotate(re, im, ir, ii);
+      __m128 v3 = _mm_mul_ps(im, a);
+      rotate(re, im, ir, ii);
+      accumulate4(out + i, v0, v1, v2, v3);
+    }
+    for (; i < frames; i++) {
+      out[i] += horizontalSum(_mm_mul_ps(im, a));
+      rotate(re, im, ir, ii);
+    }
+    _mm_store_ps(mRe + k, re);
+    _mm_store_ps(mIm + k, im);
+  }
+#endif
+
+#if PLAYGROUND_OSCBANK_AVX
+  static inline void rotate(__m256 &re, __m256 &im, __m256 ir, __m256 ii) {
+    __m256 r = _mm256_sub_ps(_mm256_mul_ps(re, ir), _mm256_mul_ps(im, ii));
+    im = _mm256_add_ps(_mm256_mul_ps(re, ii), _mm256_mul_ps(im, ir));
+    re = r;
+  }
+
+  // Fold eight lanes into four so the SSE transpose can finish the sum
+  static inline __m128 fold(__m256 v) {
+    return _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  }
+
+  void renderAVX(int k, float *out, int frames) {
+    __m256 re = _mm256_load_ps(mRe + k);
+    __m256 im = _mm256_load_ps(mIm + k);
+    const __m256 ir = _mm256_load_ps(mIncRe + k);
+    const __m256 ii = _mm256_load_ps(mIncIm + k);
+    const __m256 a = _mm256_load_ps(mAmp + k);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+      __m128 v0 = fold(_mm256_mul_ps(im, a));
+      rotate(re, im, ir, ii);
+      __m128 v1 = fold(_mm256_mul_ps(im, a));
+      rotate(re, im, ir, ii);
+      __m128 v2 = fold(_mm256_mul_ps(im, a));
+      rotate(re, im, ir, ii);
+      __m128 v3 = fold(_mm256_mul_ps(im, a));
+      rotate(re, im, ir, ii);
+      accumulate4(out + i, v0, v1, v2, v3);
+    }
+    for (; i < frames; i++) {
+      out[i] += horizontalSum(fold(_mm256_mul_ps(im, a)));
+      rotate(re, im, ir, ii);
+    }
+    _mm256_store_ps(mRe + k, re);
+    _mm256_store_ps(mIm + k, im);
+  }
+#endif
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_OSCILLATORBANK_HPP
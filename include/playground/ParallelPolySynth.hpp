@@ -0,0 +1,412 @@
+#ifndef PLAYGROUND_PARALLELPOLYSYNTH_HPP
+#define PLAYGROUND_PARALLELPOLYSYNTH_HPP
+
+// Rendering the voices of a PolySynth on several cores.
+//
+// PolySynth::render() runs every active voice one after the other on the
+// audio thread. ParallelPolySynth is a drop in PolySynth that hands the
+// voices of each block to a VoiceRenderPool instead:
+//
+//   ParallelPolySynth mScoreSynth;
+//   SynthSequencer mScoreSequencer;
+//   ...
+//   mScoreSequencer << mScoreSynth;  // sequencer renders through the pool
+//   ...
+//   void onSound(AudioIOData &io) override { mScoreSequencer.render(io); }
+//
+// Every worker (the audio thread is worker 0) takes voices from its own
+// share of the block first and steals from the other shares when it runs
+// out, so one expensive voice does not hold up the rest. Each worker renders
+// into a private scratch bus and the buses are added to the output in worker
+// order once all voices are done.
+//
+// The audio thread never takes a lock: the block is published through atomic
+// counters and idle workers are woken without blocking the caller. If no
+// worker shows up in time the audio thread simply renders everything itself.
+//
+// deterministic(true) gives every voice a scratch bus of its own and adds
+// them in voice list order. The output is then the same on every run, for
+// any number of workers, and bit identical to PolySynth::render() for voices
+// that add to each output sample once.
+//
+// Each voice's onProcess() is timed under its class by the DspProfiler
+// when that is enabled, and each worker's share of a block shows up as a
+// "voices" zone in a TraceRecorder trace.
+//
+// ParallelPolySynth renders straight into the buffers it is given. It does
+// not apply PolySynth channel maps or post processing callbacks.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define PLAYGROUND_VOICEPOOL_SSE 1
+#endif
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_PolySynth.hpp"
+
+#include "playground/DspProfiler.hpp"
+#include "playground/RtSanitizer.hpp"
+#include "playground/TraceRecorder.hpp"
+
+namespace playground {
+
+class VoiceRenderPool {
+public:
+  /// numWorkers is the number of threads besides the audio thread,
+  /// -1 for one per remaining hardware thread
+  explicit VoiceRenderPool(int numWorkers = -1) {
+    if (numWorkers < 0) {
+      unsigned cores = std::thread::hardware_concurrency();
+      numWorkers = cores > 1 ? int(cores) - 1 : 0;
+    }
+    mNumWorkers = std::min(numWorkers, kMaxWorkers - 1);
+    for (int w = 0; w < mNumWorkers + 1; w++) {
+      mBuses.emplace_back(new al::AudioIOData);
+    }
+    for (int w = 0; w < mNumWorkers + 1; w++) {
+      mBusGeneration[w].store(0, std::memory_order_relaxed);
+    }
+    for (int w = 1; w <= mNumWorkers; w++) {
+      mThreads.emplace_back([this, w]() { workerLoop(w); });
+    }
+  }
+
+  ~VoiceRenderPool() {
+    mRunning.store(false);
+    mGeneration.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(mSleepLock);
+    }
+    mWake.notify_all();
+    for (auto &t : mThreads) {
+      t.join();
+    }
+  }
+
+  /// Allocate the scratch buses. Called automatically from the audio thread
+  /// when the block size or channel count changes, so call it beforehand
+  /// (e.g. in onCreate()) to keep allocation off the audio thread.
+  void configure(double framesPerSecond, int framesPerBuffer, int channels,
+                 int maxVoices = 128) {
+    mFramesPerBuffer = framesPerBuffer;
+    mChannels = channels;
+    mMaxVoices = std::max(1, std::min(maxVoices, 0xffff));
+    mDeterministic = mDeterministicRequested.load();
+    mTasks.resize(mMaxVoices);
+    mOverflow.reserve(mMaxVoices);
+    for (auto &bus : mBuses) {
+      setupBus(*bus, framesPerSecond);
+    }
+    mSlots.clear();
+    if (mDeterministic) {
+      for (int i = 0; i < mMaxVoices; i++) {
+        mSlots.emplace_back(new al::AudioIOData);
+        setupBus(*mSlots.back(), framesPerSecond);
+      }
+    }
+  }
+
+  bool configured(const al::AudioIOData &io) const {
+    return mFramesPerBuffer == int(io.framesPerBuffer()) &&
+           mChannels == int(io.channelsOut()) && !mTasks.empty() &&
+           mDeterministic == mDeterministicRequested.load();
+  }
+
+  /// Sum voices in a fixed order so the result doesn't depend on scheduling.
+  /// Takes effect at the next configure(), which render() calls by itself.
+  void deterministic(bool on) { mDeterministicRequested.store(on); }
+  bool deterministic() const { return mDeterministicRequested.load(); }
+
+  /// Blocks with fewer voices than this are rendered on the audio thread only
+  void minParallelVoices(int n) { mMinParallelVoices = n; }
+
+  int numWorkers() const { return mNumWorkers; }
+
+  // ---- Audio thread ----
+
+  /// Start collecting the voices of a block
+  void begin() { mNumTasks = 0; }
+
+  /// Queue a voice that starts rendering at frame offset of the block
+  void add(al::SynthVoice *voice, int offset) {
+    if (mNumTasks < int(mTasks.size())) {
+      mTasks[mNumTasks++] = {voice, offset};
+    } else {
+      mOverflow.push_back({voice, offset}); // only if over maxVoices
+    }
+  }
+
+  /// Render all queued voices and add them to io
+  void render(al::AudioIOData &io) {
+    const int numTasks = mNumTasks;
+    if (!mDeterministic && (mNumWorkers == 0 || numTasks < mMinParallelVoices)) {
+      for (int i = 0; i < numTasks; i++) {
+        renderVoice(mTasks[i], io);
+      }
+    } else if (numTasks > 0) {
+      renderParallel(io, numTasks);
+    }
+    // Voices beyond maxVoices are rendered serially after the rest
+    for (auto &task : mOverflow) {
+      renderVoice(task, io);
+    }
+    mOverflow.clear();
+    io.frame(0);
+  }
+
+private:
+  static constexpr int kMaxWorkers = 64;
+  static constexpr int kSpinIterations = 2000;
+
+  struct Task {
+    al::SynthVoice *voice;
+    int offset;
+  };
+
+  // A worker's share of the block packed as generation | end | next so it can
+  // be claimed with one compare-exchange and stale workers can't claim tasks
+  // of a later block.
+  static uint64_t packShare(uint32_t generation, int begin, int end) {
+    return (uint64_t(generation) << 32) | (uint64_t(end) << 16) |
+           uint64_t(begin);
+  }
+
+  struct alignas(64) Share {
+    std::atomic<uint64_t> range{0};
+  };
+
+  int mNumWorkers{0};
+  int mFramesPerBuffer{0};
+  int mChannels{0};
+  int mMaxVoices{0};
+  int mMinParallelVoices{4};
+  bool mDeterministic{false}; // mode of the current configuration
+  std::atomic<bool> mDeterministicRequested{false};
+
+  std::vector<Task> mTasks;
+  std::vector<Task> mOverflow;
+  int mNumTasks{0};
+  std::vector<std::unique_ptr<al::AudioIOData>> mBuses; // one per worker
+  std::vector<std::unique_ptr<al::AudioIOData>> mSlots; // one per voice
+
+  Share mShares[kMaxWorkers];
+  std::atomic<uint32_t> mBusGeneration[kMaxWorkers];
+  alignas(64) std::atomic<uint32_t> mGeneration{0};
+  alignas(64) std::atomic<int> mDone{0};
+  std::atomic<bool> mRunning{true};
+  std::atomic<int> mSleepers{0};
+  std::mutex mSleepLock; // only taken by sleeping workers
+  std::condition_variable mWake;
+  std::vector<std::thread> mThreads;
+
+  void setupBus(al::AudioIOData &bus, double framesPerSecond) {
+    bus.framesPerSecond(framesPerSecond);
+    bus.framesPerBuffer(mFramesPerBuffer);
+    bus.channelsOut(mChannels);
+    bus.zeroOut();
+  }
+
+  static void renderVoice(const Task &task, al::AudioIOData &io) {
+    PLAYGROUND_RT_VOICE(task.voice);
+    PLAYGROUND_DSP_VOICE(task.voice);
+    io.frame(task.offset);
+    task.voice->onProcess(io);
+  }
+
+  void renderParallel(al::AudioIOData &io, int numTasks) {
+    const uint32_t generation = mGeneration.load(std::memory_order_relaxed) + 1;
+    const int numShares = std::min(mNumWorkers + 1, numTasks);
+    mDone.store(0, std::memory_order_relaxed);
+    for (int s = 0; s < mNumWorkers + 1; s++) {
+      int begin = s < numShares ? s * numTasks / numShares : numTasks;
+      int end = s < numShares ? (s + 1) * numTasks / numShares : numTasks;
+      mShares[s].range.store(packShare(generation, begin, end),
+                             std::memory_order_release);
+    }
+    // Publish the block and wake anyone who went to sleep. notify_all()
+    // doesn't need the lock; a worker that misses it wakes on its timeout.
+    mGeneration.store(generation, std::memory_order_release);
+    if (mSleepers.load(std::memory_order_acquire) > 0) {
+      mWake.notify_all();
+    }
+
+    int rendered = work(0, generation);
+    // Wait for voices other workers have already started
+    while (mDone.load(std::memory_order_acquire) + rendered < numTasks) {
+      pause();
+    }
+
+    // Deterministic reduction into the output buffers
+    const int frames = int(io.framesPerBuffer());
+    if (mDeterministic) {
+      for (int i = 0; i < numTasks; i++) {
+        for (int c = 0; c < mChannels; c++) {
+          mix(io.outBuffer(c), mSlots[i]->outBuffer(c), frames);
+        }
+      }
+    } else {
+      for (int w = 0; w < mNumWorkers + 1; w++) {
+        if (mBusGeneration[w].load(std::memory_order_relaxed) == generation) {
+          for (int c = 0; c < mChannels; c++) {
+            mix(io.outBuffer(c), mBuses[w]->outBuffer(c), frames);
+          }
+        }
+      }
+    }
+  }
+
+  // Claim the next task of share s, or -1 if it is empty or stale
+  int claim(int s, uint32_t generation) {
+    uint64_t v = mShares[s].range.load(std::memory_order_acquire);
+    for (;;) {
+      int next = int(v & 0xffff);
+      int end = int((v >> 16) & 0xffff);
+      if (uint32_t(v >> 32) != generation || next >= end) {
+        return -1;
+      }
+      if (mShares[s].range.compare_exchange_weak(v, v + 1,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+        return next;
+      }
+    }
+  }
+
+  // Render tasks from worker w's own share, then steal from the others.
+  // Returns the number of tasks rendered.
+  int work(int w, uint32_t generation) {
+    PLAYGROUND_RT_SCOPE("VoiceRenderPool");
+    PLAYGROUND_TRACE_ZONE("voices");
+    const int numShares = mNumWorkers + 1;
+    int rendered = 0;
+    for (int k = 0; k < numShares; k++) {
+      const int s = (w + k) % numShares;
+      int i;
+      while ((i = claim(s, generation)) >= 0) {
+        al::AudioIOData *bus;
+        if (mDeterministic) {
+          bus = mSlots[i].get();
+          bus->zeroOut();
+        } else {
+          bus = mBuses[w].get();
+          if (mBusGeneration[w].load(std::memory_order_relaxed) != generation) {
+            bus->zeroOut();
+            mBusGeneration[w].store(generation, std::memory_order_relaxed);
+          }
+        }
+        renderVoice(mTasks[i], *bus);
+        rendered++;
+        if (w != 0) {
+          mDone.fetch_add(1, std::memory_order_release);
+        }
+      }
+    }
+    return rendered;
+  }
+
+  void workerLoop(int w) {
+    PLAYGROUND_TRACE_THREAD("VoiceRenderPool");
+    uint32_t seen = mGeneration.load(std::memory_order_acquire);
+    while (mRunning.load(std::memory_order_relaxed)) {
+      uint32_t generation = waitForBlock(seen);
+      if (generation != seen) {
+        seen = generation;
+        work(w, generation);
+      }
+    }
+  }
+
+  // Spin for a while, then sleep until the next block is published
+  uint32_t waitForBlock(uint32_t seen) {
+    for (int i = 0; i < kSpinIterations; i++) {
+      uint32_t g = mGeneration.load(std::memory_order_acquire);
+      if (g != seen) {
+        return g;
+      }
+      pause();
+    }
+    mSleepers.fetch_add(1, std::memory_order_acq_rel);
+    {
+      std::unique_lock<std::mutex> lock(mSleepLock);
+      mWake.wait_for(lock, std::chrono::milliseconds(1), [&]() {
+        return mGeneration.load(std::memory_order_acquire) != seen ||
+               !mRunning.load(std::memory_order_relaxed);
+      });
+    }
+    mSleepers.fetch_sub(1, std::memory_order_acq_rel);
+    return mGeneration.load(std::memory_order_acquire);
+  }
+
+  static inline void pause() {
+#if PLAYGROUND_VOICEPOOL_SSE
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+  // dst += src. Element-wise, so SIMD and scalar give the same bits.
+  static void mix(float *dst, const float *src, int frames) {
+    int i = 0;
+#if PLAYGROUND_VOICEPOOL_SSE
+    for (; i + 4 <= frames; i += 4) {
+      _mm_storeu_ps(dst + i,
+                    _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+    }
+#endif
+    for (; i < frames; i++) {
+      dst[i] += src[i];
+    }
+  }
+};
+
+class ParallelPolySynth : public al::PolySynth {
+public:
+  explicit ParallelPolySynth(int numWorkers = -1) : mPool(numWorkers) {}
+
+  VoiceRenderPool &pool() { return mPool; }
+
+  void render(al::AudioIOData &io) override {
+    if (!mPool.configured(io)) {
+      mPool.configure(io.framesPerSecond(), int(io.framesPerBuffer()),
+                      int(io.channelsOut()));
+    }
+    processVoices();
+    processVoiceTurnOff();
+
+    // Collect the block's voices on this thread: the offsets and note offs
+    // are bookkeeping that must happen in list order.
+    const int framesPerBuffer = int(io.framesPerBuffer());
+    mPool.begin();
+    for (auto *voice = getActiveVoices(); voice; voice = voice->next) {
+      if (voice->active()) {
+        int offset = voice->getStartOffsetFrames(framesPerBuffer);
+        int endOffset = voice->getEndOffsetFrames(framesPerBuffer);
+        if (endOffset > 0 && endOffset <= framesPerBuffer) {
+          voice->triggerOff(endOffset);
+        }
+        mPool.add(voice, offset);
+      }
+    }
+    mPool.render(io);
+    processInactiveVoices();
+  }
+
+private:
+  VoiceRenderPool mPool;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_PARALLELPOLYSYNTH_HPP
@@ -0,0 +1,71 @@
+#ifndef PLAYGROUND_PARAMETERHANDLE_HPP
+#define PLAYGROUND_PARAMETERHANDLE_HPP
+
+// Pre-resolved handles to SynthVoice internal parameters.
+//
+// getInternalParameterValue("name") looks the parameter up by string every
+// time it is called. When that happens inside the per-sample loop of a voice
+// it quickly becomes one of the most expensive things the voice does.
+//
+// A ParameterHandle is resolved once, usually in init() by keeping the
+// pointer returned by createInternalTriggerParameter():
+//
+//   ParameterHandle pAmplitude;
+//   void init() override {
+//     pAmplitude = createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
+//   }
+//
+// and is then read once per block:
+//
+//   void onProcess(AudioIOData &io) override {
+//     const float amp = pAmplitude.get();
+//     while (io()) { ... * amp ... }
+//   }
+//
+// get() is a single atomic load of the parameter value, so it is safe to call
+// from the audio thread while the GUI or a sequencer writes the parameter.
+
+#include <memory>
+#include <string>
+
+#include "al/ui/al_Parameter.hpp"
+
+namespace playground {
+
+class ParameterHandle {
+public:
+  ParameterHandle() = default;
+  ParameterHandle(std::shared_ptr<al::Parameter> param)
+      : mParam(std::move(param)) {}
+
+  ParameterHandle &operator=(std::shared_ptr<al::Parameter> param) {
+    mParam = std::move(param);
+    return *this;
+  }
+
+  /// Current value. Returns the fallback value if the handle is unresolved,
+  /// matching getInternalParameterValue() for unknown names.
+  float get() const { return mParam ? mParam->get() : mFallback; }
+
+  void set(float value) {
+    if (mParam) {
+      mParam->set(value);
+    }
+  }
+
+  /// Value returned by get() while the handle is unresolved
+  void fallback(float value) { mFallback = value; }
+
+  bool valid() const { return mParam != nullptr; }
+  explicit operator bool() const { return valid(); }
+
+  al::Parameter *parameter() const { return mParam.get(); }
+
+private:
+  std::shared_ptr<al::Parameter> mParam;
+  float mFallback{0.0f};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_PARAMETERHANDLE_HPP
@@ -0,0 +1,192 @@
+#ifndef PLAYGROUND_PARTICLESTORE_HPP
+#define PLAYGROUND_PARTICLESTORE_HPP
+
+// A fixed number of particles kept as one array per component, recycled
+// oldest first, and integrated straight into a mesh's vertex and color
+// arrays.
+//
+//   playground::ParticleStore mParticles;
+//   playground::WorkerPool mPool;
+//   VAOMesh mMesh;
+//   ...
+//   mParticles.resize(1000000);
+//   mMesh.vertices().resize(mParticles.size());  // once; written in place
+//   mMesh.colors().resize(mParticles.size());
+//   ...
+//   void onAnimate(double dt) override {
+//     mParticles.emit(5000, [](playground::ParticleStore::Spawn &s) {
+//       s.velocity[1] = 0.13f;
+//       ...
+//     });
+//     mParticles.step(1.0f / 200, &mMesh.vertices()[0][0],
+//                     &mMesh.colors()[0].r, &mPool);
+//     mMesh.update();
+//   }
+//
+// step() moves every particle by its velocity and its velocity by its
+// acceleration, ages it by one, and writes its position (x, y, z) and its
+// color fading out with age (r, g, b, 1) in the same pass, four particles at
+// a time with SSE and blocks of particles spread over a WorkerPool. Particles
+// do not interact, so the result does not depend on how they are split.
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define PLAYGROUND_PARTICLESTORE_SSE 1
+#endif
+
+#include "playground/BufferOps.hpp"
+#include "playground/WorkerPool.hpp"
+
+namespace playground {
+
+class ParticleStore {
+public:
+  /// Particles per parallel task; a multiple of four, so only the last task
+  /// has a scalar tail
+  static constexpr int kGrain = 16384;
+
+  /// A new particle, filled in by the function given to emit()
+  struct Spawn {
+    float position[3]{0.0f, 0.0f, 0.0f};
+    float velocity[3]{0.0f, 0.0f, 0.0f};
+    float acceleration[3]{0.0f, 0.0f, 0.0f};
+    float color[3]{1.0f, 1.0f, 1.0f};
+  };
+
+  /// Set the number of particles. All start at the origin, black and with
+  /// age ageLimit, so they stay black until emitted.
+  void resize(int numParticles, float ageLimit = 1e9f) {
+    mSize = std::max(numParticles, 0);
+    for (auto *v : {&mPx, &mPy, &mPz, &mVx, &mVy, &mVz, &mAx, &mAy, &mAz,
+                    &mRed, &mGreen, &mBlue}) {
+      v->assign(mSize, 0.0f);
+    }
+    mAge.assign(mSize, ageLimit);
+    mTap = 0;
+  }
+
+  int size() const { return mSize; }
+
+  /// Replace the count oldest particles by new ones; init(Spawn &) sets each
+  template <typename F> void emit(int count, F &&init) {
+    if (mSize == 0) {
+      return;
+    }
+    for (int k = 0; k < count; k++) {
+      Spawn s;
+      init(s);
+      const int i = mTap;
+      mPx[i] = s.position[0];
+      mPy[i] = s.position[1];
+      mPz[i] = s.position[2];
+      mVx[i] = s.velocity[0];
+      mVy[i] = s.velocity[1];
+      mVz[i] = s.velocity[2];
+      mAx[i] = s.acceleration[0];
+      mAy[i] = s.acceleration[1];
+      mAz[i] = s.acceleration[2];
+      mRed[i] = s.color[0];
+      mGreen[i] = s.color[1];
+      mBlue[i] = s.color[2];
+      mAge[i] = 0.0f;
+      if (++mTap >= mSize) {
+        mTap = 0;
+      }
+    }
+  }
+
+  /// Advance every particle one step and write x, y, z per particle to
+  /// positions and r, g, b, a per particle to colors. Colors are the
+  /// particle's color times max(0, 1 - age * fade). Runs on pool if given.
+  void step(float fade, float *positions, float *colors,
+            WorkerPool *pool = nullptr) {
+    auto task = [&](int begin, int end) {
+      stepRange(begin, end, fade, positions, colors);
+    };
+    if (pool) {
+      pool->parallelFor(0, mSize, kGrain, task);
+    } else {
+      task(0, mSize);
+    }
+  }
+
+  /// Position of particle i as x, y, z
+  void position(int i, float *xyz) const {
+    xyz[0] = mPx[i];
+    xyz[1] = mPy[i];
+    xyz[2] = mPz[i];
+  }
+
+  float age(int i) const { return mAge[i]; }
+
+private:
+  void stepRange(int begin, int end, float fade, float *positions,
+                 float *colors) {
+    int i = begin;
+#if PLAYGROUND_PARTICLESTORE_SSE
+    const __m128 vFade = _mm_set1_ps(fade);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= end; i += 4) {
+      __m128 vx = _mm_add_ps(_mm_loadu_ps(&mVx[i]), _mm_loadu_ps(&mAx[i]));
+      __m128 vy = _mm_add_ps(_mm_loadu_ps(&mVy[i]), _mm_loadu_ps(&mAy[i]));
+      __m128 vz = _mm_add_ps(_mm_loadu_ps(&mVz[i]), _mm_loadu_ps(&mAz[i]));
+      const __m128 px = _mm_add_ps(_mm_loadu_ps(&mPx[i]), vx);
+      const __m128 py = _mm_add_ps(_mm_loadu_ps(&mPy[i]), vy);
+      const __m128 pz = _mm_add_ps(_mm_loadu_ps(&mPz[i]), vz);
+      const __m128 age = _mm_add_ps(_mm_loadu_ps(&mAge[i]), one);
+      _mm_storeu_ps(&mVx[i], vx);
+      _mm_storeu_ps(&mVy[i], vy);
+      _mm_storeu_ps(&mVz[i], vz);
+      _mm_storeu_ps(&mPx[i], px);
+      _mm_storeu_ps(&mPy[i], py);
+      _mm_storeu_ps(&mPz[i], pz);
+      _mm_storeu_ps(&mAge[i], age);
+
+      buffer::storeXyz(positions + 3 * i, px, py, pz);
+      const __m128 level = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(age, vFade)), zero);
+      __m128 r = _mm_mul_ps(_mm_loadu_ps(&mRed[i]), level);
+      __m128 g = _mm_mul_ps(_mm_loadu_ps(&mGreen[i]), level);
+      __m128 b = _mm_mul_ps(_mm_loadu_ps(&mBlue[i]), level);
+      __m128 a = one;
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+      _mm_storeu_ps(colors + 4 * i, r);
+      _mm_storeu_ps(colors + 4 * i + 4, g);
+      _mm_storeu_ps(colors + 4 * i + 8, b);
+      _mm_storeu_ps(colors + 4 * i + 12, a);
+    }
+#endif
+    for (; i < end; i++) {
+      mVx[i] += mAx[i];
+      mVy[i] += mAy[i];
+      mVz[i] += mAz[i];
+      mPx[i] += mVx[i];
+      mPy[i] += mVy[i];
+      mPz[i] += mVz[i];
+      mAge[i] += 1.0f;
+      positions[3 * i] = mPx[i];
+      positions[3 * i + 1] = mPy[i];
+      positions[3 * i + 2] = mPz[i];
+      const float level = std::max(1.0f - mAge[i] * fade, 0.0f);
+      colors[4 * i] = mRed[i] * level;
+      colors[4 * i + 1] = mGreen[i] * level;
+      colors[4 * i + 2] = mBlue[i] * level;
+      colors[4 * i + 3] = 1.0f;
+    }
+  }
+
+  int mSize{0};
+  int mTap{0}; // next particle to replace
+  std::vector<float> mPx, mPy, mPz;
+  std::vector<float> mVx, mVy, mVz;
+  std::vector<float> mAx, mAy, mAz;
+  std::vector<float> mRed, mGreen, mBlue;
+  std::vector<float> mAge;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_PARTICLESTORE_HPP
@@ -0,0 +1,614 @@
+#ifndef PLAYGROUND_RTSANITIZER_HPP
+#define PLAYGROUND_RTSANITIZER_HPP
+
+// Catching allocations, locks and file I/O on the audio thread.
+//
+// Dropouts usually come from a call deep inside a voice or plugin that
+// allocates, waits for a lock or touches the disk once in a while. Built with
+// PLAYGROUND_RT_SANITIZER defined, this header replaces malloc, free,
+// pthread_mutex_lock and the stdio and raw file calls, and reports every
+// distinct call stack that reaches them from code marked real time:
+//
+//   // Debug build: -DPLAYGROUND_RT_SANITIZER (and -rdynamic for names)
+//   #include "playground/RtSanitizer.hpp"
+//
+//   void onSound(AudioIOData &io) override {
+//     PLAYGROUND_RT_SCOPE("onSound");  // this thread is real time until '}'
+//     ...
+//   }
+//
+// which prints, from a reporter thread, e.g.
+//
+//   RtSanitizer: allocation of 96 bytes in onSound, voice ModalVoice
+//     #1 ModalVoice::onTriggerOn() ...
+//
+// Voices rendered by ParallelPolySynth and started by EventQueue are named
+// in reports by themselves; PLAYGROUND_RT_VOICE(voice) names the voice
+// elsewhere and PLAYGROUND_RT_ALLOW() lets through what is known to be fine.
+// Without PLAYGROUND_RT_SANITIZER the macros compile to nothing.
+//
+// The check is a thread local test, so the cost outside of violations is a
+// few nanoseconds per call. On a violation the audio thread takes a
+// backtrace and, for a call stack not seen before, hands it to the reporter
+// through a fixed ring; nothing is printed, allocated or locked on the audio
+// thread. A summary is printed at exit.
+//
+// The replacements are defined in the file that includes this header, so
+// define PLAYGROUND_RT_SANITIZER for one translation unit only (the apps in
+// this repository are one file each). Everything is caught on Linux with
+// glibc (link with -ldl before glibc 2.34). On macOS only operator new and
+// delete can be replaced from the program, so C allocations, locks and file
+// I/O go unnoticed; elsewhere the scopes are kept but nothing is checked.
+
+#ifdef PLAYGROUND_RT_SANITIZER
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <typeinfo>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#define PLAYGROUND_RT_BACKTRACE 1
+#endif
+
+namespace playground {
+namespace rt_sanitizer {
+
+enum Kind { ALLOCATION, DEALLOCATION, LOCK, FILE_IO, NUM_KINDS };
+
+static constexpr int kMaxFrames = 32;
+static constexpr int kNumReports = 64;   // waiting to be printed
+static constexpr int kNumStacks = 4096;  // distinct call stacks remembered
+
+inline const char *kindName(int kind) {
+  static const char *const names[NUM_KINDS] = {"allocation", "free",
+                                               "mutex lock", "file I/O"};
+  return names[kind];
+}
+
+// Everything here is zero initialized, so it works before main() and inside
+// malloc() without constructors or guards.
+struct ThreadState {
+  int realtime;                // RealtimeScope depth
+  int allowed;                 // AllowScope depth
+  int inside;                  // in the sanitizer itself
+  const char *scope;           // innermost RealtimeScope
+  const std::type_info *voice; // voice being run, if known
+};
+
+struct Report {
+  std::atomic<int> state; // 0 free, 1 being written, 2 ready to print
+  int kind;
+  size_t bytes;
+  const char *scope;
+  const std::type_info *voice;
+  int numFrames;
+  void *frames[kMaxFrames];
+};
+
+struct Shared {
+  Report reports[kNumReports];
+  std::atomic<uint64_t> stacks[kNumStacks]; // hashes, 0 for empty
+  std::atomic<uint64_t> counts[NUM_KINDS];
+  std::atomic<uint64_t> distinct;
+  std::atomic<uint64_t> dropped; // distinct stacks not reported
+  std::atomic<unsigned> nextReport;
+};
+
+inline ThreadState &threadState() {
+  static thread_local ThreadState state;
+  return state;
+}
+
+inline Shared &shared() {
+  static Shared s;
+  return s;
+}
+
+// Count a violation and queue its stack if it was not seen before
+inline void record(ThreadState &t, int kind, size_t bytes) {
+  Shared &s = shared();
+  s.counts[kind].fetch_add(1, std::memory_order_relaxed);
+#if PLAYGROUND_RT_BACKTRACE
+  void *frames[kMaxFrames];
+  const int numFrames = backtrace(frames, kMaxFrames);
+  uint64_t hash = 14695981039346656037ull ^ uint64_t(kind);
+  for (int i = 0; i < numFrames; i++) {
+    hash = (hash ^ uint64_t(uintptr_t(frames[i]))) * 1099511628211ull;
+  }
+  hash = hash ? hash : 1;
+  // Claim an empty slot of the open addressed table, or find the stack
+  // there already. If the table is crowded the stack is reported again.
+  size_t slot = size_t(hash % kNumStacks);
+  for (int probe = 0; probe < 16; probe++, slot = (slot + 1) % kNumStacks) {
+    uint64_t seen = 0;
+    if (s.stacks[slot].compare_exchange_strong(seen, hash,
+                                               std::memory_order_relaxed)) {
+      break;
+    }
+    if (seen == hash) {
+      return;
+    }
+  }
+  s.distinct.fetch_add(1, std::memory_order_relaxed);
+  for (int attempt = 0; attempt < kNumReports; attempt++) {
+    Report &r = s.reports[s.nextReport.fetch_add(1, std::memory_order_relaxed) %
+                          kNumReports];
+    int expected = 0;
+    if (r.state.compare_exchange_strong(expected, 1,
+                                        std::memory_order_acquire)) {
+      r.kind = kind;
+      r.bytes = bytes;
+      r.scope = t.scope;
+      r.voice = t.voice;
+      r.numFrames = numFrames;
+      std::memcpy(r.frames, frames, sizeof(void *) * size_t(numFrames));
+      r.state.store(2, std::memory_order_release);
+      return;
+    }
+  }
+  s.dropped.fetch_add(1, std::memory_order_relaxed);
+#else
+  (void)t;
+  (void)bytes;
+#endif
+}
+
+/// Called by the replaced functions
+inline void check(int kind, size_t bytes = 0) {
+  ThreadState &t = threadState();
+  if (t.realtime == 0 || t.allowed > 0 || t.inside > 0) {
+    return;
+  }
+  t.inside++;
+  record(t, kind, bytes);
+  t.inside--;
+}
+
+/// Marks the thread as real time while in scope
+class RealtimeScope {
+public:
+  explicit RealtimeScope(const char *name) {
+    ThreadState &t = threadState();
+    mPrevious = t.scope;
+    t.scope = name;
+    t.realtime++;
+  }
+  ~RealtimeScope() {
+    ThreadState &t = threadState();
+    t.realtime--;
+    t.scope = mPrevious;
+  }
+  RealtimeScope(const RealtimeScope &) = delete;
+  RealtimeScope &operator=(const RealtimeScope &) = delete;
+
+private:
+  const char *mPrevious;
+};
+
+/// Names the voice being run in reports while in scope
+class VoiceScope {
+public:
+  template <class TVoice> explicit VoiceScope(const TVoice *voice) {
+    ThreadState &t = threadState();
+    mPrevious = t.voice;
+    t.voice = voice ? &typeid(*voice) : nullptr;
+  }
+  ~VoiceScope() { threadState().voice = mPrevious; }
+  VoiceScope(const VoiceScope &) = delete;
+  VoiceScope &operator=(const VoiceScope &) = delete;
+
+private:
+  const std::type_info *mPrevious;
+};
+
+/// Lets calls through unchecked while in scope
+class AllowScope {
+public:
+  AllowScope() { threadState().allowed++; }
+  ~AllowScope() { threadState().allowed--; }
+  AllowScope(const AllowScope &) = delete;
+  AllowScope &operator=(const AllowScope &) = delete;
+};
+
+inline std::string demangle(const char *name) {
+#if defined(__GNUC__)
+  int status = 0;
+  char *plain = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  std::string result = status == 0 && plain ? plain : name;
+  std::free(plain);
+  return result;
+#else
+  return name;
+#endif
+}
+
+// Demangle the first mangled name in a backtrace_symbols() line
+inline std::string demangleLine(const char *line) {
+  std::string s = line;
+  const size_t begin = s.find("_Z");
+  if (begin == std::string::npos) {
+    return s;
+  }
+  const size_t end = s.find_first_of("+) ", begin);
+  const size_t length = end == std::string::npos ? std::string::npos : end - begin;
+  return s.substr(0, begin) + demangle(s.substr(begin, length).c_str()) +
+         (end == std::string::npos ? "" : s.substr(end));
+}
+
+/// Prints the queued reports every 100 ms and a summary at exit
+class Reporter {
+public:
+  Reporter() {
+#if PLAYGROUND_RT_BACKTRACE
+    void *frame;
+    backtrace(&frame, 1); // loads the unwinder now rather than on the audio thread
+#endif
+    mThread = std::thread([this]() {
+      while (mRunning.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        printReports();
+      }
+    });
+  }
+
+  ~Reporter() {
+    mRunning.store(false);
+    mThread.join();
+    printReports();
+    Shared &s = shared();
+    uint64_t total = 0;
+    for (auto &count : s.counts) {
+      total += count.load();
+    }
+    if (total > 0) {
+      fprintf(stderr,
+              "RtSanitizer: %llu violations from %llu call stacks: %llu "
+              "allocations, %llu frees, %llu locks, %llu file I/O calls",
+              (unsigned long long)total, (unsigned long long)s.distinct.load(),
+              (unsigned long long)s.counts[ALLOCATION].load(),
+              (unsigned long long)s.counts[DEALLOCATION].load(),
+              (unsigned long long)s.counts[LOCK].load(),
+              (unsigned long long)s.counts[FILE_IO].load());
+      if (s.dropped.load() > 0) {
+        fprintf(stderr, " (%llu stacks not shown)",
+                (unsigned long long)s.dropped.load());
+      }
+      fprintf(stderr, "\n");
+    }
+  }
+
+private:
+  void printReports() {
+    for (Report &r : shared().reports) {
+      if (r.state.load(std::memory_order_acquire) != 2) {
+        continue;
+      }
+      std::string line = std::string("RtSanitizer: ") + kindName(r.kind);
+      if (r.bytes > 0) {
+        line += " of " + std::to_string(r.bytes) + " bytes";
+      }
+      line += std::string(" in ") + (r.scope ? r.scope : "real time code");
+      if (r.voice) {
+        line += ", voice " + demangle(r.voice->name());
+      }
+      fprintf(stderr, "%s\n", line.c_str());
+#if PLAYGROUND_RT_BACKTRACE
+      // Frame 0 is record() itself
+      char **symbols = backtrace_symbols(r.frames, r.numFrames);
+      for (int i = 1; symbols && i < r.numFrames; i++) {
+        fprintf(stderr, "  #%d %s\n", i, demangleLine(symbols[i]).c_str());
+      }
+      std::free(symbols);
+#endif
+      r.state.store(0, std::memory_order_release);
+    }
+  }
+
+  std::atomic<bool> mRunning{true};
+  std::thread mThread;
+};
+
+static Reporter reporter;
+
+#if defined(__GLIBC__)
+// Functions other than malloc's family are found with dlsym() on first use
+struct RealFunctions {
+  std::atomic<void *> mutexLock, open, openat, read, write, fopen, fread,
+      fwrite, fputs, puts, vfprintf, vfprintfChk;
+};
+
+inline RealFunctions &realFunctions() {
+  static RealFunctions r;
+  return r;
+}
+
+template <class F> F real(std::atomic<void *> &slot, const char *name) {
+  void *f = slot.load(std::memory_order_relaxed);
+  if (!f) {
+    f = dlsym(RTLD_NEXT, name);
+    slot.store(f, std::memory_order_relaxed);
+  }
+  return reinterpret_cast<F>(f);
+}
+#endif
+
+} // namespace rt_sanitizer
+} // namespace playground
+
+#if defined(__GLIBC__)
+// The replacements are given the C names through assembler labels, so they
+// don't clash with the declarations (or _FORTIFY_SOURCE wrappers) of the
+// system headers. With _FORTIFY_SOURCE the printf family is called as
+// __printf_chk and friends, which are replaced as well.
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void __libc_free(void *);
+
+void *playground_rt_malloc(size_t) __asm__("malloc");
+void *playground_rt_calloc(size_t, size_t) __asm__("calloc");
+void *playground_rt_realloc(void *, size_t) __asm__("realloc");
+void playground_rt_free(void *) __asm__("free");
+int playground_rt_mutex_lock(pthread_mutex_t *) __asm__("pthread_mutex_lock");
+int playground_rt_open(const char *, int, ...) __asm__("open");
+int playground_rt_openat(int, const char *, int, ...) __asm__("openat");
+ssize_t playground_rt_read(int, void *, size_t) __asm__("read");
+ssize_t playground_rt_write(int, const void *, size_t) __asm__("write");
+FILE *playground_rt_fopen(const char *, const char *) __asm__("fopen");
+size_t playground_rt_fread(void *, size_t, size_t, FILE *) __asm__("fread");
+size_t playground_rt_fwrite(const void *, size_t, size_t, FILE *) __asm__("fwrite");
+int playground_rt_fputs(const char *, FILE *) __asm__("fputs");
+int playground_rt_puts(const char *) __asm__("puts");
+int playground_rt_printf(const char *, ...) __asm__("printf");
+int playground_rt_fprintf(FILE *, const char *, ...) __asm__("fprintf");
+int playground_rt_vprintf(const char *, va_list) __asm__("vprintf");
+int playground_rt_vfprintf(FILE *, const char *, va_list) __asm__("vfprintf");
+int playground_rt_printf_chk(int, const char *, ...) __asm__("__printf_chk");
+int playground_rt_fprintf_chk(FILE *, int, const char *, ...) __asm__(
+    "__fprintf_chk");
+int playground_rt_vprintf_chk(int, const char *, va_list) __asm__(
+    "__vprintf_chk");
+int playground_rt_vfprintf_chk(FILE *, int, const char *, va_list) __asm__(
+    "__vfprintf_chk");
+
+void *playground_rt_malloc(size_t size) {
+  playground::rt_sanitizer::check(playground::rt_sanitizer::ALLOCATION, size);
+  return __libc_malloc(size);
+}
+
+void *playground_rt_calloc(size_t count, size_t size) {
+  playground::rt_sanitizer::check(playground::rt_sanitizer::ALLOCATION,
+                                  count * size);
+  return __libc_calloc(count, size);
+}
+
+void *playground_rt_realloc(void *p, size_t size) {
+  playground::rt_sanitizer::check(playground::rt_sanitizer::ALLOCATION, size);
+  return __libc_realloc(p, size);
+}
+
+void playground_rt_free(void *p) {
+  if (p) {
+    playground::rt_sanitizer::check(playground::rt_sanitizer::DEALLOCATION);
+  }
+  __libc_free(p);
+}
+
+int playground_rt_mutex_lock(pthread_mutex_t *mutex) {
+  using namespace playground::rt_sanitizer;
+  check(LOCK);
+  return real<int (*)(pthread_mutex_t *)>(realFunctions().mutexLock,
+                                          "pthread_mutex_lock")(mutex);
+}
+
+int playground_rt_open(const char *path, int flags, ...) {
+  using namespace playground::rt_sanitizer;
+  unsigned mode = 0;
+  if (flags & O_CREAT) {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, unsigned);
+    va_end(args);
+  }
+  check(FILE_IO);
+  return real<int (*)(const char *, int, ...)>(realFunctions().open, "open")(
+      path, flags, mode);
+}
+
+int playground_rt_openat(int dir, const char *path, int flags, ...) {
+  using namespace playground::rt_sanitizer;
+  unsigned mode = 0;
+  if (flags & O_CREAT) {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, unsigned);
+    va_end(args);
+  }
+  check(FILE_IO);
+  return real<int (*)(int, const char *, int, ...)>(realFunctions().openat,
+                                                    "openat")(dir, path, flags,
+                                                              mode);
+}
+
+ssize_t playground_rt_read(int fd, void *buffer, size_t size) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<ssize_t (*)(int, void *, size_t)>(realFunctions().read, "read")(
+      fd, buffer, size);
+}
+
+ssize_t playground_rt_write(int fd, const void *buffer, size_t size) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<ssize_t (*)(int, const void *, size_t)>(realFunctions().write,
+                                                      "write")(fd, buffer, size);
+}
+
+FILE *playground_rt_fopen(const char *path, const char *mode) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<FILE *(*)(const char *, const char *)>(realFunctions().fopen,
+                                                     "fopen")(path, mode);
+}
+
+size_t playground_rt_fread(void *buffer, size_t size, size_t count, FILE *f) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<size_t (*)(void *, size_t, size_t, FILE *)>(
+      realFunctions().fread, "fread")(buffer, size, count, f);
+}
+
+size_t playground_rt_fwrite(const void *buffer, size_t size, size_t count,
+                            FILE *f) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<size_t (*)(const void *, size_t, size_t, FILE *)>(
+      realFunctions().fwrite, "fwrite")(buffer, size, count, f);
+}
+
+int playground_rt_fputs(const char *s, FILE *f) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<int (*)(const char *, FILE *)>(realFunctions().fputs, "fputs")(s,
+                                                                           f);
+}
+
+int playground_rt_puts(const char *s) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<int (*)(const char *)>(realFunctions().puts, "puts")(s);
+}
+
+int playground_rt_printf(const char *format, ...) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  va_list args;
+  va_start(args, format);
+  const int n = real<int (*)(FILE *, const char *, va_list)>(
+      realFunctions().vfprintf, "vfprintf")(stdout, format, args);
+  va_end(args);
+  return n;
+}
+
+int playground_rt_fprintf(FILE *f, const char *format, ...) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  va_list args;
+  va_start(args, format);
+  const int n = real<int (*)(FILE *, const char *, va_list)>(
+      realFunctions().vfprintf, "vfprintf")(f, format, args);
+  va_end(args);
+  return n;
+}
+
+int playground_rt_vprintf(const char *format, va_list args) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<int (*)(FILE *, const char *, va_list)>(
+      realFunctions().vfprintf, "vfprintf")(stdout, format, args);
+}
+
+int playground_rt_vfprintf(FILE *f, const char *format, va_list args) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<int (*)(FILE *, const char *, va_list)>(
+      realFunctions().vfprintf, "vfprintf")(f, format, args);
+}
+
+int playground_rt_printf_chk(int flag, const char *format, ...) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  va_list args;
+  va_start(args, format);
+  const int n = real<int (*)(FILE *, int, const char *, va_list)>(
+      realFunctions().vfprintfChk, "__vfprintf_chk")(stdout, flag, format,
+                                                     args);
+  va_end(args);
+  return n;
+}
+
+int playground_rt_fprintf_chk(FILE *f, int flag, const char *format, ...) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  va_list args;
+  va_start(args, format);
+  const int n = real<int (*)(FILE *, int, const char *, va_list)>(
+      realFunctions().vfprintfChk, "__vfprintf_chk")(f, flag, format, args);
+  va_end(args);
+  return n;
+}
+
+int playground_rt_vprintf_chk(int flag, const char *format, va_list args) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<int (*)(FILE *, int, const char *, va_list)>(
+      realFunctions().vfprintfChk, "__vfprintf_chk")(stdout, flag, format,
+                                                     args);
+}
+
+int playground_rt_vfprintf_chk(FILE *f, int flag, const char *format,
+                               va_list args) {
+  using namespace playground::rt_sanitizer;
+  check(FILE_IO);
+  return real<int (*)(FILE *, int, const char *, va_list)>(
+      realFunctions().vfprintfChk, "__vfprintf_chk")(f, flag, format, args);
+}
+} // extern "C"
+
+#elif defined(__APPLE__)
+// The default operator new[], delete[] and the sized and nothrow forms all
+// end up here
+void *operator new(size_t size) {
+  playground::rt_sanitizer::check(playground::rt_sanitizer::ALLOCATION, size);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  if (p) {
+    playground::rt_sanitizer::check(playground::rt_sanitizer::DEALLOCATION);
+  }
+  std::free(p);
+}
+#endif
+
+#define PLAYGROUND_RT_CONCAT_(a, b) a##b
+#define PLAYGROUND_RT_CONCAT(a, b) PLAYGROUND_RT_CONCAT_(a, b)
+#define PLAYGROUND_RT_SCOPE(name)                                              \
+  ::playground::rt_sanitizer::RealtimeScope PLAYGROUND_RT_CONCAT(              \
+      playgroundRtScope, __LINE__)(name)
+#define PLAYGROUND_RT_VOICE(voice)                                             \
+  ::playground::rt_sanitizer::VoiceScope PLAYGROUND_RT_CONCAT(                 \
+      playgroundRtVoice, __LINE__)(voice)
+#define PLAYGROUND_RT_ALLOW()                                                  \
+  ::playground::rt_sanitizer::AllowScope PLAYGROUND_RT_CONCAT(                 \
+      playgroundRtAllow, __LINE__)
+
+#else
+
+#define PLAYGROUND_RT_SCOPE(name) (void)0
+#define PLAYGROUND_RT_VOICE(voice) (void)0
+#define PLAYGROUND_RT_ALLOW() (void)0
+
+#endif // PLAYGROUND_RT_SANITIZER
+
+#endif // PLAYGROUND_RTSANITIZER_HPP
@@ -0,0 +1,497 @@
+#ifndef PLAYGROUND_SCOREFILE_HPP
+#define PLAYGROUND_SCOREFILE_HPP
+
+// Binary, memory mapped scores (.synthScore).
+//
+// A .synthSequence is text that has to be parsed whole before the first note
+// plays, and a Sequence of Notes lives in memory in full. A .synthScore holds
+// the same events as fixed size records sorted by start time, so a reader
+// maps the file and reads notes in place, however long the score is:
+//
+//   header | parameter pool | note records | time index | voice names
+//
+// Each note record stores its start time, duration, voice name and where its
+// trigger parameters are in the pool. The time index holds, for every
+// indexInterval seconds, the first note starting at or after that time, so
+// playback can start anywhere without scanning.
+//
+//   playground::ScoreWriter writer;
+//   writer.open("piece.synthScore");
+//   writer.addNote(0.0, 0.5, "SquareWave", {0.2f, 440.0f, 0.1f, 0.1f, 0.0f});
+//   writer.close();
+//
+//   playground::ScoreFile score;
+//   score.open("piece.synthScore");
+//   for (size_t i = score.firstNoteAt(60.0); i < score.numNotes(); i++) {
+//     playground::ScoreNote note = score.note(i);
+//     ...
+//   }
+//
+// convertSynthSequence() turns the text format into this one. ScoreStreamer
+// (ScoreStreamer.hpp) plays a ScoreFile into a PolySynth.
+//
+// Files are written in native byte order and are not meant to be moved
+// between machines of different endianness.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "playground/MappedFile.hpp"
+
+namespace playground {
+
+namespace score_format {
+
+static const char kMagic[8] = {'S', 'Y', 'N', 'S', 'C', 'O', 'R', 'E'};
+static const uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t numNames;
+  uint64_t numNotes;
+  uint64_t notesOffset; ///< NoteRecord[numNotes], sorted by start
+  uint64_t paramsOffset; ///< float[numParams]
+  uint64_t numParams;
+  uint64_t indexOffset; ///< uint64_t[numIndex]
+  uint64_t numIndex;
+  double indexInterval; ///< seconds per index entry
+  uint64_t namesOffset; ///< numNames null terminated strings
+  uint64_t fileSize;
+  double length; ///< end of the last note in seconds
+};
+
+struct NoteRecord {
+  double start;
+  float duration;
+  uint16_t name;
+  uint16_t numParams;
+  uint64_t firstParam;
+};
+
+} // namespace score_format
+
+/// One note read from a ScoreFile. params points into the mapped file.
+struct ScoreNote {
+  double start;
+  float duration;
+  const std::string *name;
+  const float *params;
+  int numParams;
+};
+
+class ScoreWriter {
+public:
+  /// Distinct voice names a file can hold, as note records store 16 bit ids
+  static constexpr int kMaxNames = 0x10000;
+
+  ~ScoreWriter() { close(); }
+
+  /// indexInterval is the time step of the seek index in seconds
+  bool open(const std::string &path, double indexInterval = 1.0) {
+    close();
+    mFile = fopen(path.c_str(), "wb");
+    if (!mFile) {
+      return false;
+    }
+    mPath = path;
+    mError.clear();
+    mIndexInterval = indexInterval > 0 ? indexInterval : 1.0;
+    mNotes.clear();
+    mNames.clear();
+    mNameIds.clear();
+    mNumParams = 0;
+    score_format::Header header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, mFile); // patched in close()
+    return true;
+  }
+
+  /// Notes may be added in any order. Parameters go straight to disk, only
+  /// the 24 byte note records are kept until close() sorts them. Returns
+  /// false if the note can't be stored: a file holds at most kMaxNames voice
+  /// names, and a note with one more fails the whole write (see close()).
+  bool addNote(double start, float duration, const std::string &voiceName,
+               const float *params, int numParams) {
+    if (!mFile || !mError.empty()) {
+      return false;
+    }
+    int name = nameId(voiceName);
+    if (name < 0) {
+      mError = "more than " + std::to_string(kMaxNames) + " voice names";
+      return false;
+    }
+    score_format::NoteRecord record;
+    record.start = start;
+    record.duration = duration;
+    record.name = uint16_t(name);
+    record.numParams = uint16_t(std::max(0, std::min(numParams, 0xffff)));
+    record.firstParam = mNumParams;
+    fwrite(params, sizeof(float), record.numParams, mFile);
+    mNumParams += record.numParams;
+    mNotes.push_back(record);
+    return true;
+  }
+
+  bool addNote(double start, float duration, const std::string &voiceName,
+               std::initializer_list<float> params) {
+    return addNote(start, duration, voiceName, params.begin(),
+                   int(params.size()));
+  }
+
+  size_t numNotes() const { return mNotes.size(); }
+
+  /// Why the last write failed, empty if it did not or failed on disk
+  const std::string &error() const { return mError; }
+
+  /// Sort the notes, write records, index and names. Returns false on a
+  /// write error, or if a note could not be added; the file is then removed
+  /// rather than left with notes missing.
+  bool close() {
+    if (!mFile) {
+      return true;
+    }
+    if (!mError.empty()) {
+      fclose(mFile);
+      mFile = nullptr;
+      mNotes.clear();
+      remove(mPath.c_str());
+      return false;
+    }
+    std::stable_sort(mNotes.begin(), mNotes.end(),
+                     [](const score_format::NoteRecord &a,
+                        const score_format::NoteRecord &b) {
+                       return a.start < b.start;
+                     });
+    score_format::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, score_format::kMagic, sizeof(header.magic));
+    header.version = score_format::kVersion;
+    header.numNames = uint32_t(mNames.size());
+    header.numNotes = mNotes.size();
+    header.paramsOffset = sizeof(header);
+    header.numParams = mNumParams;
+    header.indexInterval = mIndexInterval;
+
+    // Records are 8 byte aligned for the reader
+    uint64_t offset = header.paramsOffset + mNumParams * sizeof(float);
+    while (offset % 8) {
+      fputc(0, mFile);
+      offset++;
+    }
+    header.notesOffset = offset;
+    if (!mNotes.empty()) {
+      fwrite(mNotes.data(), sizeof(score_format::NoteRecord), mNotes.size(),
+             mFile);
+    }
+    offset += mNotes.size() * sizeof(score_format::NoteRecord);
+
+    double length = 0.0;
+    for (auto &note : mNotes) {
+      length = std::max(length, note.start + note.duration);
+    }
+    header.length = length;
+    const double lastStart = mNotes.empty() ? 0.0 : mNotes.back().start;
+    header.numIndex = uint64_t(std::max(0.0, lastStart) / mIndexInterval) + 1;
+    header.indexOffset = offset;
+    size_t n = 0;
+    for (uint64_t k = 0; k < header.numIndex; k++) {
+      const double t = k * mIndexInterval;
+      while (n < mNotes.size() && mNotes[n].start < t) {
+        n++;
+      }
+      uint64_t first = n;
+      fwrite(&first, sizeof(first), 1, mFile);
+    }
+    offset += header.numIndex * sizeof(uint64_t);
+
+    header.namesOffset = offset;
+    for (auto &name : mNames) {
+      fwrite(name.c_str(), 1, name.size() + 1, mFile);
+      offset += name.size() + 1;
+    }
+    header.fileSize = offset;
+
+    fseek(mFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, mFile);
+    bool ok = !ferror(mFile);
+    ok = (fclose(mFile) == 0) && ok;
+    mFile = nullptr;
+    mNotes.clear();
+    return ok;
+  }
+
+private:
+  FILE *mFile{nullptr};
+  std::string mPath;
+  std::string mError;
+  double mIndexInterval{1.0};
+  uint64_t mNumParams{0};
+  std::vector<score_format::NoteRecord> mNotes;
+  std::vector<std::string> mNames;
+  std::map<std::string, uint16_t> mNameIds;
+
+  // -1 once all kMaxNames ids are taken
+  int nameId(const std::string &name) {
+    auto it = mNameIds.find(name);
+    if (it != mNameIds.end()) {
+      return it->second;
+    }
+    if (int(mNames.size()) >= kMaxNames) {
+      return -1;
+    }
+    uint16_t id = uint16_t(mNames.size());
+    mNames.push_back(name);
+    mNameIds[name] = id;
+    return id;
+  }
+};
+
+class ScoreFile {
+public:
+  ScoreFile() = default;
+  ScoreFile(const ScoreFile &) = delete;
+  ScoreFile &operator=(const ScoreFile &) = delete;
+  ~ScoreFile() { close(); }
+
+  /// Map a .synthScore file. Nothing but the header and the voice names is
+  /// read until notes are accessed.
+  bool open(const std::string &path) {
+    close();
+    if (!mFile.open(path)) {
+      return false;
+    }
+    mFile.sequential();
+    mData = mFile.data();
+    mSize = mFile.size();
+    if (mSize < sizeof(score_format::Header)) {
+      close();
+      return false;
+    }
+    memcpy(&mHeader, mData, sizeof(mHeader));
+    const auto &h = mHeader;
+    if (memcmp(h.magic, score_format::kMagic, sizeof(h.magic)) != 0 ||
+        h.version != score_format::kVersion || h.fileSize > mSize ||
+        h.notesOffset + h.numNotes * sizeof(score_format::NoteRecord) >
+            h.fileSize ||
+        h.paramsOffset + h.numParams * sizeof(float) > h.fileSize ||
+        h.indexOffset + h.numIndex * sizeof(uint64_t) > h.fileSize ||
+        h.notesOffset % 8 || h.indexOffset % 8 || h.numIndex == 0) {
+      fprintf(stderr, "ScoreFile: %s is not a valid .synthScore\n",
+              path.c_str());
+      close();
+      return false;
+    }
+    mNotes = reinterpret_cast<const score_format::NoteRecord *>(
+        mData + h.notesOffset);
+    mParams = reinterpret_cast<const float *>(mData + h.paramsOffset);
+    mIndex = reinterpret_cast<const uint64_t *>(mData + h.indexOffset);
+    const char *name = mData + h.namesOffset;
+    const char *end = mData + h.fileSize;
+    for (uint32_t i = 0; i < h.numNames && name < end; i++) {
+      mNames.emplace_back(name, strnlen(name, size_t(end - name)));
+      name += mNames.back().size() + 1;
+    }
+    if (mNames.size() != h.numNames) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    mFile.close();
+    mData = nullptr;
+    mSize = 0;
+    mNotes = nullptr;
+    mParams = nullptr;
+    mIndex = nullptr;
+    mNames.clear();
+    memset(&mHeader, 0, sizeof(mHeader));
+  }
+
+  bool isOpen() const { return mNotes != nullptr; }
+
+  size_t numNotes() const { return size_t(mHeader.numNotes); }
+
+  /// End of the last note in seconds
+  double length() const { return mHeader.length; }
+
+  const std::vector<std::string> &voiceNames() const { return mNames; }
+
+  ScoreNote note(size_t i) const {
+    const score_format::NoteRecord &r = mNotes[i];
+    ScoreNote n;
+    n.start = r.start;
+    n.duration = r.duration;
+    n.name = r.name < mNames.size() ? &mNames[r.name] : &mEmptyName;
+    n.numParams = r.firstParam + r.numParams <= mHeader.numParams ? r.numParams : 0;
+    n.params = mParams + (n.numParams > 0 ? r.firstParam : 0);
+    return n;
+  }
+
+  /// Index of the first note starting at or after time (seconds)
+  size_t firstNoteAt(double time) const {
+    if (time <= 0 || mHeader.numNotes == 0) {
+      return 0;
+    }
+    uint64_t k = uint64_t(time / mHeader.indexInterval);
+    if (k >= mHeader.numIndex) {
+      k = mHeader.numIndex - 1;
+    }
+    size_t i = size_t(mIndex[k]);
+    while (i < numNotes() && mNotes[i].start < time) {
+      i++;
+    }
+    return i;
+  }
+
+  /// Let the OS drop pages of notes before index i (they won't be read
+  /// again unless playback seeks back)
+  void releaseBefore(size_t i) {
+    mFile.release(size_t(mHeader.notesOffset),
+                  size_t(mHeader.notesOffset) +
+                      i * sizeof(score_format::NoteRecord));
+  }
+
+private:
+  MappedFile mFile;
+  const char *mData{nullptr};
+  size_t mSize{0};
+  score_format::Header mHeader{};
+  const score_format::NoteRecord *mNotes{nullptr};
+  const float *mParams{nullptr};
+  const uint64_t *mIndex{nullptr};
+  std::vector<std::string> mNames;
+  const std::string mEmptyName;
+};
+
+/// Convert a .synthSequence text file to a .synthScore.
+/// Handles '@' events and '+'/'-' note on/off pairs. Notes still on at the
+/// end of the file last until the last event. Tempo ('t') and nested
+/// sequence ('=') lines are skipped with a warning, as are parameters that
+/// are not numbers (stored as 0).
+inline bool convertSynthSequence(const std::string &textPath,
+                                 const std::string &scorePath,
+                                 bool verbose = true) {
+  std::ifstream in(textPath);
+  if (!in) {
+    fprintf(stderr, "convertSynthSequence: can't read %s\n", textPath.c_str());
+    return false;
+  }
+  ScoreWriter writer;
+  if (!writer.open(scorePath)) {
+    fprintf(stderr, "convertSynthSequence: can't write %s\n",
+            scorePath.c_str());
+    return false;
+  }
+
+  struct OpenNote {
+    double start;
+    std::string name;
+    std::vector<float> params;
+  };
+  std::map<int, std::vector<OpenNote>> openNotes; // oldest first per id
+  double lastTime = 0.0;
+  int skipped = 0;
+  int badParams = 0;
+  std::vector<float> params;
+
+  auto readParams = [&](std::istringstream &line) {
+    params.clear();
+    std::string token;
+    while (line >> token) {
+      char *end = nullptr;
+      float value = strtof(token.c_str(), &end);
+      if (end == token.c_str()) {
+        value = 0.0f;
+        badParams++;
+      }
+      params.push_back(value);
+    }
+  };
+
+  std::string text;
+  while (std::getline(in, text)) {
+    std::istringstream line(text);
+    std::string command;
+    if (!(line >> command) || command[0] == '#') {
+      continue;
+    }
+    if (command == "@") {
+      double start;
+      float duration;
+      std::string name;
+      if (line >> start >> duration >> name) {
+        readParams(line);
+        writer.addNote(start, duration, name, params.data(),
+                       int(params.size()));
+        lastTime = std::max(lastTime, start + duration);
+      }
+    } else if (command == "+") {
+      double start;
+      int id;
+      std::string name;
+      if (line >> start >> id >> name) {
+        readParams(line);
+        openNotes[id].push_back({start, name, params});
+        lastTime = std::max(lastTime, start);
+      }
+    } else if (command == "-") {
+      double time;
+      int id;
+      if (line >> time >> id) {
+        auto it = openNotes.find(id);
+        if (it != openNotes.end() && !it->second.empty()) {
+          OpenNote &note = it->second.front();
+          writer.addNote(note.start, float(time - note.start), note.name,
+                         note.params.data(), int(note.params.size()));
+          it->second.erase(it->second.begin());
+        }
+        lastTime = std::max(lastTime, time);
+      }
+    } else {
+      skipped++;
+    }
+  }
+  for (auto &id : openNotes) {
+    for (auto &note : id.second) {
+      writer.addNote(note.start, float(lastTime - note.start), note.name,
+                     note.params.data(), int(note.params.size()));
+    }
+  }
+  const size_t numNotes = writer.numNotes();
+  if (!writer.close()) {
+    fprintf(stderr, "convertSynthSequence: error writing %s%s%s\n",
+            scorePath.c_str(), writer.error().empty() ? "" : ": ",
+            writer.error().c_str());
+    return false;
+  }
+  if (skipped > 0) {
+    fprintf(stderr, "convertSynthSequence: skipped %d unsupported lines\n",
+            skipped);
+  }
+  if (badParams > 0) {
+    fprintf(stderr, "convertSynthSequence: %d non numeric parameters set to 0\n",
+            badParams);
+  }
+  if (verbose) {
+    printf("%s -> %s: %zu notes\n", textPath.c_str(), scorePath.c_str(),
+           numNotes);
+  }
+  return true;
+}
+
+} // namespace playground
+
+#endif // PLAYGROUND_SCOREFILE_HPP
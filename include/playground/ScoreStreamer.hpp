@@ -0,0 +1,173 @@
+#ifndef PLAYGROUND_SCORESTREAMER_HPP
+#define PLAYGROUND_SCORESTREAMER_HPP
+
+// Plays a .synthScore into a PolySynth, paging notes in just ahead of the
+// playhead.
+//
+// Instead of scheduling the whole score up front, the streamer keeps only
+// lookahead() seconds of notes in flight. A background thread (or the app,
+// by calling update()) reads the next notes from the mapped ScoreFile,
+// prepares their voices and hands them to the audio thread through an
+// EventQueue. Start-up time and memory use therefore do not depend on the
+// length of the score.
+//
+//   playground::EventQueue mEvents;
+//   playground::ScoreStreamer mStreamer{synth, mEvents};
+//   ...
+//   synth.registerSynthClass<SquareWave>("SquareWave");
+//   mStreamer.open("piece.synthScore");
+//   mStreamer.startThread();
+//   mStreamer.play();
+//   ...
+//   void onSound(AudioIOData &io) override {
+//     mEvents.dispatch(synth, io);
+//     ...render synth...
+//   }
+//
+// Voices are created by name, so every voice class in the score must be
+// registered with the PolySynth.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al/scene/al_PolySynth.hpp"
+
+#include "playground/EventQueue.hpp"
+#include "playground/ScoreFile.hpp"
+#include "playground/VoiceStager.hpp"
+
+namespace playground {
+
+class ScoreStreamer {
+public:
+  ScoreStreamer(al::PolySynth &synth, EventQueue &queue)
+      : mSynth(synth), mQueue(queue), mEvents(queue.producer()) {}
+
+  ~ScoreStreamer() { stopThread(); }
+
+  bool open(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mPlaying = false;
+    return mScore.open(path);
+  }
+
+  ScoreFile &score() { return mScore; }
+
+  /// Seconds of notes handed to the audio thread ahead of the playhead
+  void lookahead(double seconds) { mLookahead = seconds; }
+
+  /// Start playing from the given score time (seconds)
+  void play(double fromSeconds = 0.0) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mScore.isOpen()) {
+      return;
+    }
+    mCursor = mScore.firstNoteAt(fromSeconds);
+    mScoreStart = int64_t(mQueue.nowFrames()) -
+                  int64_t(mQueue.seconds(fromSeconds));
+    mPlaying = true;
+  }
+
+  /// Stop handing out notes. Notes already queued still play.
+  void stop() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mPlaying = false;
+  }
+
+  bool playing() const { return mPlaying; }
+
+  /// Score time at the playhead in seconds
+  double position() const {
+    double frames = double(int64_t(mQueue.nowFrames()) - mScoreStart);
+    return frames / double(mQueue.seconds(1.0));
+  }
+
+  /// Queue the notes that start within lookahead() of the playhead.
+  /// Call regularly from a thread other than the audio thread.
+  void update() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mPlaying || !mEvents.valid()) {
+      return;
+    }
+    const double sampleRate = double(mQueue.seconds(1.0));
+    const int64_t horizon =
+        int64_t(mQueue.nowFrames()) + int64_t(mQueue.seconds(mLookahead));
+    const size_t first = mCursor;
+    while (mCursor < mScore.numNotes() && mEvents.available() > 0) {
+      ScoreNote note = mScore.note(mCursor);
+      const int64_t frame =
+          mScoreStart + int64_t(std::llround(note.start * sampleRate));
+      if (frame > horizon) {
+        break;
+      }
+      mCursor++;
+      al::SynthVoice *voice = mSynth.getVoice(*note.name);
+      if (!voice) {
+        if (mMissing.insert(*note.name).second) {
+          fprintf(stderr, "ScoreStreamer: voice '%s' is not registered\n",
+                  note.name->c_str());
+        }
+        continue;
+      }
+      mParams.assign(note.params, note.params + note.numParams);
+      voice->setTriggerParams(mParams);
+      prepareVoice(voice); // PreparedVoice set up, off the audio thread
+      // Cannot fail: the loop only takes a voice while the ring has room
+      mEvents.noteOn(voice, uint64_t(std::max<int64_t>(frame, 0)),
+                     mQueue.seconds(note.duration));
+    }
+    if (mCursor != first) {
+      mScore.releaseBefore(mCursor);
+    }
+    if (mCursor >= mScore.numNotes()) {
+      mPlaying = false;
+    }
+  }
+
+  /// Call update() every intervalMs on a thread of our own
+  void startThread(int intervalMs = 10) {
+    stopThread();
+    mRunning = true;
+    mThread = std::thread([this, intervalMs]() {
+      while (mRunning) {
+        update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+      }
+    });
+  }
+
+  void stopThread() {
+    mRunning = false;
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+  }
+
+private:
+  al::PolySynth &mSynth;
+  EventQueue &mQueue;
+  EventQueue::Producer mEvents;
+  ScoreFile mScore;
+
+  std::mutex mLock; // between update() and play()/stop(), never the audio
+  size_t mCursor{0};
+  std::atomic<int64_t> mScoreStart{0}; // stream frame of score time 0
+  std::atomic<bool> mPlaying{false};
+  std::atomic<double> mLookahead{2.0};
+  std::vector<float> mParams;
+  std::set<std::string> mMissing;
+
+  std::atomic<bool> mRunning{false};
+  std::thread mThread;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_SCORESTREAMER_HPP
@@ -0,0 +1,85 @@
+#ifndef PLAYGROUND_SCRATCHARENA_HPP
+#define PLAYGROUND_SCRATCHARENA_HPP
+
+// Preallocated scratch memory for audio callbacks.
+//
+// A ScratchArena is reserved once, off the audio thread, and then handed out
+// in cache line aligned pieces for the length of one callback:
+//
+//   playground::ScratchArena mScratch;
+//   ...
+//   mScratch.reserve(ScratchArena::footprint(frames * channels));  // setup
+//   ...
+//   void onSound(AudioIOData &io) override {
+//     mScratch.reset();
+//     float *interleaved = mScratch.allocate(frames * channels);
+//     ...
+//   }
+//
+// allocate() never touches the heap; it returns nullptr when the arena is
+// used up, so callers size their work from available() instead of from the
+// block size and process large blocks in pieces. Each allocation is rounded
+// up to a whole cache line; footprint() gives the room one takes.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace playground {
+
+class ScratchArena {
+public:
+  static constexpr size_t kAlignment = 64; // bytes
+  static constexpr size_t kLineFloats = kAlignment / sizeof(float);
+
+  ScratchArena() = default;
+  explicit ScratchArena(size_t floats) { reserve(floats); }
+
+  /// Floats one allocate(floats) takes out of the arena
+  static size_t footprint(size_t floats) {
+    return (floats + kLineFloats - 1) / kLineFloats * kLineFloats;
+  }
+
+  /// Make room for at least floats floats. Allocates when growing and
+  /// releases everything handed out; call it off the audio thread.
+  void reserve(size_t floats) {
+    floats = footprint(floats);
+    if (floats > mCapacity) {
+      mStorage.reset(new float[floats + kLineFloats]);
+      const uintptr_t address = reinterpret_cast<uintptr_t>(mStorage.get());
+      const uintptr_t aligned = (address + kAlignment - 1) & ~(kAlignment - 1);
+      mData = reinterpret_cast<float *>(aligned);
+      mCapacity = floats;
+    }
+    mUsed = 0;
+  }
+
+  /// Cache line aligned room for floats floats, or nullptr if the arena is
+  /// too small. The memory is not cleared.
+  float *allocate(size_t floats) {
+    floats = footprint(floats);
+    if (mUsed + floats > mCapacity) {
+      return nullptr;
+    }
+    float *piece = mData + mUsed;
+    mUsed += floats;
+    return piece;
+  }
+
+  /// Hand the whole arena out again
+  void reset() { mUsed = 0; }
+
+  /// Floats that can still be allocated in one piece
+  size_t available() const { return mCapacity - mUsed; }
+  size_t capacity() const { return mCapacity; }
+
+private:
+  std::unique_ptr<float[]> mStorage;
+  float *mData{nullptr};
+  size_t mCapacity{0};
+  size_t mUsed{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_SCRATCHARENA_HPP
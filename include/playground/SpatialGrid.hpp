@@ -0,0 +1,131 @@
+#ifndef PLAYGROUND_SPATIALGRID_HPP
+#define PLAYGROUND_SPATIALGRID_HPP
+
+// Finding the points within a cutoff radius of each other in 2D without
+// comparing every pair.
+//
+// build() drops the points into square cells one cutoff wide, covering their
+// bounding box, and sorts them by cell (a counting sort, linear in the number
+// of points). Everything within the cutoff of a point is then in its own cell
+// or the eight around it, and because cells are numbered row by row those
+// nine cells are three contiguous runs of the sorted points:
+//
+//   playground::SpatialGrid grid;
+//   grid.build(x, y, n, cutoff);
+//   // gather point data into sorted order with grid.order(), then
+//   grid.forEachNeighborRange(cellOfSortedPoint, [&](int begin, int end) {
+//     for (int j = begin; j < end; j++) { ...sorted point j... }
+//   });
+//
+// Callers are expected to keep their per point data in sorted order while
+// they look for neighbors, so the inner loops read memory front to back.
+// Lookups only read the grid and can run on any number of threads.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace playground {
+
+class SpatialGrid {
+public:
+  /// Cells along either side at most; larger spreads get larger cells
+  static constexpr int kMaxCellsPerSide = 2048;
+
+  /// Sort n points (x[i], y[i]) into cells at least cellSize wide
+  void build(const float *x, const float *y, int n, float cellSize) {
+    mNumPoints = n;
+    float minX = 0.0f, maxX = 0.0f, minY = 0.0f, maxY = 0.0f;
+    if (n > 0) {
+      minX = maxX = x[0];
+      minY = maxY = y[0];
+    }
+    for (int i = 1; i < n; i++) {
+      minX = std::min(minX, x[i]);
+      maxX = std::max(maxX, x[i]);
+      minY = std::min(minY, y[i]);
+      maxY = std::max(maxY, y[i]);
+    }
+    const float extent = std::max(maxX - minX, maxY - minY);
+    const float maxCells = float(kMaxCellsPerSide);
+    mCellSize = std::max(cellSize, extent / maxCells);
+    mInvCellSize = 1.0f / mCellSize;
+    mMinX = minX;
+    mMinY = minY;
+    mWidth = int((maxX - minX) * mInvCellSize) + 1;
+    mHeight = int((maxY - minY) * mInvCellSize) + 1;
+
+    // Counting sort by cell
+    mCellOf.resize(n);
+    mCellStart.assign(size_t(mWidth) * mHeight + 1, 0);
+    for (int i = 0; i < n; i++) {
+      const int c = cellAt(x[i], y[i]);
+      mCellOf[i] = c;
+      mCellStart[c + 1]++;
+    }
+    for (size_t c = 1; c < mCellStart.size(); c++) {
+      mCellStart[c] += mCellStart[c - 1];
+    }
+    mFill.assign(mCellStart.begin(), mCellStart.end() - 1);
+    mOrder.resize(n);
+    mSortedCell.resize(n);
+    for (int i = 0; i < n; i++) {
+      const int slot = mFill[mCellOf[i]]++;
+      mOrder[slot] = i;
+      mSortedCell[slot] = mCellOf[i];
+    }
+  }
+
+  int size() const { return mNumPoints; }
+
+  /// Original index of each sorted point
+  const std::vector<int> &order() const { return mOrder; }
+
+  /// Cell of each sorted point
+  const std::vector<int> &sortedCells() const { return mSortedCell; }
+
+  /// Call f(begin, end) for the three runs of sorted points in cell and the
+  /// cells around it
+  template <typename F> void forEachNeighborRange(int cell, F &&f) const {
+    const int cx = cell % mWidth;
+    const int cy = cell / mWidth;
+    const int x0 = std::max(cx - 1, 0);
+    const int x1 = std::min(cx + 1, mWidth - 1);
+    for (int row = std::max(cy - 1, 0); row <= std::min(cy + 1, mHeight - 1);
+         row++) {
+      const int begin = mCellStart[row * mWidth + x0];
+      const int end = mCellStart[row * mWidth + x1 + 1];
+      if (begin < end) {
+        f(begin, end);
+      }
+    }
+  }
+
+  float cellSize() const { return mCellSize; }
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+
+private:
+  int cellAt(float x, float y) const {
+    const int cx = std::min(int((x - mMinX) * mInvCellSize), mWidth - 1);
+    const int cy = std::min(int((y - mMinY) * mInvCellSize), mHeight - 1);
+    return std::max(cy, 0) * mWidth + std::max(cx, 0);
+  }
+
+  int mNumPoints{0};
+  float mCellSize{1.0f};
+  float mInvCellSize{1.0f};
+  float mMinX{0.0f};
+  float mMinY{0.0f};
+  int mWidth{1};
+  int mHeight{1};
+  std::vector<int> mCellStart; // sorted index of the first point per cell
+  std::vector<int> mFill;
+  std::vector<int> mCellOf;
+  std::vector<int> mOrder;
+  std::vector<int> mSortedCell;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_SPATIALGRID_HPP
@@ -0,0 +1,282 @@
+#ifndef PLAYGROUND_SPRINGMESH_HPP
+#define PLAYGROUND_SPRINGMESH_HPP
+
+// A mesh of damped springs, as in the blob: every vertex is pulled back to
+// its rest position and towards each of its neighbors.
+//
+//   playground::SpringMesh mSprings;
+//   playground::WorkerPool mPool;
+//   ...
+//   mSprings.build(numVertices, restPositions, offsets, neighbors);
+//   mSprings.renumberIndices(mesh.indices().data(), mesh.indices().size());
+//   mSprings.copyPositions(&mesh.vertices()[0][0]);
+//   ...
+//   void onAnimate(double dt) override {
+//     mSprings.step(anchorK, neighborK, damping, &mPool);
+//     mSprings.copyPositions(&mesh.vertices()[0][0], &mPool);
+//   }
+//
+// Neighbors are given in compressed sparse row form: the neighbors of vertex
+// i are neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1].
+//
+// build() renumbers the vertices breadth first (Cuthill-McKee) so that
+// neighbors sit close together in memory. From then on every vertex number
+// going in or out is in the new order; renumberIndices() brings triangle
+// indices along and order() maps back to the original numbering. Copying the
+// positions out is then a straight stream rather than a scatter. Each vertex is kept as
+// four floats so one SSE load fetches a neighbor and one SSE expression
+// integrates a vertex. All positions of a step are computed from the
+// previous step, so blocks of vertices are independent and spread over a
+// WorkerPool.
+//
+// Positions are double buffered: step() writes the back buffer and then
+// publishes it, so position() on another thread (e.g. onSound()) always sees
+// one whole step. All other calls belong to the simulation thread.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define PLAYGROUND_SPRINGMESH_SSE 1
+#endif
+
+#include "playground/WorkerPool.hpp"
+
+namespace playground {
+
+class SpringMesh {
+public:
+  /// Vertices per parallel task
+  static constexpr int kGrain = 4096;
+
+  /// Set up numVertices at rest at positions (x, y, z per vertex) with the
+  /// given neighbors, and no velocity. renumber false keeps the given order,
+  /// for meshes stored in breadthFirstOrder() already.
+  void build(int numVertices, const float *positions, const int *offsets,
+             const int *neighbors, bool renumber = true) {
+    mNumVertices = numVertices;
+    if (renumber) {
+      mOrder = breadthFirstOrder(numVertices, offsets, neighbors);
+    } else {
+      mOrder.resize(numVertices);
+      for (int i = 0; i < numVertices; i++) {
+        mOrder[i] = i;
+      }
+    }
+    mRank.resize(numVertices);
+    for (int i = 0; i < numVertices; i++) {
+      mRank[mOrder[i]] = i;
+    }
+
+    // Neighbor lists in the new numbering
+    mOffsets.assign(1, 0);
+    mNeighbors.clear();
+    for (int i = 0; i < numVertices; i++) {
+      const int old = mOrder[i];
+      for (int k = offsets[old]; k < offsets[old + 1]; k++) {
+        mNeighbors.push_back(mRank[neighbors[k]]);
+      }
+      mOffsets.push_back(int(mNeighbors.size()));
+    }
+
+    mRest.assign(4 * size_t(numVertices), 0.0f);
+    mVelocity.assign(4 * size_t(numVertices), 0.0f);
+    for (int i = 0; i < numVertices; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        mRest[4 * i + axis] = positions[3 * mOrder[i] + axis];
+      }
+    }
+    mPosition[0] = mRest;
+    mPosition[1] = mRest;
+    mFront.store(0, std::memory_order_release);
+  }
+
+  /// Same, with neighbor lists as vectors
+  void build(int numVertices, const float *positions,
+             const std::vector<std::vector<int>> &neighborLists) {
+    std::vector<int> offsets(1, 0);
+    std::vector<int> neighbors;
+    for (int i = 0; i < numVertices; i++) {
+      neighbors.insert(neighbors.end(), neighborLists[i].begin(),
+                       neighborLists[i].end());
+      offsets.push_back(int(neighbors.size()));
+    }
+    build(numVertices, positions, offsets.data(), neighbors.data());
+  }
+
+  int size() const { return mNumVertices; }
+
+  /// Original number of each vertex
+  const std::vector<int> &order() const { return mOrder; }
+
+  /// Replace original vertex numbers in indices by the new ones
+  template <typename Index> void renumberIndices(Index *indices, size_t n) const {
+    for (size_t i = 0; i < n; i++) {
+      indices[i] = Index(mRank[indices[i]]);
+    }
+  }
+
+  /// Advance one step: every vertex is pulled towards its rest position by
+  /// anchorK and towards its neighbors by neighborK, and its velocity is
+  /// damped by damping. Runs on pool if given.
+  void step(float anchorK, float neighborK, float damping,
+            WorkerPool *pool = nullptr) {
+    const int front = mFront.load(std::memory_order_relaxed);
+    auto task = [&](int begin, int end) {
+      stepRange(front, begin, end, anchorK, neighborK, damping);
+    };
+    if (pool) {
+      pool->parallelFor(0, mNumVertices, kGrain, task);
+    } else {
+      task(0, mNumVertices);
+    }
+    mFront.store(1 - front, std::memory_order_release);
+  }
+
+  /// Move a vertex (and nothing else) by (dx, dy, dz)
+  void displace(int vertex, float dx, float dy, float dz) {
+    float *p =
+        mPosition[mFront.load(std::memory_order_relaxed)].data() + 4 * vertex;
+    p[0] += dx;
+    p[1] += dy;
+    p[2] += dz;
+  }
+
+  /// Call f(neighbor) for each neighbor of vertex
+  template <typename F> void forEachNeighbor(int vertex, F &&f) const {
+    for (int k = mOffsets[vertex]; k < mOffsets[vertex + 1]; k++) {
+      f(mNeighbors[k]);
+    }
+  }
+
+  /// Current position of vertex as x, y, z. Safe from any thread.
+  void position(int vertex, float *xyz) const {
+    const float *p =
+        mPosition[mFront.load(std::memory_order_acquire)].data() + 4 * vertex;
+    std::memcpy(xyz, p, 3 * sizeof(float));
+  }
+
+  void restPosition(int vertex, float *xyz) const {
+    std::memcpy(xyz, mRest.data() + 4 * vertex, 3 * sizeof(float));
+  }
+
+  /// Write all positions as x, y, z per vertex
+  void copyPositions(float *xyz, WorkerPool *pool = nullptr) const {
+    const float *p = mPosition[mFront.load(std::memory_order_relaxed)].data();
+    auto task = [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        std::memcpy(xyz + 3 * i, p + 4 * i, 3 * sizeof(float));
+      }
+    };
+    if (pool) {
+      pool->parallelFor(0, mNumVertices, kGrain, task);
+    } else {
+      task(0, mNumVertices);
+    }
+  }
+
+  /// Vertices in breadth first order, starting each connected part from its
+  /// lowest degree vertex: the order build() renumbers to
+  static std::vector<int> breadthFirstOrder(int numVertices, const int *offsets,
+                                            const int *neighbors) {
+    std::vector<int> order;
+    order.reserve(numVertices);
+    std::vector<bool> seen(numVertices, false);
+    std::vector<int> byDegree(numVertices);
+    for (int i = 0; i < numVertices; i++) {
+      byDegree[i] = i;
+    }
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) {
+      return offsets[a + 1] - offsets[a] < offsets[b + 1] - offsets[b];
+    });
+    for (int start : byDegree) {
+      if (seen[start]) {
+        continue;
+      }
+      size_t head = order.size();
+      seen[start] = true;
+      order.push_back(start);
+      while (head < order.size()) {
+        const int v = order[head++];
+        for (int k = offsets[v]; k < offsets[v + 1]; k++) {
+          const int u = neighbors[k];
+          if (!seen[u]) {
+            seen[u] = true;
+            order.push_back(u);
+          }
+        }
+      }
+    }
+    return order;
+  }
+
+private:
+  void stepRange(int front, int begin, int end, float anchorK, float neighborK,
+                 float damping) {
+    const float *p = mPosition[front].data();
+    float *next = mPosition[1 - front].data();
+    const float *rest = mRest.data();
+    float *velocity = mVelocity.data();
+
+    // force = -anchorK (p - rest) - neighborK (degree p - sum of neighbors)
+    //         - damping v
+#if PLAYGROUND_SPRINGMESH_SSE
+    const __m128 a = _mm_set1_ps(anchorK);
+    const __m128 nk = _mm_set1_ps(neighborK);
+    const __m128 d = _mm_set1_ps(damping);
+    for (int i = begin; i < end; i++) {
+      const __m128 x = _mm_loadu_ps(p + 4 * i);
+      __m128 sum = _mm_setzero_ps();
+      for (int k = mOffsets[i]; k < mOffsets[i + 1]; k++) {
+        sum = _mm_add_ps(sum, _mm_loadu_ps(p + 4 * mNeighbors[k]));
+      }
+      const __m128 degree = _mm_set1_ps(float(mOffsets[i + 1] - mOffsets[i]));
+      __m128 v = _mm_loadu_ps(velocity + 4 * i);
+      const __m128 anchor = _mm_mul_ps(a, _mm_sub_ps(x, _mm_loadu_ps(rest + 4 * i)));
+      const __m128 spring = _mm_mul_ps(nk, _mm_sub_ps(_mm_mul_ps(degree, x), sum));
+      v = _mm_sub_ps(_mm_sub_ps(v, _mm_add_ps(anchor, spring)), _mm_mul_ps(d, v));
+      _mm_storeu_ps(velocity + 4 * i, v);
+      _mm_storeu_ps(next + 4 * i, _mm_add_ps(x, v));
+    }
+#else
+    for (int i = begin; i < end; i++) {
+      float sum[3] = {0.0f, 0.0f, 0.0f};
+      for (int k = mOffsets[i]; k < mOffsets[i + 1]; k++) {
+        for (int axis = 0; axis < 3; axis++) {
+          sum[axis] += p[4 * mNeighbors[k] + axis];
+        }
+      }
+      const float degree = float(mOffsets[i + 1] - mOffsets[i]);
+      for (int axis = 0; axis < 3; axis++) {
+        const int j = 4 * i + axis;
+        velocity[j] -= anchorK * (p[j] - rest[j]) +
+                       neighborK * (degree * p[j] - sum[axis]) +
+                       damping * velocity[j];
+        next[j] = p[j] + velocity[j];
+      }
+    }
+#endif
+  }
+
+  // Four floats per vertex: x, y, z, 0
+  typedef std::vector<float> Vectors;
+
+  int mNumVertices{0};
+  std::vector<int> mOrder; // new index -> original vertex
+  std::vector<int> mRank;  // original vertex -> new index
+  std::vector<int> mOffsets;
+  std::vector<int> mNeighbors;
+
+  Vectors mRest;
+  Vectors mVelocity;
+  Vectors mPosition[2]; // front and back buffer
+  std::atomic<int> mFront{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_SPRINGMESH_HPP
@@ -0,0 +1,85 @@
+#ifndef PLAYGROUND_TELEMETRY_HPP
+#define PLAYGROUND_TELEMETRY_HPP
+
+// Getting measurements out of the audio callback without printing there.
+//
+// Writing to std::cout, allocating or taking a lock in onSound() can block
+// the audio thread long enough to drop out. A TelemetryChannel carries fixed
+// size records from the audio thread to one reader instead:
+//
+//   struct Levels { float peak; float gain; };
+//   playground::TelemetryChannel<Levels> mLevels;
+//
+//   // Audio thread: never blocks, drops the record if the reader is behind
+//   mLevels.publish({peak, gain});
+//
+//   // GUI or logging thread: aggregate whatever arrived since last frame
+//   float peak = 0;
+//   mLevels.drain([&](const Levels &l) { peak = std::max(peak, l.peak); });
+//
+// The ring has one writer and one reader. Records are copied in and out, so
+// they must be trivially copyable. Records that did not fit are counted in
+// dropped() rather than blocking the writer.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace playground {
+
+template <typename Record> class TelemetryChannel {
+  static_assert(std::is_trivially_copyable<Record>::value,
+                "telemetry records are copied between threads");
+
+public:
+  /// capacity is in records; a few seconds of blocks is plenty for a reader
+  /// running at the frame rate
+  explicit TelemetryChannel(size_t capacity = 256) : mRecords(capacity) {}
+
+  /// Writer side. Wait-free; returns false if the ring was full.
+  bool publish(const Record &record) {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    const size_t head = mHead.load(std::memory_order_acquire);
+    if (tail - head >= mRecords.size()) {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    mRecords[tail % mRecords.size()] = record;
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Reader side. Calls f(record) for every record published since the last
+  /// drain, oldest first, and returns how many there were.
+  template <typename F> size_t drain(F &&f) {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    const size_t tail = mTail.load(std::memory_order_acquire);
+    for (size_t i = head; i != tail; i++) {
+      f(static_cast<const Record &>(mRecords[i % mRecords.size()]));
+    }
+    mHead.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  /// Reader side. Drains the channel into the newest record. Returns false,
+  /// leaving record untouched, if nothing was published.
+  bool latest(Record &record) {
+    return drain([&](const Record &r) { record = r; }) > 0;
+  }
+
+  /// Records lost because the reader fell behind
+  uint64_t dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+  std::vector<Record> mRecords;
+  std::atomic<size_t> mHead{0}; // next record to read
+  char mPad[64];                // keep reader and writer off one cache line
+  std::atomic<size_t> mTail{0}; // next record to write
+  std::atomic<uint64_t> mDropped{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_TELEMETRY_HPP
@@ -0,0 +1,390 @@
+#ifndef PLAYGROUND_TRACERECORDER_HPP
+#define PLAYGROUND_TRACERECORDER_HPP
+
+// One timeline for the audio, graphics, sequencer and network threads.
+//
+// A hitch in a distributed piece can come from the audio callback, a slow
+// onDraw(), a preset step or a late state packet, and each of them runs on a
+// thread of its own. The TraceRecorder collects timed zones from all of them
+// and writes a Chrome trace event file, which chrome://tracing or
+// https://ui.perfetto.dev shows as one timeline per thread:
+//
+//   playground::TraceRecorder::get().start("trace.json"); // e.g. in main()
+//   ...
+//   void onSound(AudioIOData &io) override {
+//     PLAYGROUND_TRACE_THREAD("audio"); // names this thread's timeline
+//     PLAYGROUND_TRACE_ZONE("onSound"); // timed until the end of the scope
+//     ...
+//   }
+//   void onAnimate(double dt) override {
+//     PLAYGROUND_TRACE_THREAD("graphics");
+//     if (stateChanged) PLAYGROUND_TRACE_INSTANT("state received");
+//     PLAYGROUND_TRACE_COUNTER("voices", numVoices);
+//     ...
+//   }
+//   ...
+//   playground::TraceRecorder::get().stop(); // or let it stop at exit
+//
+// Zones append to a ring of the calling thread: two reads of the steady
+// clock and no locks or allocation, so the audio thread can be traced. A
+// writer thread drains the rings every 20 ms and appends the events to the
+// file. While nothing is recording, a macro costs one atomic load, so the
+// zones are meant to stay in release builds; define PLAYGROUND_NO_TRACE to
+// remove them anyway.
+//
+// Names must be string literals (or otherwise outlive the recorder). Events
+// that do not fit in a thread's ring before the writer comes by are counted
+// and reported by stop().
+//
+// A thread takes a ring the first time it records and hands it back when it
+// exits, so threads that come and go (PresetSequencer starts one for every
+// playSequence()) do not use up the rings. Once the writer has drained it, a
+// returned ring goes to the next thread that records, on a timeline of its
+// own.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "playground/Telemetry.hpp"
+
+namespace playground {
+
+class TraceRecorder {
+public:
+  /// Threads that can record at once; further threads are not traced
+  static constexpr int kMaxThreads = 64;
+  /// Events per thread between drains
+  static constexpr int kRingSize = 4096;
+
+  /// The recorder shared by every zone
+  static TraceRecorder &get() {
+    static TraceRecorder recorder;
+    return recorder;
+  }
+
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  ~TraceRecorder() { stop(); }
+
+  /// Start recording into a new file at path. The first start allocates
+  /// the rings, so make it before the audio starts. Returns false if the
+  /// file could not be opened or a recording is already running.
+  bool start(const std::string &path) {
+    std::lock_guard<std::mutex> control(mControl);
+    if (mWriter.joinable()) {
+      return false;
+    }
+    mFile = fopen(path.c_str(), "w");
+    if (!mFile) {
+      return false;
+    }
+    mPath = path;
+    if (!mRings[0]) {
+      for (auto &ring : mRings) {
+        ring.reset(new Ring);
+      }
+    }
+    for (auto &ring : mRings) {
+      ring->events.drain([](const Event &) {}); // left over from a stop()
+      ring->written = nullptr;
+      if (ring->state.load(std::memory_order_acquire) == RETURNED) {
+        release(*ring);
+      }
+    }
+    mDroppedBefore = dropped();
+    mWritten = 0;
+    mStart = now();
+    fprintf(mFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(mFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"args\":{\"name\":\"%s\"}}",
+            escape(path).c_str());
+    mRunning = true;
+    mRecording.store(true, std::memory_order_release);
+    mWriter = std::thread([this]() { writerLoop(); });
+    return true;
+  }
+
+  /// Write what is left, close the file and print a summary
+  void stop() {
+    std::lock_guard<std::mutex> control(mControl);
+    if (!mWriter.joinable()) {
+      return;
+    }
+    mRecording.store(false, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mRunning = false;
+    }
+    mWake.notify_all();
+    mWriter.join();
+    fprintf(mFile, "\n]}\n");
+    fclose(mFile);
+    mFile = nullptr;
+    printf("trace: %llu events written to %s (%llu dropped)\n",
+           (unsigned long long)mWritten, mPath.c_str(),
+           (unsigned long long)(dropped() - mDroppedBefore));
+  }
+
+  bool recording() const { return mRecording.load(std::memory_order_acquire); }
+
+  /// Nanoseconds of the steady clock
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /// Name the calling thread's timeline. Cheap enough to call at the top of
+  /// every callback; works whether or not a recording is running.
+  void nameThread(const char *name) {
+    Slot &slot = threadSlot();
+    if (slot.name != name) {
+      slot.name = name;
+      if (slot.ring) {
+        slot.ring->name.store(name, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  enum Type : uint32_t { ZONE, INSTANT, COUNTER };
+
+  /// Add an event of the calling thread. Wait-free; only call while
+  /// recording(). value is the duration of a ZONE in nanoseconds, or the
+  /// value of a COUNTER.
+  void record(Type type, const char *name, int64_t time, double value) {
+    Slot &slot = threadSlot();
+    if (!slot.ring && !(slot.ring = claim())) {
+      return; // all rings taken
+    }
+    slot.ring->events.publish({name, time, value, type});
+  }
+
+  /// Times the enclosing scope
+  class Zone {
+  public:
+    explicit Zone(const char *name)
+        : mName(name), mStart(get().recording() ? now() : 0) {}
+    ~Zone() {
+      if (mStart && get().recording()) {
+        get().record(ZONE, mName, mStart, double(now() - mStart));
+      }
+    }
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+  private:
+    const char *mName;
+    int64_t mStart;
+  };
+
+private:
+  struct Event {
+    const char *name;
+    int64_t time;
+    double value;
+    Type type;
+  };
+
+  /// Who a ring belongs to
+  enum State : int { FREE, TAKEN, RETURNED };
+
+  struct Ring {
+    TelemetryChannel<Event> events{kRingSize};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<int> state{FREE};
+    const char *written{nullptr}; // writer only: name last written
+    int generation{0};            // writer only: threads that had the ring
+  };
+
+  /// The calling thread's ring, handed back when the thread exits
+  struct Slot {
+    Ring *ring{nullptr};
+    const char *name{nullptr};
+    ~Slot() {
+      if (ring) {
+        ring->state.store(RETURNED, std::memory_order_release);
+      }
+    }
+  };
+
+  TraceRecorder() = default;
+
+  static Slot &threadSlot() {
+    static thread_local Slot slot;
+    return slot;
+  }
+
+  /// A free ring for the calling thread, or nullptr if all are taken.
+  /// Lock-free: at most one pass over the rings.
+  Ring *claim() {
+    Slot &slot = threadSlot();
+    for (auto &ring : mRings) {
+      int expected = FREE;
+      if (ring && ring->state.load(std::memory_order_relaxed) == FREE &&
+          ring->state.compare_exchange_strong(expected, TAKEN,
+                                              std::memory_order_acquire)) {
+        ring->name.store(slot.name, std::memory_order_relaxed);
+        return ring.get();
+      }
+    }
+    return nullptr;
+  }
+
+  /// Make a drained ring of an exited thread free for the next one
+  static void release(Ring &ring) {
+    ring.name.store(nullptr, std::memory_order_relaxed);
+    ring.written = nullptr;
+    ring.generation++;
+    ring.state.store(FREE, std::memory_order_release);
+  }
+
+  static std::string escape(const std::string &s) {
+    std::string escaped;
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+        escaped += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        escaped += ' ';
+      } else {
+        escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  uint64_t dropped() const {
+    uint64_t dropped = 0;
+    for (const auto &ring : mRings) {
+      if (ring) {
+        dropped += ring->events.dropped();
+      }
+    }
+    return dropped;
+  }
+
+  void writerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (mRunning) {
+      lock.unlock();
+      write();
+      lock.lock();
+      mWake.wait_for(lock, std::chrono::milliseconds(20),
+                     [this]() { return !mRunning; });
+    }
+    lock.unlock();
+    write(); // what arrived before stop()
+  }
+
+  void write() {
+    for (int t = 0; t < kMaxThreads; t++) {
+      Ring &ring = *mRings[t];
+      // Read before draining: a returned ring has all its events published
+      const int state = ring.state.load(std::memory_order_acquire);
+      if (state == FREE) {
+        continue;
+      }
+      const int tid = ring.generation * kMaxThreads + t + 1;
+      const char *name = ring.name.load(std::memory_order_relaxed);
+      if (name && name != ring.written) {
+        fprintf(mFile,
+                ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                tid, escape(name).c_str());
+        ring.written = name;
+      }
+      mWritten += ring.events.drain([&](const Event &e) {
+        const double ts = double(e.time - mStart) * 1e-3; // microseconds
+        const std::string eventName = escape(e.name);
+        switch (e.type) {
+        case ZONE:
+          fprintf(mFile,
+                  ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                  "\"ts\":%.3f,\"dur\":%.3f}",
+                  eventName.c_str(), tid, ts, e.value * 1e-3);
+          break;
+        case INSTANT:
+          fprintf(mFile,
+                  ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+                  "\"tid\":%d,\"ts\":%.3f}",
+                  eventName.c_str(), tid, ts);
+          break;
+        case COUNTER:
+          fprintf(mFile,
+                  ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,"
+                  "\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                  eventName.c_str(), tid, ts, e.value);
+          break;
+        }
+      });
+      if (state == RETURNED) {
+        release(ring);
+      }
+    }
+    fflush(mFile);
+  }
+
+  std::atomic<bool> mRecording{false};
+  std::unique_ptr<Ring> mRings[kMaxThreads];
+
+  std::mutex mControl; // start() and stop()
+  std::mutex mLock;    // mRunning
+  std::condition_variable mWake;
+  bool mRunning{false};
+  std::thread mWriter;
+
+  // Writer thread while recording
+  FILE *mFile{nullptr};
+  std::string mPath;
+  int64_t mStart{0};
+  uint64_t mWritten{0};
+  uint64_t mDroppedBefore{0};
+};
+
+} // namespace playground
+
+#if defined(PLAYGROUND_NO_TRACE)
+
+#define PLAYGROUND_TRACE_THREAD(name) (void)0
+#define PLAYGROUND_TRACE_ZONE(name) (void)0
+#define PLAYGROUND_TRACE_INSTANT(name) (void)0
+#define PLAYGROUND_TRACE_COUNTER(name, value) (void)0
+
+#else
+
+#define PLAYGROUND_TRACE_CONCAT_(a, b) a##b
+#define PLAYGROUND_TRACE_CONCAT(a, b) PLAYGROUND_TRACE_CONCAT_(a, b)
+#define PLAYGROUND_TRACE_THREAD(name)                                          \
+  ::playground::TraceRecorder::get().nameThread(name)
+#define PLAYGROUND_TRACE_ZONE(name)                                            \
+  ::playground::TraceRecorder::Zone PLAYGROUND_TRACE_CONCAT(                   \
+      playgroundTraceZone, __LINE__)(name)
+#define PLAYGROUND_TRACE_INSTANT(name)                                         \
+  do {                                                                         \
+    auto &playgroundTrace = ::playground::TraceRecorder::get();                \
+    if (playgroundTrace.recording()) {                                         \
+      playgroundTrace.record(::playground::TraceRecorder::INSTANT, name,       \
+                             ::playground::TraceRecorder::now(), 0.0);         \
+    }                                                                          \
+  } while (0)
+#define PLAYGROUND_TRACE_COUNTER(name, value)                                  \
+  do {                                                                         \
+    auto &playgroundTrace = ::playground::TraceRecorder::get();                \
+    if (playgroundTrace.recording()) {                                         \
+      playgroundTrace.record(::playground::TraceRecorder::COUNTER, name,       \
+                             ::playground::TraceRecorder::now(),               \
+                             double(value));                                   \
+    }                                                                          \
+  } while (0)
+
+#endif // PLAYGROUND_NO_TRACE
+
+#endif // PLAYGROUND_TRACERECORDER_HPP
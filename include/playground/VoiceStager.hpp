@@ -0,0 +1,219 @@
+#ifndef PLAYGROUND_VOICESTAGER_HPP
+#define PLAYGROUND_VOICESTAGER_HPP
+
+// Preparing voices ahead of their notes, off the audio thread.
+//
+// PolySynth calls onTriggerOn() on the audio thread, so a voice that sizes
+// buffers, clears delay lines or opens files there does it in the middle of
+// a callback. A PreparedVoice moves that work into onPrepare() and keeps
+// only the cheap part (envelope resets) in onTriggerOn():
+//
+//   struct Bell : public SynthVoice, public playground::PreparedVoice {
+//     void onPrepare() override { modes.resize(n); ... } // off audio thread
+//     void onTriggerOn() override {
+//       ensurePrepared(); // runs onPrepare() here if nobody did beforehand
+//       env.reset();
+//     }
+//   };
+//
+// A VoiceStager holds scheduled notes until they come within lookahead() of
+// the playhead, prepares their voices on a thread of its own and hands them
+// to an EventQueue, whose dispatch() then starts them at their frame:
+//
+//   playground::EventQueue mEvents;
+//   playground::VoiceStager mStager{mEvents};
+//   ...
+//   mStager.startThread();
+//   auto *voice = synth.getVoice<Bell>();  // any thread but the audio one
+//   voice->setTriggerParams(params);
+//   mStager.addVoiceFromNow(voice, time, duration);
+//   ...
+//   void onSound(AudioIOData &io) override {
+//     mEvents.dispatch(synth, io);
+//     synth.render(io);
+//   }
+//
+// Voices triggered any other way (a SynthSequencer, SynthGUIManager) still
+// work, as ensurePrepared() then prepares them on the audio thread as before.
+// prepareVoice() prepares a voice right away, e.g. on the UI thread just
+// before PolySynth::triggerOn().
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "al/scene/al_PolySynth.hpp"
+
+#include "playground/EventQueue.hpp"
+
+namespace playground {
+
+/// Mixin for voices with set up that should not run on the audio thread
+class PreparedVoice {
+public:
+  virtual ~PreparedVoice() {}
+
+  /// Set up for the next note. Runs after the trigger parameters are set,
+  /// off the audio thread when the voice is staged.
+  virtual void onPrepare() = 0;
+
+  void prepare() {
+    onPrepare();
+    mPrepared = true;
+  }
+
+protected:
+  /// Call first in onTriggerOn(): prepares the voice now unless that was
+  /// done beforehand
+  void ensurePrepared() {
+    if (!mPrepared) {
+      onPrepare();
+    }
+    mPrepared = false;
+  }
+
+private:
+  bool mPrepared{false};
+};
+
+/// Prepare voice if it is a PreparedVoice. Not for the audio thread.
+inline void prepareVoice(al::SynthVoice *voice) {
+  if (auto *prepared = dynamic_cast<PreparedVoice *>(voice)) {
+    prepared->prepare();
+  }
+}
+
+class VoiceStager {
+public:
+  explicit VoiceStager(EventQueue &queue)
+      : mQueue(queue), mEvents(queue.producer()) {}
+
+  ~VoiceStager() { stopThread(); }
+
+  VoiceStager(const VoiceStager &) = delete;
+  VoiceStager &operator=(const VoiceStager &) = delete;
+
+  /// Seconds ahead of the playhead that voices are prepared and queued
+  void lookahead(double seconds) { mLookahead = std::max(seconds, 0.0); }
+  double lookahead() const { return mLookahead; }
+
+  /// Stage voice, with its trigger parameters set, to start time seconds
+  /// from now and stop duration seconds later (0 to wait for a note off).
+  /// Safe to call from any thread but the audio thread.
+  void addVoiceFromNow(al::SynthVoice *voice, double time, double duration) {
+    addVoice(voice, mQueue.nowFrames() + mQueue.seconds(time),
+             mQueue.seconds(duration));
+  }
+
+  /// Stage voice to start at the absolute stream frame
+  void addVoice(al::SynthVoice *voice, uint64_t frame, uint64_t duration) {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mPending.push_back({frame, duration, voice, mOrder++});
+      std::push_heap(mPending.begin(), mPending.end(), Later());
+    }
+    mWake.notify_one();
+  }
+
+  /// Notes staged but not yet handed to the queue
+  size_t pending() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mPending.size();
+  }
+
+  /// Voices prepared so far
+  uint64_t prepared() const { return mPrepared.load(std::memory_order_relaxed); }
+
+  /// Prepare and queue the notes due within lookahead(). Call from one
+  /// thread at a time, not the audio thread; startThread() does it for you.
+  void update() {
+    if (!mEvents.valid()) {
+      return;
+    }
+    const uint64_t horizon =
+        mQueue.nowFrames() + mQueue.seconds(mLookahead.load());
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      size_t room = mEvents.available();
+      while (!mPending.empty() && room > 0 &&
+             mPending.front().frame <= horizon) {
+        std::pop_heap(mPending.begin(), mPending.end(), Later());
+        mDue.push_back(mPending.back());
+        mPending.pop_back();
+        room--;
+      }
+    }
+    // Outside the lock, so slow preparation does not hold up addVoice().
+    // noteOn() cannot fail: no more notes were taken than the ring had room.
+    for (const Note &note : mDue) {
+      prepareVoice(note.voice);
+      mPrepared.fetch_add(1, std::memory_order_relaxed);
+      mEvents.noteOn(note.voice, note.frame, note.duration);
+    }
+    mDue.clear();
+  }
+
+  /// Call update() on a thread of our own every intervalMs, and as soon as
+  /// a note is added
+  void startThread(int intervalMs = 5) {
+    stopThread();
+    mRunning = true;
+    mThread = std::thread([this, intervalMs]() {
+      std::unique_lock<std::mutex> lock(mLock);
+      while (mRunning) {
+        const uint64_t order = mOrder;
+        lock.unlock();
+        update();
+        lock.lock();
+        mWake.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                       [&]() { return !mRunning || mOrder != order; });
+      }
+    });
+  }
+
+  void stopThread() {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mRunning = false;
+    }
+    mWake.notify_all();
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+  }
+
+private:
+  struct Note {
+    uint64_t frame;
+    uint64_t duration;
+    al::SynthVoice *voice;
+    uint64_t order; // keeps notes with the same frame in the order added
+  };
+  struct Later {
+    bool operator()(const Note &a, const Note &b) const {
+      return a.frame != b.frame ? a.frame > b.frame : a.order > b.order;
+    }
+  };
+
+  EventQueue &mQueue;
+  EventQueue::Producer mEvents; // used by update() only
+  std::atomic<double> mLookahead{0.1};
+  std::atomic<uint64_t> mPrepared{0};
+
+  std::mutex mLock; // never taken by the audio thread
+  std::condition_variable mWake;
+  std::vector<Note> mPending; // min-heap on frame
+  std::vector<Note> mDue;     // update() only
+  uint64_t mOrder{0};
+  bool mRunning{false};
+  std::thread mThread;
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_VOICESTAGER_HPP
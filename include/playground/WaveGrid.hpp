@@ -0,0 +1,278 @@
+#ifndef PLAYGROUND_WAVEGRID_HPP
+#define PLAYGROUND_WAVEGRID_HPP
+
+// The 2D wave equation on a toroidal grid, stepped a row band per thread.
+//
+//   u(t+1) = 2u(t) - u(t-1) + v^2 [u(x+1) + u(x-1) + u(y+1) + u(y-1) - 4u(t)]
+//
+// The two time steps are kept as separate planes, each with a halo: one
+// extra column on either side and one extra row above and below, refreshed
+// from the opposite edge before every step. The update then reads its five
+// neighbors at fixed offsets, with no wraparound tests, and runs through each
+// row eight (AVX, when the compiler targets it) or four (SSE) cells at a
+// time.
+//
+//   playground::WaveGrid mWave;
+//   playground::WorkerPool mPool;
+//   ...
+//   mWave.resize(1024, 1024);
+//   mWave.add(x, y, 0.5f);                  // disturb both time steps
+//   ...
+//   playground::WaveGrid::Surface surface;  // optional
+//   surface.positions = &mesh.vertices()[0][0];
+//   surface.normals = &mesh.normals()[0][0];
+//   surface.dx = surface.dy = 2.0f / (1024 - 1);
+//   mWave.step(velocity, decay, &surface, &mPool);
+//
+// With a Surface, the same pass writes the heights (the z of x, y, z
+// vertices laid out row by row) and the surface normals from central
+// differences, so the mesh needs no generateNormals(). They show the field
+// the step started from, i.e. the result of the previous step.
+//
+// Values are multiplied by decay as they are stored; heights written to the
+// surface are the undecayed values.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PLAYGROUND_WAVEGRID_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define PLAYGROUND_WAVEGRID_SSE 1
+#endif
+
+#include "playground/BufferOps.hpp"
+#include "playground/WorkerPool.hpp"
+
+namespace playground {
+
+class WaveGrid {
+public:
+  static constexpr int kMaxSize = 4096;
+
+  /// Where step() writes the surface. positions and normals hold x, y, z per
+  /// cell, row by row; only the z of positions is written.
+  struct Surface {
+    float *positions{nullptr};
+    float *normals{nullptr};
+    float dx{1.0f}; ///< distance between columns
+    float dy{1.0f}; ///< distance between rows
+  };
+
+  WaveGrid() = default;
+  WaveGrid(int nx, int ny) { resize(nx, ny); }
+
+  /// Set the grid size (up to kMaxSize either way) and clear it
+  void resize(int nx, int ny) {
+    mNx = std::max(1, std::min(nx, int(kMaxSize)));
+    mNy = std::max(1, std::min(ny, int(kMaxSize)));
+    mStride = mNx + 2;
+    for (auto &plane : mPlanes) {
+      plane.assign(size_t(mStride) * (mNy + 2), 0.0f);
+    }
+    mCurrent = 0;
+  }
+
+  int width() const { return mNx; }
+  int height() const { return mNy; }
+
+  /// Add v at cell (x, y) to both time steps, so it starts out at rest
+  void add(int x, int y, float v) {
+    cell(mCurrent, x, y) += v;
+    cell(1 - mCurrent, x, y) += v;
+  }
+
+  /// Value of cell (x, y) as of the last step
+  float value(int x, int y) const {
+    return mPlanes[mCurrent][index(x, y)];
+  }
+
+  /// Advance one time step. velocity is in (0, 0.5], decay in (0, 1].
+  void step(float velocity, float decay, const Surface *surface = nullptr,
+            WorkerPool *pool = nullptr) {
+    wrapHalo(mPlanes[mCurrent]);
+    const int grain = std::max(1, 32768 / mNx); // rows per task
+    auto band = [&](int begin, int end) {
+      for (int y = begin; y < end; y++) {
+        stepRow(y, velocity, decay, surface);
+      }
+    };
+    if (pool) {
+      pool->parallelFor(0, mNy, grain, band);
+    } else {
+      band(0, mNy);
+    }
+    mCurrent = 1 - mCurrent;
+  }
+
+private:
+  size_t index(int x, int y) const {
+    return size_t(y + 1) * mStride + (x + 1);
+  }
+  float &cell(int plane, int x, int y) { return mPlanes[plane][index(x, y)]; }
+
+  // Copy the edges into the halo on the opposite side
+  void wrapHalo(std::vector<float> &plane) {
+    float *p = plane.data();
+    std::memcpy(p + index(0, -1), p + index(0, mNy - 1), mNx * sizeof(float));
+    std::memcpy(p + index(0, mNy), p + index(0, 0), mNx * sizeof(float));
+    for (int y = 0; y < mNy; y++) {
+      p[index(-1, y)] = p[index(mNx - 1, y)];
+      p[index(mNx, y)] = p[index(0, y)];
+    }
+  }
+
+  void stepRow(int y, float velocity, float decay, const Surface *surface) {
+    const float *c = mPlanes[mCurrent].data() + index(0, y);
+    const float *n = c - mStride; // row y - 1
+    const float *s = c + mStride; // row y + 1
+    float *p = mPlanes[1 - mCurrent].data() + index(0, y);
+
+    // next = (2 - 4v) c - p + v (left + right + up + down)
+    const float center = 2.0f - 4.0f * velocity;
+    const float invDecay = 1.0f / decay;
+    // Surface gradient from central differences of the undecayed field
+    float gx = 0.0f, gy = 0.0f;
+    float *positions = nullptr;
+    float *normals = nullptr;
+    if (surface) {
+      gx = invDecay / (2.0f * surface->dx);
+      gy = invDecay / (2.0f * surface->dy);
+      positions = surface->positions + size_t(3) * mNx * y;
+      normals = surface->normals + size_t(3) * mNx * y;
+    }
+
+    int x = 0;
+#if PLAYGROUND_WAVEGRID_AVX
+    {
+      const __m256 vCenter = _mm256_set1_ps(center);
+      const __m256 vVelocity = _mm256_set1_ps(velocity);
+      const __m256 vDecay = _mm256_set1_ps(decay);
+      const __m256 vGx = _mm256_set1_ps(gx);
+      const __m256 vGy = _mm256_set1_ps(gy);
+      const __m256 vInvDecay = _mm256_set1_ps(invDecay);
+      for (; x + 8 <= mNx; x += 8) {
+        const __m256 vc = _mm256_loadu_ps(c + x);
+        const __m256 vl = _mm256_loadu_ps(c + x - 1);
+        const __m256 vr = _mm256_loadu_ps(c + x + 1);
+        const __m256 vn = _mm256_loadu_ps(n + x);
+        const __m256 vs = _mm256_loadu_ps(s + x);
+        const __m256 neighbors =
+            _mm256_add_ps(_mm256_add_ps(vl, vr), _mm256_add_ps(vn, vs));
+        const __m256 next = _mm256_add_ps(
+            _mm256_sub_ps(_mm256_mul_ps(vCenter, vc), _mm256_loadu_ps(p + x)),
+            _mm256_mul_ps(vVelocity, neighbors));
+        _mm256_storeu_ps(p + x, _mm256_mul_ps(next, vDecay));
+        if (surface) {
+          const __m256 fx = _mm256_mul_ps(vGx, _mm256_sub_ps(vr, vl));
+          const __m256 fy = _mm256_mul_ps(vGy, _mm256_sub_ps(vs, vn));
+          const __m256 length2 = _mm256_add_ps(
+              _mm256_add_ps(_mm256_mul_ps(fx, fx), _mm256_mul_ps(fy, fy)),
+              _mm256_set1_ps(1.0f));
+          const __m256 nz = rsqrt(length2);
+          const __m256 nx = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(fx, nz));
+          const __m256 ny = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(fy, nz));
+          buffer::storeXyz(normals + 3 * x, _mm256_castps256_ps128(nx),
+                           _mm256_castps256_ps128(ny),
+                           _mm256_castps256_ps128(nz));
+          buffer::storeXyz(normals + 3 * x + 12, _mm256_extractf128_ps(nx, 1),
+                           _mm256_extractf128_ps(ny, 1),
+                           _mm256_extractf128_ps(nz, 1));
+          alignas(32) float heights[8];
+          _mm256_store_ps(heights, _mm256_mul_ps(vc, vInvDecay));
+          for (int k = 0; k < 8; k++) {
+            positions[3 * (x + k) + 2] = heights[k];
+          }
+        }
+      }
+    }
+#endif
+#if PLAYGROUND_WAVEGRID_SSE
+    {
+      const __m128 vCenter = _mm_set1_ps(center);
+      const __m128 vVelocity = _mm_set1_ps(velocity);
+      const __m128 vDecay = _mm_set1_ps(decay);
+      const __m128 vGx = _mm_set1_ps(gx);
+      const __m128 vGy = _mm_set1_ps(gy);
+      const __m128 vInvDecay = _mm_set1_ps(invDecay);
+      for (; x + 4 <= mNx; x += 4) {
+        const __m128 vc = _mm_loadu_ps(c + x);
+        const __m128 vl = _mm_loadu_ps(c + x - 1);
+        const __m128 vr = _mm_loadu_ps(c + x + 1);
+        const __m128 vn = _mm_loadu_ps(n + x);
+        const __m128 vs = _mm_loadu_ps(s + x);
+        const __m128 neighbors =
+            _mm_add_ps(_mm_add_ps(vl, vr), _mm_add_ps(vn, vs));
+        const __m128 next =
+            _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vCenter, vc), _mm_loadu_ps(p + x)),
+                       _mm_mul_ps(vVelocity, neighbors));
+        _mm_storeu_ps(p + x, _mm_mul_ps(next, vDecay));
+        if (surface) {
+          const __m128 fx = _mm_mul_ps(vGx, _mm_sub_ps(vr, vl));
+          const __m128 fy = _mm_mul_ps(vGy, _mm_sub_ps(vs, vn));
+          const __m128 length2 =
+              _mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)),
+                         _mm_set1_ps(1.0f));
+          const __m128 nz = rsqrt(length2);
+          buffer::storeXyz(normals + 3 * x,
+                           _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(fx, nz)),
+                           _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(fy, nz)), nz);
+          alignas(16) float heights[4];
+          _mm_store_ps(heights, _mm_mul_ps(vc, vInvDecay));
+          for (int k = 0; k < 4; k++) {
+            positions[3 * (x + k) + 2] = heights[k];
+          }
+        }
+      }
+    }
+#endif
+    for (; x < mNx; x++) {
+      const float next =
+          center * c[x] - p[x] + velocity * ((c[x - 1] + c[x + 1]) + (n[x] + s[x]));
+      p[x] = next * decay;
+      if (surface) {
+        const float fx = gx * (c[x + 1] - c[x - 1]);
+        const float fy = gy * (s[x] - n[x]);
+        const float nz = 1.0f / std::sqrt(fx * fx + fy * fy + 1.0f);
+        positions[3 * x + 2] = c[x] * invDecay;
+        normals[3 * x] = -fx * nz;
+        normals[3 * x + 1] = -fy * nz;
+        normals[3 * x + 2] = nz;
+      }
+    }
+  }
+
+  // 1 / sqrt(x) to about 22 bits: the hardware estimate and a Newton step
+#if PLAYGROUND_WAVEGRID_AVX
+  static __m256 rsqrt(__m256 x) {
+    const __m256 y = _mm256_rsqrt_ps(x);
+    return _mm256_mul_ps(
+        _mm256_mul_ps(_mm256_set1_ps(0.5f), y),
+        _mm256_sub_ps(_mm256_set1_ps(3.0f),
+                      _mm256_mul_ps(_mm256_mul_ps(x, y), y)));
+  }
+#endif
+#if PLAYGROUND_WAVEGRID_SSE
+  static __m128 rsqrt(__m128 x) {
+    const __m128 y = _mm_rsqrt_ps(x);
+    return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y),
+                      _mm_sub_ps(_mm_set1_ps(3.0f),
+                                 _mm_mul_ps(_mm_mul_ps(x, y), y)));
+  }
+#endif
+
+  int mNx{0};
+  int mNy{0};
+  int mStride{0};
+  std::vector<float> mPlanes[2];
+  int mCurrent{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_WAVEGRID_HPP
@@ -0,0 +1,212 @@
+#ifndef PLAYGROUND_WAVETABLEBANK_HPP
+#define PLAYGROUND_WAVETABLEBANK_HPP
+
+// The oscillator tables of the instrument library, built once per process
+// and shared by every voice.
+//
+// Voices used to fill global gam::ArrayPow2 tables with gam::addSines() in
+// init(), once per voice allocated, so allocating polyphony repeated the
+// work and, as the sines were added to what was already there, left tables
+// louder with every voice. The bank builds each table on first use and
+// voices only point their oscillators at it:
+//
+//   using playground::WavetableBank;
+//   ...
+//   void onTriggerOn() override {
+//     mOsc.freq(frequency);
+//     mOsc.source(WavetableBank::get().table(WavetableBank::SAW, frequency,
+//                                            gam::sampleRate()));
+//   }
+//
+// Each table is kept at one band limit per partial: level L keeps the
+// lowest L + 1 partials of its recipe. table(which, frequency, sampleRate)
+// picks the level that keeps every partial below the Nyquist frequency for
+// that fundamental, so high notes do not alias, and never fewer than the
+// lowest partial, so no note is silent. table(which) is the table with all
+// partials.
+//
+// The partials of each table are constants computed at compile time; only
+// the summing of sines into samples happens at run time, once.
+
+#include <algorithm>
+#include <cmath>
+
+#include "Gamma/Containers.h"
+
+namespace playground {
+
+class WavetableBank {
+public:
+  /// Tables in the order of the instruments' "table" parameter
+  enum Table {
+    SAW,        ///< 9 harmonics at 1/n
+    SQUARE,     ///< 9 odd harmonics at 1/n
+    IMPULSE,    ///< 9 harmonics at 1
+    SINE,       ///< fundamental only
+    PULSE,      ///< 8 harmonics, rolled off from the 5th
+    PARTIALS_1, ///< harmonics 1 to 18, sparse
+    PARTIALS_2, ///< harmonics 3 to 16 in close pairs
+    PARTIALS_3, ///< harmonics 10 to 135, spaced by 27
+    PARTIALS_4, ///< harmonics 1 to 141, spaced by 20
+    NUM_TABLES
+  };
+
+  /// Samples per table
+  static constexpr int kSize = 2048;
+  static constexpr int kMaxPartials = 9;
+  /// Band limits per table at most, one per partial
+  static constexpr int kLevels = kMaxPartials;
+
+  struct Partial {
+    int harmonic = 0;
+    float amplitude = 0.0f;
+  };
+
+  /// Partials in rising order of harmonic
+  struct Recipe {
+    int numPartials = 0;
+    Partial partials[kMaxPartials];
+  };
+
+  /// The bank, built by the first caller; safe to call from any thread
+  static WavetableBank &get() {
+    static WavetableBank bank;
+    return bank;
+  }
+
+  /// Table with all partials. which is clamped to a valid Table.
+  gam::ArrayPow2<float> &table(int which) {
+    which = clampTable(which);
+    return mTables[which][recipe(which).numPartials - 1];
+  }
+
+  /// Table band limited for a fundamental of frequency Hz at sampleRate.
+  /// which is clamped to a valid Table.
+  gam::ArrayPow2<float> &table(int which, double frequency, double sampleRate) {
+    which = clampTable(which);
+    return mTables[which][level(which, frequency, sampleRate)];
+  }
+
+  /// Level of table which that keeps the partials below sampleRate / 2 at
+  /// frequency, and at least the lowest partial
+  static int level(int which, double frequency, double sampleRate) {
+    const Recipe &r = recipe(clampTable(which));
+    if (!(frequency > 0)) {
+      return r.numPartials - 1;
+    }
+    const double maxHarmonic = 0.5 * sampleRate / frequency;
+    int level = 0;
+    while (level < r.numPartials - 1 &&
+           double(r.partials[level + 1].harmonic) < maxHarmonic) {
+      level++;
+    }
+    return level;
+  }
+
+  /// Partials of table which
+  static const Recipe &recipe(int which);
+
+private:
+  static int clampTable(int which) {
+    return std::min(std::max(which, 0), int(NUM_TABLES) - 1);
+  }
+
+  struct Values {
+    float v[kMaxPartials];
+  };
+  struct Harmonics {
+    int v[kMaxPartials];
+  };
+
+  // numPartials harmonics 1, 1 + step, 1 + 2 step, ... at amplitude
+  // 1 / harmonic^power, as gam::addSinesPow<power>(table, numPartials, step)
+  static constexpr Recipe powerSeries(int numPartials, int step, int power) {
+    Recipe r;
+    r.numPartials = numPartials;
+    for (int i = 0; i < numPartials; i++) {
+      const int harmonic = 1 + i * step;
+      float amplitude = 1.0f;
+      for (int p = 0; p < power; p++) {
+        amplitude /= harmonic;
+      }
+      r.partials[i].harmonic = harmonic;
+      r.partials[i].amplitude = amplitude;
+    }
+    return r;
+  }
+
+  // Harmonics 1, 1 + step, ... at the given amplitudes, as
+  // gam::addSines(table, amplitudes, numPartials, step)
+  static constexpr Recipe series(Values amplitudes, int numPartials, int step) {
+    Recipe r;
+    r.numPartials = numPartials;
+    for (int i = 0; i < numPartials; i++) {
+      r.partials[i].harmonic = 1 + i * step;
+      r.partials[i].amplitude = amplitudes.v[i];
+    }
+    return r;
+  }
+
+  // The given harmonics at the given amplitudes, as
+  // gam::addSines(table, amplitudes, harmonics, numPartials)
+  static constexpr Recipe partials(Values amplitudes, Harmonics harmonics,
+                                   int numPartials) {
+    Recipe r;
+    r.numPartials = numPartials;
+    for (int i = 0; i < numPartials; i++) {
+      r.partials[i].harmonic = harmonics.v[i];
+      r.partials[i].amplitude = amplitudes.v[i];
+    }
+    return r;
+  }
+
+  WavetableBank() {
+    // One cycle of a sine; harmonic h at sample i is sine[h * i mod kSize]
+    const double pi = 3.14159265358979323846;
+    float sine[kSize];
+    for (int i = 0; i < kSize; i++) {
+      sine[i] = float(std::sin(2.0 * pi * i / kSize));
+    }
+    for (int which = 0; which < NUM_TABLES; which++) {
+      const Recipe &r = recipe(which);
+      for (int level = 0; level < r.numPartials; level++) {
+        auto &table = mTables[which][level];
+        table.resize(kSize);
+        for (int i = 0; i < kSize; i++) {
+          float sum = 0.0f;
+          for (int k = 0; k <= level; k++) {
+            sum += r.partials[k].amplitude *
+                   sine[(r.partials[k].harmonic * i) & (kSize - 1)];
+          }
+          table[i] = sum;
+        }
+      }
+    }
+  }
+
+  WavetableBank(const WavetableBank &) = delete;
+  WavetableBank &operator=(const WavetableBank &) = delete;
+
+  gam::ArrayPow2<float> mTables[NUM_TABLES][kLevels];
+};
+
+inline const WavetableBank::Recipe &WavetableBank::recipe(int which) {
+  static constexpr Recipe kRecipes[NUM_TABLES] = {
+      powerSeries(9, 1, 1),                                          // SAW
+      powerSeries(9, 2, 1),                                          // SQUARE
+      powerSeries(9, 1, 0),                                          // IMPULSE
+      powerSeries(1, 1, 0),                                          // SINE
+      series({1, 1, 1, 1, 0.7f, 0.5f, 0.3f, 0.1f}, 8, 1),            // PULSE
+      partials({1, 0.4f, 0.65f, 0.3f, 0.18f, 0.08f},
+               {1, 4, 7, 11, 15, 18}, 6),                            // PARTIALS_1
+      partials({0.5f, 0.8f, 0.7f, 1, 0.3f, 0.4f, 0.2f, 0.12f},
+               {3, 4, 7, 8, 11, 12, 15, 16}, 8),                     // PARTIALS_2
+      partials({1, 0.7f, 0.45f, 0.3f, 0.15f, 0.08f},
+               {10, 27, 54, 81, 108, 135}, 6),                       // PARTIALS_3
+      series({0.2f, 0.4f, 0.6f, 1, 0.7f, 0.5f, 0.3f, 0.1f}, 8, 20)}; // PARTIALS_4
+  return kRecipes[which];
+}
+
+} // namespace playground
+
+#endif // PLAYGROUND_WAVETABLEBANK_HPP
@@ -0,0 +1,159 @@
+#ifndef PLAYGROUND_WORKERPOOL_HPP
+#define PLAYGROUND_WORKERPOOL_HPP
+
+// Running simulation steps on several cores.
+//
+// A WorkerPool keeps its threads for the life of the app and runs numbered
+// tasks on them, with the calling thread taking tasks too:
+//
+//   playground::WorkerPool mPool;
+//   ...
+//   void onAnimate(double dt) override {
+//     mPool.parallelFor(0, numParticles, 4096, [&](int begin, int end) {
+//       for (int i = begin; i < end; i++) { ...update particle i... }
+//     });
+//   }
+//
+// run() and parallelFor() return once every task has finished. Tasks are
+// handed out one at a time from a shared counter, so uneven tasks balance
+// out. Idle workers sleep on a condition variable; this is for the graphics
+// or simulation thread, not for onSound() (see VoiceRenderPool for that).
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace playground {
+
+class WorkerPool {
+public:
+  /// numWorkers is the number of threads besides the caller,
+  /// -1 for one per remaining hardware thread
+  explicit WorkerPool(int numWorkers = -1) {
+    if (numWorkers < 0) {
+      unsigned cores = std::thread::hardware_concurrency();
+      numWorkers = cores > 1 ? int(cores) - 1 : 0;
+    }
+    for (int w = 1; w <= numWorkers; w++) {
+      mThreads.emplace_back([this, w]() { workerLoop(w); });
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mRunning = false;
+    }
+    mWake.notify_all();
+    for (auto &t : mThreads) {
+      t.join();
+    }
+  }
+
+  /// Threads that run tasks, the caller included
+  int concurrency() const { return int(mThreads.size()) + 1; }
+
+  /// Call f(task, worker) for every task in [0, numTasks). worker is 0 on
+  /// the calling thread and in [1, concurrency()) on pool threads, for
+  /// indexing per thread scratch.
+  template <typename F> void run(int numTasks, F &&f) {
+    if (mThreads.empty() || numTasks <= 1) {
+      for (int i = 0; i < numTasks; i++) {
+        f(i, 0);
+      }
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      // Stragglers from the last run must be gone before it is replaced
+      mIdle.wait(lock, [&]() { return mActive == 0; });
+      typedef typename std::remove_reference<F>::type Task;
+      mTask = const_cast<void *>(static_cast<const void *>(&f));
+      mCall = [](void *task, int i, int worker) {
+        (*static_cast<Task *>(task))(i, worker);
+      };
+      mNumTasks = numTasks;
+      mNext.store(0, std::memory_order_relaxed);
+      mDone.store(0, std::memory_order_relaxed);
+      mGeneration++;
+    }
+    mWake.notify_all();
+
+    work(0);
+    std::unique_lock<std::mutex> lock(mLock);
+    mIdle.wait(lock, [&]() {
+      return mDone.load(std::memory_order_acquire) == mNumTasks;
+    });
+  }
+
+  /// Split [begin, end) into ranges of grain elements and call
+  /// f(rangeBegin, rangeEnd) for each, in parallel
+  template <typename F> void parallelFor(int begin, int end, int grain, F &&f) {
+    if (end <= begin) {
+      return;
+    }
+    grain = std::max(grain, 1);
+    const int numTasks = (end - begin + grain - 1) / grain;
+    run(numTasks, [&](int task, int) {
+      const int b = begin + task * grain;
+      f(b, std::min(b + grain, end));
+    });
+  }
+
+private:
+  void work(int worker) {
+    int i;
+    while ((i = mNext.fetch_add(1, std::memory_order_relaxed)) < mNumTasks) {
+      mCall(mTask, i, worker);
+      if (mDone.fetch_add(1, std::memory_order_acq_rel) + 1 == mNumTasks) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIdle.notify_all();
+      }
+    }
+  }
+
+  void workerLoop(int worker) {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(mLock);
+    for (;;) {
+      mWake.wait(lock, [&]() { return !mRunning || mGeneration != seen; });
+      if (!mRunning) {
+        return;
+      }
+      seen = mGeneration;
+      mActive++;
+      lock.unlock();
+      work(worker);
+      lock.lock();
+      if (--mActive == 0) {
+        mIdle.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::thread> mThreads;
+  std::mutex mLock;
+  std::condition_variable mWake; // workers wait for a run
+  std::condition_variable mIdle; // the caller waits for tasks and stragglers
+  bool mRunning{true};
+  unsigned mGeneration{0};
+  int mActive{0}; // workers inside work()
+
+  // The current run. Written under mLock while no worker is inside work().
+  void *mTask{nullptr};
+  void (*mCall)(void *, int, int){nullptr};
+  int mNumTasks{0};
+  std::atomic<int> mNext{0};
+  std::atomic<int> mDone{0};
+};
+
+} // namespace playground
+
+#endif // PLAYGROUND_WORKERPOOL_HPP
@@ -17,6 +17,8 @@
 #include "al/io/al_MIDI.hpp"
 #include "al/math/al_Random.hpp"
 
+#include "playground/OfflineRenderer.hpp"
+
 // using namespace gam;
 using namespace al;
 using namespace std;
@@ -661,145 +663,78 @@ class Hihat : public SynthVoice {
   //void onTriggerOff() override {  }
 };
 
-// We make an app.
-class MyApp : public App {
+// The piece. Notes are scheduled into sequencer(), which is the synth
+// manager's sequencer when the app runs and a headless one when the piece is
+// bounced offline with --bounce.
+class Song : public playground::Score {
 public:
-
-// GUI manager for SineEnv voices
-  // The name provided determines the name of the directory
-  // where the presets and sequences are stored
-  SynthGUIManager<SineEnv> synthManager{"SineEnv"};
-
-  // This function is called right after the window is created
-  // It provides a grphics context to initialize ParameterGUI
-  // It's also a good place to put things that should
-  // happen once at startup.
-  void onCreate() override {
-    navControl().active(false); // Disable navigation via keyboard, since we
-                                // will be using keyboard for note triggering
-
-    // Set sampling rate for Gamma objects from app's audio
-    gam::sampleRate(audioIO().framesPerSecond());
-
-    imguiInit();
-
-    // Play example sequence. Comment this line to start from scratch
-    playSong(1);
-    // synthManager.synthSequencer().playSequence("synth1.synthSequence");
-    synthManager.synthRecorder().verbose(true);
-  }
-
-  // The audio callback function. Called when audio hardware requires data
-  void onSound(AudioIOData &io) override {
-    synthManager.render(io); // Render audio
-  }
-
-  void onAnimate(double dt) override {
-    // The GUI is prepared here
-    imguiBeginFrame();
-    // Draw a window that contains the synth control panel
-    synthManager.drawSynthControlPanel();
-    imguiEndFrame();
-  }
-
-  // The graphics callback function.
-  void onDraw(Graphics &g) override {
-    g.clear();
-    // Render the synth's graphics
-    synthManager.render(g);
-
-    // GUI is drawn here
-    imguiDraw();
-  }
-
-  // Whenever a key is pressed, this function is called
-  bool onKeyDown(Keyboard const &k) override {
-    if (ParameterGUI::usingKeyboard()) { // Ignore keys if GUI is using
-                                         // keyboard
-      return true;
-    }
-    if (k.shift()) {
-      // If shift pressed then keyboard sets preset
-      int presetNumber = asciiToIndex(k.key());
-      synthManager.recallPreset(presetNumber);
-    } else {
-      // Otherwise trigger note for polyphonic synth
-      int midiNote = asciiToMIDI(k.key());
-      if (midiNote > 0) {
-        synthManager.voice()->setInternalParameterValue(
-            "frequency", ::pow(2.f, (midiNote - 69.f) / 12.f) * 440.f);
-        synthManager.triggerOn(midiNote);
-      }
-    }
-    return true;
-  }
-
-  // Whenever a key is released this function is called
-  bool onKeyUp(Keyboard const &k) override {
-    int midiNote = asciiToMIDI(k.key());
-    if (midiNote > 0) {
-      synthManager.triggerOff(midiNote);
-    }
-    return true;
-  }
-
-  void onExit() override { imguiShutdown(); }
-
+  void playScore() override { playSong(1); }
 
   void playSineEnv(float freq, float time, float duration, float amp = .07, float attack = 0.2, float release = 0.7)
   {
-    auto *voice = synthManager.synth().getVoice<SineEnv>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SineEnv>();
     // amp, freq, attack, release, pan
     vector<float> params = vector<float>({amp, freq, attack, release ,0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSineEnv2(float freq, float time, float duration, float amp = .07, float attack = 0.03, float release = 0.1)
   {
-    auto *voice = synthManager.synth().getVoice<SineEnv2>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SineEnv2>();
     // amp, freq, attack, release, pan
     vector<float> params = vector<float>({amp, freq, attack, release ,0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSineEnv3(float freq, float time, float duration, float amp = .02, float attack = 0.15, float release = 0.7)
   {
-    auto *voice = synthManager.synth().getVoice<SineEnv3>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SineEnv3>();
     // amp, freq, attack, release, pan
     vector<float> params = vector<float>({amp, freq, attack, release ,0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSquareWave(float freq, float time, float duration, float amp = .07, float attack = 0.1, float release = 0.2)
   {
-    auto *voice = synthManager.synth().getVoice<SquareWave>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SquareWave>();
     // amp, freq, attack, release, pan
     vector<float> params = vector<float>({amp, freq, attack, release, 0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playPluckString(float freq, float time, float duration, float amp = 0.05)
   {
-    
-    auto *voice = synthManager.synth().getVoice<PluckedString>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<PluckedString>();
     //vector<VariantValue> params = vector<VariantValue>({amp, freq, attack, decay, 0.0});
     //voice->setTriggerParams(params);
 
     voice->setInternalParameterValue("frequency", freq);
     voice->setInternalParameterValue("amplitude", amp);
 
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playHihat(float time, float duration = 0.3)
   {
-      auto *voice = synthManager.synth().getVoice<Hihat>();
+      if (!claimNote(time, duration))
+        return;
+      auto *voice = sequencer().synth().getVoice<Hihat>();
       // amp, freq, attack, release, pan
-      synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+      sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   // NOTES AND CORRESPONDING FREQUENCIES
@@ -1664,10 +1599,103 @@ public:
     // hihat(start + 48*measure + 2*beat);
     // hihat(start + 48*measure + 3*beat);
   }
+};
+
+// We make an app.
+class MyApp : public App, public Song {
+public:
+
+// GUI manager for SineEnv voices
+  // The name provided determines the name of the directory
+  // where the presets and sequences are stored
+  SynthGUIManager<SineEnv> synthManager{"SineEnv"};
+
+  // This function is called right after the window is created
+  // It provides a grphics context to initialize ParameterGUI
+  // It's also a good place to put things that should
+  // happen once at startup.
+  void onCreate() override {
+    navControl().active(false); // Disable navigation via keyboard, since we
+                                // will be using keyboard for note triggering
+
+    // Set sampling rate for Gamma objects from app's audio
+    gam::sampleRate(audioIO().framesPerSecond());
+
+    imguiInit();
+
+    // Play example sequence. Comment this line to start from scratch
+    playSong(1);
+    // synthManager.synthSequencer().playSequence("synth1.synthSequence");
+    synthManager.synthRecorder().verbose(true);
+  }
 
+  // The audio callback function. Called when audio hardware requires data
+  void onSound(AudioIOData &io) override {
+    synthManager.render(io); // Render audio
+  }
+
+  void onAnimate(double dt) override {
+    // The GUI is prepared here
+    imguiBeginFrame();
+    // Draw a window that contains the synth control panel
+    synthManager.drawSynthControlPanel();
+    imguiEndFrame();
+  }
+
+  // The graphics callback function.
+  void onDraw(Graphics &g) override {
+    g.clear();
+    // Render the synth's graphics
+    synthManager.render(g);
+
+    // GUI is drawn here
+    imguiDraw();
+  }
+
+  // Whenever a key is pressed, this function is called
+  bool onKeyDown(Keyboard const &k) override {
+    if (ParameterGUI::usingKeyboard()) { // Ignore keys if GUI is using
+                                         // keyboard
+      return true;
+    }
+    if (k.shift()) {
+      // If shift pressed then keyboard sets preset
+      int presetNumber = asciiToIndex(k.key());
+      synthManager.recallPreset(presetNumber);
+    } else {
+      // Otherwise trigger note for polyphonic synth
+      int midiNote = asciiToMIDI(k.key());
+      if (midiNote > 0) {
+        synthManager.voice()->setInternalParameterValue(
+            "frequency", ::pow(2.f, (midiNote - 69.f) / 12.f) * 440.f);
+        synthManager.triggerOn(midiNote);
+      }
+    }
+    return true;
+  }
+
+  // Whenever a key is released this function is called
+  bool onKeyUp(Keyboard const &k) override {
+    int midiNote = asciiToMIDI(k.key());
+    if (midiNote > 0) {
+      synthManager.triggerOff(midiNote);
+    }
+    return true;
+  }
+
+  void onExit() override { imguiShutdown(); }
+
+  SynthSequencer &sequencer() override { return synthManager.synthSequencer(); }
 };
 
-int main() {
+int main(int argc, char *argv[]) {
+  // Render to a WAV file instead of the audio device when asked to, e.g.
+  //   ./0521demo --bounce 0521demo.wav --all-cores
+  playground::OfflineRenderer offline;
+  if (offline.parseArgs(argc, argv)) {
+    return offline.bounce<playground::HeadlessScore<Song>>() ? 0 : 1;
+  }
+
   // Create app instance
   MyApp app;
 
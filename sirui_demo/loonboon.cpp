@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio> // for printing to stdout
 
 #include "Gamma/Analysis.h"
@@ -17,9 +18,17 @@
 #include "al/io/al_MIDI.hpp"
 #include "al/math/al_Random.hpp"
 
+#include "playground/EventQueue.hpp"
+#include "playground/NoteCache.hpp"
+#include "playground/OfflineRenderer.hpp"
+#include "playground/ParallelPolySynth.hpp"
+#include "playground/OscillatorBank.hpp"
+#include "playground/RtSanitizer.hpp"
+
 // using namespace gam;
 using namespace al;
 using namespace std;
+using playground::OscillatorBank;
 #define FFT_SIZE 4048
 
 class SineEnv : public SynthVoice
@@ -257,8 +266,9 @@ class SineEnv3 : public SynthVoice
 public:
   // Unit generators
   gam::Pan<> mPan;
-  gam::Sine<> mOsc1;
-  gam::Sine<> mOsc3;
+  OscillatorBank<2> mPartials; // fundamental and octave
+  static const int kBlock = 256;
+  float mBuffer[kBlock];
   gam::Saw<> mSaw1;
   gam::Saw<> mSaw2;
   gam::Saw<> mSaw3;
@@ -287,6 +297,7 @@ public:
     //addCone(mMesh);
     // addDodecahedron(mMesh,0.4);
     addRect(mMesh, 2.5,0.25);
+    mPartials.size(2);
 
     createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
     createInternalTriggerParameter("frequency", 60, 20, 5000);
@@ -304,8 +315,13 @@ public:
     // voice, rather than having to trigger a new voice to hear the changes.
     // Parameters will update values once per audio callback because they
     // are outside the sample processing loop.
-    mOsc1.freq(getInternalParameterValue("frequency"));
-    mOsc3.freq(2*getInternalParameterValue("frequency"));
+    float frequency = getInternalParameterValue("frequency");
+    float amplitude = getInternalParameterValue("amplitude");
+    mPartials.sampleRate(io.framesPerSecond());
+    mPartials.freq(0, frequency);
+    mPartials.freq(1, 2 * frequency);
+    mPartials.amp(0, amplitude);
+    mPartials.amp(1, amplitude / 3.0f);
     mSaw1.freq(getInternalParameterValue("frequency"));
     mSaw3.freq(3*getInternalParameterValue("frequency"));
     mSaw2.freq(2*getInternalParameterValue("frequency"));
@@ -314,14 +330,16 @@ public:
     mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
     mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
     mPan.pos(getInternalParameterValue("pan"));
+    int i = 0, n = 0;
     while (io())
     {
-      
-      float s1 =  // mSaw1() * (1.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-              // + mSaw3() * (1.0/6.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-              //mSaw2() * (1.0/3.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-                mOsc1() * (1.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-               + mOsc3() * (1.0/3.0) * mAmpEnv() * getInternalParameterValue("amplitude");
+      if (i == n)
+      { // Render the partials for the next chunk of the block
+        n = std::min(int(io.framesPerBuffer()) - int(io.frame()), int(kBlock));
+        mPartials.render(mBuffer, n);
+        i = 0;
+      }
+      float s1 = mBuffer[i++] * mAmpEnv();
       float s2;
       mPan(s1, s1, s2);
       io.out(0) += s1;
@@ -363,7 +381,7 @@ public:
   // The triggering functions just need to tell the envelope to start or release
   // The audio processing function checks when the envelope is done to remove
   // the voice from the processing chain.
-  void onTriggerOn() override { mAmpEnv.reset(); }
+  void onTriggerOn() override { mAmpEnv.reset(); mPartials.reset(); }
 
   void onTriggerOff() override { mAmpEnv.release(); }
 };
@@ -373,11 +391,9 @@ class SquareWave : public SynthVoice
 public:
   // Unit generators
   gam::Pan<> mPan;
-  gam::Sine<> mOsc1;
-  gam::Sine<> mOsc3;
-  gam::Sine<> mOsc5;
-  gam::Sine<> mOsc7;
-  gam::Sine<> mOsc9;
+  OscillatorBank<5> mPartials; // odd harmonics 1 to 9
+  static const int kBlock = 256;
+  float mBuffer[kBlock];
   gam::Env<3> mAmpEnv;
 
   gam::EnvFollow<> mEnvFollow;
@@ -403,6 +419,7 @@ public:
     addIcosphere(mMesh,0.8,2);
     //addAnnulus(mMesh, 1.2,1.5);
     addWireBox(mMesh, 0.01);
+    mPartials.size(5);
 
     createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
     createInternalTriggerParameter("frequency", 60, 20, 5000);
@@ -420,24 +437,30 @@ public:
     // voice, rather than having to trigger a new voice to hear the changes.
     // Parameters will update values once per audio callback because they
     // are outside the sample processing loop.
-    mOsc1.freq(getInternalParameterValue("frequency"));
-    mOsc3.freq(3*getInternalParameterValue("frequency"));
-    mOsc5.freq(5*getInternalParameterValue("frequency"));
-    mOsc7.freq(7*getInternalParameterValue("frequency"));
-    mOsc9.freq(9*getInternalParameterValue("frequency"));
+    float frequency = getInternalParameterValue("frequency");
+    float amplitude = getInternalParameterValue("amplitude");
+    mPartials.sampleRate(io.framesPerSecond());
+    for (int k = 0; k < 5; k++)
+    {
+      int harmonic = 2 * k + 1;
+      mPartials.freq(k, harmonic * frequency);
+      mPartials.amp(k, 0.4f * amplitude / harmonic);
+    }
   
 
     mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
     mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
     mPan.pos(getInternalParameterValue("pan"));
+    int i = 0, n = 0;
     while (io())
     {
-      
-      float s1 =  0.4*(mOsc1() * (1.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-               + mOsc3() * (1.0/3.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-               + mOsc5() * (1.0/5.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-               + mOsc7() * (1.0/7.0) * mAmpEnv() * getInternalParameterValue("amplitude")
-               + mOsc9() * (1.0/9.0) * mAmpEnv() * getInternalParameterValue("amplitude"));
+      if (i == n)
+      { // Render the partials for the next chunk of the block
+        n = std::min(int(io.framesPerBuffer()) - int(io.frame()), int(kBlock));
+        mPartials.render(mBuffer, n);
+        i = 0;
+      }
+      float s1 = mBuffer[i++] * mAmpEnv();
       float s2;
       mPan(s1, s1, s2);
       io.out(0) += s1;
@@ -479,7 +502,7 @@ public:
   // The triggering functions just need to tell the envelope to start or release
   // The audio processing function checks when the envelope is done to remove
   // the voice from the processing chain.
-  void onTriggerOn() override { mAmpEnv.reset(); }
+  void onTriggerOn() override { mAmpEnv.reset(); mPartials.reset(); }
 
   void onTriggerOff() override { mAmpEnv.release(); }
 };
@@ -705,7 +728,8 @@ class Kick : public SynthVoice {
     }
   }
 
-  void onTriggerOn() override { mAmpEnv.reset(); mDecay.reset(); }
+  // Start from the same phase whether or not the voice was used before
+  void onTriggerOn() override { mAmpEnv.reset(); mDecay.reset(); mOsc.phase(0); }
 
   void onTriggerOff() override { mAmpEnv.release(); mDecay.finish(); }
 };
@@ -772,173 +796,140 @@ class Snare : public SynthVoice {
 
 
 
-// We make an app.
-class MyApp : public App {
-public:
-
-// GUI manager for SineEnv voices
-  // The name provided determines the name of the directory
-  // where the presets and sequences are stored
-  SynthGUIManager<SineEnv> synthManager{"SineEnv"};
-
-  // This function is called right after the window is created
-  // It provides a grphics context to initialize ParameterGUI
-  // It's also a good place to put things that should
-  // happen once at startup.
-  void onCreate() override {
-    navControl().active(false); // Disable navigation via keyboard, since we
-                                // will be using keyboard for note triggering
+// Set by --cache-notes: kicks are rendered once per distinct note and
+// replayed from memory. The kick resets its pitch sweep every block, so the
+// takes are rendered with the synth's block size (cacheBlockSize). The
+// hihat, snare and pluck draw noise and are always played live.
+bool cacheNotes = false;
+int cacheBlockSize = 512;
 
-    // Set sampling rate for Gamma objects from app's audio
-    gam::sampleRate(audioIO().framesPerSecond());
-
-    imguiInit();
-
-    // Play example sequence. Comment this line to start from scratch
+// The piece. Notes are scheduled into sequencer(), which is the synth
+// manager's sequencer when the app runs and a headless one when the piece is
+// bounced offline with --bounce.
+class Song : public playground::Score {
+public:
+  void playScore() override {
+    mNotes.blockSize = cacheBlockSize;
     playSong(1);
-    // synthManager.synthSequencer().playSequence("synth1.synthSequence");
-    synthManager.synthRecorder().verbose(true);
-  }
-
-  // The audio callback function. Called when audio hardware requires data
-  void onSound(AudioIOData &io) override {
-    synthManager.render(io); // Render audio
-  }
-
-  void onAnimate(double dt) override {
-    // The GUI is prepared here
-    imguiBeginFrame();
-    // Draw a window that contains the synth control panel
-    synthManager.drawSynthControlPanel();
-    imguiEndFrame();
-  }
-
-  // The graphics callback function.
-  void onDraw(Graphics &g) override {
-    g.clear();
-    // Render the synth's graphics
-    synthManager.render(g);
-
-    // GUI is drawn here
-    imguiDraw();
-  }
-
-  // Whenever a key is pressed, this function is called
-  bool onKeyDown(Keyboard const &k) override {
-    if (ParameterGUI::usingKeyboard()) { // Ignore keys if GUI is using
-                                         // keyboard
-      return true;
-    }
-    // if (k.key() == 'a'){
-    //   playSong(1);
-    // }
-    if (k.shift()) {
-      // If shift pressed then keyboard sets preset
-      int presetNumber = asciiToIndex(k.key());
-      synthManager.recallPreset(presetNumber);
-    } else {
-      // Otherwise trigger note for polyphonic synth
-      int midiNote = asciiToMIDI(k.key());
-      if (midiNote > 0) {
-        synthManager.voice()->setInternalParameterValue(
-            "frequency", ::pow(2.f, (midiNote - 69.f) / 12.f) * 440.f);
-        synthManager.triggerOn(midiNote);
-      }
+    if (cacheNotes) {
+      mNotes.wait();
+      mNotes.print("loonboon note cache");
     }
-    return true;
   }
 
-  // Whenever a key is released this function is called
-  bool onKeyUp(Keyboard const &k) override {
-    int midiNote = asciiToMIDI(k.key());
-    if (midiNote > 0) {
-      synthManager.triggerOff(midiNote);
-    }
+  // Schedule the cached take of a TVoice note if it was played before
+  template <class TVoice>
+  bool playCached(vector<float> params, float time, float duration)
+  {
+    if (!cacheNotes)
+      return false;
+    auto take = mNotes.find<TVoice>(params, duration);
+    if (!take)
+      return false;
+    auto *voice = sequencer().synth().getVoice<playground::CachedNote>();
+    voice->play(take, &mNotes);
+    sequencer().addVoiceFromNow(voice, time, duration);
     return true;
   }
 
-  void onExit() override { imguiShutdown(); }
-
-
   void playSineEnv(float freq, float time, float duration, float amp = .07, float attack = 0.2, float release = 0.7)
   {
-    auto *voice = synthManager.synth().getVoice<SineEnv>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SineEnv>();
     // amp, freq, attack, release, pan
     vector<VariantValue> params = vector<VariantValue>({amp, freq, attack, release ,0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSineEnv2(float freq, float time, float duration, float amp = .09, float attack = 0.03, float release = 0.3)
   {
-    auto *voice = synthManager.synth().getVoice<SineEnv2>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SineEnv2>();
     // amp, freq, attack, release, pan
     vector<float> params = vector<float>({amp, freq, attack, release ,0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSineEnv3(float freq, float time, float duration, float amp = .02, float attack = 0.15, float release = 0.7)
   {
-    auto *voice = synthManager.synth().getVoice<SineEnv3>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SineEnv3>();
     // amp, freq, attack, release, pan
     vector<VariantValue> params = vector<VariantValue>({amp, freq, attack, release ,0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSquareWave(float freq, float time, float duration, float amp = .12, float attack = 0.07, float release = 0.4)
   {
-    auto *voice = synthManager.synth().getVoice<SquareWave>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SquareWave>();
     // amp, freq, attack, release, pan
     vector<float> params = vector<float>({amp, freq, attack, release, 0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSquareWave2(float freq, float time, float duration, float amp = .09, float attack = 0.07, float release = 0.4)
   {
-    auto *voice = synthManager.synth().getVoice<SquareWave>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<SquareWave>();
     // amp, freq, attack, release, pan
     vector<VariantValue> params = vector<VariantValue>({amp, freq, attack, release, 0.0});
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playPluckString(float freq, float time, float duration, float amp = 0.06)
   {
-    
-    auto *voice = synthManager.synth().getVoice<PluckedString>();
+    if (!claimNote(time, duration))
+      return;
+    auto *voice = sequencer().synth().getVoice<PluckedString>();
     //vector<VariantValue> params = vector<VariantValue>({amp, freq, attack, decay, 0.0});
     //voice->setTriggerParams(params);
 
     voice->setInternalParameterValue("frequency", freq);
     voice->setInternalParameterValue("amplitude", amp);
 
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playHihat(float time, float duration = 0.3)
   {
-      auto *voice = synthManager.synth().getVoice<Hihat>();
+      if (!claimNote(time, duration))
+        return;
+      auto *voice = sequencer().synth().getVoice<Hihat>();
       // amp, freq, attack, release, pan
-      synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+      sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playKick(float time, float freq = 150, float duration = 0.5, float amp = 0.25, float attack = 0.1, float decay = 0.1)
   {
-      auto *voice = synthManager.synth().getVoice<Kick>();
+      if (!claimNote(time, duration))
+        return;
+      if (playCached<Kick>({amp, freq}, time, duration))
+        return;
+      auto *voice = sequencer().synth().getVoice<Kick>();
       // amp, freq, attack, release, pan
       vector<VariantValue> params = vector<VariantValue>({amp, freq, 0.01, 0.1, 0.0});
       voice->setTriggerParams(params);
-      synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+      sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   void playSnare(float time, float duration = 0.3)
   {
-      auto *voice = synthManager.synth().getVoice<Hihat>();
+      if (!claimNote(time, duration))
+        return;
+      auto *voice = sequencer().synth().getVoice<Hihat>();
       // amp, freq, attack, release, pan
-      synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+      sequencer().addVoiceFromNow(voice, time, duration);
   }
 
   // NOTES AND CORRESPONDING FREQUENCIES
@@ -1881,9 +1872,145 @@ public:
 
   }
 
+private:
+  playground::NoteCache mNotes;
+};
+
+// We make an app.
+class MyApp : public App, public Song {
+public:
+
+// GUI manager for SineEnv voices
+  // The name provided determines the name of the directory
+  // where the presets and sequences are stored
+  SynthGUIManager<SineEnv> synthManager{"SineEnv"};
+
+  // The score has dozens of overlapping voices, so it gets its own sequencer
+  // whose voices are rendered on all cores. The keyboard still plays through
+  // synthManager.
+  playground::ParallelPolySynth mScoreSynth;
+  SynthSequencer mScoreSequencer;
+
+  // Keyboard notes are handed to the audio thread through a lock-free queue
+  playground::EventQueue mEvents;
+  playground::EventQueue::Producer mKeyboardEvents;
+
+  // This function is called right after the window is created
+  // It provides a grphics context to initialize ParameterGUI
+  // It's also a good place to put things that should
+  // happen once at startup.
+  void onCreate() override {
+    navControl().active(false); // Disable navigation via keyboard, since we
+                                // will be using keyboard for note triggering
+
+    // Set sampling rate for Gamma objects from app's audio
+    gam::sampleRate(audioIO().framesPerSecond());
+
+    mScoreSynth.prepare(audioIO());
+    mScoreSynth.pool().configure(audioIO().framesPerSecond(),
+                                 audioIO().framesPerBuffer(),
+                                 audioIO().channelsOut());
+    mScoreSequencer << mScoreSynth;
+
+    synthManager.synth().allocatePolyphony<SineEnv>(16);
+    mKeyboardEvents = mEvents.producer();
+
+    imguiInit();
+
+    // Play example sequence. Comment this line to start from scratch
+    playScore();
+    // synthManager.synthSequencer().playSequence("synth1.synthSequence");
+    synthManager.synthRecorder().verbose(true);
+  }
+
+  // The audio callback function. Called when audio hardware requires data
+  void onSound(AudioIOData &io) override {
+    PLAYGROUND_RT_SCOPE("onSound"); // checked with -DPLAYGROUND_RT_SANITIZER
+    mEvents.dispatch(synthManager.synth(), io); // Start keyboard notes
+    synthManager.render(io); // Render audio
+    mScoreSequencer.render(io);
+  }
+
+  void onAnimate(double dt) override {
+    // The GUI is prepared here
+    imguiBeginFrame();
+    // Draw a window that contains the synth control panel
+    synthManager.drawSynthControlPanel();
+    imguiEndFrame();
+  }
+
+  // The graphics callback function.
+  void onDraw(Graphics &g) override {
+    g.clear();
+    // Render the synth's graphics
+    synthManager.render(g);
+    mScoreSynth.render(g);
+
+    // GUI is drawn here
+    imguiDraw();
+  }
+
+  // Whenever a key is pressed, this function is called
+  bool onKeyDown(Keyboard const &k) override {
+    if (ParameterGUI::usingKeyboard()) { // Ignore keys if GUI is using
+                                         // keyboard
+      return true;
+    }
+    // if (k.key() == 'a'){
+    //   playSong(1);
+    // }
+    if (k.shift()) {
+      // If shift pressed then keyboard sets preset
+      int presetNumber = asciiToIndex(k.key());
+      synthManager.recallPreset(presetNumber);
+    } else {
+      // Otherwise trigger note for polyphonic synth
+      int midiNote = asciiToMIDI(k.key());
+      if (midiNote > 0) {
+        synthManager.voice()->setInternalParameterValue(
+            "frequency", ::pow(2.f, (midiNote - 69.f) / 12.f) * 440.f);
+        // Set the voice up here, the audio thread only starts it. No voice
+        // while the queue is full: the key is ignored.
+        auto *voice =
+            mKeyboardEvents.getVoice<SineEnv>(synthManager.synth());
+        if (voice) {
+          auto params = synthManager.voice()->getTriggerParams();
+          voice->setTriggerParams(params);
+          mKeyboardEvents.noteOn(voice, mEvents.nowFrames(), 0, midiNote);
+        }
+      }
+    }
+    return true;
+  }
+
+  // Whenever a key is released this function is called
+  bool onKeyUp(Keyboard const &k) override {
+    int midiNote = asciiToMIDI(k.key());
+    if (midiNote > 0) {
+      mKeyboardEvents.noteOff(midiNote, mEvents.nowFrames());
+    }
+    return true;
+  }
+
+  void onExit() override { imguiShutdown(); }
+
+  SynthSequencer &sequencer() override { return mScoreSequencer; }
 };
 
-int main() {
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "--cache-notes")
+      cacheNotes = true;
+  }
+
+  // Render to a WAV file instead of the audio device when asked to, e.g.
+  //   ./loonboon --bounce loonboon.wav --all-cores --cache-notes
+  playground::OfflineRenderer offline;
+  if (offline.parseArgs(argc, argv)) {
+    cacheBlockSize = offline.blockSize;
+    return offline.bounce<playground::HeadlessScore<Song>>() ? 0 : 1;
+  }
+
   // Create app instance
   MyApp app;
 
@@ -0,0 +1,85 @@
+// Checks that a full EventQueue turns notes away without losing voices.
+//
+// Tries to start three times as many notes per block as the ring holds,
+// for many blocks. Voices are taken through Producer::getVoice(), which
+// refuses them while the ring is full; every voice taken must start, play
+// and go back to the synth, so no more voices than the ring holds are ever
+// created. Exits with 1 on failure.
+//
+// Usage: ./run.sh tests/event_queue_test.cpp
+
+#include <cstdio>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_PolySynth.hpp"
+
+#include "playground/EventQueue.hpp"
+
+class CountedVoice : public al::SynthVoice {
+public:
+  static int created;
+  CountedVoice() { created++; }
+  void onProcess(al::AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.0f;
+    }
+  }
+  void onTriggerOff() override { free(); }
+};
+int CountedVoice::created = 0;
+
+int main() {
+  const int kRing = 8;
+  const int kRounds = 100;
+  al::PolySynth synth;
+  playground::EventQueue queue(kRing, 64, 1);
+  playground::EventQueue::Producer producer = queue.producer();
+  al::AudioIOData io;
+  io.framesPerSecond(48000);
+  io.framesPerBuffer(64);
+  io.channelsOut(2);
+
+  int started = 0;
+  int refused = 0;
+  for (int round = 0; round < kRounds; round++) {
+    for (int n = 0; n < 3 * kRing; n++) {
+      auto *voice = producer.getVoice<CountedVoice>(synth);
+      if (!voice) {
+        refused++;
+        continue;
+      }
+      if (!producer.noteOn(voice, queue.frame(), 32)) {
+        printf("FAIL: note on refused after getVoice() gave a voice\n");
+        return 1;
+      }
+      started++;
+    }
+    // Long enough for every note to start, end and free its voice
+    for (int block = 0; block < 4; block++) {
+      io.zeroOut();
+      queue.dispatch(synth, io);
+      synth.render(io);
+    }
+  }
+
+  int active = 0;
+  for (auto *voice = synth.getActiveVoices(); voice; voice = voice->next) {
+    active++;
+  }
+  const auto stats = queue.stats();
+  printf("%d notes started, %d refused, %d voices created, %d active, "
+         "%llu dropped\n",
+         started, refused, CountedVoice::created, active,
+         (unsigned long long)stats.dropped);
+  if (started != kRounds * kRing || refused != kRounds * 2 * kRing) {
+    printf("FAIL: expected %d notes started per round\n", kRing);
+    return 1;
+  }
+  if (CountedVoice::created > kRing || active != 0 || stats.dropped != 0 ||
+      stats.dispatched != uint64_t(started)) {
+    printf("FAIL: voices were lost\n");
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,55 @@
+// Checks that every WavetableBank table sounds across the playable range.
+//
+// For each table, sample rate and note from 20 Hz to 12 kHz (a quarter tone
+// apart) the band limited table must not be silent, and every partial it
+// keeps above the lowest must lie below the Nyquist frequency. Exits with 1
+// on the first failure.
+//
+// Usage: ./run.sh tests/wavetable_bank_test.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "playground/WavetableBank.hpp"
+
+using playground::WavetableBank;
+
+int main() {
+  WavetableBank &bank = WavetableBank::get();
+  int checked = 0;
+  for (double sampleRate : {44100.0, 48000.0, 96000.0}) {
+    for (int which = 0; which < WavetableBank::NUM_TABLES; which++) {
+      const WavetableBank::Recipe &r = WavetableBank::recipe(which);
+      for (double f = 20.0; f <= 12000.0; f *= std::pow(2.0, 1.0 / 24)) {
+        auto &table = bank.table(which, f, sampleRate);
+        float peak = 0.0f;
+        for (int i = 0; i < WavetableBank::kSize; i++) {
+          peak = std::max(peak, std::abs(table[i]));
+        }
+        if (!(peak > 1e-3f)) {
+          printf("FAIL: table %d is silent at %.1f Hz, %.0f Hz\n", which, f,
+                 sampleRate);
+          return 1;
+        }
+        const int level = WavetableBank::level(which, f, sampleRate);
+        for (int k = 1; k <= level; k++) {
+          if (r.partials[k].harmonic * f >= 0.5 * sampleRate) {
+            printf("FAIL: table %d keeps harmonic %d at %.1f Hz, %.0f Hz\n",
+                   which, r.partials[k].harmonic, f, sampleRate);
+            return 1;
+          }
+        }
+        if (level + 1 < r.numPartials &&
+            r.partials[level + 1].harmonic * f < 0.5 * sampleRate) {
+          printf("FAIL: table %d drops harmonic %d at %.1f Hz, %.0f Hz\n",
+                 which, r.partials[level + 1].harmonic, f, sampleRate);
+          return 1;
+        }
+        checked++;
+      }
+    }
+  }
+  printf("ok: %d tables and notes checked\n", checked);
+  return 0;
+}
@@ -10,6 +10,10 @@
 #include "al/ui/al_ParameterGUI.hpp"
 #include "al_ext/soundfile/al_SoundfileBuffered.hpp"
 
+#include "playground/BufferOps.hpp"
+#include "playground/ScratchArena.hpp"
+#include "playground/Telemetry.hpp"
+
 using namespace al;
 
 struct MappedAudioFile {
@@ -19,6 +23,14 @@ struct MappedAudioFile {
   std::string fileName;
   float gain;
   bool mute{false};
+  uint64_t shortReads{0};
+  std::vector<float *> outputs; // per file channel, filled in onSound
+};
+
+// Sent from the audio thread when a file could not fill the block
+struct ShortRead {
+  int file;
+  int framesRead;
 };
 
 class AudioPlayerApp : public App {
@@ -109,6 +121,18 @@ public:
       }
     }
     audioIO().channelsOut(highestChannel + 1);
+
+    // Everything onSound needs, so it never allocates or puts the file
+    // frames on the stack
+    int mostChannels = 1;
+    for (auto &sf : soundfiles) {
+      sf.outputs.resize(sf.soundfile->channels());
+      mostChannels = std::max(mostChannels, int(sf.soundfile->channels()));
+    }
+    mScratchChannels = mostChannels;
+    mScratch.reserve(
+        playground::ScratchArena::footprint(kScratchFrames * mostChannels) +
+        playground::ScratchArena::footprint(kScratchFrames));
     if (soundfiles.size() == 6) {
       // assume 5.1 to stereo
       mDownMixer.set5_1toStereo(audioIO());
@@ -119,6 +143,11 @@ public:
   void onCreate() override { imguiInit(); }
 
   void onDraw(Graphics &g) override {
+    mShortReads.drain([&](const ShortRead &r) {
+      std::cout << "short buffer " << r.framesRead << std::endl;
+      soundfiles[r.file].shortReads++;
+    });
+
     imguiBeginFrame();
 
     ImGui::Begin("Multichannel Player");
@@ -144,6 +173,9 @@ public:
       ImGui::PushID(sf.soundfile.get());
       ImGui::Checkbox("Mute", &sf.mute);
       ImGui::Text("%s", sf.fileInfoText.c_str());
+      if (sf.shortReads > 0) {
+        ImGui::Text(" short reads: %llu", (unsigned long long)sf.shortReads);
+      }
       ImGui::PopID();
     }
 
@@ -154,21 +186,37 @@ public:
   }
 
   void onSound(AudioIOData &io) override {
-    float buffer[2048 * 60];
     if (play.get() == 1.0f) {
-      for (auto &sf : soundfiles) {
-        int numChannels = sf.soundfile->channels();
-        int framesRead = sf.soundfile->read(buffer, io.framesPerBuffer());
-        if (framesRead != io.framesPerBuffer()) {
-          std::cout << "short buffer " << framesRead << std::endl;
-        }
-        for (size_t i = 0; i < sf.outChannelMap.size(); i++) {
-          size_t outIndex = sf.outChannelMap[i];
+      const int framesPerBuffer = io.framesPerBuffer();
+      mScratch.reset();
+      float *interleaved =
+          mScratch.allocate(size_t(kScratchFrames) * mScratchChannels);
+      float *discard = mScratch.allocate(kScratchFrames);
+      for (size_t file = 0; file < soundfiles.size(); file++) {
+        auto &sf = soundfiles[file];
+        const int numChannels = sf.soundfile->channels();
+        // Blocks larger than the scratch space are read in pieces
+        for (int offset = 0; offset < framesPerBuffer;
+             offset += kScratchFrames) {
+          const int frames = framesPerBuffer - offset < kScratchFrames
+                                 ? framesPerBuffer - offset
+                                 : kScratchFrames;
+          int framesRead = sf.soundfile->read(interleaved, frames);
+          if (framesRead != frames) {
+            mShortReads.publish({int(file), offset + framesRead});
+          }
           if (!sf.mute) {
-            for (uint64_t sample = 0; sample < framesRead; sample++) {
-              io.outBuffer(outIndex)[sample] +=
-                  sf.gain * buffer[sample * numChannels + i];
+            for (int i = 0; i < numChannels; i++) {
+              sf.outputs[i] = i < int(sf.outChannelMap.size())
+                                  ? io.outBuffer(sf.outChannelMap[i]) + offset
+                                  : discard;
             }
+            playground::buffer::deinterleaveAdd(sf.outputs.data(), interleaved,
+                                                numChannels, framesRead,
+                                                sf.gain);
+          }
+          if (framesRead != frames) {
+            break;
           }
         }
       }
@@ -189,6 +237,11 @@ private:
   std::vector<MappedAudioFile> soundfiles;
   SpeakerDistanceGainAdjustmentProcessor gainAdjustment;
   DownMixer mDownMixer;
+  playground::TelemetryChannel<ShortRead> mShortReads;
+
+  static const int kScratchFrames = 1024;
+  int mScratchChannels{1};
+  playground::ScratchArena mScratch;
 };
 
 int main(int argc, char *argv[]) {
@@ -23,10 +23,20 @@
 #include "Gamma/Analysis.h"
 #include "Gamma/scl.h"
 
+#include "playground/BufferOps.hpp"
+#include "playground/DspProfiler.hpp"
+#include "playground/DspProfilerPanel.hpp"
+#include "playground/LevelMeter.hpp"
+#include "playground/RtSanitizer.hpp"
+#include "playground/ScratchArena.hpp"
+#include "playground/TraceRecorder.hpp"
+#include "playground/VoiceStager.hpp"
+
 using namespace al;
 
 struct SharedState {
   float meterValues[64] = {0};
+  uint32_t frame = 0; // counted up by the primary, to trace state arrival
 };
 
 struct MappedAudioFile {
@@ -45,7 +55,7 @@ struct AudioObjectData {
   Mesh *mesh;
 };
 
-class AudioObject : public PositionedVoice {
+class AudioObject : public PositionedVoice, public playground::PreparedVoice {
 public:
   // Trigger Params
   ParameterString file{"audioFile", ""};            // in seconds
@@ -66,21 +76,46 @@ public:
     mSequencer << parameterPose();
     mPresetHandler << parameterPose();
     mSequencer << mPresetHandler; // For morphing
+    // Presets are recalled on the sequencer's own thread
+    mPresetHandler.registerPresetCallback(
+        [](int, void *, void *) {
+          PLAYGROUND_TRACE_THREAD("PresetSequencer");
+          PLAYGROUND_TRACE_INSTANT("preset recall");
+        });
+
+    mScratch.reserve(kScratchFloats);
   }
 
   void onProcess(AudioIOData &io) override {
-    float buffer[2048 * 60];
+    PLAYGROUND_DSP_VOICE(this);
     int numChannels = soundfile.channels();
     assert(io.framesPerBuffer() < INT32_MAX);
-    auto framesRead =
-        soundfile.read(buffer, static_cast<int>(io.framesPerBuffer()));
+    const int framesPerBuffer = static_cast<int>(io.framesPerBuffer());
     int outIndex = 0;
-    size_t inChannel = 0;
-    if (!mute) {
-      for (size_t sample = 0; sample < framesRead; sample++) {
-        io.outBuffer(outIndex)[sample] +=
-            gain * buffer[sample * numChannels + inChannel];
-        mEnvFollow(buffer[sample * numChannels + inChannel]);
+    int inChannel = 0;
+
+    // As many file frames as fit in the scratch arena at a time, so wide
+    // files and large blocks are read in pieces
+    mScratch.reset();
+    const int chunkFrames = static_cast<int>(
+        (mScratch.capacity() - 2 * playground::ScratchArena::kLineFloats) /
+        (numChannels + 1));
+    float *interleaved = mScratch.allocate(size_t(chunkFrames) * numChannels);
+    float *mono = mScratch.allocate(chunkFrames);
+    float *out = io.outBuffer(outIndex);
+    for (int offset = 0; offset < framesPerBuffer; offset += chunkFrames) {
+      const int frames = std::min(chunkFrames, framesPerBuffer - offset);
+      const int framesRead = soundfile.read(interleaved, frames);
+      if (!mute) {
+        playground::buffer::deinterleave(mono, interleaved, numChannels,
+                                         inChannel, framesRead);
+        playground::buffer::addScaled(out + offset, mono, gain, framesRead);
+        for (int sample = 0; sample < framesRead; sample++) {
+          mEnvFollow(mono[sample]);
+        }
+      }
+      if (framesRead != frames) {
+        break;
       }
     }
   }
@@ -97,7 +132,9 @@ public:
     g.draw(mesh);
   }
 
-  void onTriggerOn() override {
+  // Opening the file (which starts its reader thread filling the buffer) is
+  // too slow for the audio thread; staged voices do it beforehand
+  void onPrepare() override {
     auto objData = static_cast<AudioObjectData *>(userData());
 
     if (isPrimary()) {
@@ -107,7 +144,16 @@ public:
         std::cerr << "ERROR: opening audio file: "
                   << File::conformPathToOS(rootPath) + file.get() << std::endl;
       }
+    }
+  }
 
+  void onTriggerOn() override {
+    ensurePrepared();
+    auto objData = static_cast<AudioObjectData *>(userData());
+
+    // The automation starts playing when it is loaded, so it stays here
+    if (isPrimary()) {
+      auto &rootPath = objData->rootPath;
       float seqStep = (float)objData->audioBlockSize / objData->audioSampleRate;
       mSequencer.setSequencerStepTime(seqStep);
 
@@ -134,9 +180,25 @@ private:
   SoundFileBuffered soundfile{8192};
   Color c;
 
+  static const size_t kScratchFloats = 16384;
+  playground::ScratchArena mScratch;
+
   gam::EnvFollow<> mEnvFollow;
 };
 
+// A spatializer that times its panning, per voice buffer, in the DspProfiler
+template <class TSpatializer> class ProfiledSpatializer : public TSpatializer {
+public:
+  using TSpatializer::TSpatializer;
+
+  void renderBuffer(AudioIOData &io, const Pose &listeningPose,
+                    const float *samples,
+                    const unsigned int &numFrames) override {
+    playground::DspProfiler::ClassZone zone(typeid(TSpatializer), this);
+    TSpatializer::renderBuffer(io, listeningPose, samples, numFrames);
+  }
+};
+
 class SpatialSequencer : public DistributedAppWithState<SharedState> {
 public:
   std::string rootDir{""};
@@ -165,7 +227,7 @@ public:
     if (al::sphere::isSimulatorMachine()) {
     }
     auto sl = al::AlloSphereSpeakerLayoutCompensated();
-    mSpatializer = scene.setSpatializer<Lbap>(sl);
+    mSpatializer = scene.setSpatializer<ProfiledSpatializer<Lbap>>(sl);
 
     audioIO().channelsOut(60);
     audioIO().print();
@@ -181,6 +243,7 @@ public:
 
     // Prepare GUI
     if (isPrimary()) {
+      playground::DspProfiler::get().enable();
       auto guiDomain = GUIDomain::enableGUI(defaultWindowDomain());
       auto &gui = guiDomain->newGUI();
       gui << downMix << mSequencer << audioDomain()->parameters()[0];
@@ -190,6 +253,7 @@ public:
           mObjectData.audioSampleRate = audioIO().framesPerSecond();
           mObjectData.audioBlockSize = audioIO().framesPerBuffer();
         }
+        playground::drawDspLoad(); // per voice class and stage
       };
     }
     CuttleboneDomain<SharedState>::enableCuttlebone(this);
@@ -205,17 +269,31 @@ public:
   }
 
   void onAnimate(double dt) override {
-    mSequencer.update(dt);
+    PLAYGROUND_TRACE_THREAD("graphics");
+    PLAYGROUND_TRACE_ZONE("onAnimate");
+    {
+      PLAYGROUND_TRACE_ZONE("SynthSequencer");
+      mSequencer.update(dt);
+    }
     if (isPrimary()) {
-      auto &values = mMeter.getMeterValues();
-      assert(values.size() < 65);
-      memcpy(state().meterValues, values.data(), values.size() * sizeof(float));
-    } else {
-      mMeter.setMeterValues(state().meterValues, 64);
+      // Levels are measured on the audio thread and written into the shared
+      // state here
+      mLevels.update(state().meterValues, 64);
+      state().frame++;
+    } else if (state().frame != mStateFrame) {
+      // Cuttlebone has delivered a new state since the last frame
+      PLAYGROUND_TRACE_INSTANT("state received");
+      if (mStateFrame != 0) {
+        PLAYGROUND_TRACE_COUNTER("state frames skipped",
+                                 state().frame - mStateFrame - 1);
+      }
+      mStateFrame = state().frame;
     }
+    mMeter.setMeterValues(state().meterValues, 64); // for drawing
   }
 
   void onDraw(Graphics &g) override {
+    PLAYGROUND_TRACE_ZONE("onDraw");
     g.clear(0, 0, 0);
     g.pushMatrix();
     if (isPrimary()) {
@@ -237,10 +315,20 @@ public:
   }
 
   void onSound(AudioIOData &io) override {
-    mSequencer.render(io);
-    mMeter.processSound(io);
+    PLAYGROUND_RT_SCOPE("onSound"); // checked with -DPLAYGROUND_RT_SANITIZER
+    PLAYGROUND_DSP_ZONE("onSound");
+    PLAYGROUND_TRACE_THREAD("audio");
+    PLAYGROUND_TRACE_ZONE("onSound");
+    {
+      PLAYGROUND_DSP_ZONE("scene");
+      mSequencer.render(io);
+    }
+    mLevels.processSound(io);
     // downmix to stereo to bus 0 and 1
-    downMixer.downMixToBus(io);
+    {
+      PLAYGROUND_DSP_ZONE("DownMixer");
+      downMixer.downMixToBus(io);
+    }
     // This can be used to create a global reverb
     while (io()) {
       float lfeLevel = 0.1;
@@ -248,6 +336,7 @@ public:
       io.out(47) += io.bus(1) * lfeLevel;
     }
     if (downMix) {
+      PLAYGROUND_DSP_ZONE("DownMixer");
       downMixer.copyBusToOuts(io);
     }
   }
@@ -262,20 +351,34 @@ private:
   AudioObjectData mObjectData;
   SpeakerDistanceGainAdjustmentProcessor gainAdjustment;
   Meter mMeter;
+  playground::LevelMeter mLevels;
   std::shared_ptr<Spatializer> mSpatializer;
+  uint32_t mStateFrame{0}; // last state().frame seen by a renderer
 };
 
 int main(int argc, char *argv[]) {
   SpatialSequencer app;
 
-  std::string folder;
-  if (argc > 1) {
-    folder = argv[1];
-  } else {
-    folder = "Morris Allosphere piece";
+  // spatial_sequencer [folder] [--trace trace.json]
+  std::string folder = "Morris Allosphere piece";
+  std::string tracePath;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+      tracePath = argv[++i];
+    } else {
+      folder = argv[i];
+    }
   }
   app.setPath(folder);
 
+  // Audio, graphics, preset steps and state arrival on one timeline, for
+  // chrome://tracing or ui.perfetto.dev. Give each machine its own path.
+  if (!tracePath.empty() &&
+      !playground::TraceRecorder::get().start(tracePath)) {
+    std::cerr << "ERROR: could not write trace " << tracePath << std::endl;
+  }
+
   app.start();
+  playground::TraceRecorder::get().stop();
   return 0;
 }
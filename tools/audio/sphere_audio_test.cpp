@@ -26,6 +26,8 @@
 #include "Gamma/Noise.h"
 #include "Gamma/scl.h"
 
+#include "playground/LevelMeter.hpp"
+
 using namespace al;
 
 struct SharedState {
@@ -46,48 +48,19 @@ public:
     mSl = sl;
   }
 
-  void processSound(AudioIOData &io) {
+  // Audio thread
+  void processSound(AudioIOData &io) { mLevels.processSound(io); }
 
-    if (tempValues.size() != io.channelsOut()) {
-      tempValues.resize(io.channelsOut());
-      values.resize(io.channelsOut());
-      std::cout << "Resizing Meter buffers" << std::endl;
-    }
-    for (int i = 0; i < io.channelsOut(); i++) {
-      tempValues[i] = FLT_MIN;
-      auto *outBuf = io.outBuffer(i);
-      auto fpb = io.framesPerBuffer();
-      for (int samp = 0; samp < fpb; samp++) {
-        float val = fabs(*outBuf);
-        if (tempValues[i] < val) {
-          tempValues[i] = val;
-        }
-        outBuf++;
-      }
-      if (tempValues[i] == 0) {
-        tempValues[i] = 0.01;
-      } else {
-        float db = 20.0 * log10(tempValues[i]);
-        if (db < -60) {
-          tempValues[i] = 0.01;
-        } else {
-          tempValues[i] = 0.01 + 0.005 * (60 + db);
-        }
-      }
-      if (values[i] > tempValues[i]) {
-        values[i] = values[i] - 0.05 * (values[i] - tempValues[i]);
-      } else {
-        values[i] = tempValues[i];
-      }
-    }
-  }
+  // Graphics thread: write meter values for the blocks measured since the
+  // last call straight into values
+  void update(float *values, int count) { mLevels.update(values, count); }
 
-  void draw(Graphics &g) {
+  void draw(Graphics &g, const float *values, int count) {
     g.polygonLine();
-    int index = 0;
     auto spkrIt = mSl.begin();
     g.color(1);
-    for (const auto &v : values) {
+    for (int index = 0; index < count; index++) {
+      const float v = values[index];
       if (spkrIt != mSl.end()) {
         // FIXME assumes speakers are sorted by device channel index
         // Should sort inside init()
@@ -103,29 +76,12 @@ public:
       } else {
         spkrIt = mSl.begin();
       }
-      index++;
-    }
-  }
-
-  const std::vector<float> &getMeterValues() { return values; }
-
-  void setMeterValues(float *newValues, size_t count) {
-    if (tempValues.size() != count) {
-      tempValues.resize(count);
-      values.resize(count);
-      std::cout << "Resizing Meter buffers" << std::endl;
-    }
-    count = values.size();
-    for (int i = 0; i < count; i++) {
-      values[i] = *newValues;
-      newValues++;
     }
   }
 
 private:
   Mesh mMesh;
-  std::vector<float> values;
-  std::vector<float> tempValues;
+  playground::LevelMeter mLevels;
   Speakers mSl;
 };
 
@@ -302,12 +258,9 @@ public:
   void onAnimate(double dt) override {
     mSequencer.update(dt);
     if (isPrimary()) {
-      auto &values = mMeter.getMeterValues();
-      assert(values.size() < 65);
-      memcpy(state().meterValues, values.data(), values.size() * sizeof(float));
+      mMeter.update(state().meterValues, 64);
       state().pose = nav();
     } else {
-      mMeter.setMeterValues(state().meterValues, 64);
       nav().set(state().pose);
     }
   }
@@ -327,7 +280,7 @@ public:
       g.draw(mSphereMesh);
       g.popMatrix();
     }
-    mMeter.draw(g);
+    mMeter.draw(g, state().meterValues, 64);
 
     mSequencer.render(g);
     g.popMatrix();
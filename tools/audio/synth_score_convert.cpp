@@ -0,0 +1,65 @@
+// Converts .synthSequence text files to memory mapped .synthScore files
+// (see include/playground/ScoreFile.hpp) and prints what a .synthScore holds.
+//
+// Usage:
+//   synth_score_convert input.synthSequence [output.synthScore]
+//   synth_score_convert --info file.synthScore
+
+#include <cstdio>
+#include <string>
+
+#include "playground/ScoreFile.hpp"
+
+int printInfo(const std::string &path) {
+  playground::ScoreFile score;
+  if (!score.open(path)) {
+    fprintf(stderr, "Can't open %s\n", path.c_str());
+    return 1;
+  }
+  printf("%s\n", path.c_str());
+  printf("  %zu notes, %.2f s\n", score.numNotes(), score.length());
+  printf("  voices:");
+  for (auto &name : score.voiceNames()) {
+    printf(" %s", name.c_str());
+  }
+  printf("\n");
+  size_t shown = score.numNotes() < 5 ? score.numNotes() : 5;
+  for (size_t i = 0; i < shown; i++) {
+    playground::ScoreNote note = score.note(i);
+    printf("  @ %g %g %s", note.start, note.duration, note.name->c_str());
+    for (int p = 0; p < note.numParams; p++) {
+      printf(" %g", note.params[p]);
+    }
+    printf("\n");
+  }
+  if (shown < score.numNotes()) {
+    printf("  ...\n");
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s input.synthSequence [output.synthScore]\n"
+           "       %s --info file.synthScore\n",
+           argv[0], argv[0]);
+    return 1;
+  }
+  std::string first = argv[1];
+  if (first == "--info") {
+    return argc > 2 ? printInfo(argv[2]) : 1;
+  }
+
+  std::string output;
+  if (argc > 2) {
+    output = argv[2];
+  } else {
+    size_t dot = first.rfind('.');
+    output = (dot == std::string::npos ? first : first.substr(0, dot)) +
+             ".synthScore";
+  }
+  if (!playground::convertSynthSequence(first, output)) {
+    return 1;
+  }
+  return printInfo(output);
+}
@@ -0,0 +1,58 @@
+// Converts text .ico icospheres (as used by cookbook/blob) to memory mapped
+// .icomesh files (see include/playground/IcoMesh.hpp) and prints what a
+// .icomesh holds.
+//
+// Usage:
+//   ico_mesh_convert input.ico [output.icomesh]
+//   ico_mesh_convert --info file.icomesh
+
+#include <cstdio>
+#include <string>
+
+#include "playground/IcoMesh.hpp"
+
+int printInfo(const std::string &path) {
+  playground::IcoMeshFile file;
+  if (!file.open(path)) {
+    fprintf(stderr, "Can't open %s\n", path.c_str());
+    return 1;
+  }
+  printf("%s\n", path.c_str());
+  printf("  %d vertices, %zu triangles, %zu neighbors\n", file.numVertices(),
+         file.numIndices() / 3, file.numNeighbors());
+  int minDegree = file.numVertices() > 0 ? 1 << 30 : 0;
+  int maxDegree = 0;
+  for (int i = 0; i < file.numVertices(); i++) {
+    const int degree = file.neighborOffsets()[i + 1] - file.neighborOffsets()[i];
+    minDegree = degree < minDegree ? degree : minDegree;
+    maxDegree = degree > maxDegree ? degree : maxDegree;
+  }
+  printf("  %d to %d neighbors per vertex\n", minDegree, maxDegree);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s input.ico [output.icomesh]\n"
+           "       %s --info file.icomesh\n",
+           argv[0], argv[0]);
+    return 1;
+  }
+  std::string first = argv[1];
+  if (first == "--info") {
+    return argc > 2 ? printInfo(argv[2]) : 1;
+  }
+
+  std::string output;
+  if (argc > 2) {
+    output = argv[2];
+  } else {
+    size_t dot = first.rfind('.');
+    output = (dot == std::string::npos ? first : first.substr(0, dot)) +
+             ".icomesh";
+  }
+  if (!playground::convertIcoText(first, output)) {
+    return 1;
+  }
+  return printInfo(output);
+}
@@ -12,7 +12,6 @@
 #include "Gamma/Gamma.h"
 #include "Gamma/Oscillator.h"
 #include "Gamma/Types.h"
-#include "Gamma/DFT.h"
 
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
@@ -23,10 +22,16 @@
 #include "al/io/al_MIDI.hpp"
 #include "al/math/al_Random.hpp"
 
+#include "playground/AnalysisBus.hpp"
+
 // using namespace gam;
 using namespace al;
 using namespace std;
-#define FFT_SIZE 4048
+#define FFT_SIZE 4096
+
+// Spectra of every note and of the mix. Voices push their output and the bus
+// analyzes it on its own thread, so no voice runs an FFT in the callback.
+playground::AnalysisBus spectra(FFT_SIZE, FFT_SIZE / 4);
 
 class PluckedString : public SynthVoice
 {
@@ -42,7 +47,7 @@ public:
     gam::ADSR<> mAmpEnv;
     gam::EnvFollow<> mEnvFollow;
     gam::Env<2> mPanEnv;
-    gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+    int mSpectrumChannel; // in spectra
     // This time, let's use spectrograms for each notes as the visual components.
     Mesh mSpectrogram;
     vector<float> spectrum;
@@ -56,6 +61,7 @@ public:
     {
         // Declare the size of the spectrum
         spectrum.resize(FFT_SIZE / 2 + 1);
+        mSpectrumChannel = spectra.addChannel();
         // mSpectrogram.primitive(Mesh::POINTS);
         mSpectrogram.primitive(Mesh::LINE_STRIP);
         mAmpEnv.levels(0, 1, 1, 0);
@@ -99,16 +105,10 @@ public:
             mPan(s1, s1, s2);
             io.out(0) += s1;
             io.out(1) += s2;
-            // STFT for each notes
-            if (stft(s1))
-            { // Loop through all the frequency bins
-                for (unsigned k = 0; k < stft.numBins(); ++k)
-                {
-                    // Here we simply scale the complex sample
-                    spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-                }
-            }
+            // Spectrum for each note, analyzed by spectra
+            spectra.push(mSpectrumChannel, s1);
         }
+        spectra.publish(mSpectrumChannel);
         if (mAmpEnv.done() && (mEnvFollow.value() < 0.001))
             free();
     }
@@ -124,8 +124,11 @@ public:
         mSpectrogram.reset();
         // mSpectrogram.primitive(Mesh::LINE_STRIP);
 
+        const float *magnitudes = spectra.spectrum(mSpectrumChannel);
         for (int i = 0; i < FFT_SIZE / 2; i++)
         {
+            // Here we simply scale the magnitude
+            spectrum[i] = tanh(pow(magnitudes[i], 1.3));
             mSpectrogram.color(HSV(spectrum[i] * 1000 + al::rnd::uniform()));
             mSpectrogram.vertex(i, spectrum[i], 0.0);
         }
@@ -182,7 +185,7 @@ public:
     bool showGUI = true;
     bool showSpectro = true;
     bool navi = false;
-    gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+    int mixSpectrum; // in spectra
 
     virtual void onInit() override
     {
@@ -209,6 +212,7 @@ public:
         }
         // Declare the size of the spectrum
         spectrum.resize(FFT_SIZE / 2 + 1);
+        mixSpectrum = spectra.addChannel();
     }
 
     void onCreate() override
@@ -221,19 +225,12 @@ public:
     void onSound(AudioIOData &io) override
     {
         synthManager.render(io); // Render audio
-        // STFT
+        // Spectrum of the mix, analyzed off the audio thread
         while (io())
         {
-            if (stft(io.out(0)))
-            { // Loop through all the frequency bins
-                for (unsigned k = 0; k < stft.numBins(); ++k)
-                {
-                    // Here we simply scale the complex sample
-                    spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-                    // spectrum[k] = stft.bin(k).real();
-                }
-            }
-        }        
+            spectra.push(mixSpectrum, io.out(0));
+        }
+        spectra.publish(mixSpectrum);
     }
 
     void onAnimate(double dt) override
@@ -253,8 +250,11 @@ public:
         mSpectrogram.primitive(Mesh::LINE_STRIP);
         if (showSpectro)
         {
+            const float *magnitudes = spectra.spectrum(mixSpectrum);
             for (int i = 0; i < FFT_SIZE / 2; i++)
             {
+                // Here we simply scale the magnitude
+                spectrum[i] = tanh(pow(magnitudes[i], 1.3));
                 mSpectrogram.color(HSV(0.5 - spectrum[i] * 100));
                 mSpectrogram.vertex(i, spectrum[i], 0.0);
             }
@@ -17,7 +17,6 @@
 #include "Gamma/Gamma.h"
 #include "Gamma/Oscillator.h"
 #include "Gamma/Types.h"
-#include "Gamma/DFT.h"
 
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
@@ -28,11 +27,13 @@
 #include "al/io/al_MIDI.hpp"
 #include "al/math/al_Random.hpp"
 #include "_instrument_classes.cpp"
+#include "playground/DspProfilerPanel.hpp"
+#include "playground/RtSanitizer.hpp"
 
 using namespace gam;
 using namespace al;
 using namespace std;
-#define FFT_SIZE 4048
+#define FFT_SIZE 4096
 
 class MyApp : public App, public MIDIMessageHandler
 {
@@ -53,7 +54,7 @@ public:
   bool showGUI = true;
   bool showSpectro = true;
   bool navi = false;
-  gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+  int mixSpectrum; // in voiceSpectra, analyzed alongside the voices
 
   virtual void onInit() override
   {
@@ -75,6 +76,9 @@ public:
     }
     // Declare the size of the spectrum
     spectrum.resize(FFT_SIZE / 2 + 1);
+    mixSpectrum = voiceSpectra.addChannel();
+    // Time the voices (see _instrument_classes.cpp) for the "DSP load" panel
+    playground::DspProfiler::get().enable();
 
     imguiInit();
     navControl().active(false); // Disable navigation via keyboard, since we
@@ -103,20 +107,15 @@ public:
 
   void onSound(AudioIOData &io) override
   {
+    PLAYGROUND_RT_SCOPE("onSound"); // checked with -DPLAYGROUND_RT_SANITIZER
+    PLAYGROUND_DSP_ZONE("onSound");
     synthManager.render(io); // Render audio
-    // STFT
+    // Spectrum of the mix, analyzed off the audio thread
     while (io())
     {
-      if (stft(io.out(0)))
-      { // Loop through all the frequency bins
-        for (unsigned k = 0; k < stft.numBins(); ++k)
-        {
-          // Here we simply scale the complex sample
-          spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-          // spectrum[k] = stft.bin(k).real();
-        }
-      }
+      voiceSpectra.push(mixSpectrum, io.out(0));
     }
+    voiceSpectra.publish(mixSpectrum);
   }
 
   void onAnimate(double dt) override
@@ -124,21 +123,29 @@ public:
     navControl().active(navi); // Disable navigation via keyboard, since we
     imguiBeginFrame();
     synthManager.drawSynthControlPanel();
+    ParameterGUI::beginPanel("DSP load");
+    playground::drawDspLoad();
+    ParameterGUI::endPanel();
     imguiEndFrame();
   }
 
   void onDraw(Graphics &g) override
   {
     g.clear();
-    // Render the synth's graphics
+    // Render the synth's graphics: voices add their meshes to voiceMeshes,
+    // which draws all copies of each mesh at once
     synthManager.render(g);
+    voiceMeshes.draw(g);
     // // Draw Spectrum
     mSpectrogram.reset();
     mSpectrogram.primitive(Mesh::LINE_STRIP);
     if (showSpectro)
     {
+      const float *magnitudes = voiceSpectra.spectrum(mixSpectrum);
       for (int i = 0; i < FFT_SIZE / 2; i++)
       {
+        // Here we simply scale the magnitude
+        spectrum[i] = tanh(pow(magnitudes[i], 1.3));
         mSpectrogram.color(HSV(0.5 - spectrum[i] * 100));
         mSpectrogram.vertex(i, spectrum[i], 0.0);
       }
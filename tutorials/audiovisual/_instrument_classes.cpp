@@ -1,5 +1,6 @@
 // Just Instrument Classes
 
+#include <algorithm>
 #include <cstdio> // for printing to stdout
 
 #include "Gamma/Analysis.h"
@@ -8,7 +9,6 @@
 #include "Gamma/Gamma.h"
 #include "Gamma/Oscillator.h"
 #include "Gamma/Types.h"
-#include "Gamma/DFT.h"
 
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
@@ -19,17 +19,114 @@
 #include "al/io/al_MIDI.hpp"
 #include "al/math/al_Random.hpp"
 
+#include "playground/AnalysisBus.hpp"
+#include "playground/DspProfiler.hpp"
+#include "playground/InstanceBatch.hpp"
+#include "playground/OscillatorBank.hpp"
+#include "playground/ParameterHandle.hpp"
+#include "playground/VoiceStager.hpp"
+#include "playground/WavetableBank.hpp"
+
 using namespace gam;
 using namespace al;
 using namespace std;
-#define FFT_SIZE 4048
-// tables for oscillator
-gam::ArrayPow2<float> tbSaw(2048), tbSqr(2048), tbImp(2048), tbSin(2048), tbDin(2048),
-    tbPls(2048), tb__1(2048), tb__2(2048), tb__3(2048), tb__4(2048);
+using playground::OscillatorBank;
+using playground::ParameterHandle;
+using playground::PreparedVoice;
+using playground::WavetableBank;
+#define FFT_SIZE 4096
 Vec3f randomVec3f(float scale)
 {
   return Vec3f(al::rnd::uniformS(), al::rnd::uniformS(), al::rnd::uniformS()) * scale;
 }
+
+// Meshes shared by all voices, built once by the first voice that needs them.
+// A voice's onProcess(Graphics &) adds its copy with voiceMeshes.add(), and
+// the app draws all copies of each mesh in one call with voiceMeshes.draw(g)
+// after rendering the synth.
+playground::InstanceBatch voiceMeshes;
+
+// Spectra of the voices that draw one. Voices push their output and the bus
+// analyzes it on its own thread, so no voice runs an FFT in the callback.
+playground::AnalysisBus voiceSpectra(FFT_SIZE, FFT_SIZE / 4);
+
+// Every voice times its onProcess(AudioIOData &) with PLAYGROUND_DSP_VOICE,
+// so apps that enable the DspProfiler see the load of each class.
+
+// Sphere drawn by SineEnv
+int smallSphereMesh()
+{
+  static const int id = [] {
+    Mesh m;
+    addSphere(m, 0.3, 50, 50);
+    m.decompress();
+    m.generateNormals();
+    return voiceMeshes.addMesh(m);
+  }();
+  return id;
+}
+
+// Unit sphere drawn by FM, AddSyn, OscAM and Sub
+int ballMesh()
+{
+  static const int id = [] {
+    Mesh m;
+    addSphere(m, 1, 100, 100);
+    m.decompress();
+    m.generateNormals();
+    return voiceMeshes.addMesh(m);
+  }();
+  return id;
+}
+
+// One mesh per oscillator table in WavetableBank, in the order of the "table"
+// parameter, drawn by OscEnv, Vib, FMWT and OscTrm
+const int *waveformMeshes()
+{
+  static const int numb_waveform = WavetableBank::NUM_TABLES;
+  struct Meshes
+  {
+    int id[numb_waveform];
+    Meshes()
+    {
+      Mesh mMesh[numb_waveform];
+      addCone(mMesh[0], 1, Vec3f(0, 0, 5), 40, 1); // SAW
+      addCube(mMesh[1]);                           // SQUARE
+      addPrism(mMesh[2], 1, 1, 1, 100);            // IMPULSE
+      addSphere(mMesh[3], 0.3, 16, 100);           // SINE
+      addWireBox(mMesh[4], 2);                     // PULSE
+
+      // Boxes sized by the partials of each table
+      float scaler = 0.15;
+      float hscaler = 1;
+      for (int k = WavetableBank::PARTIALS_1; k < numb_waveform; ++k)
+      {
+        const auto &p = WavetableBank::recipe(k).partials;
+        for (int i = 0; i < 7; i++)
+        {
+          if (k == WavetableBank::PARTIALS_4)
+            addWireBox(mMesh[k], hscaler * p[i].amplitude, hscaler * p[i + 1].amplitude, 1 + 0.3 * i);
+          else
+            addWireBox(mMesh[k], scaler * p[i].amplitude * p[i].harmonic,
+                       scaler * p[i + 1].amplitude * p[i + 1].harmonic, 1 + 0.3 * i);
+        }
+      }
+
+      // Scale and generate normals. Vertex colors are left out, as voices
+      // draw in a single color.
+      for (int i = 0; i < numb_waveform; ++i)
+      {
+        mMesh[i].scale(0.4);
+        if (mMesh[i].primitive() == Mesh::TRIANGLES)
+          mMesh[i].decompress();
+        mMesh[i].generateNormals();
+        id[i] = voiceMeshes.addMesh(mMesh[i]);
+      }
+    }
+  };
+  static const Meshes meshes;
+  return meshes.id;
+}
 // 01_SineEnv
 class SineEnv : public SynthVoice
 {
@@ -41,13 +138,16 @@ public:
   // envelope follower to connect audio output to graphics
   gam::EnvFollow<> mEnvFollow;
   // Draw parameters
-  Mesh mMesh;
+  int mMesh; // in voiceMeshes
   double a = 0;
   double b = 0;
   double timepose = 0;
   Vec3f note_position;
   Vec3f note_direction;
 
+  // Parameter handles, resolved once in init()
+  ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pPan;
+
   // Additional members
   // Initialize voice. This function will only be called once per voice when
   // it is created. Voices will be reused if they are idle.
@@ -59,9 +159,7 @@ public:
     mAmpEnv.sustainPoint(2); // Make point 2 sustain until a release is issued
 
     // We have the mesh be a sphere
-    addSphere(mMesh, 0.3, 50, 50);
-    mMesh.decompress();
-    mMesh.generateNormals();
+    mMesh = smallSphereMesh();
 
     // This is a quick way to create parameters for the voice. Trigger
     // parameters are meant to be set only when the voice starts, i.e. they
@@ -69,11 +167,11 @@ public:
     // change them while you are prototyping, but their changes will only be
     // stored and aplied when a note is triggered.)
 
-    createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-    createInternalTriggerParameter("frequency", 60, 20, 5000);
-    createInternalTriggerParameter("attackTime", 1.0, 0.01, 3.0);
-    createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    pAmplitude = createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
+    pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+    pAttackTime = createInternalTriggerParameter("attackTime", 1.0, 0.01, 3.0);
+    pReleaseTime = createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
 
     // Initalize MIDI device input
   }
@@ -81,19 +179,21 @@ public:
   // The audio processing function
   void onProcess(AudioIOData &io) override
   {
+    PLAYGROUND_DSP_VOICE(this);
     // Get the values from the parameters and apply them to the corresponding
     // unit generators. You could place these lines in the onTrigger() function,
     // but placing them here allows for realtime prototyping on a running
     // voice, rather than having to trigger a new voice to hear the changes.
     // Parameters will update values once per audio callback because they
     // are outside the sample processing loop.
-    mOsc.freq(getInternalParameterValue("frequency"));
-    mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
-    mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
-    mPan.pos(getInternalParameterValue("pan"));
+    mOsc.freq(pFrequency.get());
+    mAmpEnv.lengths()[0] = pAttackTime.get();
+    mAmpEnv.lengths()[2] = pReleaseTime.get();
+    mPan.pos(pPan.get());
+    float amp = pAmplitude.get();
     while (io())
     {
-      float s1 = mOsc() * mAmpEnv() * getInternalParameterValue("amplitude");
+      float s1 = mOsc() * mAmpEnv() * amp;
       float s2;
       mEnvFollow(s1);
       mPan(s1, s1, s2);
@@ -108,26 +208,22 @@ public:
   }
 
   // The graphics processing function
-  void onProcess(Graphics &g) override
+  void onProcess(Graphics &) override
   {
     a += 0.29;
     b += 0.23;
     timepose += 0.02;
     // Get the paramter values on every video frame, to apply changes to the
     // current instance
-    float frequency = getInternalParameterValue("frequency");
-    float amplitude = getInternalParameterValue("amplitude");
-    // Now draw
-    g.pushMatrix();
-    g.depthTesting(true);
-    g.lighting(true);
-    g.translate(note_position + note_direction * timepose);
-    g.rotate(a, Vec3f(0, 1, 0));
-    g.rotate(b, Vec3f(1));
-    g.scale(0.3 + mAmpEnv() * 0.2, 0.3 + mAmpEnv() * 0.5, amplitude);
-    g.color(HSV(frequency / 1000, 0.5 + mAmpEnv() * 0.1, 0.3 + 0.5 * mAmpEnv()));
-    g.draw(mMesh);
-    g.popMatrix();
+    float frequency = pFrequency.get();
+    float amplitude = pAmplitude.get();
+    // Now draw, along with the other voices
+    playground::InstanceBatch::Transform t;
+    t.translate(note_position + note_direction * timepose);
+    t.rotate(a, Vec3f(0, 1, 0));
+    t.rotate(b, Vec3f(1));
+    t.scale(0.3 + mAmpEnv() * 0.2, 0.3 + mAmpEnv() * 0.5, amplitude);
+    voiceMeshes.add(mMesh, t, HSV(frequency / 1000, 0.5 + mAmpEnv() * 0.1, 0.3 + 0.5 * mAmpEnv()));
   }
 
   // The triggering functions just need to tell the envelope to start or release
@@ -135,7 +231,7 @@ public:
   // the voice from the processing chain.
   void onTriggerOn() override
   {
-    float angle = getInternalParameterValue("frequency") / 200;
+    float angle = pFrequency.get() / 200;
     mAmpEnv.reset();
     a = al::rnd::uniform();
     b = al::rnd::uniform();
@@ -158,14 +254,15 @@ class OscEnv : public SynthVoice {
       mEnvFollow;  // envelope follower to connect audio output to graphics
   int mtable;
   // Additional members
-  static const int numb_waveform = 9;
-  Mesh mMesh[numb_waveform];
-  bool wireframe = false;
-  bool vertexLight = false;
+  const int *mMeshes; // in voiceMeshes, one per table
   double a_rotate = 0;
   double b_rotate = 0;
   double timepose = 0;
 
+  // Parameter handles, resolved once in init()
+  ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pSustain,
+      pCurve, pPan, pTable;
+
   // Initialize voice. This function will nly be called once per voice
   void init() override {
     // Intialize envelope
@@ -174,109 +271,25 @@ class OscEnv : public SynthVoice {
                    0);  // These tables are not normalized, so scale to 0.3
     mAmpEnv.sustainPoint(2);  // Make point 2 sustain until a release is issued
 
-    createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
-    createInternalTriggerParameter("frequency", 60, 20, 5000);
-    createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-    createInternalTriggerParameter("releaseTime", 1.0, 0.1, 10.0);
-    createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
-    createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
-    createInternalTriggerParameter("table", 0, 0, 8);
-
-    // Table & Visual meshes
-    // Now We have the mesh according to the waveform
-    gam::addSinesPow<1>(tbSaw, 9, 1);
-    addCone(mMesh[0],1, Vec3f(0,0,5), 40, 1); //tbSaw
-
-    gam::addSinesPow<1>(tbSqr, 9, 2);
-    addCube(mMesh[1]);  // tbSquare
-
-    gam::addSinesPow<0>(tbImp, 9, 1);
-    addPrism(mMesh[2],1,1,1,100); // tbImp
-
-    gam::addSine(tbSin);
-    addSphere(mMesh[3], 0.3, 16, 100); // tbSin
-
-// About: addSines (dst, amps, cycs, numh)
-// \param[out] dst		destination array
-// \param[in] amps		harmonic amplitudes of series, size must be numh - A[]
-// \param[in] cycs		harmonic numbers of series, size must be numh - C[]
-// \param[in] numh		total number of harmonics
-    float scaler = 0.15;
-    float hscaler = 1;
-
-    { //tbPls
-      float A[] = {1, 1, 1, 1, 0.7, 0.5, 0.3, 0.1};
-      gam::addSines(tbPls, A, 8); 
-      addWireBox(mMesh[4],2);    // tbPls
-    }
-    { // tb__1 
-      float A[] = {1, 0.4, 0.65, 0.3, 0.18, 0.08, 0, 0};
-      float C[] = {1, 4, 7, 11, 15, 18, 0, 0 };
-      gam::addSines(tb__1, A, C, 6);
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[5], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-
-        // addSphere(mMesh[5],scaler * A[i], 16, 30); // tb__1
-      }
-    }
-    { // inharmonic partials
-      float A[] = {0.5, 0.8, 0.7, 1, 0.3, 0.4, 0.2, 0.12};
-      float C[] = {3, 4, 7, 8, 11, 12, 15, 16}; 
-      gam::addSines(tb__2, A, C, 8); // tb__2
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[6], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-      }
-    }
-    { // inharmonic partials
-      float A[] = {1, 0.7, 0.45, 0.3, 0.15, 0.08, 0 , 0};
-      float C[] = {10, 27, 54, 81, 108, 135, 0, 0};
-      gam::addSines(tb__3, A, C, 6); // tb__3
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[7], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-      }
-    }
-  { // harmonics 20-27
-      float A[] = {0.2, 0.4, 0.6, 1, 0.7, 0.5, 0.3, 0.1};
-      gam::addSines(tb__4, A, 8, 20); // tb__4
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[8], hscaler * A[i], hscaler * A[i+1], 1 + 0.3*i);
-      }
-    }
-    // { // Write your own waveform!
-    //   float A[] = {1, 1, 1, 1, 1, 1};
-    //   float C[] = {2, 3, 5, 7, 11, 13}; // prime numbers?
-    //   gam::addSines(tb__3, A, C, 6);
-    //   addPrism(mMesh[7], scaler * A[0]*C[0], scaler * A[1]*C[1], 1, 100, 27);// tb__2
-    //   addPrism(mMesh[7], scaler * A[2]*C[2], scaler * A[3]*C[3], 2, 100, 27*2);// tb__2
-    //   addPrism(mMesh[7], scaler * A[4]*C[4], scaler * A[5]*C[5], 3, 100, 27*3); // tb__3
-    // }
-
-
-//int addSurfaceLoop(Mesh& m, int Nx, int Ny, int loopMode, double width, double height, double x, double y) 
-
-
-    // Scale and generate normals
-    for (int i = 0; i < numb_waveform; ++i) {
-      mMesh[i].scale(0.4);
-
-      int Nv = mMesh[i].vertices().size();
-      for (int k = 0; k < Nv; ++k) {
-        mMesh[i].color(HSV(float(k) / Nv, 0.3, 1));
-      }
-
-      if (!vertexLight && mMesh[i].primitive() == Mesh::TRIANGLES) {
-        mMesh[i].decompress();
-      }
-      mMesh[i].generateNormals();
-    }
+    pAmplitude = createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
+    pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+    pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+    pReleaseTime = createInternalTriggerParameter("releaseTime", 1.0, 0.1, 10.0);
+    pSustain = createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
+    pCurve = createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    pTable = createInternalTriggerParameter("table", 0, 0, 8);
+
+    // Meshes, one per oscillator table, shared by all voices
+    mMeshes = waveformMeshes();
   }
 
   virtual void onProcess(AudioIOData& io) override {
+    PLAYGROUND_DSP_VOICE(this);
     updateFromParameters();
+    float amp = pAmplitude.get();
     while (io()) {
-      float s1 =
-          0.1 * mOsc() * mAmpEnv() * getInternalParameterValue("amplitude");
+      float s1 = 0.1 * mOsc() * mAmpEnv() * amp;
       float s2;
       mEnvFollow(s1);
       mPan(s1, s1, s2);
@@ -289,29 +302,20 @@ class OscEnv : public SynthVoice {
     if (mAmpEnv.done() && (mEnvFollow.value() < 0.001f)) free();
   }
 
-  void onProcess(Graphics& g) override {
+  void onProcess(Graphics &) override {
     a_rotate += 0.81;
     b_rotate += 0.78;
     timepose -= 0.06;
-    float frequency = getInternalParameterValue("frequency");
-    float amplitude = getInternalParameterValue("amplitude");
-    int shape = getInternalParameterValue("table");
-
-    // static Light light;
-    g.polygonMode(wireframe ? GL_LINE : GL_FILL);
-    // light.pos(0, 0, 0);
-    gl::depthTesting(true);
-    g.lighting(true);
-    // g.light(light);
-    g.pushMatrix();
-    g.depthTesting(true);
-    g.translate( timepose, getInternalParameterValue("frequency") / 200 - 3 , -15);
-    g.rotate(a_rotate, Vec3f(0, 1, 1));
-    g.rotate(b_rotate, Vec3f(1));    
-    g.scale(0.5 + mAmpEnv() * 2, 0.5 + mAmpEnv() * 2, 0.03 + 0.1*mAmpEnv() );
-    g.color(HSV(frequency / 1000, 0.6 + mAmpEnv() * 0.1, 0.6 + 0.5 * mAmpEnv()));
-    g.draw(mMesh[shape]);
-    g.popMatrix();
+    float frequency = pFrequency.get();
+    float amplitude = pAmplitude.get();
+    int shape = pTable.get();
+
+    playground::InstanceBatch::Transform t;
+    t.translate( timepose, pFrequency.get() / 200 - 3 , -15);
+    t.rotate(a_rotate, Vec3f(0, 1, 1));
+    t.rotate(b_rotate, Vec3f(1));    
+    t.scale(0.5 + mAmpEnv() * 2, 0.5 + mAmpEnv() * 2, 0.03 + 0.1*mAmpEnv() );
+    voiceMeshes.add(mMeshes[shape], t, HSV(frequency / 1000, 0.6 + mAmpEnv() * 0.1, 0.6 + 0.5 * mAmpEnv()));
   } 
 
   virtual void onTriggerOn() override {
@@ -324,45 +328,18 @@ class OscEnv : public SynthVoice {
   virtual void onTriggerOff() override { mAmpEnv.triggerRelease(); }
 
   void updateFromParameters() {
-    mOsc.freq(getInternalParameterValue("frequency"));
-    mAmpEnv.attack(getInternalParameterValue("attackTime"));
-    mAmpEnv.decay(getInternalParameterValue("attackTime"));
-    mAmpEnv.release(getInternalParameterValue("releaseTime"));
-    mAmpEnv.sustain(getInternalParameterValue("sustain"));
-    mAmpEnv.curve(getInternalParameterValue("curve"));
-    mPan.pos(getInternalParameterValue("pan"));
+    mOsc.freq(pFrequency.get());
+    mAmpEnv.attack(pAttackTime.get());
+    mAmpEnv.decay(pAttackTime.get());
+    mAmpEnv.release(pReleaseTime.get());
+    mAmpEnv.sustain(pSustain.get());
+    mAmpEnv.curve(pCurve.get());
+    mPan.pos(pPan.get());
   }
-  void updateWaveform(){
-        // Map table number to table in memory
-    switch (int(getInternalParameterValue("table"))) {
-      case 0:
-        mOsc.source(tbSaw);
-        break;
-      case 1:
-        mOsc.source(tbSqr);
-        break;
-      case 2:
-        mOsc.source(tbImp);
-        break;
-      case 3:
-        mOsc.source(tbSin);
-        break;
-      case 4:
-        mOsc.source(tbPls);
-        break;
-      case 5:
-        mOsc.source(tb__1);
-        break;
-      case 6:
-        mOsc.source(tb__2);
-        break;
-      case 7:
-        mOsc.source(tb__3);
-        break;
-      case 8:
-        mOsc.source(tb__4);
-        break;
-    }
+  void updateWaveform() {
+    // Map table number to the shared table, band limited for the note
+    mOsc.source(WavetableBank::get().table(int(pTable.get()), pFrequency.get(),
+                                           gam::sampleRate()));
   }
 
 };
@@ -379,16 +356,17 @@ class Vib : public SynthVoice {
   gam::EnvFollow<> mEnvFollow;  // envelope follower to connect audio output to graphics
   int mtable;
   // Additional members
-  static const int numb_waveform = 9;
-  Mesh mMesh[numb_waveform];
-  bool wireframe = false;
-  bool vertexLight = false;
+  const int *mMeshes; // in voiceMeshes, one per table
   double a_rotate = 0;
   double b_rotate = 0;
   double timepose = 0;
   float vibValue;
   float outFreq;
   
+  // Parameter handles, resolved once in init()
+  ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pSustain,
+      pCurve, pPan, pTable, pVibRate1, pVibRate2, pVibRise, pVibDepth;
+
   // Initialize voice. This function will nly be called once per voice
   void init() override {
     // Intialize envelope
@@ -398,108 +376,36 @@ class Vib : public SynthVoice {
     mAmpEnv.sustainPoint(2);  // Make point 2 sustain until a release is issued
     mVibEnv.curve(0);
 
-    createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
-    createInternalTriggerParameter("frequency", 60, 20, 5000);
-    createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-    createInternalTriggerParameter("releaseTime", 1.0, 0.1, 10.0);
-    createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
-    createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
-    createInternalTriggerParameter("table", 0, 0, 8);
-    createInternalTriggerParameter("vibRate1", 3.5, 0.2, 20);
-    createInternalTriggerParameter("vibRate2", 5.8, 0.2, 20);
-    createInternalTriggerParameter("vibRise", 0.5, 0.1, 2);
-    createInternalTriggerParameter("vibDepth", 0.005, 0.0, 0.3);
-
-    // Table & Visual meshes
-    // Now We have the mesh according to the waveform
-    gam::addSinesPow<1>(tbSaw, 9, 1);
-    addCone(mMesh[0],1, Vec3f(0,0,5), 40, 1); //tbSaw
-
-    gam::addSinesPow<1>(tbSqr, 9, 2);
-    addCube(mMesh[1]);  // tbSquare
-
-    gam::addSinesPow<0>(tbImp, 9, 1);
-    addPrism(mMesh[2],1,1,1,100); // tbImp
-
-    gam::addSine(tbSin);
-    addSphere(mMesh[3], 0.3, 16, 100); // tbSin
-
-// About: addSines (dst, amps, cycs, numh)
-// \param[out] dst		destination array
-// \param[in] amps		harmonic amplitudes of series, size must be numh - A[]
-// \param[in] cycs		harmonic numbers of series, size must be numh - C[]
-// \param[in] numh		total number of harmonics
-    float scaler = 0.15;
-    float hscaler = 1;
-
-    { //tbPls
-      float A[] = {1, 1, 1, 1, 0.7, 0.5, 0.3, 0.1};
-      gam::addSines(tbPls, A, 8); 
-      addWireBox(mMesh[4],2);    // tbPls
-    }
-    { // tb__1 
-      float A[] = {1, 0.4, 0.65, 0.3, 0.18, 0.08, 0, 0};
-      float C[] = {1, 4, 7, 11, 15, 18, 0, 0 };
-      gam::addSines(tb__1, A, C, 6);
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[5], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-
-        // addSphere(mMesh[5],scaler * A[i], 16, 30); // tb__1
-      }
-    }
-    { // inharmonic partials
-      float A[] = {0.5, 0.8, 0.7, 1, 0.3, 0.4, 0.2, 0.12};
-      float C[] = {3, 4, 7, 8, 11, 12, 15, 16}; 
-      gam::addSines(tb__2, A, C, 8); // tb__2
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[6], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-      }
-    }
-    { // inharmonic partials
-      float A[] = {1, 0.7, 0.45, 0.3, 0.15, 0.08, 0 , 0};
-      float C[] = {10, 27, 54, 81, 108, 135, 0, 0};
-      gam::addSines(tb__3, A, C, 6); // tb__3
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[7], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-      }
-    }
-  { // harmonics 20-27
-      float A[] = {0.2, 0.4, 0.6, 1, 0.7, 0.5, 0.3, 0.1};
-      gam::addSines(tb__4, A, 8, 20); // tb__4
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[8], hscaler * A[i], hscaler * A[i+1], 1 + 0.3*i);
-      }
-    }
-
-    // Scale and generate normals
-    for (int i = 0; i < numb_waveform; ++i) {
-      mMesh[i].scale(0.4);
-
-      int Nv = mMesh[i].vertices().size();
-      for (int k = 0; k < Nv; ++k) {
-        mMesh[i].color(HSV(float(k) / Nv, 0.3, 1));
-      }
-
-      if (!vertexLight && mMesh[i].primitive() == Mesh::TRIANGLES) {
-        mMesh[i].decompress();
-      }
-      mMesh[i].generateNormals();
-    }
+    pAmplitude = createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
+    pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+    pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+    pReleaseTime = createInternalTriggerParameter("releaseTime", 1.0, 0.1, 10.0);
+    pSustain = createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
+    pCurve = createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    pTable = createInternalTriggerParameter("table", 0, 0, 8);
+    pVibRate1 = createInternalTriggerParameter("vibRate1", 3.5, 0.2, 20);
+    pVibRate2 = createInternalTriggerParameter("vibRate2", 5.8, 0.2, 20);
+    pVibRise = createInternalTriggerParameter("vibRise", 0.5, 0.1, 2);
+    pVibDepth = createInternalTriggerParameter("vibDepth", 0.005, 0.0, 0.3);
+
+    // Meshes, one per oscillator table, shared by all voices
+    mMeshes = waveformMeshes();
   }
 
   //
   virtual void onProcess(AudioIOData& io) override {
+    PLAYGROUND_DSP_VOICE(this);
     updateFromParameters();
-    float oscFreq = getInternalParameterValue("frequency");
-    float vibDepth = getInternalParameterValue("vibDepth");
+    float oscFreq = pFrequency.get();
+    float vibDepth = pVibDepth.get();
+    float amp = pAmplitude.get();
     outFreq = oscFreq + vibValue * vibDepth * oscFreq;
     while (io()) {
       mVib.freq(mVibEnv());
       vibValue = mVib();
        mOsc.freq(outFreq);
-      float s1 =
-          0.1 * mOsc() * mAmpEnv() * getInternalParameterValue("amplitude");
+      float s1 = 0.1 * mOsc() * mAmpEnv() * amp;
       float s2;
       mEnvFollow(s1);
       mPan(s1, s1, s2);
@@ -512,26 +418,17 @@ class Vib : public SynthVoice {
     if (mAmpEnv.done() && (mEnvFollow.value() < 0.001f)) free();
   }
 
-  void onProcess(Graphics& g) override {
+  void onProcess(Graphics &) override {
     a_rotate += 0.81;
     b_rotate += 0.78;
     timepose -= 0.06;
-    int shape = getInternalParameterValue("table");
-    // static Light light;
-    g.polygonMode(wireframe ? GL_LINE : GL_FILL);
-    // light.pos(0, 0, 0);
-    gl::depthTesting(true);
-    g.lighting(true);
-    // g.light(light);
-    g.pushMatrix();
-    g.depthTesting(true);
-    g.translate( timepose, outFreq / 200 - 3 , -15);
-    g.rotate(a_rotate, Vec3f(0, 1, 1));
-    g.rotate(b_rotate, Vec3f(1));    
-    g.scale(0.5 + mAmpEnv() * 2, 0.5 + mAmpEnv() * 2, 0.03 + 0.1*mAmpEnv() );
-    g.color(HSV(outFreq / 1000, 0.6 + mAmpEnv() * 0.1, 0.6 + 0.5 * mAmpEnv()));
-    g.draw(mMesh[shape]);
-    g.popMatrix();
+    int shape = pTable.get();
+    playground::InstanceBatch::Transform t;
+    t.translate( timepose, outFreq / 200 - 3 , -15);
+    t.rotate(a_rotate, Vec3f(0, 1, 1));
+    t.rotate(b_rotate, Vec3f(1));    
+    t.scale(0.5 + mAmpEnv() * 2, 0.5 + mAmpEnv() * 2, 0.03 + 0.1*mAmpEnv() );
+    voiceMeshes.add(mMeshes[shape], t, HSV(outFreq / 1000, 0.6 + mAmpEnv() * 0.1, 0.6 + 0.5 * mAmpEnv()));
   } 
 
   virtual void onTriggerOn() override {
@@ -548,52 +445,25 @@ class Vib : public SynthVoice {
   }
 
   void updateFromParameters() {
-    mOsc.freq(getInternalParameterValue("frequency"));
-    mAmpEnv.attack(getInternalParameterValue("attackTime"));
-    mAmpEnv.decay(getInternalParameterValue("attackTime"));
-    mAmpEnv.release(getInternalParameterValue("releaseTime"));
-    mAmpEnv.sustain(getInternalParameterValue("sustain"));
-    mAmpEnv.curve(getInternalParameterValue("curve"));
-    mPan.pos(getInternalParameterValue("pan"));
-    mVibEnv.levels(getInternalParameterValue("vibRate1"),
-                   getInternalParameterValue("vibRate2"),
-                   getInternalParameterValue("vibRate2"),
-                   getInternalParameterValue("vibRate1"));
-    mVibEnv.lengths()[0] = getInternalParameterValue("vibRise");
-    mVibEnv.lengths()[1] = getInternalParameterValue("vibRise");
-    mVibEnv.lengths()[3] = getInternalParameterValue("vibRise");
+    mOsc.freq(pFrequency.get());
+    mAmpEnv.attack(pAttackTime.get());
+    mAmpEnv.decay(pAttackTime.get());
+    mAmpEnv.release(pReleaseTime.get());
+    mAmpEnv.sustain(pSustain.get());
+    mAmpEnv.curve(pCurve.get());
+    mPan.pos(pPan.get());
+    mVibEnv.levels(pVibRate1.get(),
+                   pVibRate2.get(),
+                   pVibRate2.get(),
+                   pVibRate1.get());
+    mVibEnv.lengths()[0] = pVibRise.get();
+    mVibEnv.lengths()[1] = pVibRise.get();
+    mVibEnv.lengths()[3] = pVibRise.get();
   }
-  void updateWaveform(){
-        // Map table number to table in memory
-    switch (int(getInternalParameterValue("table"))) {
-      case 0:
-        mOsc.source(tbSaw);
-        break;
-      case 1:
-        mOsc.source(tbSqr);
-        break;
-      case 2:
-        mOsc.source(tbImp);
-        break;
-      case 3:
-        mOsc.source(tbSin);
-        break;
-      case 4:
-        mOsc.source(tbPls);
-        break;
-      case 5:
-        mOsc.source(tb__1);
-        break;
-      case 6:
-        mOsc.source(tb__2);
-        break;
-      case 7:
-        mOsc.source(tb__3);
-        break;
-      case 8:
-        mOsc.source(tb__4);
-        break;
-    }
+  void updateWaveform() {
+    // Map table number to the shared table, band limited for the note
+    mOsc.source(WavetableBank::get().table(int(pTable.get()), pFrequency.get(),
+                                           gam::sampleRate()));
   }
 
 };
@@ -613,13 +483,18 @@ public:
   double a = 0;
   double b = 0;
   double timepose = 10;
-  Mesh ball;
+  int ball; // in voiceMeshes
 
   // Additional members
   float mVibFrq;
   float mVibDepth;
   float mVibRise;
 
+  // Parameter handles, resolved once in init()
+  ParameterHandle pFrequency, pAmplitude, pAttackTime, pReleaseTime, pSustain,
+      pIdx1, pIdx2, pIdx3, pCarMul, pModMul, pVibRate1, pVibRate2, pVibRise,
+      pVibDepth, pPan;
+
   void init() override
   {
     mAmpEnv.curve(0); // linear segments
@@ -629,42 +504,41 @@ public:
     mModEnv.levels(0, 1, 1, 0);
     mVibEnv.levels(0, 1, 1, 0);
     //      mVibEnv.curve(0);
-    addSphere(ball, 1, 100, 100);
-    ball.decompress();
-    ball.generateNormals();
+    ball = ballMesh();
 
     // We have the mesh be a sphere
-    createInternalTriggerParameter("frequency", 440, 10, 4000.0);
-    createInternalTriggerParameter("amplitude", 0.05, 0.0, 1.0);
-    createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-    createInternalTriggerParameter("releaseTime", 0.5, 0.1, 10.0);
-    createInternalTriggerParameter("sustain", 0.65, 0.1, 1.0);
+    pFrequency = createInternalTriggerParameter("frequency", 440, 10, 4000.0);
+    pAmplitude = createInternalTriggerParameter("amplitude", 0.05, 0.0, 1.0);
+    pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+    pReleaseTime = createInternalTriggerParameter("releaseTime", 0.5, 0.1, 10.0);
+    pSustain = createInternalTriggerParameter("sustain", 0.65, 0.1, 1.0);
 
     // FM index
-    createInternalTriggerParameter("idx1", 0.01, 0.0, 10.0);
-    createInternalTriggerParameter("idx2", 7, 0.0, 10.0);
-    createInternalTriggerParameter("idx3", 5, 0.0, 10.0);
+    pIdx1 = createInternalTriggerParameter("idx1", 0.01, 0.0, 10.0);
+    pIdx2 = createInternalTriggerParameter("idx2", 7, 0.0, 10.0);
+    pIdx3 = createInternalTriggerParameter("idx3", 5, 0.0, 10.0);
 
-    createInternalTriggerParameter("carMul", 1, 0.0, 20.0);
-    createInternalTriggerParameter("modMul", 1.0007, 0.0, 20.0);
+    pCarMul = createInternalTriggerParameter("carMul", 1, 0.0, 20.0);
+    pModMul = createInternalTriggerParameter("modMul", 1.0007, 0.0, 20.0);
 
-    createInternalTriggerParameter("vibRate1", 0.01, 0.0, 10.0);
-    createInternalTriggerParameter("vibRate2", 0.5, 0.0, 10.0);
-    createInternalTriggerParameter("vibRise", 0, 0.0, 10.0);
-    createInternalTriggerParameter("vibDepth", 0, 0.0, 10.0);
+    pVibRate1 = createInternalTriggerParameter("vibRate1", 0.01, 0.0, 10.0);
+    pVibRate2 = createInternalTriggerParameter("vibRate2", 0.5, 0.0, 10.0);
+    pVibRise = createInternalTriggerParameter("vibRise", 0, 0.0, 10.0);
+    pVibDepth = createInternalTriggerParameter("vibDepth", 0, 0.0, 10.0);
 
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
   }
 
   //
   void onProcess(AudioIOData &io) override
   {
+    PLAYGROUND_DSP_VOICE(this);
     mVib.freq(mVibEnv());
     float carBaseFreq =
-        getInternalParameterValue("frequency") * getInternalParameterValue("carMul");
+        pFrequency.get() * pCarMul.get();
     float modScale =
-        getInternalParameterValue("frequency") * getInternalParameterValue("modMul");
-    float amp = getInternalParameterValue("amplitude");
+        pFrequency.get() * pModMul.get();
+    float amp = pAmplitude.get();
     while (io())
     {
       mVib.freq(mVibEnv());
@@ -681,22 +555,18 @@ public:
       free();
   }
 
-  void onProcess(Graphics &g) override
+  void onProcess(Graphics &) override
   {
     a += 0.29;
     b += 0.23;
     timepose -= 0.06;
-    g.pushMatrix();
-    g.depthTesting(true);
-    g.lighting(true);
-    g.translate(timepose, getInternalParameterValue("frequency") / 200 - 3, -15);
-    g.rotate(mVib() + a, Vec3f(0, 1, 0));
-    g.rotate(mVibDepth + b, Vec3f(1));
-    float scaling = getInternalParameterValue("amplitude") / 10;
-    g.scale(scaling + getInternalParameterValue("modMul") / 10, scaling + getInternalParameterValue("carMul") / 30, scaling + mEnvFollow.value() * 5);
-    g.color(HSV(getInternalParameterValue("modMul") / 20, getInternalParameterValue("carMul") / 20, 0.5 + getInternalParameterValue("attackTime")));
-    g.draw(ball);
-    g.popMatrix();
+    playground::InstanceBatch::Transform t;
+    t.translate(timepose, pFrequency.get() / 200 - 3, -15);
+    t.rotate(mVib() + a, Vec3f(0, 1, 0));
+    t.rotate(mVibDepth + b, Vec3f(1));
+    float scaling = pAmplitude.get() / 10;
+    t.scale(scaling + pModMul.get() / 10, scaling + pCarMul.get() / 30, scaling + mEnvFollow.value() * 5);
+    voiceMeshes.add(ball, t, HSV(pModMul.get() / 20, pCarMul.get() / 20, 0.5 + pAttackTime.get()));
   }
 
   void onTriggerOn() override
@@ -710,7 +580,7 @@ public:
     updateFromParameters();
 
     float modFreq =
-        getInternalParameterValue("frequency") * getInternalParameterValue("modMul");
+        pFrequency.get() * pModMul.get();
     mod.freq(modFreq);
   }
   void onTriggerOff() override
@@ -722,28 +592,28 @@ public:
 
   void updateFromParameters()
   {
-    mModEnv.levels()[0] = getInternalParameterValue("idx1");
-    mModEnv.levels()[1] = getInternalParameterValue("idx2");
-    mModEnv.levels()[2] = getInternalParameterValue("idx2");
-    mModEnv.levels()[3] = getInternalParameterValue("idx3");
-
-    mAmpEnv.attack(getInternalParameterValue("attackTime"));
-    mAmpEnv.release(getInternalParameterValue("releaseTime"));
-    mAmpEnv.sustain(getInternalParameterValue("sustain"));
-
-    mModEnv.lengths()[0] = getInternalParameterValue("attackTime");
-    mModEnv.lengths()[3] = getInternalParameterValue("releaseTime");
-
-    mVibEnv.levels(getInternalParameterValue("vibRate1"),
-                   getInternalParameterValue("vibRate2"),
-                   getInternalParameterValue("vibRate2"),
-                   getInternalParameterValue("vibRate1"));
-    mVibEnv.lengths()[0] = getInternalParameterValue("vibRise");
-    mVibEnv.lengths()[1] = getInternalParameterValue("vibRise");
-    mVibEnv.lengths()[3] = getInternalParameterValue("vibRise");
-    mVibDepth = getInternalParameterValue("vibDepth");
+    mModEnv.levels()[0] = pIdx1.get();
+    mModEnv.levels()[1] = pIdx2.get();
+    mModEnv.levels()[2] = pIdx2.get();
+    mModEnv.levels()[3] = pIdx3.get();
+
+    mAmpEnv.attack(pAttackTime.get());
+    mAmpEnv.release(pReleaseTime.get());
+    mAmpEnv.sustain(pSustain.get());
+
+    mModEnv.lengths()[0] = pAttackTime.get();
+    mModEnv.lengths()[3] = pReleaseTime.get();
+
+    mVibEnv.levels(pVibRate1.get(),
+                   pVibRate2.get(),
+                   pVibRate2.get(),
+                   pVibRate1.get());
+    mVibEnv.lengths()[0] = pVibRise.get();
+    mVibEnv.lengths()[1] = pVibRise.get();
+    mVibEnv.lengths()[3] = pVibRise.get();
+    mVibDepth = pVibDepth.get();
     
-    mPan.pos(getInternalParameterValue("pan"));
+    mPan.pos(pPan.get());
   }
 };
 
@@ -768,10 +638,12 @@ public:
   float mVibDepth;
   float mVibRise;
   int mtable;
-  static const int numb_waveform = 9;
-  Mesh mMesh[numb_waveform];
-  bool wireframe = false;
-  bool vertexLight = false;
+  const int *mMeshes; // in voiceMeshes, one per table
+
+  // Parameter handles, resolved once in init()
+  ParameterHandle pFrequency, pAmplitude, pAttackTime, pReleaseTime, pSustain,
+      pIdx1, pIdx2, pIdx3, pCarMul, pModMul, pVibRate1, pVibRate2, pVibRise,
+      pVibDepth, pPan, pTable;
 
   void init() override
   {
@@ -782,103 +654,30 @@ public:
     mAmpEnv.sustainPoint(2);
 
     // We have the mesh be a sphere
-    createInternalTriggerParameter("frequency", 440, 10, 4000.0);
-    createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
-    createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-    createInternalTriggerParameter("releaseTime", 0.3, 0.1, 10.0);
-    createInternalTriggerParameter("sustain", 0.65, 0.1, 1.0);
+    pFrequency = createInternalTriggerParameter("frequency", 440, 10, 4000.0);
+    pAmplitude = createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
+    pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+    pReleaseTime = createInternalTriggerParameter("releaseTime", 0.3, 0.1, 10.0);
+    pSustain = createInternalTriggerParameter("sustain", 0.65, 0.1, 1.0);
 
     // FM index
-    createInternalTriggerParameter("idx1", 0.01, 0.0, 10.0);
-    createInternalTriggerParameter("idx2", 7, 0.0, 10.0);
-    createInternalTriggerParameter("idx3", 5, 0.0, 10.0);
-
-    createInternalTriggerParameter("carMul", 1, 0.0, 20.0);
-    createInternalTriggerParameter("modMul", 1.0007, 0.0, 20.0);
-
-    createInternalTriggerParameter("vibRate1", 0.01, 0.0, 10.0);
-    createInternalTriggerParameter("vibRate2", 0.5, 0.0, 10.0);
-    createInternalTriggerParameter("vibRise", 0, 0.0, 10.0);
-    createInternalTriggerParameter("vibDepth", 0, 0.0, 10.0);
-
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
-    createInternalTriggerParameter("table", 0, 0, 8);
-
-    // Table & Visual meshes
-    // Now We have the mesh according to the waveform
-    gam::addSinesPow<1>(tbSaw, 9, 1);
-    addCone(mMesh[0],1, Vec3f(0,0,5), 40, 1); //tbSaw
-
-    gam::addSinesPow<1>(tbSqr, 9, 2);
-    addCube(mMesh[1]);  // tbSquare
-
-    gam::addSinesPow<0>(tbImp, 9, 1);
-    addPrism(mMesh[2],1,1,1,100); // tbImp
-
-    gam::addSine(tbSin);
-    addSphere(mMesh[3], 0.3, 16, 100); // tbSin
-
-// About: addSines (dst, amps, cycs, numh)
-// \param[out] dst		destination array
-// \param[in] amps		harmonic amplitudes of series, size must be numh - A[]
-// \param[in] cycs		harmonic numbers of series, size must be numh - C[]
-// \param[in] numh		total number of harmonics
-    float scaler = 0.15;
-    float hscaler = 1;
-
-    { //tbPls
-      float A[] = {1, 1, 1, 1, 0.7, 0.5, 0.3, 0.1};
-      gam::addSines(tbPls, A, 8); 
-      addWireBox(mMesh[4],2);    // tbPls
-    }
-    { // tb__1 
-      float A[] = {1, 0.4, 0.65, 0.3, 0.18, 0.08, 0, 0};
-      float C[] = {1, 4, 7, 11, 15, 18, 0, 0 };
-      gam::addSines(tb__1, A, C, 6);
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[5], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-
-        // addSphere(mMesh[5],scaler * A[i], 16, 30); // tb__1
-      }
-    }
-    { // inharmonic partials
-      float A[] = {0.5, 0.8, 0.7, 1, 0.3, 0.4, 0.2, 0.12};
-      float C[] = {3, 4, 7, 8, 11, 12, 15, 16}; 
-      gam::addSines(tb__2, A, C, 8); // tb__2
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[6], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-      }
-    }
-    { // inharmonic partials
-      float A[] = {1, 0.7, 0.45, 0.3, 0.15, 0.08, 0 , 0};
-      float C[] = {10, 27, 54, 81, 108, 135, 0, 0};
-      gam::addSines(tb__3, A, C, 6); // tb__3
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[7], scaler * A[i]*C[i], scaler * A[i+1]*C[i+1], 1 + 0.3*i);
-      }
-    }
-  { // harmonics 20-27
-      float A[] = {0.2, 0.4, 0.6, 1, 0.7, 0.5, 0.3, 0.1};
-      gam::addSines(tb__4, A, 8, 20); // tb__4
-      for (int i = 0; i < 7; i++){
-        addWireBox(mMesh[8], hscaler * A[i], hscaler * A[i+1], 1 + 0.3*i);
-      }
-    }
+    pIdx1 = createInternalTriggerParameter("idx1", 0.01, 0.0, 10.0);
+    pIdx2 = createInternalTriggerParameter("idx2", 7, 0.0, 10.0);
+    pIdx3 = createInternalTriggerParameter("idx3", 5, 0.0, 10.0);
 
-    // Scale and generate normals
-    for (int i = 0; i < numb_waveform; ++i) {
-      mMesh[i].scale(0.4);
+    pCarMul = createInternalTriggerParameter("carMul", 1, 0.0, 20.0);
+    pModMul = createInternalTriggerParameter("modMul", 1.0007, 0.0, 20.0);
 
-      int Nv = mMesh[i].vertices().size();
-      for (int k = 0; k < Nv; ++k) {
-        mMesh[i].color(HSV(float(k) / Nv, 0.3, 1));
-      }
+    pVibRate1 = createInternalTriggerParameter("vibRate1", 0.01, 0.0, 10.0);
+    pVibRate2 = createInternalTriggerParameter("vibRate2", 0.5, 0.0, 10.0);
+    pVibRise = createInternalTriggerParameter("vibRise", 0, 0.0, 10.0);
+    pVibDepth = createInternalTriggerParameter("vibDepth", 0, 0.0, 10.0);
 
-      if (!vertexLight && mMesh[i].primitive() == Mesh::TRIANGLES) {
-        mMesh[i].decompress();
-      }
-      mMesh[i].generateNormals();
-    }
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    pTable = createInternalTriggerParameter("table", 0, 0, 8);
+
+    // Meshes, one per oscillator table, shared by all voices
+    mMeshes = waveformMeshes();
 
 
   }
@@ -886,11 +685,12 @@ public:
   //
   void onProcess(AudioIOData &io) override
   {
+    PLAYGROUND_DSP_VOICE(this);
     mVib.freq(mVibEnv());
     float carBaseFreq =
-        getInternalParameterValue("frequency") * getInternalParameterValue("carMul");
-    float modScale = getInternalParameterValue("frequency") * getInternalParameterValue("modMul");
-    float amp = getInternalParameterValue("amplitude") * 0.01;
+        pFrequency.get() * pCarMul.get();
+    float modScale = pFrequency.get() * pModMul.get();
+    float amp = pAmplitude.get() * 0.01;
     while (io())
     {
       mVib.freq(mVibEnv());
@@ -907,26 +707,19 @@ public:
       free();
   }
 
-  void onProcess(Graphics &g) override
+  void onProcess(Graphics &) override
   {
     a += 0.29;
     b += 0.23;
     timepose -= 0.06;
-    int shape = getInternalParameterValue("table");
-    g.polygonMode(wireframe ? GL_LINE : GL_FILL);
-    // light.pos(0, 0, 0);
-    gl::depthTesting(true);
-    g.pushMatrix();
-    g.depthTesting(true);
-    g.lighting(true);
-    g.translate(timepose, getInternalParameterValue("frequency") / 200 - 3, -15);
-    g.rotate(mVib() + a, Vec3f(0, 1, 0));
-    g.rotate(mVib() * mVibDepth + b, Vec3f(1));
-    float scaling = getInternalParameterValue("amplitude") * 10;
-    g.scale(scaling + getInternalParameterValue("modMul") / 2, scaling + getInternalParameterValue("carMul") / 20, scaling + mEnvFollow.value() * 5);
-    g.color(HSV(getInternalParameterValue("modMul") / 20, getInternalParameterValue("carMul") / 20, 0.5 + getInternalParameterValue("attackTime")));
-    g.draw(mMesh[shape]);
-    g.popMatrix();
+    int shape = pTable.get();
+    playground::InstanceBatch::Transform t;
+    t.translate(timepose, pFrequency.get() / 200 - 3, -15);
+    t.rotate(mVib() + a, Vec3f(0, 1, 0));
+    t.rotate(mVib() * mVibDepth + b, Vec3f(1));
+    float scaling = pAmplitude.get() * 10;
+    t.scale(scaling + pModMul.get() / 2, scaling + pCarMul.get() / 20, scaling + mEnvFollow.value() * 5);
+    voiceMeshes.add(mMeshes[shape], t, HSV(pModMul.get() / 20, pCarMul.get() / 20, 0.5 + pAttackTime.get()));
   }
 
   void onTriggerOn() override
@@ -941,7 +734,7 @@ public:
     updateWaveform();
 
     float modFreq =
-        getInternalParameterValue("frequency") * getInternalParameterValue("modMul");
+        pFrequency.get() * pModMul.get();
     mod.freq(modFreq);
   }
   void onTriggerOff() override
@@ -953,60 +746,33 @@ public:
 
   void updateFromParameters()
   {
-    mModEnv.levels()[0] = getInternalParameterValue("idx1");
-    mModEnv.levels()[1] = getInternalParameterValue("idx2");
-    mModEnv.levels()[2] = getInternalParameterValue("idx2");
-    mModEnv.levels()[3] = getInternalParameterValue("idx3");
-
-    mAmpEnv.attack(getInternalParameterValue("attackTime"));
-    mAmpEnv.release(getInternalParameterValue("releaseTime"));
-    mAmpEnv.sustain(getInternalParameterValue("sustain"));
-
-    mModEnv.lengths()[0] = getInternalParameterValue("attackTime");
-    mModEnv.lengths()[3] = getInternalParameterValue("releaseTime");
-
-    mVibEnv.levels(getInternalParameterValue("vibRate1"),
-                   getInternalParameterValue("vibRate2"),
-                   getInternalParameterValue("vibRate2"),
-                   getInternalParameterValue("vibRate1"));
-    mVibEnv.lengths()[0] = getInternalParameterValue("vibRise");
-    mVibEnv.lengths()[1] = getInternalParameterValue("vibRise");
-    mVibEnv.lengths()[3] = getInternalParameterValue("vibRise");
-    mVibDepth = getInternalParameterValue("vibDepth");
+    mModEnv.levels()[0] = pIdx1.get();
+    mModEnv.levels()[1] = pIdx2.get();
+    mModEnv.levels()[2] = pIdx2.get();
+    mModEnv.levels()[3] = pIdx3.get();
+
+    mAmpEnv.attack(pAttackTime.get());
+    mAmpEnv.release(pReleaseTime.get());
+    mAmpEnv.sustain(pSustain.get());
+
+    mModEnv.lengths()[0] = pAttackTime.get();
+    mModEnv.lengths()[3] = pReleaseTime.get();
+
+    mVibEnv.levels(pVibRate1.get(),
+                   pVibRate2.get(),
+                   pVibRate2.get(),
+                   pVibRate1.get());
+    mVibEnv.lengths()[0] = pVibRise.get();
+    mVibEnv.lengths()[1] = pVibRise.get();
+    mVibEnv.lengths()[3] = pVibRise.get();
+    mVibDepth = pVibDepth.get();
     
-    mPan.pos(getInternalParameterValue("pan"));
+    mPan.pos(pPan.get());
   }
-  void updateWaveform(){
-        // Map table number to table in memory
-    switch (int(getInternalParameterValue("table"))) {
-      case 0:
-        car.source(tbSaw);
-        break;
-      case 1:
-        car.source(tbSqr);
-        break;
-      case 2:
-        car.source(tbImp);
-        break;
-      case 3:
-        car.source(tbSin);
-        break;
-      case 4:
-        car.source(tbPls);
-        break;
-      case 5:
-        car.source(tb__1);
-        break;
-      case 6:
-        car.source(tb__2);
-        break;
-      case 7:
-        car.source(tb__3);
-        break;
-      case 8:
-        car.source(tb__4);
-        break;
-    }
+  void updateWaveform() {
+    // Map table number to the shared table, band limited for the note
+    car.source(WavetableBank::get().table(int(pTable.get()), pFrequency.get() * pCarMul.get(),
+                                          gam::sampleRate()));
   }
 
 
@@ -1026,13 +792,14 @@ public:
 
     // Additional members
     int mtable;
-    static const int numb_waveform = 9;
-    Mesh mMesh[numb_waveform];
-    bool wireframe = false;
-    bool vertexLight = false;
+    const int *mMeshes; // in voiceMeshes, one per table
     double a_rotate = 0;
     double b_rotate = 0;
     double timepose = 0;
+    // Parameter handles, resolved once in init()
+    ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pSustain,
+        pCurve, pPan, pTable, pTrm1, pTrm2, pTrmRise, pTrmDepth;
+
     // Initialize voice. This function will nly be called once per voice
     virtual void init()
     {
@@ -1041,110 +808,31 @@ public:
         mAmpEnv.levels(0, 0.3, 0.3, 0); // These tables are not normalized, so scale to 0.3
         mTrmEnv.curve(0);
         mTrmEnv.levels(0, 1, 1, 0);
-        createInternalTriggerParameter("amplitude", 0.03, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-        createInternalTriggerParameter("releaseTime", 2.0, 0.1, 10.0);
-        createInternalTriggerParameter("sustain", 0.6, 0.0, 1.0);
-        createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
-        createInternalTriggerParameter("table", 0, 0, 8);
-        createInternalTriggerParameter("trm1", 3.5, 0.2, 20);
-        createInternalTriggerParameter("trm2", 5.8, 0.2, 20);
-        createInternalTriggerParameter("trmRise", 0.5, 0.1, 2);
-        createInternalTriggerParameter("trmDepth", 0.1, 0.0, 1.0);
-
-        // Table & Visual meshes
-        // Now We have the mesh according to the waveform
-        gam::addSinesPow<1>(tbSaw, 9, 1);
-        addCone(mMesh[0], 1, Vec3f(0, 0, 5), 40, 1); // tbSaw
-
-        gam::addSinesPow<1>(tbSqr, 9, 2);
-        addCube(mMesh[1]); // tbSquare
-
-        gam::addSinesPow<0>(tbImp, 9, 1);
-        addPrism(mMesh[2], 1, 1, 1, 100); // tbImp
-
-        gam::addSine(tbSin);
-        addSphere(mMesh[3], 0.3, 16, 100); // tbSin
-
-        // About: addSines (dst, amps, cycs, numh)
-        // \param[out] dst		destination array
-        // \param[in] amps		harmonic amplitudes of series, size must be numh - A[]
-        // \param[in] cycs		harmonic numbers of series, size must be numh - C[]
-        // \param[in] numh		total number of harmonics
-        float scaler = 0.15;
-        float hscaler = 1;
-
-        { // tbPls
-            float A[] = {1, 1, 1, 1, 0.7, 0.5, 0.3, 0.1};
-            gam::addSines(tbPls, A, 8);
-            addWireBox(mMesh[4], 2); // tbPls
-        }
-        { // tb__1
-            float A[] = {1, 0.4, 0.65, 0.3, 0.18, 0.08, 0, 0};
-            float C[] = {1, 4, 7, 11, 15, 18, 0, 0};
-            gam::addSines(tb__1, A, C, 6);
-            for (int i = 0; i < 7; i++)
-            {
-                addWireBox(mMesh[5], scaler * A[i] * C[i], scaler * A[i + 1] * C[i + 1], 1 + 0.3 * i);
-
-                // addSphere(mMesh[5],scaler * A[i], 16, 30); // tb__1
-            }
-        }
-        { // inharmonic partials
-            float A[] = {0.5, 0.8, 0.7, 1, 0.3, 0.4, 0.2, 0.12};
-            float C[] = {3, 4, 7, 8, 11, 12, 15, 16};
-            gam::addSines(tb__2, A, C, 8); // tb__2
-            for (int i = 0; i < 7; i++)
-            {
-                addWireBox(mMesh[6], scaler * A[i] * C[i], scaler * A[i + 1] * C[i + 1], 1 + 0.3 * i);
-            }
-        }
-        { // inharmonic partials
-            float A[] = {1, 0.7, 0.45, 0.3, 0.15, 0.08, 0, 0};
-            float C[] = {10, 27, 54, 81, 108, 135, 0, 0};
-            gam::addSines(tb__3, A, C, 6); // tb__3
-            for (int i = 0; i < 7; i++)
-            {
-                addWireBox(mMesh[7], scaler * A[i] * C[i], scaler * A[i + 1] * C[i + 1], 1 + 0.3 * i);
-            }
-        }
-        { // harmonics 20-27
-            float A[] = {0.2, 0.4, 0.6, 1, 0.7, 0.5, 0.3, 0.1};
-            gam::addSines(tb__4, A, 8, 20); // tb__4
-            for (int i = 0; i < 7; i++)
-            {
-                addWireBox(mMesh[8], hscaler * A[i], hscaler * A[i + 1], 1 + 0.3 * i);
-            }
-        }
-
-        // Scale and generate normals
-        for (int i = 0; i < numb_waveform; ++i)
-        {
-            mMesh[i].scale(0.4);
-
-            int Nv = mMesh[i].vertices().size();
-            for (int k = 0; k < Nv; ++k)
-            {
-                mMesh[i].color(HSV(float(k) / Nv, 0.3, 1));
-            }
-
-            if (!vertexLight && mMesh[i].primitive() == Mesh::TRIANGLES)
-            {
-                mMesh[i].decompress();
-            }
-            mMesh[i].generateNormals();
-        }
+        pAmplitude = createInternalTriggerParameter("amplitude", 0.03, 0.0, 1.0);
+        pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+        pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+        pReleaseTime = createInternalTriggerParameter("releaseTime", 2.0, 0.1, 10.0);
+        pSustain = createInternalTriggerParameter("sustain", 0.6, 0.0, 1.0);
+        pCurve = createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
+        pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+        pTable = createInternalTriggerParameter("table", 0, 0, 8);
+        pTrm1 = createInternalTriggerParameter("trm1", 3.5, 0.2, 20);
+        pTrm2 = createInternalTriggerParameter("trm2", 5.8, 0.2, 20);
+        pTrmRise = createInternalTriggerParameter("trmRise", 0.5, 0.1, 2);
+        pTrmDepth = createInternalTriggerParameter("trmDepth", 0.1, 0.0, 1.0);
+
+        // Meshes, one per oscillator table, shared by all voices
+        mMeshes = waveformMeshes();
     }
 
     //
     virtual void onProcess(AudioIOData &io) override
     {
+        PLAYGROUND_DSP_VOICE(this);
         // updateFromParameters();
-        float oscFreq = getInternalParameterValue("frequency");
-        float amp = getInternalParameterValue("amplitude");
-        float trmDepth = getInternalParameterValue("trmDepth");
+        float oscFreq = pFrequency.get();
+        float amp = pAmplitude.get();
+        float trmDepth = pTrmDepth.get();
         while (io())
         {
 
@@ -1165,30 +853,21 @@ public:
             free();
     }
 
-    virtual void onProcess(Graphics &g)
+    virtual void onProcess(Graphics &)
     {
         a_rotate += 0.81;
         b_rotate += 0.78;
         timepose -= 0.06;
-        float frequency = getInternalParameterValue("frequency");
-        int shape = getInternalParameterValue("table");
-
-        // static Light light;
-        g.polygonMode(wireframe ? GL_LINE : GL_FILL);
-        // light.pos(0, 0, 0);
-        gl::depthTesting(true);
-        g.lighting(true);
-        // g.light(light);
-        g.pushMatrix();
-        g.depthTesting(true);
-        g.translate(timepose, getInternalParameterValue("frequency") / 200 - 3, -15);
-        g.rotate(a_rotate, Vec3f(0, 1, 1));
-        g.rotate(b_rotate, Vec3f(1));
-        g.scale(0.2 + mAmpEnv() * 0.2 + 0.01 * mTrm(), 0.3 + mAmpEnv() * 0.5 + 0.01 * mTrm(), 0.1 + 0.01 * mTrm());
-        g.scale(3 + mAmpEnv() * 0.5, 3 + mAmpEnv() * 0.5, 5 + mAmpEnv());
-        g.color(HSV(frequency / 1000, 0.6 + mAmpEnv() * 0.1, 0.6 + 0.5 * mAmpEnv()));
-        g.draw(mMesh[shape]);
-        g.popMatrix();
+        float frequency = pFrequency.get();
+        int shape = pTable.get();
+
+        playground::InstanceBatch::Transform t;
+        t.translate(timepose, pFrequency.get() / 200 - 3, -15);
+        t.rotate(a_rotate, Vec3f(0, 1, 1));
+        t.rotate(b_rotate, Vec3f(1));
+        t.scale(0.2 + mAmpEnv() * 0.2 + 0.01 * mTrm(), 0.3 + mAmpEnv() * 0.5 + 0.01 * mTrm(), 0.1 + 0.01 * mTrm());
+        t.scale(3 + mAmpEnv() * 0.5, 3 + mAmpEnv() * 0.5, 5 + mAmpEnv());
+        voiceMeshes.add(mMeshes[shape], t, HSV(frequency / 1000, 0.6 + mAmpEnv() * 0.1, 0.6 + 0.5 * mAmpEnv()));
     }
 
     virtual void onTriggerOn() override
@@ -1210,56 +889,28 @@ public:
 
     void updateFromParameters()
     {
-        mOsc.freq(getInternalParameterValue("frequency"));
-        mAmpEnv.attack(getInternalParameterValue("attackTime"));
-        mAmpEnv.decay(getInternalParameterValue("attackTime"));
-        mAmpEnv.release(getInternalParameterValue("releaseTime"));
-        mAmpEnv.sustain(getInternalParameterValue("sustain"));
-        mAmpEnv.curve(getInternalParameterValue("curve"));
-        mPan.pos(getInternalParameterValue("pan"));
-
-        mTrmEnv.levels(getInternalParameterValue("trm1"),
-                       getInternalParameterValue("trm2"),
-                       getInternalParameterValue("trm2"),
-                       getInternalParameterValue("trm1"));
-
-        mTrmEnv.attack(getInternalParameterValue("trmRise"));
-        mTrmEnv.decay(getInternalParameterValue("trmRise"));
-        mTrmEnv.release(getInternalParameterValue("trmRise"));
+        mOsc.freq(pFrequency.get());
+        mAmpEnv.attack(pAttackTime.get());
+        mAmpEnv.decay(pAttackTime.get());
+        mAmpEnv.release(pReleaseTime.get());
+        mAmpEnv.sustain(pSustain.get());
+        mAmpEnv.curve(pCurve.get());
+        mPan.pos(pPan.get());
+
+        mTrmEnv.levels(pTrm1.get(),
+                       pTrm2.get(),
+                       pTrm2.get(),
+                       pTrm1.get());
+
+        mTrmEnv.attack(pTrmRise.get());
+        mTrmEnv.decay(pTrmRise.get());
+        mTrmEnv.release(pTrmRise.get());
     }
     void updateWaveform()
     {
-        // Map table number to table in memory
-        switch (int(getInternalParameterValue("table")))
-        {
-        case 0:
-            mOsc.source(tbSaw);
-            break;
-        case 1:
-            mOsc.source(tbSqr);
-            break;
-        case 2:
-            mOsc.source(tbImp);
-            break;
-        case 3:
-            mOsc.source(tbSin);
-            break;
-        case 4:
-            mOsc.source(tbPls);
-            break;
-        case 5:
-            mOsc.source(tb__1);
-            break;
-        case 6:
-            mOsc.source(tb__2);
-            break;
-        case 7:
-            mOsc.source(tb__3);
-            break;
-        case 8:
-            mOsc.source(tb__4);
-            break;
-        }
+        // Map table number to the shared table, band limited for the note
+        mOsc.source(WavetableBank::get().table(int(pTable.get()), pFrequency.get(),
+                                               gam::sampleRate()));
     }
 };
 
@@ -1274,7 +925,7 @@ public:
   gam::EnvFollow<> mEnvFollow;
   gam::Pan<> mPan;
   int mtable;
-  Mesh mMesh;
+  int mMesh; // in voiceMeshes
   float a = 0.f; // current rotation angle
   bool wireframe = false;
   bool vertexLight = false;
@@ -1282,12 +933,14 @@ public:
   double b_rotate = 0;
   double timepose = 0;
   Vec3f spinner;
+  // Parameter handles, resolved once in init()
+  ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pSustain,
+      pPan, pAmFunc, pAm1, pAm2, pAmRise, pAmRatio;
+
   // Initialize voice. This function will nly be called once per voice
   virtual void init()
   {
-    addSphere(mMesh, 1, 100, 100);
-    mMesh.decompress();
-    mMesh.generateNormals();
+    mMesh = ballMesh();
     mAmpEnv.levels(0, 1, 1, 0);
     //    mAmpEnv.sustainPoint(1);
 
@@ -1297,25 +950,26 @@ public:
 
     // We have the mesh be a sphere
 
-    createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
-    createInternalTriggerParameter("frequency", 440, 10, 4000.0);
-    createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-    createInternalTriggerParameter("releaseTime", 4, 0.1, 10.0);
-    createInternalTriggerParameter("sustain", 0.3, 0.1, 1.0);
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
-    createInternalTriggerParameter("amFunc", 0.0, 0.0, 3.0);
-    createInternalTriggerParameter("am1", 0.75, 0.0, 1.0);
-    createInternalTriggerParameter("am2", 0.75, 0.0, 1.0);
-    createInternalTriggerParameter("amRise", 0.75, 0.1, 1.0);
-    createInternalTriggerParameter("amRatio", 0.75, 0.0, 2.0);
+    pAmplitude = createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
+    pFrequency = createInternalTriggerParameter("frequency", 440, 10, 4000.0);
+    pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+    pReleaseTime = createInternalTriggerParameter("releaseTime", 4, 0.1, 10.0);
+    pSustain = createInternalTriggerParameter("sustain", 0.3, 0.1, 1.0);
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    pAmFunc = createInternalTriggerParameter("amFunc", 0.0, 0.0, 3.0);
+    pAm1 = createInternalTriggerParameter("am1", 0.75, 0.0, 1.0);
+    pAm2 = createInternalTriggerParameter("am2", 0.75, 0.0, 1.0);
+    pAmRise = createInternalTriggerParameter("amRise", 0.75, 0.1, 1.0);
+    pAmRatio = createInternalTriggerParameter("amRatio", 0.75, 0.0, 2.0);
   }
 
   virtual void onProcess(AudioIOData &io) override
   {
-    mOsc.freq(getInternalParameterValue("frequency"));
+    PLAYGROUND_DSP_VOICE(this);
+    mOsc.freq(pFrequency.get());
 
-    float amp = getInternalParameterValue("amplitude");
-    float amRatio = getInternalParameterValue("amRatio");
+    float amp = pAmplitude.get();
+    float amRatio = pAmRatio.get();
     while (io())
     {
 
@@ -1340,73 +994,60 @@ public:
       free();
   }
 
-  virtual void onProcess(Graphics &g)
+  virtual void onProcess(Graphics &)
   {
-    float frequency = getInternalParameterValue("frequency");
-    float amplitude = getInternalParameterValue("amplitude");
-    float pan = getInternalParameterValue("pan");
-    int shape = getInternalParameterValue("table");
+    float frequency = pFrequency.get();
+    float amplitude = pAmplitude.get();
+    float pan = pPan.get();
     float radius = frequency / 300;
     b_rotate += 1.1;
     timepose -= 0.04;
-    // g.rotate(a_rotate, Vec3f(0, 1, 1));
-    // g.rotate(b_rotate, Vec3f(1));
+    // t.rotate(a_rotate, Vec3f(0, 1, 1));
+    // t.rotate(b_rotate, Vec3f(1));
 
-    gl::depthTesting(true);
-    g.lighting(true);
-    // g.light().dir(1.f, 1.f, 2.f);
-    g.pushMatrix();
-    g.translate(radius * sin(timepose) + 2, radius * cos(timepose), -15 + pan);
+    playground::InstanceBatch::Transform t;
+    t.translate(radius * sin(timepose) + 2, radius * cos(timepose), -15 + pan);
 
     // Rotate
-    g.rotate(b_rotate, spinner);
-    g.scale(0.05 * mAM() + 0.3);
+    t.rotate(b_rotate, spinner);
+    t.scale(0.05 * mAM() + 0.3);
     // center the model
-    g.color(HSV(mOsc.freq() * getInternalParameterValue("amRatio") / 1000 + mAM() * 0.01, 0.5 + mAmpEnv() * 0.5, 0.05 + 5 * mAmpEnv()));
-    g.draw(mMesh);
-    g.popMatrix();
+    voiceMeshes.add(mMesh, t, HSV(mOsc.freq() * pAmRatio.get() / 1000 + mAM() * 0.01, 0.5 + mAmpEnv() * 0.5, 0.05 + 5 * mAmpEnv()));
   }
 
   virtual void onTriggerOn() override
   {
-    mAmpEnv.attack(getInternalParameterValue("attackTime"));
+    mAmpEnv.attack(pAttackTime.get());
     mAmpEnv.lengths()[1] = 0.001;
-    mAmpEnv.release(getInternalParameterValue("releaseTime"));
+    mAmpEnv.release(pReleaseTime.get());
 
-    mAmpEnv.levels()[1] = getInternalParameterValue("sustain");
-    mAmpEnv.levels()[2] = getInternalParameterValue("sustain");
+    mAmpEnv.levels()[1] = pSustain.get();
+    mAmpEnv.levels()[2] = pSustain.get();
 
-    mAMEnv.levels(getInternalParameterValue("am1"),
-                  getInternalParameterValue("am2"),
-                  getInternalParameterValue("am2"),
-                  getInternalParameterValue("am1"));
+    mAMEnv.levels(pAm1.get(),
+                  pAm2.get(),
+                  pAm2.get(),
+                  pAm1.get());
 
-    mAMEnv.lengths(getInternalParameterValue("amRise"),
-                   1 - getInternalParameterValue("amRise"));
+    mAMEnv.lengths(pAmRise.get(),
+                   1 - pAmRise.get());
 
-    mPan.pos(getInternalParameterValue("pan"));
+    mPan.pos(pPan.get());
 
     mAmpEnv.reset();
     mAMEnv.reset();
     timepose = 0; // Initiate timeline
     b_rotate = al::rnd::uniform(0, 360);
     spinner = randomVec3f(1);
-    // Map table number to table in memory
-    switch (int(getInternalParameterValue("amFunc")))
-    {
-    case 0:
-      mAM.source(tbSin);
-      break;
-    case 1:
-      mAM.source(tbSqr);
-      break;
-    case 2:
-      mAM.source(tbPls);
-      break;
-    case 3:
-      mAM.source(tbDin);
-      break;
-    }
+    // Map table number to a bank table, band limited for the AM frequency.
+    // The inharmonic "Din" table of 06_AM_visual is PARTIALS_3.
+    static const int amTables[] = {WavetableBank::SINE, WavetableBank::SQUARE,
+                                   WavetableBank::PULSE,
+                                   WavetableBank::PARTIALS_3};
+    const int amFunc = std::min(std::max(int(pAmFunc.get()), 0), 3);
+    mAM.source(WavetableBank::get().table(amTables[amFunc],
+                                          pFrequency.get() * pAmRatio.get(),
+                                          gam::sampleRate()));
   }
 
   virtual void onTriggerOff() override
@@ -1420,16 +1061,14 @@ public:
 class AddSyn : public SynthVoice
 {
 public:
-  gam::Sine<> mOsc;
-  gam::Sine<> mOsc1;
-  gam::Sine<> mOsc2;
-  gam::Sine<> mOsc3;
-  gam::Sine<> mOsc4;
-  gam::Sine<> mOsc5;
-  gam::Sine<> mOsc6;
-  gam::Sine<> mOsc7;
-  gam::Sine<> mOsc8;
-  gam::Sine<> mOsc9;
+  // Partials grouped by the envelope they share
+  OscillatorBank<4> mStri; // 3 string partials
+  OscillatorBank<4> mLow;  // 2 low partials
+  OscillatorBank<4> mUp;   // 4 upper partials
+  static const int kBlock = 256;
+  float mStriBuf[kBlock];
+  float mLowBuf[kBlock];
+  float mUpBuf[kBlock];
   gam::ADSR<> mEnvStri;
   gam::ADSR<> mEnvLow;
   gam::ADSR<> mEnvUp;
@@ -1437,12 +1076,18 @@ public:
   gam::EnvFollow<> mEnvFollow;
 
   // Additional members
-  Mesh ball;
+  int ball; // in voiceMeshes
   double a = 0;
   double b = 0;
   double timepose = 0;
   Vec3f note_position;
   Vec3f note_direction;
+  // Parameter handles, resolved once in init()
+  ParameterHandle pAmp, pFrequency, pAmpStri, pAttackStri, pReleaseStri,
+      pSustainStri, pAmpLow, pAttackLow, pReleaseLow, pSustainLow, pAmpUp,
+      pAttackUp, pReleaseUp, pSustainUp, pFreqStri1, pFreqStri2, pFreqStri3,
+      pFreqLow1, pFreqLow2, pFreqUp1, pFreqUp2, pFreqUp3, pFreqUp4, pPan;
+
   virtual void init()
   {
 
@@ -1459,63 +1104,80 @@ public:
     mEnvUp.levels(0, 1, 1, 0);
     mEnvUp.lengths(0.1, 0.1, 0.1);
     mEnvUp.sustain(2); // Make point 2 sustain until a release is issued
+    mStri.size(3);
+    mLow.size(2);
+    mUp.size(4);
 
     // We have the mesh be a sphere
-    addSphere(ball, 1, 100, 100);
-    ball.decompress();
-    ball.generateNormals();
-
-    createInternalTriggerParameter("amp", 0.01, 0.0, 0.3);
-    createInternalTriggerParameter("frequency", 60, 20, 5000);
-    createInternalTriggerParameter("ampStri", 0.5, 0.0, 1.0);
-    createInternalTriggerParameter("attackStri", 0.1, 0.01, 3.0);
-    createInternalTriggerParameter("releaseStri", 0.1, 0.1, 10.0);
-    createInternalTriggerParameter("sustainStri", 0.8, 0.0, 1.0);
-    createInternalTriggerParameter("ampLow", 0.5, 0.0, 1.0);
-    createInternalTriggerParameter("attackLow", 0.001, 0.01, 3.0);
-    createInternalTriggerParameter("releaseLow", 0.1, 0.1, 10.0);
-    createInternalTriggerParameter("sustainLow", 0.8, 0.0, 1.0);
-    createInternalTriggerParameter("ampUp", 0.6, 0.0, 1.0);
-    createInternalTriggerParameter("attackUp", 0.01, 0.01, 3.0);
-    createInternalTriggerParameter("releaseUp", 0.075, 0.1, 10.0);
-    createInternalTriggerParameter("sustainUp", 0.9, 0.0, 1.0);
-    createInternalTriggerParameter("freqStri1", 1.0, 0.1, 10);
-    createInternalTriggerParameter("freqStri2", 2.001, 0.1, 10);
-    createInternalTriggerParameter("freqStri3", 3.0, 0.1, 10);
-    createInternalTriggerParameter("freqLow1", 4.009, 0.1, 10);
-    createInternalTriggerParameter("freqLow2", 5.002, 0.1, 10);
-    createInternalTriggerParameter("freqUp1", 6.0, 0.1, 10);
-    createInternalTriggerParameter("freqUp2", 7.0, 0.1, 10);
-    createInternalTriggerParameter("freqUp3", 8.0, 0.1, 10);
-    createInternalTriggerParameter("freqUp4", 9.0, 0.1, 10);
-    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    ball = ballMesh();
+
+    pAmp = createInternalTriggerParameter("amp", 0.01, 0.0, 0.3);
+    pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+    pAmpStri = createInternalTriggerParameter("ampStri", 0.5, 0.0, 1.0);
+    pAttackStri = createInternalTriggerParameter("attackStri", 0.1, 0.01, 3.0);
+    pReleaseStri = createInternalTriggerParameter("releaseStri", 0.1, 0.1, 10.0);
+    pSustainStri = createInternalTriggerParameter("sustainStri", 0.8, 0.0, 1.0);
+    pAmpLow = createInternalTriggerParameter("ampLow", 0.5, 0.0, 1.0);
+    pAttackLow = createInternalTriggerParameter("attackLow", 0.001, 0.01, 3.0);
+    pReleaseLow = createInternalTriggerParameter("releaseLow", 0.1, 0.1, 10.0);
+    pSustainLow = createInternalTriggerParameter("sustainLow", 0.8, 0.0, 1.0);
+    pAmpUp = createInternalTriggerParameter("ampUp", 0.6, 0.0, 1.0);
+    pAttackUp = createInternalTriggerParameter("attackUp", 0.01, 0.01, 3.0);
+    pReleaseUp = createInternalTriggerParameter("releaseUp", 0.075, 0.1, 10.0);
+    pSustainUp = createInternalTriggerParameter("sustainUp", 0.9, 0.0, 1.0);
+    pFreqStri1 = createInternalTriggerParameter("freqStri1", 1.0, 0.1, 10);
+    pFreqStri2 = createInternalTriggerParameter("freqStri2", 2.001, 0.1, 10);
+    pFreqStri3 = createInternalTriggerParameter("freqStri3", 3.0, 0.1, 10);
+    pFreqLow1 = createInternalTriggerParameter("freqLow1", 4.009, 0.1, 10);
+    pFreqLow2 = createInternalTriggerParameter("freqLow2", 5.002, 0.1, 10);
+    pFreqUp1 = createInternalTriggerParameter("freqUp1", 6.0, 0.1, 10);
+    pFreqUp2 = createInternalTriggerParameter("freqUp2", 7.0, 0.1, 10);
+    pFreqUp3 = createInternalTriggerParameter("freqUp3", 8.0, 0.1, 10);
+    pFreqUp4 = createInternalTriggerParameter("freqUp4", 9.0, 0.1, 10);
+    pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
   }
 
   virtual void onProcess(AudioIOData &io) override
   {
+    PLAYGROUND_DSP_VOICE(this);
     // Parameters will update values once per audio callback
-    float freq = getInternalParameterValue("frequency");
-    mOsc.freq(freq);
-    mOsc1.freq(getInternalParameterValue("freqStri1") * freq);
-    mOsc2.freq(getInternalParameterValue("freqStri2") * freq);
-    mOsc3.freq(getInternalParameterValue("freqStri3") * freq);
-    mOsc4.freq(getInternalParameterValue("freqLow1") * freq);
-    mOsc5.freq(getInternalParameterValue("freqLow2") * freq);
-    mOsc6.freq(getInternalParameterValue("freqUp1") * freq);
-    mOsc7.freq(getInternalParameterValue("freqUp2") * freq);
-    mOsc8.freq(getInternalParameterValue("freqUp3") * freq);
-    mOsc9.freq(getInternalParameterValue("freqUp4") * freq);
-    mPan.pos(getInternalParameterValue("pan"));
-    float ampStri = getInternalParameterValue("ampStri");
-    float ampUp = getInternalParameterValue("ampUp");
-    float ampLow = getInternalParameterValue("ampLow");
-    float amp = getInternalParameterValue("amp");
+    float freq = pFrequency.get();
+    mStri.sampleRate(io.framesPerSecond());
+    mLow.sampleRate(io.framesPerSecond());
+    mUp.sampleRate(io.framesPerSecond());
+    mStri.freq(0, pFreqStri1.get() * freq);
+    mStri.freq(1, pFreqStri2.get() * freq);
+    mStri.freq(2, pFreqStri3.get() * freq);
+    mLow.freq(0, pFreqLow1.get() * freq);
+    mLow.freq(1, pFreqLow2.get() * freq);
+    mUp.freq(0, pFreqUp1.get() * freq);
+    mUp.freq(1, pFreqUp2.get() * freq);
+    mUp.freq(2, pFreqUp3.get() * freq);
+    mUp.freq(3, pFreqUp4.get() * freq);
+    mPan.pos(pPan.get());
+    // Fold the group and overall amplitudes into the partial amplitudes so
+    // each group costs one envelope multiply per sample
+    float amp = pAmp.get();
+    for (int k = 0; k < 3; k++)
+      mStri.amp(k, pAmpStri.get() * amp);
+    for (int k = 0; k < 2; k++)
+      mLow.amp(k, pAmpLow.get() * amp);
+    for (int k = 0; k < 4; k++)
+      mUp.amp(k, pAmpUp.get() * amp);
+    int i = 0, n = 0;
     while (io())
     {
-      float s1 = (mOsc1() + mOsc2() + mOsc3()) * mEnvStri() * ampStri;
-      s1 += (mOsc4() + mOsc5()) * mEnvLow() * ampLow;
-      s1 += (mOsc6() + mOsc7() + mOsc8() + mOsc9()) * mEnvUp() * ampUp;
-      s1 *= amp;
+      if (i == n)
+      { // Render the partials for the next chunk of the block
+        n = std::min(int(io.framesPerBuffer()) - int(io.frame()), int(kBlock));
+        mStri.render(mStriBuf, n);
+        mLow.render(mLowBuf, n);
+        mUp.render(mUpBuf, n);
+        i = 0;
+      }
+      float s1 = mStriBuf[i] * mEnvStri() + mLowBuf[i] * mEnvLow() +
+                 mUpBuf[i] * mEnvUp();
+      i++;
       float s2;
       mEnvFollow(s1);
       mPan(s1, s1, s2);
@@ -1527,53 +1189,51 @@ public:
       free();
   }
 
-  virtual void onProcess(Graphics &g)
+  virtual void onProcess(Graphics &)
   {
     a += 0.29;
     b += 0.23;
     timepose += 0.02;
     // Get the paramter values on every video frame, to apply changes to the
     // current instance
-    float frequency = getInternalParameterValue("frequency");
-    float amplitude = getInternalParameterValue("amplitude");
+    float frequency = pFrequency.get();
     // Now draw
-    g.pushMatrix();
-    g.depthTesting(true);
-    g.lighting(true);
-    g.translate(Vec3f(0, 0, -15));
-    // g.translate(note_position + note_direction * timepose);
-    g.rotate(a, Vec3f(0, 1, 0));
-    g.rotate(b, Vec3f(1));
-    g.scale(0.3 + mEnvStri() * 0.2, 0.3 + mEnvStri() * 0.5, 1);
-    g.color(HSV(frequency / 1000, 0.5 + mEnvStri() * 0.1, 0.3 + 0.5 * mEnvStri()));
-    g.draw(ball);
-    g.popMatrix();
+    playground::InstanceBatch::Transform t;
+    t.translate(Vec3f(0, 0, -15));
+    // t.translate(note_position + note_direction * timepose);
+    t.rotate(a, Vec3f(0, 1, 0));
+    t.rotate(b, Vec3f(1));
+    t.scale(0.3 + mEnvStri() * 0.2, 0.3 + mEnvStri() * 0.5, 1);
+    voiceMeshes.add(ball, t, HSV(frequency / 1000, 0.5 + mEnvStri() * 0.1, 0.3 + 0.5 * mEnvStri()));
   }
 
   virtual void onTriggerOn() override
   {
 
-    mEnvStri.attack(getInternalParameterValue("attackStri"));
-    mEnvStri.decay(getInternalParameterValue("attackStri"));
-    mEnvStri.sustain(getInternalParameterValue("sustainStri"));
-    mEnvStri.release(getInternalParameterValue("releaseStri"));
+    mEnvStri.attack(pAttackStri.get());
+    mEnvStri.decay(pAttackStri.get());
+    mEnvStri.sustain(pSustainStri.get());
+    mEnvStri.release(pReleaseStri.get());
 
-    mEnvLow.attack(getInternalParameterValue("attackLow"));
-    mEnvLow.decay(getInternalParameterValue("attackLow"));
-    mEnvLow.sustain(getInternalParameterValue("sustainLow"));
-    mEnvLow.release(getInternalParameterValue("releaseLow"));
+    mEnvLow.attack(pAttackLow.get());
+    mEnvLow.decay(pAttackLow.get());
+    mEnvLow.sustain(pSustainLow.get());
+    mEnvLow.release(pReleaseLow.get());
 
-    mEnvUp.attack(getInternalParameterValue("attackUp"));
-    mEnvUp.decay(getInternalParameterValue("attackUp"));
-    mEnvUp.sustain(getInternalParameterValue("sustainUp"));
-    mEnvUp.release(getInternalParameterValue("releaseUp"));
+    mEnvUp.attack(pAttackUp.get());
+    mEnvUp.decay(pAttackUp.get());
+    mEnvUp.sustain(pSustainUp.get());
+    mEnvUp.release(pReleaseUp.get());
 
-    mPan.pos(getInternalParameterValue("pan"));
+    mPan.pos(pPan.get());
 
     mEnvStri.reset();
     mEnvLow.reset();
     mEnvUp.reset();
-    float angle = getInternalParameterValue("frequency") / 200;
+    mStri.reset();
+    mLow.reset();
+    mUp.reset();
+    float angle = pFrequency.get() / 200;
 
     a = al::rnd::uniform();
     b = al::rnd::uniform();
@@ -1605,12 +1265,17 @@ public:
     gam::Env<2> mCFEnv;
     gam::Env<2> mBWEnv;
     // Additional members
-    Mesh mMesh;
+    int mMesh; // in voiceMeshes
     double a = 0;
     double b = 0;
     double timepose = 0;
     Vec3f note_position;
     Vec3f note_direction;
+    // Parameter handles, resolved once in init()
+    ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pSustain,
+        pCurve, pNoise, pEnvDur, pCf1, pCf2, pCfRise, pBw1, pBw2, pBwRise,
+        pHmnum, pHmamp, pPan;
+
     // Initialize voice. This function will nly be called once per voice
     void init() override
     {
@@ -1621,36 +1286,35 @@ public:
         mBWEnv.curve(0);
         mOsc.harmonics(12);
         // We have the mesh be a sphere
-        addSphere(mMesh, 1, 100, 100);
-        mMesh.decompress();
-        mMesh.generateNormals();
-
-        createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-        createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
-        createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
-        createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("noise", 0.0, 0.0, 1.0);
-        createInternalTriggerParameter("envDur", 1, 0.0, 5.0);
-        createInternalTriggerParameter("cf1", 400.0, 10.0, 5000);
-        createInternalTriggerParameter("cf2", 400.0, 10.0, 5000);
-        createInternalTriggerParameter("cfRise", 0.5, 0.1, 2);
-        createInternalTriggerParameter("bw1", 700.0, 10.0, 5000);
-        createInternalTriggerParameter("bw2", 900.0, 10.0, 5000);
-        createInternalTriggerParameter("bwRise", 0.5, 0.1, 2);
-        createInternalTriggerParameter("hmnum", 12.0, 5.0, 20.0);
-        createInternalTriggerParameter("hmamp", 1.0, 0.0, 1.0);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+        mMesh = ballMesh();
+
+        pAmplitude = createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
+        pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+        pAttackTime = createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
+        pReleaseTime = createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
+        pSustain = createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
+        pCurve = createInternalTriggerParameter("curve", 4.0, -10.0, 10.0);
+        pNoise = createInternalTriggerParameter("noise", 0.0, 0.0, 1.0);
+        pEnvDur = createInternalTriggerParameter("envDur", 1, 0.0, 5.0);
+        pCf1 = createInternalTriggerParameter("cf1", 400.0, 10.0, 5000);
+        pCf2 = createInternalTriggerParameter("cf2", 400.0, 10.0, 5000);
+        pCfRise = createInternalTriggerParameter("cfRise", 0.5, 0.1, 2);
+        pBw1 = createInternalTriggerParameter("bw1", 700.0, 10.0, 5000);
+        pBw2 = createInternalTriggerParameter("bw2", 900.0, 10.0, 5000);
+        pBwRise = createInternalTriggerParameter("bwRise", 0.5, 0.1, 2);
+        pHmnum = createInternalTriggerParameter("hmnum", 12.0, 5.0, 20.0);
+        pHmamp = createInternalTriggerParameter("hmamp", 1.0, 0.0, 1.0);
+        pPan = createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
     }
 
     //
 
     virtual void onProcess(AudioIOData &io) override
     {
+        PLAYGROUND_DSP_VOICE(this);
         updateFromParameters();
-        float amp = getInternalParameterValue("amplitude");
-        float noiseMix = getInternalParameterValue("noise");
+        float amp = pAmplitude.get();
+        float noiseMix = pNoise.get();
         while (io())
         {
             // mix oscillator with noise
@@ -1673,27 +1337,23 @@ public:
             free();
     }
 
-    virtual void onProcess(Graphics &g)
+    virtual void onProcess(Graphics &)
     {
         a += 0.29;
         b += 0.23;
         timepose += 0.02;
         // Get the paramter values on every video frame, to apply changes to the
         // current instance
-        float frequency = getInternalParameterValue("frequency");
-        float amplitude = getInternalParameterValue("amplitude");
+        float frequency = pFrequency.get();
+        float amplitude = pAmplitude.get();
         // Now draw
-        g.pushMatrix();
-        g.depthTesting(true);
-        g.lighting(true);
-        // g.translate(note_position);
-        g.translate(note_position + note_direction * timepose);
-        g.rotate(a, Vec3f(mCFEnv(), mBWEnv(), 0));
-        g.rotate(b, Vec3f(mNoise()));
-        g.scale(mCFEnv()/ 10000, mBWEnv()/ 10000,  0.3 + 0.1*mNoise());
-        g.color(HSV(frequency / 1000, 0.5 + mOsc() * 0.1, 0.3 + 0.1*mNoise()));
-        g.draw(mMesh);
-        g.popMatrix();
+        playground::InstanceBatch::Transform t;
+        // t.translate(note_position);
+        t.translate(note_position + note_direction * timepose);
+        t.rotate(a, Vec3f(mCFEnv(), mBWEnv(), 0));
+        t.rotate(b, Vec3f(mNoise()));
+        t.scale(mCFEnv()/ 10000, mBWEnv()/ 10000,  0.3 + 0.1*mNoise());
+        voiceMeshes.add(mMesh, t, HSV(frequency / 1000, 0.5 + mOsc() * 0.1, 0.3 + 0.1*mNoise()));
     }
     virtual void onTriggerOn() override
     {
@@ -1705,7 +1365,7 @@ public:
         b = al::rnd::uniform();
         timepose = 0;
         note_position = {0, 0, -15};
-        float angle = getInternalParameterValue("frequency") / 200;
+        float angle = pFrequency.get() / 200;
         note_direction = {sin(angle), cos(angle), 0};
     }
 
@@ -1718,36 +1378,36 @@ public:
 
     void updateFromParameters()
     {
-        mOsc.freq(getInternalParameterValue("frequency"));
-        mOsc.harmonics(getInternalParameterValue("hmnum"));
-        mOsc.ampRatio(getInternalParameterValue("hmamp"));
-        mAmpEnv.attack(getInternalParameterValue("attackTime"));
-        //    mAmpEnv.decay(getInternalParameterValue("attackTime"));
-        mAmpEnv.release(getInternalParameterValue("releaseTime"));
-        mAmpEnv.levels()[1] = getInternalParameterValue("sustain");
-        mAmpEnv.levels()[2] = getInternalParameterValue("sustain");
-
-        mAmpEnv.curve(getInternalParameterValue("curve"));
-        mPan.pos(getInternalParameterValue("pan"));
-        mCFEnv.levels(getInternalParameterValue("cf1"),
-                      getInternalParameterValue("cf2"),
-                      getInternalParameterValue("cf1"));
-
-        mCFEnv.lengths()[0] = getInternalParameterValue("cfRise");
-        mCFEnv.lengths()[1] = 1 - getInternalParameterValue("cfRise");
-        mBWEnv.levels(getInternalParameterValue("bw1"),
-                      getInternalParameterValue("bw2"),
-                      getInternalParameterValue("bw1"));
-        mBWEnv.lengths()[0] = getInternalParameterValue("bwRise");
-        mBWEnv.lengths()[1] = 1 - getInternalParameterValue("bwRise");
-
-        mCFEnv.totalLength(getInternalParameterValue("envDur"));
-        mBWEnv.totalLength(getInternalParameterValue("envDur"));
+        mOsc.freq(pFrequency.get());
+        mOsc.harmonics(pHmnum.get());
+        mOsc.ampRatio(pHmamp.get());
+        mAmpEnv.attack(pAttackTime.get());
+        //    mAmpEnv.decay(pAttackTime.get());
+        mAmpEnv.release(pReleaseTime.get());
+        mAmpEnv.levels()[1] = pSustain.get();
+        mAmpEnv.levels()[2] = pSustain.get();
+
+        mAmpEnv.curve(pCurve.get());
+        mPan.pos(pPan.get());
+        mCFEnv.levels(pCf1.get(),
+                      pCf2.get(),
+                      pCf1.get());
+
+        mCFEnv.lengths()[0] = pCfRise.get();
+        mCFEnv.lengths()[1] = 1 - pCfRise.get();
+        mBWEnv.levels(pBw1.get(),
+                      pBw2.get(),
+                      pBw1.get());
+        mBWEnv.lengths()[0] = pBwRise.get();
+        mBWEnv.lengths()[1] = 1 - pBwRise.get();
+
+        mCFEnv.totalLength(pEnvDur.get());
+        mBWEnv.totalLength(pEnvDur.get());
     }
 };
 
 // 09 Plucked_string
-class PluckedString : public SynthVoice
+class PluckedString : public SynthVoice, public PreparedVoice
 {
 public:
     float mAmp;
@@ -1761,7 +1421,7 @@ public:
     gam::ADSR<> mAmpEnv;
     gam::EnvFollow<> mEnvFollow;
     gam::Env<2> mPanEnv;
-    gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+    int mSpectrumChannel; // in voiceSpectra
     // This time, let's use spectrograms for each notes as the visual components.
     Mesh mSpectrogram;
     vector<float> spectrum;
@@ -1771,10 +1431,15 @@ public:
     // Additional members
     Mesh mMesh;
 
+    // Parameter handles, resolved once in init()
+    ParameterHandle pAmplitude, pFrequency, pAttackTime, pReleaseTime, pSustain,
+        pPan1, pPan2, pPanRise;
+
     virtual void init() override
     {
         // Declare the size of the spectrum
         spectrum.resize(FFT_SIZE / 2 + 1);
+        mSpectrumChannel = voiceSpectra.addChannel();
         mSpectrogram.primitive(Mesh::POINTS);
         mAmpEnv.levels(0, 1, 1, 0);
         mPanEnv.curve(4);
@@ -1783,14 +1448,14 @@ public:
         delay.delay(1. / 440.0);
 
         addDisc(mMesh, 1.0, 30);
-        createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("attackTime", 0.001, 0.001, 1.0);
-        createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
-        createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
-        createInternalTriggerParameter("Pan1", 0.0, -1.0, 1.0);
-        createInternalTriggerParameter("Pan2", 0.0, -1.0, 1.0);
-        createInternalTriggerParameter("PanRise", 0.0, 0, 3.0); // range check
+        pAmplitude = createInternalTriggerParameter("amplitude", 0.1, 0.0, 1.0);
+        pFrequency = createInternalTriggerParameter("frequency", 60, 20, 5000);
+        pAttackTime = createInternalTriggerParameter("attackTime", 0.001, 0.001, 1.0);
+        pReleaseTime = createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
+        pSustain = createInternalTriggerParameter("sustain", 0.7, 0.0, 1.0);
+        pPan1 = createInternalTriggerParameter("Pan1", 0.0, -1.0, 1.0);
+        pPan2 = createInternalTriggerParameter("Pan2", 0.0, -1.0, 1.0);
+        pPanRise = createInternalTriggerParameter("PanRise", 0.0, 0, 3.0); // range check
     }
 
     //    void reset(){ env.reset(); }
@@ -1807,6 +1472,7 @@ public:
 
     virtual void onProcess(AudioIOData &io) override
     {
+        PLAYGROUND_DSP_VOICE(this);
 
         while (io())
         {
@@ -1817,24 +1483,18 @@ public:
             mPan(s1, s1, s2);
             io.out(0) += s1;
             io.out(1) += s2;
-            // STFT for each notes
-            if (stft(s1))
-            { // Loop through all the frequency bins
-                for (unsigned k = 0; k < stft.numBins(); ++k)
-                {
-                    // Here we simply scale the complex sample
-                    spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-                }
-            }
+            // Spectrum for each note, analyzed by voiceSpectra
+            voiceSpectra.push(mSpectrumChannel, s1);
         }
+        voiceSpectra.publish(mSpectrumChannel);
         if (mAmpEnv.done() && (mEnvFollow.value() < 0.001))
             free();
     }
 
     virtual void onProcess(Graphics &g) override
     {
-        float frequency = getInternalParameterValue("frequency");
-        float amplitude = getInternalParameterValue("amplitude");
+        float frequency = pFrequency.get();
+        float amplitude = pAmplitude.get();
         a += 0.29;
         b += 0.23;
         timepose -= 0.1;
@@ -1842,8 +1502,11 @@ public:
         mSpectrogram.reset();
         // mSpectrogram.primitive(Mesh::LINE_STRIP);
 
+        const float *magnitudes = voiceSpectra.spectrum(mSpectrumChannel);
         for (int i = 0; i < FFT_SIZE / 2; i++)
         {
+            // Here we simply scale the magnitude
+            spectrum[i] = tanh(pow(magnitudes[i], 1.3));
             mSpectrogram.color(HSV(0.5 - spectrum[i] * 100));
             mSpectrogram.vertex(i, spectrum[i], 0.0);
         }
@@ -1858,13 +1521,20 @@ public:
         g.popMatrix();
     }
 
+    // Clearing the delay line is the costly part of a new note, so it is
+    // done here, off the audio thread when the voice is staged
+    virtual void onPrepare() override
+    {
+        updateFromParameters();
+        delay.zero();
+    }
+
     virtual void onTriggerOn() override
     {
+        ensurePrepared();
         mAmpEnv.reset();
         timepose = 10;
-        updateFromParameters();
         env.reset();
-        delay.zero();
         mPanEnv.reset();
     }
 
@@ -1875,16 +1545,16 @@ public:
 
     void updateFromParameters()
     {
-        mPanEnv.levels(getInternalParameterValue("Pan1"),
-                       getInternalParameterValue("Pan2"),
-                       getInternalParameterValue("Pan1"));
-        mPanRise = getInternalParameterValue("PanRise");
-        delay.freq(getInternalParameterValue("frequency"));
-        mAmp = getInternalParameterValue("amplitude");
+        mPanEnv.levels(pPan1.get(),
+                       pPan2.get(),
+                       pPan1.get());
+        mPanRise = pPanRise.get();
+        delay.freq(pFrequency.get());
+        mAmp = pAmplitude.get();
         mAmpEnv.levels()[1] = 1.0;
-        mAmpEnv.levels()[2] = getInternalParameterValue("sustain");
-        mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
-        mAmpEnv.lengths()[3] = getInternalParameterValue("releaseTime");
+        mAmpEnv.levels()[2] = pSustain.get();
+        mAmpEnv.lengths()[0] = pAttackTime.get();
+        mAmpEnv.lengths()[3] = pReleaseTime.get();
         mPanEnv.lengths()[0] = mPanRise;
         mPanEnv.lengths()[1] = mPanRise;
     }
@@ -0,0 +1,217 @@
+// Voices-per-core benchmark for the instrument library
+//
+// Renders every voice class in _instrument_classes.cpp through a PolySynth
+// without an audio device and reports how many voices of each class fit on
+// one core in real time. LegacySineEnv reads its parameters by name inside
+// the sample loop, the way the library did before it was ported to
+// ParameterHandle, so its row is the "before" figure for SineEnv.
+//
+// The last section renders the same mix of voices through PolySynth and
+// ParallelPolySynth, and checks that the deterministic mode of the parallel
+// renderer reproduces the serial output bit for bit. The mix leaves out the
+// voices with noise generators, which are seeded differently per instance.
+//
+// Usage: ./bench_voices_per_core [voices] [seconds] [blockSize]
+//   defaults: 64 voices, 10 seconds of audio, 128 frame blocks at 48 kHz
+
+#include <chrono>
+#include <cstdio> // for printing to stdout
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "_instrument_classes.cpp"
+#include "playground/ParallelPolySynth.hpp"
+
+// SineEnv as it was before the port: every parameter read is a string lookup
+class LegacySineEnv : public SynthVoice
+{
+public:
+  gam::Pan<> mPan;
+  gam::Sine<> mOsc;
+  gam::Env<3> mAmpEnv;
+  gam::EnvFollow<> mEnvFollow;
+
+  void init() override
+  {
+    mAmpEnv.curve(0);
+    mAmpEnv.levels(0, 1, 1, 0);
+    mAmpEnv.sustainPoint(2);
+
+    createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
+    createInternalTriggerParameter("frequency", 60, 20, 5000);
+    createInternalTriggerParameter("attackTime", 1.0, 0.01, 3.0);
+    createInternalTriggerParameter("releaseTime", 3.0, 0.1, 10.0);
+    createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+  }
+
+  void onProcess(AudioIOData &io) override
+  {
+    mOsc.freq(getInternalParameterValue("frequency"));
+    mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
+    mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
+    mPan.pos(getInternalParameterValue("pan"));
+    while (io())
+    {
+      float s1 = mOsc() * mAmpEnv() * getInternalParameterValue("amplitude");
+      float s2;
+      mEnvFollow(s1);
+      mPan(s1, s1, s2);
+      io.out(0) += s1;
+      io.out(1) += s2;
+    }
+    if (mAmpEnv.done() && (mEnvFollow.value() < 0.001f))
+      free();
+  }
+
+  void onTriggerOn() override { mAmpEnv.reset(); }
+  void onTriggerOff() override { mAmpEnv.release(); }
+};
+
+struct BenchConfig
+{
+  int voices = 64;
+  double seconds = 10.0;
+  int blockSize = 128;
+  double sampleRate = 48000.0;
+};
+
+// Returns the number of voices of class TVoice one core can render in real
+// time, extrapolated from rendering config.voices of them for config.seconds.
+template <class TVoice>
+double voicesPerCore(const char *name, const BenchConfig &config)
+{
+  AudioIOData io;
+  io.framesPerSecond(config.sampleRate);
+  io.framesPerBuffer(config.blockSize);
+  io.channelsOut(2);
+
+  PolySynth synth;
+  synth.allocatePolyphony<TVoice>(config.voices);
+  for (int i = 0; i < config.voices; i++)
+  {
+    auto *voice = synth.getVoice<TVoice>();
+    // Spread the voices over a few octaves so they don't phase-align
+    voice->setInternalParameterValue("frequency", 110.0f * (1 + i % 24));
+    synth.triggerOn(voice, 0, i);
+  }
+
+  const int numBlocks =
+      int(config.seconds * config.sampleRate / config.blockSize);
+  auto start = std::chrono::steady_clock::now();
+  for (int block = 0; block < numBlocks; block++)
+  {
+    io.zeroOut();
+    synth.render(io);
+  }
+  auto end = std::chrono::steady_clock::now();
+  synth.allNotesOff();
+
+  double elapsed = std::chrono::duration<double>(end - start).count();
+  double load = elapsed / config.seconds; // fraction of one core
+  double perCore = config.voices / load;
+  printf("%-16s %8.2f %% of a core for %d voices  -> %8.0f voices/core\n",
+         name, 100.0 * load, config.voices, perCore);
+  return perCore;
+}
+
+// Render a mix of voices through synth, returning channel 0 of every block
+// and the elapsed time in seconds
+std::vector<float> renderMix(PolySynth &synth, const BenchConfig &config,
+                             double &elapsed)
+{
+  AudioIOData io;
+  io.framesPerSecond(config.sampleRate);
+  io.framesPerBuffer(config.blockSize);
+  io.channelsOut(2);
+  synth.prepare(io);
+
+  for (int i = 0; i < config.voices; i++)
+  {
+    SynthVoice *voice;
+    if (i % 3 == 0)
+      voice = synth.getVoice<AddSyn>();
+    else if (i % 3 == 1)
+      voice = synth.getVoice<FM>();
+    else
+      voice = synth.getVoice<SineEnv>();
+    voice->setInternalParameterValue("frequency", 110.0f * (1 + i % 24));
+    synth.triggerOn(voice, 0, i);
+  }
+
+  const int numBlocks =
+      int(config.seconds * config.sampleRate / config.blockSize);
+  std::vector<float> out;
+  out.reserve(size_t(numBlocks) * config.blockSize);
+  auto start = std::chrono::steady_clock::now();
+  for (int block = 0; block < numBlocks; block++)
+  {
+    io.zeroOut();
+    synth.render(io);
+    out.insert(out.end(), io.outBuffer(0), io.outBuffer(0) + config.blockSize);
+  }
+  elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          start)
+                .count();
+  synth.allNotesOff();
+  return out;
+}
+
+void parallelSpeedup(const BenchConfig &config)
+{
+  double serialTime, parallelTime, deterministicTime;
+  PolySynth serial;
+  std::vector<float> reference = renderMix(serial, config, serialTime);
+
+  playground::ParallelPolySynth parallel;
+  renderMix(parallel, config, parallelTime);
+
+  playground::ParallelPolySynth deterministic;
+  deterministic.pool().deterministic(true);
+  std::vector<float> exact = renderMix(deterministic, config, deterministicTime);
+  bool identical = exact.size() == reference.size() &&
+                   memcmp(exact.data(), reference.data(),
+                          exact.size() * sizeof(float)) == 0;
+
+  printf("\nAddSyn + FM + SineEnv mix, %d voices, %d worker threads\n",
+         config.voices, parallel.pool().numWorkers());
+  printf("PolySynth          %8.3f s\n", serialTime);
+  printf("ParallelPolySynth  %8.3f s  (%.2fx)\n", parallelTime,
+         serialTime / parallelTime);
+  printf("  deterministic    %8.3f s  (%.2fx), output %s\n",
+         deterministicTime, serialTime / deterministicTime,
+         identical ? "bit identical to PolySynth" : "DIFFERS from PolySynth");
+}
+
+int main(int argc, char *argv[])
+{
+  BenchConfig config;
+  if (argc > 1)
+    config.voices = atoi(argv[1]);
+  if (argc > 2)
+    config.seconds = atof(argv[2]);
+  if (argc > 3)
+    config.blockSize = atoi(argv[3]);
+
+  gam::sampleRate(config.sampleRate);
+  printf("%d voices, %.1f s of audio, %d frame blocks @ %.0f Hz\n\n",
+         config.voices, config.seconds, config.blockSize, config.sampleRate);
+
+  double before = voicesPerCore<LegacySineEnv>("SineEnv (legacy)", config);
+  double after = voicesPerCore<SineEnv>("SineEnv", config);
+  voicesPerCore<OscEnv>("OscEnv", config);
+  voicesPerCore<Vib>("Vib", config);
+  voicesPerCore<FM>("FM", config);
+  voicesPerCore<FMWT>("FMWT", config);
+  voicesPerCore<OscTrm>("OscTrm", config);
+  voicesPerCore<OscAM>("OscAM", config);
+  voicesPerCore<AddSyn>("AddSyn", config);
+  voicesPerCore<Sub>("Sub", config);
+  voicesPerCore<PluckedString>("PluckedString", config);
+
+  printf("\nSineEnv parameter handles: %.2fx the voices of name lookups\n",
+         after / before);
+
+  parallelSpeedup(config);
+  return 0;
+}
@@ -12,6 +12,8 @@
 #include "al/ui/al_ControlGUI.hpp"
 #include "al/ui/al_Parameter.hpp"
 
+#include "playground/EventQueue.hpp"
+
 // using namespace gam;
 using namespace al;
 
@@ -102,6 +104,12 @@ public:
   // where the presets and sequences are stored
   SynthGUIManager<SquareWave> synthManager{"SquareWave"};
 
+  // Notes are scheduled from the UI thread through a lock-free queue and
+  // started by the audio thread at their exact frame
+  playground::EventQueue mEvents;
+  playground::EventQueue::Producer mUiEvents;
+  uint64_t mSequenceStart = 0; // frame the current sequence is timed from
+
   // This function is called right after the window is created
   // It provides a grphics context to initialize ParameterGUI
   // It's also a good place to put things that should
@@ -114,6 +122,10 @@ public:
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
 
+    // Create the voices up front so scheduling never allocates
+    synthManager.synth().allocatePolyphony<SquareWave>(64);
+    mUiEvents = mEvents.producer();
+
     imguiInit();
 
     // Play example sequence. Comment this line to start from scratch
@@ -124,6 +136,7 @@ public:
   // The audio callback function. Called when audio hardware requires data
   void onSound(AudioIOData &io) override
   {
+    mEvents.dispatch(synthManager.synth(), io); // Start notes due this block
     synthManager.render(io); // Render audio
   }
 
@@ -133,6 +146,18 @@ public:
     imguiBeginFrame();
     // Draw a window that contains the synth control panel
     synthManager.drawSynthControlPanel();
+    // How late notes started relative to when they were scheduled
+    auto stats = mEvents.stats();
+    float msPerFrame = 1000.0f / audioIO().framesPerSecond();
+    ImGui::Begin("Scheduling");
+    ImGui::Text("notes %llu  late %llu  dropped %llu",
+                (unsigned long long)stats.dispatched,
+                (unsigned long long)stats.late,
+                (unsigned long long)stats.dropped);
+    ImGui::Text("late by %.2f ms on average, %.2f ms at most",
+                stats.meanLateFrames * msPerFrame,
+                stats.maxLateFrames * msPerFrame);
+    ImGui::End();
     imguiEndFrame();
   }
 
@@ -234,17 +259,26 @@ public:
 
   // New code: a function to play a note A
 
+  // time is in seconds from the start of the current sequence
   void playNote(float freq, float time, float duration = 0.5, float amp = 0.2, float attack = 0.1, float decay = 0.1)
   {
-    auto *voice = synthManager.synth().getVoice<SquareWave>();
+    // No voice while the event queue is full: the note is skipped
+    auto *voice = mUiEvents.getVoice<SquareWave>(synthManager.synth());
+    if (!voice)
+    {
+      printf("Event queue full, note at %.2f s skipped\n", time);
+      return;
+    }
     std::vector<al::VariantValue> params = std::vector<al::VariantValue>({amp, freq, attack, decay, 0.0});
     // amp, freq, attack, release, pan
     voice->setTriggerParams(params);
-    synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+    mUiEvents.noteOn(voice, mSequenceStart + mEvents.seconds(time),
+                     mEvents.seconds(duration));
   }
 
   void playSequenceA()
   {
+    mSequenceStart = mEvents.nowFrames();
     playNote(110.0, 0, 0.5, 0.1);
     playNote(220.0, 1, 0.5, 0.2);
     playNote(330.0, 2, 0.5, 0.4);
@@ -263,6 +297,8 @@ public:
 
     const float G3 = G4/2.0;
 
+    mSequenceStart = mEvents.nowFrames();
+
     playNote(C4 * offset, 0, 0.5, 0.1);
     playNote(D4 * offset, 1, 0.5, 0.2);
     playNote(E4 * offset, 2, 0.5, 0.3);
@@ -12,6 +12,9 @@
 #include "al/ui/al_ControlGUI.hpp"
 #include "al/ui/al_Parameter.hpp"
 
+#include "playground/ScoreFile.hpp"
+#include "playground/ScoreStreamer.hpp"
+
 #include <cassert>
 #include <vector>
 #include <cmath> // std::abs
@@ -21,38 +24,18 @@
 #include "SimpleCompressor/src/GainReductionComputer.h"
 #include "SimpleCompressor/src/GainReductionComputer.cpp"
 
+#include "playground/Compressor.hpp"
+#include "playground/RtSanitizer.hpp"
+
 // using namespace gam;
 using namespace al;
 
-const int BLOCK_SIZE = 128;
-
 float linearToDecibels(float linear)
 {
   return 20.f * std::log10(std::abs(linear));
 }
 
-float decibelsToLinear(float decibels)
-{
-  return std::pow(10.f, decibels / 20.f);
-}
-
-class CompressorStats
-{
-public:
-  float pre_peak;
-  float duck;
-  float post_peak;
-  CompressorStats(float pre_peak, float duck, float post_peak)
-  {
-    this->set(pre_peak, duck, post_peak);
-  };
-  void set(float pre_peak, float duck, float post_peak)
-  {
-    this->pre_peak = pre_peak;
-    this->duck = duck;
-    this->post_peak = post_peak;
-  };
-};
+using playground::CompressorStats;
 
 bool approxEqual(float l, float r)
 {
@@ -61,99 +44,9 @@ bool approxEqual(float l, float r)
 
 bool operator==(const CompressorStats &l, const CompressorStats &r)
 {
-  return approxEqual(l.pre_peak, r.pre_peak) && approxEqual(l.duck, r.duck) && approxEqual(l.post_peak, r.post_peak);
+  return approxEqual(l.prePeak, r.prePeak) && approxEqual(l.gain, r.gain) && approxEqual(l.postPeak, r.postPeak);
 }
 
-template <int block_size>
-class CompressorPlugin
-{
-public:
-  bool useLookAhead = false;
-  bool debug = true;
-
-  CompressorStats previousStats = CompressorStats(0.0f, 1.0f, 0.0f);
-
-  CompressorPlugin()
-  {
-    gain.prepare(48000.);
-    gain.setThreshold(-5.f);
-    gain.setRatio(100.f);
-    gain.setKnee(20.f);
-    gain.setAttackTime(0.0025f);
-
-    lookahead.setDelayTime(0.005f);
-    lookahead.prepare(48000., 2 * block_size);
-  };
-
-  AudioIOData &operator()(AudioIOData &io)
-  {
-    // TODO get look-ahead working
-    io.frame(0);
-    for (int i = 0; io() && i < BLOCK_SIZE; i++)
-    {
-      sidechain_buf[i] = std::max(std::abs(io.out(0)), std::abs(io.out(1)));
-    }
-
-    if (useLookAhead)
-    {
-      gain.computeGainInDecibelsFromSidechainSignal(sidechain_buf, gain_buf, block_size);
-    }
-    else
-    {
-      gain.computeLinearGainFromSidechainSignal(sidechain_buf, gain_buf, block_size);
-    }
-
-    if (useLookAhead)
-    {
-      lookahead.pushSamples(gain_buf, block_size);
-      lookahead.process();
-      lookahead.readSamples(look_buf, block_size);
-
-      for (int i = 0; i < block_size; i++)
-      {
-        gain_buf[i] = decibelsToLinear(look_buf[i]);
-      }
-    }
-
-    float pre_peak = 0;
-    float duck = 1;
-    float post_peak = 0;
-    io.frame(0);
-    for (int i = 0; io() && i < BLOCK_SIZE; i++)
-    {
-      pre_peak = std::max(pre_peak, std::abs(io.out(0)));
-      pre_peak = std::max(pre_peak, std::abs(io.out(1)));
-      duck = std::min(duck, gain_buf[i]);
-      io.out(0) *= gain_buf[i];
-      io.out(1) *= gain_buf[i];
-      post_peak = std::max(post_peak, std::abs(io.out(0)));
-      post_peak = std::max(post_peak, std::abs(io.out(1)));
-    }
-
-    if (debug)
-    {
-      CompressorStats currentStats(pre_peak, duck, post_peak);
-      if (!(currentStats == previousStats))
-      {
-        std::cout << std::fixed << std::setprecision(2);
-        std::cout << "pre_peak:  " << std::setw(10) << linearToDecibels(pre_peak) << " dB  "
-                  << "compress:  " << std::setw(10) << linearToDecibels(duck) << " dB  "
-                  << "post_peak: " << std::setw(10) << linearToDecibels(post_peak) << " dB" << std::endl;
-        previousStats = currentStats;
-      }
-    }
-
-    return io;
-  }
-
-private:
-  GainReductionComputer gain;
-  LookAheadGainReduction lookahead;
-
-  float sidechain_buf[block_size];
-  float gain_buf[block_size];
-  float look_buf[block_size];
-};
 
 enum Instrument
 {
@@ -278,6 +171,23 @@ public:
   {
     return &notes;
   }
+
+  // Write the notes to a .synthScore starting at startSeconds. The trigger
+  // parameters match what MyApp::playNote() sets on the voice.
+  void writeScore(playground::ScoreWriter &writer, float bpm,
+                  Instrument instrument, double startSeconds = 0.0)
+  {
+    float secondsPerBeat = 60.0f / bpm;
+    const char *voiceName = instrument == INSTR_FM ? "FM" : "SquareWave";
+    float pan = instrument == INSTR_FM ? 1.0f : -1.0f;
+    for (auto &note : notes)
+    {
+      // amplitude, frequency, attackTime, releaseTime, pan
+      writer.addNote(startSeconds + note.getTime() * secondsPerBeat,
+                     note.getDuration() * secondsPerBeat, voiceName,
+                     {note.getAmp(), note.getFreq(), 0.1f, 0.1f, pan});
+    }
+  }
 };
 
 // In a class that inherits from SynthVoice you will
@@ -476,7 +386,14 @@ public:
   // where the presets and sequences are stored
   SynthGUIManager<SquareWave> synthManager{"SquareWave"};
 
-  CompressorPlugin<BLOCK_SIZE> compressor;
+  playground::Compressor compressor;
+  bool compressorDebug = true;
+  CompressorStats previousStats;
+
+  // Long scores are streamed from a .synthScore file instead of being
+  // scheduled up front
+  playground::EventQueue mEvents;
+  playground::ScoreStreamer mStreamer{synthManager.synth(), mEvents};
 
   bool useCompressor = true;
 
@@ -491,6 +408,13 @@ public:
 
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    compressor.prepare(audioIO().framesPerSecond(), audioIO().channelsOut());
+
+    // The streamer creates voices by name
+    synthManager.synth().registerSynthClass<SquareWave>("SquareWave");
+    synthManager.synth().registerSynthClass<FM>("FM");
+    mEvents.sampleRate(audioIO().framesPerSecond());
+    mStreamer.startThread();
 
     imguiInit();
 
@@ -502,6 +426,8 @@ public:
   // The audio callback function. Called when audio hardware requires data
   void onSound(AudioIOData &io) override
   {
+    PLAYGROUND_RT_SCOPE("onSound"); // checked with -DPLAYGROUND_RT_SANITIZER
+    mEvents.dispatch(synthManager.synth(), io); // Start streamed notes
     synthManager.render(io); // Render audio
     if (useCompressor)
       compressor(io);
@@ -509,6 +435,24 @@ public:
 
   void onAnimate(double dt) override
   {
+    // Compressor levels are printed here rather than from the audio thread.
+    // Drain every block since the last frame and report the extremes.
+    CompressorStats currentStats;
+    size_t blocks = compressor.telemetry().drain([&](const CompressorStats &block)
+    {
+      currentStats.prePeak = std::max(currentStats.prePeak, block.prePeak);
+      currentStats.gain = std::min(currentStats.gain, block.gain);
+      currentStats.postPeak = std::max(currentStats.postPeak, block.postPeak);
+    });
+    if (compressorDebug && blocks > 0 && !(currentStats == previousStats))
+    {
+      std::cout << std::fixed << std::setprecision(2);
+      std::cout << "pre_peak:  " << std::setw(10) << linearToDecibels(currentStats.prePeak) << " dB  "
+                << "compress:  " << std::setw(10) << linearToDecibels(currentStats.gain) << " dB  "
+                << "post_peak: " << std::setw(10) << linearToDecibels(currentStats.postPeak) << " dB" << std::endl;
+      previousStats = currentStats;
+    }
+
     // The GUI is prepared here
     imguiBeginFrame();
     // Draw a window that contains the synth control panel
@@ -547,8 +491,27 @@ public:
 
     case '-':
       std::cout << "- pressed!" << std::endl;
-      compressor.debug = !compressor.debug;
-      std::cout << "compressor.debug=" << compressor.debug << std::endl;
+      compressorDebug = !compressorDebug;
+      std::cout << "compressorDebug=" << compressorDebug << std::endl;
+      return false;
+
+    case ']':
+      compressor.lookAhead(!compressor.lookAhead());
+      std::cout << "lookAhead=" << compressor.lookAhead() << " ("
+                << compressor.latency() << " frames latency)" << std::endl;
+      return false;
+
+    case 'z':
+      std::cout << "z pressed!" << std::endl;
+      // An hour of rounds, written to disk and streamed from there
+      writeScoreFJ("frere_jacques.synthScore", 120, 3600.0);
+      if (mStreamer.open("frere_jacques.synthScore"))
+        mStreamer.play();
+      return false;
+
+    case 'x':
+      std::cout << "x pressed!" << std::endl;
+      mStreamer.stop();
       return false;
 
     case '1':
@@ -628,7 +591,11 @@ public:
     return true;
   }
 
-  void onExit() override { imguiShutdown(); }
+  void onExit() override
+  {
+    mStreamer.stopThread();
+    imguiShutdown();
+  }
 
   // New code: a function to play a note A
 
@@ -763,6 +730,33 @@ public:
     Sequence *fjSequence = sequenceFJ(offset);
     playSequence(fjSequence, bpm, instrument);
   }
+
+  // Write the round over and over for the given number of seconds, with the
+  // FM voice entering two bars after the square wave each time
+  void writeScoreFJ(const std::string &path, float bpm, double seconds)
+  {
+    playground::ScoreWriter writer;
+    if (!writer.open(path))
+    {
+      std::cout << "Can't write " << path << std::endl;
+      return;
+    }
+    Sequence *fjSequence = sequenceFJ(1.0);
+    const double secondsPerBeat = 60.0 / bpm;
+    const double roundLength = 40 * secondsPerBeat; // 32 beats + 2 bars
+    for (double start = 0; start < seconds; start += roundLength)
+    {
+      fjSequence->writeScore(writer, bpm, INSTR_SQUARE, start);
+      fjSequence->writeScore(writer, bpm, INSTR_FM, start + 8 * secondsPerBeat);
+    }
+    delete fjSequence;
+    if (!writer.close())
+    {
+      std::cout << "Can't write " << path << " " << writer.error() << std::endl;
+      return;
+    }
+    std::cout << "Wrote " << path << std::endl;
+  }
 };
 
 int main()
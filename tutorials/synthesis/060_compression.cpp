@@ -23,6 +23,8 @@
 #include "SimpleCompressor/src/GainReductionComputer.h"
 #include "SimpleCompressor/src/GainReductionComputer.cpp"
 
+#include "playground/Compressor.hpp"
+
 // using namespace gam;
 using namespace al;
 
@@ -38,28 +40,7 @@ float linearToDecibels(float linear)
   return 20.f * std::log10(std::abs(linear));
 }
 
-float decibelsToLinear(float decibels)
-{
-  return std::pow(10.f, decibels / 20.f);
-}
-
-class CompressorStats
-{
-public:
-  float pre_peak;
-  float duck;
-  float post_peak;
-  CompressorStats(float pre_peak, float duck, float post_peak)
-  {
-    this->set(pre_peak, duck, post_peak);
-  };
-  void set(float pre_peak, float duck, float post_peak)
-  {
-    this->pre_peak = pre_peak;
-    this->duck = duck;
-    this->post_peak = post_peak;
-  };
-};
+using playground::CompressorStats;
 
 bool approxEqual(float l, float r)
 {
@@ -68,99 +49,9 @@ bool approxEqual(float l, float r)
 
 bool operator==(const CompressorStats &l, const CompressorStats &r)
 {
-  return approxEqual(l.pre_peak, r.pre_peak) && approxEqual(l.duck, r.duck) && approxEqual(l.post_peak, r.post_peak);
+  return approxEqual(l.prePeak, r.prePeak) && approxEqual(l.gain, r.gain) && approxEqual(l.postPeak, r.postPeak);
 }
 
-template <int block_size>
-class CompressorPlugin
-{
-public:
-  bool useLookAhead = false;
-  bool debug = true;
-
-  CompressorStats previousStats = CompressorStats(0.0f, 1.0f, 0.0f);
-
-  CompressorPlugin()
-  {
-    gain.prepare(48000.);
-    gain.setThreshold(-5.f);
-    gain.setRatio(100.f);
-    gain.setKnee(20.f);
-    gain.setAttackTime(0.0025f);
-
-    lookahead.setDelayTime(0.005f);
-    lookahead.prepare(48000., 2 * block_size);
-  };
-
-  AudioIOData &operator()(AudioIOData &io)
-  {
-    // TODO get look-ahead working
-    io.frame(0);
-    for (int i = 0; io() && i < BLOCK_SIZE; i++)
-    {
-      sidechain_buf[i] = std::max(std::abs(io.out(0)), std::abs(io.out(1)));
-    }
-
-    if (useLookAhead)
-    {
-      gain.computeGainInDecibelsFromSidechainSignal(sidechain_buf, gain_buf, block_size);
-    }
-    else
-    {
-      gain.computeLinearGainFromSidechainSignal(sidechain_buf, gain_buf, block_size);
-    }
-
-    if (useLookAhead)
-    {
-      lookahead.pushSamples(gain_buf, block_size);
-      lookahead.process();
-      lookahead.readSamples(look_buf, block_size);
-
-      for (int i = 0; i < block_size; i++)
-      {
-        gain_buf[i] = decibelsToLinear(look_buf[i]);
-      }
-    }
-
-    float pre_peak = 0;
-    float duck = 1;
-    float post_peak = 0;
-    io.frame(0);
-    for (int i = 0; io() && i < BLOCK_SIZE; i++)
-    {
-      pre_peak = std::max(pre_peak, std::abs(io.out(0)));
-      pre_peak = std::max(pre_peak, std::abs(io.out(1)));
-      duck = std::min(duck, gain_buf[i]);
-      io.out(0) *= gain_buf[i];
-      io.out(1) *= gain_buf[i];
-      post_peak = std::max(post_peak, std::abs(io.out(0)));
-      post_peak = std::max(post_peak, std::abs(io.out(1)));
-    }
-
-    if (debug)
-    {
-      CompressorStats currentStats(pre_peak, duck, post_peak);
-      if (!(currentStats == previousStats))
-      {
-        std::cout << std::fixed << std::setprecision(3);
-        std::cout << "pre_peak:  " << std::setw(10) << linearToDecibels(pre_peak) << " dB  "
-                  << "compress:  " << std::setw(10) << linearToDecibels(duck) << " dB  "
-                  << "post_peak: " << std::setw(10) << linearToDecibels(post_peak) << " dB" << std::endl;
-        previousStats = currentStats;
-      }
-    }
-
-    return io;
-  }
-
-private:
-  GainReductionComputer gain;
-  LookAheadGainReduction lookahead;
-
-  float sidechain_buf[block_size];
-  float gain_buf[block_size];
-  float look_buf[block_size];
-};
 
 class SineEnv : public SynthVoice
 {
@@ -266,7 +157,9 @@ public:
   // where the presets and sequences are stored
   SynthGUIManager<SineEnv> synthManager{"SineEnv"};
 
-  CompressorPlugin<BLOCK_SIZE> compressor;
+  playground::Compressor compressor;
+  bool compressorDebug = true;
+  CompressorStats previousStats;
 
   bool useCompressor = true;
 
@@ -369,6 +262,7 @@ public:
 
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    compressor.prepare(audioIO().framesPerSecond(), audioIO().channelsOut());
 
     imguiInit();
 
@@ -387,6 +281,24 @@ public:
 
   void onAnimate(double dt) override
   {
+    // Compressor levels are printed here rather than from the audio thread.
+    // Drain every block since the last frame and report the extremes.
+    CompressorStats currentStats;
+    size_t blocks = compressor.telemetry().drain([&](const CompressorStats &block)
+    {
+      currentStats.prePeak = std::max(currentStats.prePeak, block.prePeak);
+      currentStats.gain = std::min(currentStats.gain, block.gain);
+      currentStats.postPeak = std::max(currentStats.postPeak, block.postPeak);
+    });
+    if (compressorDebug && blocks > 0 && !(currentStats == previousStats))
+    {
+      std::cout << std::fixed << std::setprecision(2);
+      std::cout << "pre_peak:  " << std::setw(10) << linearToDecibels(currentStats.prePeak) << " dB  "
+                << "compress:  " << std::setw(10) << linearToDecibels(currentStats.gain) << " dB  "
+                << "post_peak: " << std::setw(10) << linearToDecibels(currentStats.postPeak) << " dB" << std::endl;
+      previousStats = currentStats;
+    }
+
     // The GUI is prepared here
     imguiBeginFrame();
     // Draw a window that contains the synth control panel
@@ -424,8 +336,14 @@ public:
 
       case '-':
         std::cout << "- pressed!" << std::endl;
-        compressor.debug = !compressor.debug;
-        std::cout << "compressor.debug=" << compressor.debug << std::endl;
+        compressorDebug = !compressorDebug;
+        std::cout << "compressorDebug=" << compressorDebug << std::endl;
+        return false;
+
+      case ']':
+        compressor.lookAhead(!compressor.lookAhead());
+        std::cout << "lookAhead=" << compressor.lookAhead() << " ("
+                  << compressor.latency() << " frames latency)" << std::endl;
         return false;
     }
 
@@ -23,6 +23,8 @@
 #include "SimpleCompressor/src/GainReductionComputer.h"
 #include "SimpleCompressor/src/GainReductionComputer.cpp"
 
+#include "playground/Compressor.hpp"
+
 // using namespace gam;
 using namespace al;
 
@@ -37,84 +39,6 @@ float linearToDecibels(float linear) {
   return 20.f * std::log10(std::abs(linear));
 }
 
-float decibelsToLinear(float decibels) {
-  return std::pow(10.f, decibels / 20.f);
-}
-
-template <int block_size>
-class CompressorPlugin {
-  public:
-  bool useLookAhead = false;
-  bool debug = true;
-
-  CompressorPlugin() {
-    gain.prepare(48000.);
-    gain.setThreshold(-5.f);
-    gain.setRatio(100.f);
-    gain.setKnee(20.f);
-    gain.setAttackTime(0.0025f);
-
-    lookahead.setDelayTime(0.005f);
-    lookahead.prepare(48000., 2 * block_size);
-  };
-
-  AudioIOData& operator()(AudioIOData& io) {
-    // TODO get look-ahead working
-    io.frame(0);
-    for (int i = 0; io() && i < BLOCK_SIZE; i++) {
-      sidechain_buf[i] = std::max(std::abs(io.out(0)), std::abs(io.out(1)));
-    }
-
-    if (useLookAhead) {
-      gain.computeGainInDecibelsFromSidechainSignal(sidechain_buf, gain_buf, block_size);
-    } else {
-      gain.computeLinearGainFromSidechainSignal(sidechain_buf, gain_buf, block_size);
-    }
-
-
-    if (useLookAhead) {
-      lookahead.pushSamples(gain_buf, block_size);
-      lookahead.process();
-      lookahead.readSamples(look_buf, block_size);
-
-      for (int i = 0; i < block_size; i++) {
-        gain_buf[i] = decibelsToLinear(look_buf[i]);
-      }
-    }
-
-    float pre_peak = 0;
-    float duck = 1;
-    float post_peak = 0;
-    io.frame(0);
-    for (int i = 0; io() && i < BLOCK_SIZE; i++) {
-      pre_peak = std::max(pre_peak, std::abs(io.out(0)));
-      pre_peak = std::max(pre_peak, std::abs(io.out(1)));
-      duck = std::min(duck, gain_buf[i]);
-      io.out(0) *= gain_buf[i];
-      io.out(1) *= gain_buf[i];
-      post_peak = std::max(post_peak, std::abs(io.out(0)));
-      post_peak = std::max(post_peak, std::abs(io.out(1)));
-    }
-
-    if (debug) {
-      std::cout << "pre_peak: " << linearToDecibels(pre_peak) << " dB" << std::endl;
-      std::cout << "compress: " << linearToDecibels(duck) << " dB" << std::endl;
-      std::cout << "post_peak: " << linearToDecibels(post_peak) << " dB" << std::endl;
-    }
-
-    return io;
-  }
-
-  private:
-  GainReductionComputer gain;
-  LookAheadGainReduction lookahead;
-
-  float sidechain_buf[block_size];
-  float gain_buf[block_size];
-  float look_buf[block_size];
-};
-
-
 class SineEnv : public SynthVoice {
  public:
   // Unit generators
@@ -212,7 +136,13 @@ class MyApp : public App, public MIDIMessageHandler {
   // where the presets and sequences are stored
   SynthGUIManager<SineEnv> synthManager{"SineEnv"};
 
-  CompressorPlugin<BLOCK_SIZE> compressor;
+  playground::Compressor compressor;
+  // Print the compressor levels, toggled with '-'
+  bool compressorDebug = true;
+  // Levels of the blocks since the last print
+  playground::CompressorStats printStats;
+  size_t printBlocks = 0;
+  double printTimer = 0.0;
 
   RtMidiIn midiIn;
 
@@ -300,6 +230,7 @@ class MyApp : public App, public MIDIMessageHandler {
 
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    compressor.prepare(audioIO().framesPerSecond(), audioIO().channelsOut());
 
     imguiInit();
 
@@ -315,6 +246,26 @@ class MyApp : public App, public MIDIMessageHandler {
   }
 
   void onAnimate(double dt) override {
+    // Compressor levels are printed here rather than from the audio thread,
+    // four times a second with the extremes of the blocks in between
+    printBlocks += compressor.telemetry().drain(
+        [&](const playground::CompressorStats &block) {
+          printStats.prePeak = std::max(printStats.prePeak, block.prePeak);
+          printStats.gain = std::min(printStats.gain, block.gain);
+          printStats.postPeak = std::max(printStats.postPeak, block.postPeak);
+        });
+    printTimer += dt;
+    if (printTimer >= 0.25) {
+      if (compressorDebug && printBlocks > 0) {
+        std::cout << "pre_peak: " << linearToDecibels(printStats.prePeak) << " dB" << std::endl;
+        std::cout << "compress: " << linearToDecibels(printStats.gain) << " dB" << std::endl;
+        std::cout << "post_peak: " << linearToDecibels(printStats.postPeak) << " dB" << std::endl;
+      }
+      printStats = playground::CompressorStats();
+      printBlocks = 0;
+      printTimer = 0.0;
+    }
+
     // The GUI is prepared here
     imguiBeginFrame();
     // Draw a window that contains the synth control panel
@@ -338,6 +289,11 @@ class MyApp : public App, public MIDIMessageHandler {
                                           // keyboard
       return true;
     }
+    if (k.key() == '-') {
+      compressorDebug = !compressorDebug;
+      std::cout << "compressorDebug=" << compressorDebug << std::endl;
+      return true;
+    }
     if (k.shift()) {
       // If shift pressed then keyboard sets preset
       int presetNumber = asciiToIndex(k.key());
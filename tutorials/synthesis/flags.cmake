@@ -0,0 +1,3 @@
+# playground/Compressor.hpp includes SimpleCompressor relative to the app
+# directory, where the synthesis tutorials keep it.
+set(app_include_dirs .)